@@ -1,6 +1,9 @@
 #pragma once
 #include <Arduino.h>
 #include <math.h>
+#include "frame_bus.h"
+#include "time_mgr.h"
+#include "profile.h"
 
 struct AdcReadings {
   int mv_vmid_sys = 0;
@@ -18,6 +21,49 @@ struct AdcReadings {
   float ibatt_dsg_a = 0.00f;
 };
 
+// Averaged frames go out on a FrameBus (see frame_bus.h): consumers read
+// them in place instead of copying them out. 8 slots: a handful of
+// consumers holding one Ref each plus the newest frame.
+typedef FrameBus<AdcReadings, 8> AdcBus;
+
+// An external converter (e.g. an I2C shunt monitor, see ina_src.h) for
+// some of the channels. The internal ADC keeps reading all of them; when
+// a frame is converted, fill() overwrites the fields the source has a
+// reading for, so a source that stops answering falls back to the ADC.
+class AdcSource {
+public:
+  virtual ~AdcSource() {}
+  virtual const char* name() const = 0;
+  // From ADCMgr::service(), every call. Must not block.
+  virtual void service() = 0;
+  // Overwrite the fields of out this source measures
+  virtual void fill(AdcReadings& out) = 0;
+};
+
+// Activity-adaptive rate (ADCMgr::setAdapt). Three rates:
+//   Idle    load and charge current below idleA, no step for idleMs:
+//           a slow tick, same frame period, a quarter of the reads
+//   Normal  startTimer()'s tick and samples per channel (adc_tick_us / adc_spc)
+//   Burst   a current step: a fast tick and short frames for burstMs
+//           after the last step, so the control path sees the new current
+//           within a frame or two instead of up to two 640 ms frames
+// A step is a current read stepA off its channel's last average, STEP_READS
+// reads in a row. The channels are read round-robin, so each current
+// channel comes up every 5 ticks: a step is seen within 2 * 5 ticks of the
+// rate it happens in (80 ms at Idle, 20 ms at Normal), and the first
+// Burst frame follows 5 * burstSpc * burstTickUs later (40 ms).
+struct AdcAdaptConfig {
+  bool     enabled     = true;
+  float    stepA       = 0.050f;
+  float    idleA       = Profile::BOARD.idleLoadA;   // IdleSleep's "load off"
+  uint32_t idleMs      = 5000;
+  uint32_t burstMs     = 2000;
+  uint32_t idleTickUs  = 8000;    // 125 reads/s, 640 ms frames
+  uint16_t idleSpc     = 16;
+  uint32_t burstTickUs = 1000;    // 1000 reads/s, 40 ms frames
+  uint16_t burstSpc    = 8;
+};
+
 class ADCMgr {
 public:
   void begin();
@@ -38,8 +84,56 @@ public:
   // Call frequently from loop() - consumes scheduled ticks and does a few ADC reads
   void service(uint8_t max_reads_per_call = 3);
 
-  // If a full averaged set is ready, copy into out and return true
-  bool fetchLatest(AdcReadings &out);
+  // Every full averaged set is converted straight into a bus slot and
+  // published there; subscribe with bus().subscribe()
+  AdcBus& bus() { return bus_; }
+
+  // Raw tap: called from service() for every ADC read (stream mode).
+  // ch is the index into the channel table (0=VOLT,1=NTC,2=LOAD,3=BCHG,4=BDSG).
+  typedef void (*RawSink)(uint8_t ch, int mv, uint32_t t_us);
+  void setRawSink(RawSink sink) { raw_sink_ = sink; }
+
+  // Load step tap: called from service() when the load channel's reads
+  // move stepA (AdcAdaptConfig) off its level STEP_READS in a row, once per
+  // step and at any rate, adaptive or not. dA is + for an attach, - for a
+  // detach; t_us is the first read past the step.
+  typedef void (*StepSink)(float dA, uint64_t t_us);
+  void setStepSink(StepSink sink) { step_sink_ = sink; }
+
+  // External source for some of the channels; nullptr = internal ADC only
+  void setSource(AdcSource* src) { src_ = src; }
+  AdcSource* source() const { return src_; }
+
+  // Random 0..1 ms delay before each read (dithers the averages).
+  // Costs up to half the loop time at high rates, so streaming turns it off.
+  void setJitter(bool on) { jitter_ = on; }
+
+  uint32_t tickUs() const { return tick_us_; }
+  int samplesPerChannel() const { return samples_per_ch_; }
+
+  // -------- Activity-adaptive rate (see AdcAdaptConfig) --------
+  enum class Rate : uint8_t { Idle, Normal, Burst };
+  static constexpr uint8_t RATE_COUNT = 3;
+  static constexpr uint8_t STEP_READS = 2;
+
+  void setAdapt(const AdcAdaptConfig& cfg);
+  // Fixed at the startTimer() rate while held (StreamMgr while streaming)
+  void holdRate(bool hold) { held_ = hold; }
+  // An event seen elsewhere (a charger change): Burst now
+  void burst();
+
+  Rate rate() const { return rate_; }
+  static const char* rateName(Rate r);
+  // Since begin(): time at each rate, Burst entries, ADC reads and the
+  // time service() spent reading (jitter included)
+  uint64_t rateUs(Rate r) const;
+  uint32_t bursts() const { return bursts_; }
+  uint32_t reads() const { return reads_; }
+  uint64_t busyUs() const { return busy_us_; }
+
+  // The startTimer() rate, which Normal runs at
+  uint32_t baseTickUs() const { return base_tick_us_; }
+  int baseSamplesPerChannel() const { return base_spc_; }
 
 private:
   int zero_load_mv = 0;
@@ -49,20 +143,30 @@ private:
   int adc_floor_mv = 0;
   int pminus_clamp_mv = 3;
 
-  // ---- Hardware constants (FROM YOUR FILES) ----
-  static constexpr float VIN_SCALE = 2.0f;
-  static constexpr float SHUNT_SENSE_OHMS = 0.050f;
-  static constexpr float GAIN_LOAD = 29.5f;
-  static constexpr float GAIN_BATT = 16.0f;
-float ntc_r_fixed = 10000.0f;   // Rfixed = 10k
-float ntc_r0      = 10000.0f;   // R25 = 10k
-float ntc_beta    = 4250.0f;    // datasheet beta
+  // ---- Hardware constants: the board profile (profile.h) ----
+  static constexpr float VIN_SCALE = Profile::BOARD.vinScale;
+  static constexpr float VBAT_OFF_V = Profile::BOARD.vbatOffV;
+  static constexpr float SHUNT_SENSE_OHMS = Profile::BOARD.shuntOhm;
+  static constexpr float GAIN_LOAD = Profile::BOARD.gainLoad;
+  static constexpr float GAIN_BATT = Profile::BOARD.gainBatt;
+  // amps per mV after the amplifier: a multiply instead of a divide per reading
+  static constexpr float A_PER_MV_LOAD = 1.0f / (1000.0f * GAIN_LOAD * SHUNT_SENSE_OHMS);
+  static constexpr float A_PER_MV_BATT = 1.0f / (1000.0f * GAIN_BATT * SHUNT_SENSE_OHMS);
+float ntc_r_fixed = Profile::BOARD.ntcRfixed;
+float ntc_r0      = Profile::BOARD.ntcR25;
+float ntc_beta    = Profile::BOARD.ntcBeta;
 
 
 private:
   int readMilliVoltsAvg(int pin, int samples);
-  float currentFromMv(int mv, float gain);
+  float currentFromMv(int mv, float aPerMv) { return mv * aPerMv; }
   float ntcTempFromMv(int mv_node);
+  void convertLatest(AdcReadings &out);
+  bool restartTimer(uint32_t tick_us, int samples_per_channel);
+  bool watchStep(uint8_t ch, int mv, uint64_t now);
+  void watchLoad(int mv, uint64_t now);
+  Rate frameRate(const AdcReadings& d, uint64_t now);
+  void setRate(Rate r);
 
   int applyZeroAndFloor(int raw_mv, int zero_mv) const {
     int mv = raw_mv - zero_mv - adc_floor_mv;
@@ -79,11 +183,41 @@ private:
 
 
   int samples_per_ch_ = 64;
+  uint32_t tick_us_ = 2000;
+  RawSink raw_sink_ = nullptr;
+  StepSink step_sink_ = nullptr;
+  AdcSource* src_ = nullptr;
+  bool jitter_ = true;
   uint8_t ch_ = 0;
   int samp_ = 0;
 
   uint32_t sum_[5] = {0};
   int latest_mv_[5] = {0};
-
-  volatile bool latest_ready_ = false;
+  bool have_frame_ = false;        // latest_mv_ holds averages (step reference)
+
+  // ---- Adaptive rate ----
+  AdcAdaptConfig adapt_;
+  bool held_ = false;
+  Rate rate_ = Rate::Normal;
+  uint32_t base_tick_us_ = 2000;
+  int base_spc_ = 64;
+  int step_mv_[5] = {0};           // stepA in raw mV, current channels only
+  uint8_t over_[5] = {0};          // reads in a row past it
+  uint64_t step_us_ = 0;           // last step
+  uint64_t busy_since_us_ = 0;     // last step or current above idleA
+  uint64_t rate_since_us_ = 0;
+  uint64_t rate_us_[RATE_COUNT] = {0};
+  uint32_t bursts_ = 0;
+  uint32_t reads_ = 0;
+  uint64_t busy_us_ = 0;
+
+  // ---- Load step tap ----
+  int load_lvl_mv_ = 0;            // the last frame's load average, or the step's reads
+  int load_sum_mv_ = 0;            // reads past it so far
+  uint8_t load_over_ = 0;
+  bool load_up_ = false;
+  uint64_t load_first_us_ = 0;
+  bool load_skip_ = false;         // the next frame straddles the step: keep the level
+
+  AdcBus bus_{TimeMgr::nowUs};
 };
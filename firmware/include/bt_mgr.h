@@ -1,16 +1,66 @@
 #pragma once
 #include <Arduino.h>
+#include "tlm_proto.h"
 
 namespace BtMgr {
+  // TX priority: when the link backs up, telemetry is dropped first
+  // (oldest frames go), command replies are kept.
+  enum class TxPrio : uint8_t { Telemetry = 0, Reply = 1 };
+
+  // Payload bytes and frames. Every queued frame is sent, dropped or still
+  // pending: queued = sent + dropped + pending (+ the one frame the TX
+  // task may be writing). Rejected frames never entered the queue.
+  struct TxStats {
+    uint32_t queuedBytes;    // accepted into the TX queue
+    uint32_t sentBytes;      // handed to SerialBT by the TX task
+    uint32_t droppedBytes;   // evicted for newer telemetry or flushed on disconnect
+    uint32_t rejectedBytes;  // did not fit (reply queue full, oversize)
+    uint32_t queuedFrames;
+    uint32_t sentFrames;
+    uint32_t droppedFrames;
+    uint32_t rejectedFrames;
+    uint32_t maxBlockUs;     // longest single SerialBT.write() in the TX task
+    uint32_t pendingBytes;   // currently waiting in both queues
+    uint32_t pendingFrames;
+  };
+
+  // Longest frame the TX queue takes; also the printf / reply line buffer
+  static constexpr size_t MAX_FRAME = 1024;
+
   void begin(const char* deviceName);
   bool connected();
 
+  // All TX calls only copy into the queue and return; they never block.
+  // println / printf / reply format into one static buffer: loop task only.
   void print(const char* s);
   void println(const char* s);
   void printf(const char* fmt, ...);
+  bool write(const uint8_t* data, size_t len, TxPrio prio = TxPrio::Telemetry);
+
+  // Same as printf but queued as a command reply
+  void reply(const char* fmt, ...);
+
+  TxStats txStats();
+  size_t  txFree(TxPrio prio);   // bytes a new frame of this priority can use
+
+  // Waits (delay()) until the TX task has written everything queued, up to
+  // timeoutMs. Before deep sleep, so the last lines reach the host.
+  bool flush(uint32_t timeoutMs);
 
   // ---- NEW: RX helpers ----
   int  available();
   int  read();  // returns -1 if none
-  size_t readLine(char* out, size_t outLen); // reads up to '\n', null-terminated
+  // Next complete line (without '\r'/'\n', NUL-terminated) in BtMgr's own
+  // RX buffer, or nullptr if none yet. Partial lines are kept between calls;
+  // the buffer stays valid (and may be modified in place) until the next call.
+  char* readLine(size_t* lenOut);
+
+  // Binary frames from the host (TlmProto, e.g. OTA chunks) share the RX
+  // link with the command lines: a 0x00, which no line contains, opens a
+  // frame and the frame's own trailing 0x00 closes it. readLine() passes
+  // every frame with a good CRC to fn, on the caller's task, and drops the
+  // rest; a partial line before the 0x00 is dropped too.
+  typedef void (*FrameFn)(const TlmProto::Decoder& d);
+  void onFrame(FrameFn fn);
+  const TlmProto::Decoder& rxFrames();   // counters
 }
@@ -1,18 +1,43 @@
 #pragma once
 #include <Arduino.h>
 
+// ------------------------------------------------------------
+// Charger status inputs: PIN_CHARGING (HIGH = charging) and PIN_CHG_DONE
+// (open drain, LOW = done).
+//
+// Both pins interrupt on every edge; the ISR only queues the edge with
+// its esp_timer time stamp (lib/edge_debounce). update() debounces from
+// those time stamps, so the stable state does not depend on how often
+// the charge task gets to run, and it costs nothing while the pins are
+// quiet.
+// ------------------------------------------------------------
 namespace ChargeMgr {
-  // Call once at boot
-  void begin(bool initialCharging);
+  // Call once at boot, after pinMode() on both pins: takes the current
+  // levels as stable and attaches the interrupts
+  void begin();
 
-  // Call every loop with raw pin value (HIGH = charging)
-  void update(bool rawCharging);
+  // Debounced levels for RtcState. restore() takes them as the stable
+  // state; a pin that reads otherwise now is an edge that still has to
+  // pass the debounce.
+  struct State {
+    bool charging;
+    bool done;
+  };
+  State state();
+  void  restore(const State& s);
+
+  // Charge task: takes the queued edges
+  void update();
 
   // Debounced stable state
   bool isCharging();
+  bool isDone();
 
-  // True if stable state changed (debounced)
+  // True if isCharging() changed in the last update()
   bool stableChanged();
+  // When stableChanged(): TimeMgr µs of the pin edge that started it
+  // (the debounce runs on the ISR's time stamps, so this is exact)
+  uint64_t changedAtUs();
 
   // Schedule LCD re-init for N ms after stable change
   void scheduleUiReinit(uint32_t delayMs);
@@ -0,0 +1,97 @@
+#pragma once
+#include <Arduino.h>
+#include "load_prot.h"
+#include "thermal_mgr.h"
+#include "energy_mgr.h"
+#include "rtc_state.h"
+#include "adc_mgr.h"
+#include "json_tok.h"
+
+// BT command handling: one JSON object per line, e.g.
+//   {"cmd":"set","trip_a":0.8,"trip_ms":200,"id":7}
+//   {"cmd":"get"}   {"cmd":"get","keys":["trip_a","ui_period_ms"]}
+//   {"cmd":"set","pin":"en_charge","val":0}      (old UI form)
+// Every command gets exactly one ack line:
+//   {"ver":1,"ack":"set","err":0,"msg":"ok","id":7, ...extra fields}
+// Parsing is in place on the RX line buffer - no String, no heap.
+namespace CmdMgr {
+
+enum Err : uint8_t {
+  ERR_OK = 0,
+  ERR_PARSE,        // not a JSON object / too many tokens
+  ERR_UNKNOWN_CMD,
+  ERR_UNKNOWN_KEY,
+  ERR_BAD_VALUE,    // wrong type
+  ERR_RANGE,        // outside limits or inconsistent with other fields
+  ERR_BUSY,         // can't change now (e.g. ADC rate while streaming)
+  ERR_FAILED,       // hardware refused, nothing changed
+  ERR_REPLY_FULL,   // the command ran but its reply didn't fit; no fields sent
+};
+
+// Everything the host can get/set. A "set" is staged on a copy, checked
+// as a whole and only then applied, so multi-field changes are atomic.
+struct AppConfig {
+  LoadProt::Config lp;
+  ThermalMgr::Config th;
+  EnergyMgr::Config en;
+  RtcState::Config rs;
+  AdcAdaptConfig ad;
+  uint32_t adc_tick_us  = 2000;
+  uint16_t adc_spc      = 64;      // samples per channel per frame
+  float    soc_cap_mah  = Profile::BATTERY.capacityMah;
+  uint32_t ui_period_ms = 1000;
+  bool     en_charge    = true;    // user enables
+  bool     en_load_dsg  = true;
+  bool     usb_tlm      = true;    // JSON telemetry on USB Serial too
+  uint32_t log_period_ms = 1000;   // flash history record period
+  uint32_t pwr_dead_us  = 10000;   // relay / DC-DC break-before-make
+  uint32_t mem_period_ms = 10000;  // MemMgr line; 0 = off
+  uint32_t ota_gap_ms   = 20;     // OtaMgr pause after each sector write
+};
+
+// The parsed command line, for handlers
+struct Args {
+  char* s;
+  const JsonTok::Token* t;
+  int n;
+  const char* errKey;   // handler may point this at the offending key
+
+  int  find(const char* key) const { return JsonTok::find(s, t, n, 0, key); }
+  bool getLong(const char* key, long& out) const;
+  bool getInt64(const char* key, int64_t& out) const;
+  bool getFloat(const char* key, float& out) const;
+  const char* getStr(const char* key) const;   // nullptr if missing / not a string
+};
+
+// Extra fields for the ack, written as ",\"k\":v" pairs. A field that
+// doesn't fit is not written and sets full; the ack then carries
+// ERR_REPLY_FULL instead of a cut-off reply.
+struct Reply {
+  char*  buf;
+  size_t cap;
+  size_t len;
+  bool   full;
+  void add(const char* fmt, ...);
+};
+
+typedef Err (*Handler)(Args& a, Reply& r);
+
+// Push a validated config to the modules. Return ERR_OK or a reason;
+// on error the live config is left unchanged.
+typedef Err (*ApplyFn)(const AppConfig& next, const AppConfig& prev);
+
+// "cmd" task period; OtaMgr shortens it while receiving
+static constexpr uint32_t POLL_US = 5000;
+
+// Also adds the "cmd" scheduler task that drains BT lines into handleLine()
+void begin(AppConfig& live, ApplyFn apply);
+
+// Extra commands owned by other modules (max 24)
+bool registerCmd(const char* name, Handler fn);
+
+// line is modified in place
+void handleLine(char* line, size_t len);
+
+const char* errName(Err e);
+
+} // namespace CmdMgr
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include "adc_mgr.h"
+
+// ------------------------------------------------------------
+// Energy accounting and DC-DC efficiency, once per ADC frame.
+//
+// Three Wh accumulators, trapezoidal over the frame stamps:
+//   chg_in   vbat * ibatt_chg      into the cell
+//   dsg_out  vbat * ibatt_dsg      out of the cell (load path + board)
+//   load     dcdcV * iload         delivered at the output
+// The output voltage is not measured, so the load side uses the nominal
+// dcdcV. A frame gap over GAP_US (sleep, stalled frame task) is not
+// bridged. A session starts at boot (unless RtcState restores the one
+// before the reset) and at every ChargeMgr::isCharging() change. The
+// lifetime record lives in NVS ("energy"), saved every SAVE_MS while it
+// grows and from IdleSleep before deep sleep.
+//
+// Efficiency is Pload / Pdsg while the cell feeds the output through
+// the DC-DC (DC-DC and load on, relay off). The ADC samples the channels
+// one after the other, so right after a load step vbat, iload and idsg
+// describe different moments. Frames with a current step are skipped,
+// and both powers are low-passed separately (effTauS) before dividing.
+// NAN while the path is off, below EFF_MIN_W, not yet settled, or when
+// the ratio comes out above 1 (dcdcV does not match the board).
+//
+// BT command:
+//   {"cmd":"energy"}                    session, lifetime, eff
+//   {"cmd":"energy","reset":"session"}  (or "life")
+// ------------------------------------------------------------
+namespace EnergyMgr {
+
+struct Config {
+  float dcdcV   = Profile::BOARD.dcdcV;   // nominal output voltage
+  float effTauS = 20.0f;     // power low-pass for the efficiency
+  float minA    = 0.030f;    // shunt readings below this count as 0
+};
+
+struct Totals {
+  double chgInWh  = 0;
+  double dsgOutWh = 0;
+  double loadWh   = 0;
+};
+
+void begin(const Config& cfg = Config{});
+void setConfig(const Config& cfg);
+const Config& config();
+
+// Once per ADC frame; tUs = frame stamp (AdcBus::Ref::tUs())
+void update(const AdcReadings& adc, uint64_t tUs, bool charging, uint8_t outputs);
+
+// Store the lifetime record now (no-op if nothing changed)
+void save();
+
+const Totals& session();
+const Totals& lifetime();
+uint32_t sessions();         // lifetime session count
+uint32_t sessionS();         // age of the current session
+float    efficiency();       // (0, 1], NAN = unknown
+
+// Accumulators for RtcState: the session carries on over a reset and
+// the lifetime totals don't lose what came in since the last save()
+struct State {
+  Totals   session, life;
+  uint32_t sessions;
+  uint64_t sessionMs;        // TimeMgr ms
+  bool     charging;
+};
+State state();
+void  restore(const State& s);
+
+void resetSession();
+void resetLifetime();
+
+} // namespace EnergyMgr
@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+#include "tlm_proto.h"
+#include "tlm_bus.h"
+
+class ADCMgr;
+
+// ------------------------------------------------------------
+// Event channel: what the 1 Hz telemetry line would only show up to a
+// second late, sent to every connected client as it happens, with the
+// time it happened.
+//
+// Events (TlmProto::EventType) and where they are detected:
+//   load_step   ADCMgr, per raw load read (the step sink): the step in A
+//   trip        frame task, after LoadProt::update(): the load current
+//   chg_start/  charge task, on ChargeMgr::stableChanged(): the time is
+//   chg_stop    the pin edge's, not the end of the debounce
+//   full/empty  frame task, SocMgr::lastCal()
+//   sleep       IdleSleep, right before deep sleep (flush() follows)
+//
+// push() writes into a fixed ring of QLEN events and never blocks. The
+// "evt" task (every pass, after the frame and charge tasks) keeps a
+// position per TlmBus transport and sends each one the events it has not
+// had, in order, one frame per event in the transport's format; BT
+// queues them as replies, so telemetry never pushes one out. A transport
+// that refuses a frame gets it again on the next pass. A disconnected
+// one skips what happens meanwhile, and one more than QLEN events behind
+// loses the oldest. seq counts every event since boot, so a client sees
+// a skip or a loss as a gap.
+//
+// JSON (one line per event; "a" only for load_step and trip):
+//   {"ver":1,"evt":{"type":"load_step","seq":12,"boot":3,"t_us":81234567,"a":-0.312}}
+// Binary: schema 6, TlmProto::EventV1.
+//
+// Everything runs on the loop task.
+//
+// BT command:
+//   {"cmd":"evt"}   "seq" (events since boot), "boot", per type counts
+//                   and per transport [name,sent,skipped,lost], "retries"
+// ------------------------------------------------------------
+namespace EventMgr {
+
+static constexpr size_t QLEN = 32;
+
+struct Stats {
+  uint32_t pushed;
+  uint32_t byType[TlmProto::EVT_TYPE_COUNT];
+  uint32_t sent[TlmBus::MAX_TRANSPORTS];      // per TlmBus::get(i)
+  uint32_t skipped[TlmBus::MAX_TRANSPORTS];   // while it was disconnected
+  uint32_t lost[TlmBus::MAX_TRANSPORTS];      // overwritten before it took them
+  uint32_t retries;                           // frames refused, sent again
+};
+
+// After the TlmBus transports are added: registers "evt", adds the "evt"
+// task and sets adc's step sink
+void begin(ADCMgr& adc);
+
+// a: amps for load_step and trip, ignored for the others
+void push(TlmProto::EventType type, uint64_t tUs, float a = 0.0f);
+
+// Run by the "evt" task
+void service();
+
+// Before deep sleep: sends what is queued and waits up to timeoutMs for
+// BT to write it
+void flush(uint32_t timeoutMs);
+
+Stats stats();
+
+} // namespace EventMgr
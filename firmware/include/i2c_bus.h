@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+#include "ina_mon.h"
+
+// ------------------------------------------------------------
+// The board's I2C master as an InaMon::I2cIf.
+//
+// Transfers run on the "i2c" task through the ESP-IDF I2C driver, which
+// is interrupt driven: the task sleeps until the controller is done.
+// The loop task only hands a transfer over and polls for the result, so
+// it never waits on the bus, a stretched clock or a missing device
+// (XFER_TIMEOUT_MS, then Status::Error).
+// The sim replaces this module with simulated register devices
+// (sim/sim_i2c.cpp).
+// ------------------------------------------------------------
+namespace I2cBus {
+
+static constexpr uint32_t DEFAULT_HZ = 400000;
+static constexpr uint32_t XFER_TIMEOUT_MS = 10;
+
+// Installs the driver and starts the task; false if it failed. Again
+// after a restart: keeps the running bus.
+bool begin(int sda, int scl, uint32_t hz = DEFAULT_HZ);
+InaMon::I2cIf& bus();
+
+} // namespace I2cBus
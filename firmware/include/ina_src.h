@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include "adc_mgr.h"
+#include "ina_mon.h"
+
+// ------------------------------------------------------------
+// I2C shunt monitors (lib/ina_mon) as the ADCMgr source.
+//
+// The board profile says which monitors are fitted (Profile::Board
+// inaBatt / inaLoad). The cell monitor gives vbat and the battery
+// current, split by sign into ibatt_chg_a / ibatt_dsg_a; the load
+// monitor gives iload_a. A frame gets the average of the conversions
+// since the frame before, or the last average again if none came in.
+// A monitor that is not running leaves its fields to the internal ADC.
+// The loop task only polls: the transfers run on the "i2c" task
+// (i2c_bus.h).
+//
+// BT command:
+//   {"cmd":"ina"}   "mon":[{"name","chip","addr","state","reads",
+//                   "errors","faults","clipped","a","v"},..] - fitted
+//                   monitors only; "a" / "v" is the last average
+// ------------------------------------------------------------
+namespace InaSrc {
+
+enum Mon : uint8_t { BATT = 0, LOAD = 1, MON_COUNT };
+
+// Starts the bus and the fitted monitors, registers "ina". nullptr if
+// the board has no monitor or the bus would not start.
+AdcSource* begin();
+
+bool fitted(uint8_t i);
+const InaMon::Monitor& monitor(uint8_t i);
+
+} // namespace InaSrc
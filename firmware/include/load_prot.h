@@ -15,6 +15,10 @@ struct Config {
 
 void begin(const Config& cfg = Config{});
 
+// Change thresholds/timings at runtime without clearing the trip state
+void setConfig(const Config& cfg);
+const Config& config();
+
 // Call this whenever you have a fresh AdcReadings update
 void update(const AdcReadings& adc);
 
@@ -30,7 +34,16 @@ void forceTrip();
 bool tryReset(const AdcReadings& adc);
 void resetForce();
 
+// Trip state for RtcState: a trip (latched or cooling down) survives a
+// reset. lastTripMs is TimeMgr time, which carries over resets.
+struct State {
+  bool     tripped;
+  uint64_t lastTripMs;
+};
+State state();
+void  restore(const State& s);
+
 float lastLoadA();
-uint32_t lastTripMillis();
+uint64_t lastTripMillis();   // TimeMgr ms
 
 } // namespace LoadProt
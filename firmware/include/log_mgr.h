@@ -0,0 +1,51 @@
+#pragma once
+#include <Arduino.h>
+#include "tlm_sub.h"
+
+// On-flash telemetry history.
+// Every period a full snapshot is compressed into a 4 KB RAM block
+// (TlmLog codec, ~4 bytes/record); full blocks go round-robin into the
+// "tlmlog" data partition (see partitions.csv). Erase + write happen in
+// a low-priority task so loop() never waits on flash.
+//
+// BT command:
+//   {"cmd":"log"}                                 info
+//   {"cmd":"log","op":"get","from":120,"off":0}   download (binary, schema 4)
+//   {"cmd":"log","op":"stop"}                     abort download
+//   {"cmd":"log","op":"flush"}                    store the open block now
+// A download covers all stored blocks from "from" on; the open block is
+// flushed first so it is included. Resume by asking for the first
+// missing (seq, off) again.
+namespace LogMgr {
+
+struct Info {
+  bool     mounted;
+  uint32_t sectors;        // partition size in blocks
+  uint32_t used;           // blocks holding data
+  uint32_t oldestSeq;
+  uint32_t nextSeq;        // = seq of the open RAM block
+  uint16_t openRecords;
+  uint16_t openBytes;
+  uint32_t records;        // appended since boot
+  uint32_t writeErrors;
+  uint32_t dropped;        // blocks lost because the writer was still busy
+  uint32_t boot;
+};
+
+static constexpr uint32_t MIN_PERIOD_MS = 100;
+
+// fill: same snapshot source as TlmSub (all fields are requested)
+bool begin(TlmSub::FillFn fill, uint32_t periodMs);
+void setPeriod(uint32_t periodMs);
+
+// Seal the open block and hand it to the writer; wait = block until
+// it is on flash (before deep sleep)
+void flush(bool wait);
+
+// Run by the "log" scheduler task (added in begin()): records on
+// schedule, paces an active download
+void service();
+
+Info info();
+
+} // namespace LogMgr
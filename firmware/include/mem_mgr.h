@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+
+// ------------------------------------------------------------
+// Memory telemetry and the heap guard.
+//
+// Every runtime buffer in the firmware is a static pool or array (AdcBus
+// slots, TlmBus frames, BtMgr rings, CmdMgr line and reply buffers); the
+// heap is only used by begin() calls during setup(). MemMgr checks that
+// this holds:
+//
+// - Free heap, the lowest it has been, the largest free block and the
+//   stack high-water mark of each firmware task (TASK_NAMES) are
+//   reported by {"cmd":"mem"}. Every periodMs they are also published
+//   as one JSON line on the JSON transports of TlmBus:
+//     {"ver":1,"mem":{"heap":..,"heap_min":..,"largest":..,
+//      "allocs":{"loopTask":..,..},"stk":{"loopTask":..,"bt_tx":..,"log_wr":..,"i2c":..,"ota_wr":..}}}
+//   Stack figures are the bytes never touched since the task started.
+//   "allocs" is null without the heap guard.
+// - Heap guard (build with -DHEAP_GUARD=1): malloc / calloc / realloc,
+//   and so new and String, are wrapped (-Wl,--wrap, see the esp32dev_guard
+//   env) and feed noteAlloc(). Once arm() has run at the end of setup(),
+//   each allocation made by a firmware task is counted against that task,
+//   with the size and return address of the last one. The address goes
+//   into addr2line. Allocations of the BT / WiFi stacks' own tasks are
+//   not counted. The count for loopTask must stay 0; bt_tx counts
+//   BluetoothSerial's per-write packet buffer.
+//
+// The counters are per task and written only by that task; the "last"
+// fields may mix two tasks' allocations.
+//
+// BT command:
+//   {"cmd":"mem"}   the published fields, plus "guard", "alloc_bytes",
+//                   "last_size", "last_pc", "last_task"
+// ------------------------------------------------------------
+#ifndef HEAP_GUARD
+#define HEAP_GUARD 0
+#endif
+
+namespace MemMgr {
+
+static constexpr uint8_t MAX_TASKS = 5;
+
+struct Stats {
+  uint32_t heapFree;
+  uint32_t heapMin;          // lowest free heap since boot
+  uint32_t heapLargest;      // largest block malloc() could return now
+  uint32_t allocs[MAX_TASKS];   // since arm(), per entry of taskName()
+  uint32_t allocBytes;
+  uint32_t lastSize;
+  uintptr_t lastPc;
+  uint8_t  lastTask;
+};
+
+// Early in setup(): disarms the guard, registers "mem", adds the "mem"
+// task. periodMs = 0: no periodic line.
+void begin(uint32_t periodMs);
+void setPeriod(uint32_t periodMs);
+
+// End of setup(): looks up the task handles and starts counting
+void arm();
+bool armed();
+
+// From the allocation hooks. Must not allocate or block.
+void noteAlloc(size_t bytes, const void* pc);
+
+Stats   stats();
+uint8_t taskCount();
+const char* taskName(uint8_t i);
+// Bytes of stack task i never used; 0 if the task does not exist
+uint32_t stackFree(uint8_t i);
+
+} // namespace MemMgr
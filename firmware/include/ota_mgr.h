@@ -0,0 +1,76 @@
+#pragma once
+#include <Arduino.h>
+
+// ------------------------------------------------------------
+// Firmware update over the BT link.
+//
+// Receiving: the host (host-tools/ota-send) cuts the image into 4 KB
+// chunks, one per flash sector of the inactive app slot, LZ4-compresses
+// each on its own and sends them as TlmProto frames (schema 5) between
+// the command lines (BtMgr::onFrame). The cmd task feeds the frames to
+// an OtaImg::Receiver, which reassembles, unpacks and CRC-checks a chunk.
+// The "ota_wr" task then erases and writes its sector while the next
+// chunk arrives, the same split as LogMgr: the loop never waits on flash.
+// After each sector the writer pauses gapMs, so the stalls flash writes
+// cause the other core stay short and spread out. While receiving, the
+// cmd task drains the RX queue every 1 ms instead of 5.
+//
+// Flow control: the device reports each chunk once it is on flash, ahead
+// of the writer's pause, and the host keeps at most a window of chunks
+// beyond that in flight (ota-send: 1, so the next chunk comes in while
+// flash is quiet; bytes that arrive during an erase can overflow the RX
+// queue). Lost pieces or a bad chunk make the device report where it
+// stands, and the host goes back there (go-back-N).
+//
+// Resume: the session (size, image CRC, slot, chunks on flash) is saved
+// in NVS every SAVE_EVERY chunks. A "begin" with the same size and CRC
+// for the same slot continues from there, after a disconnect or a reset.
+//
+// Finish: the writer reads the slot back against the image CRC and
+// makes it the boot slot (esp_ota_set_boot_partition also checks the
+// image). "reboot" starts it.
+//
+// Confirm or roll back: the new image boots as pending-verify (ESP-IDF
+// app rollback; verifyRollbackLater() keeps the Arduino core from
+// confirming it on its own). OtaMgr confirms it once it has run for
+// CONFIRM_MS and the health check passes. A reset before that - a
+// crash, a watchdog - makes the bootloader go back to the old image, and
+// so does {"op":"rollback"}.
+//
+// BT command:
+//   {"cmd":"ota"}                                  state, slots, counters
+//   {"cmd":"ota","op":"begin","size":N,"crc":C}    start or resume; "next"
+//                                                  is the first chunk to send
+//   {"cmd":"ota","op":"abort"}                     drop the session
+//   {"cmd":"ota","op":"reboot"}                    once "ready"
+//   {"cmd":"ota","op":"confirm"}                   confirm a pending image now
+//   {"cmd":"ota","op":"rollback"}                  back to the old image (restarts,
+//                                                  no ack)
+// While receiving, progress lines (as command replies, never dropped):
+//   {"ver":1,"ota":{"state":"rx","stored":K,"next":K2}}
+//   {"ver":1,"ota":{"state":"rx","stored":K,"next":K2,"err":"gap"}}
+//   {"ver":1,"ota":{"state":"ready","stored":N,"next":N}}
+// stored = chunks on flash, next = first chunk the device still needs.
+// ------------------------------------------------------------
+namespace OtaMgr {
+
+static constexpr uint32_t SAVE_EVERY = 16;          // chunks between NVS saves
+static constexpr uint32_t CONFIRM_MS = 60000;
+
+enum class State : uint8_t { Idle, Rx, Verify, Ready, Failed };
+
+// true once the control path is known to work (main.cpp: frames reach
+// the frame task)
+typedef bool (*HealthFn)();
+
+// Registers "ota", adds the "ota" task, starts the writer
+void begin(HealthFn healthy, uint32_t gapMs);
+void setGapMs(uint32_t gapMs);
+
+// Run by the "ota" scheduler task: collects the writer, reports, confirms
+void service();
+
+State state();
+const char* stateName(State s);
+
+} // namespace OtaMgr
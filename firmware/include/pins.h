@@ -1,22 +1,29 @@
 #pragma once
 #include <Arduino.h>
+#include "profile.h"
+
+// Pin map of the selected board profile (profile.h)
+static constexpr const Profile::Pins& PINS = Profile::BOARD.pins;
 
 // ===== ENABLE / CONTROL PINS (ACTIVE-HIGH) =====
-static constexpr int PIN_EN_CHARGE    = 4;   // Charge enable
-static constexpr int PIN_EN_DCDC      = 14;  // DC-DC enable
-static constexpr int PIN_EN_RELAY     = 27;  // Relay enable change 
-static constexpr int PIN_EN_LOAD_DSG  = 13;  // Load discharge enable
-static constexpr int PIN_EN_BYPASS    = 2;   // Bypass path enable
-static constexpr int PIN_CHG_DONE = 22; 
+static constexpr int PIN_EN_CHARGE    = PINS.enCharge;    // Charge enable
+static constexpr int PIN_EN_DCDC      = PINS.enDcdc;      // DC-DC enable
+static constexpr int PIN_EN_RELAY     = PINS.enRelay;     // Relay enable change
+static constexpr int PIN_EN_LOAD_DSG  = PINS.enLoadDsg;   // Load discharge enable
+static constexpr int PIN_EN_BYPASS    = PINS.enBypass;    // Bypass path enable
+static constexpr int PIN_CHG_DONE     = PINS.chgDone;
 // ===== INPUTS =====
-static constexpr int PIN_CHARGING = 25;      // Charging status input (HIGH = charging)
-static constexpr int PIN_BTN_SLEEP  = 26; 
+static constexpr int PIN_CHARGING     = PINS.charging;    // Charging status input (HIGH = charging)
+static constexpr int PIN_BTN_SLEEP    = PINS.btnSleep;
 // ===== ADC PINS =====
-static constexpr int PIN_ADC_VOLT      = 34;
-static constexpr int PIN_ADC_LOAD_DSG  = 33;
-static constexpr int PIN_ADC_BATT_CHG  = 39;
-static constexpr int PIN_ADC_BATT_DSG  = 36;
-static constexpr int PIN_ADC_NTC       = 35; // placeholder until you confirm
+static constexpr int PIN_ADC_VOLT      = PINS.adcVolt;
+static constexpr int PIN_ADC_LOAD_DSG  = PINS.adcLoadDsg;
+static constexpr int PIN_ADC_BATT_CHG  = PINS.adcBattChg;
+static constexpr int PIN_ADC_BATT_DSG  = PINS.adcBattDsg;
+static constexpr int PIN_ADC_NTC       = PINS.adcNtc;
+// ===== I2C (-1 = not wired) =====
+static constexpr int PIN_I2C_SDA       = PINS.i2cSda;
+static constexpr int PIN_I2C_SCL       = PINS.i2cScl;
 // Measure Battery P- (battery negative before shunts) vs System GND
 //static constexpr int PIN_ADC_PMINUS = 27;  // <-- example, change to your GPIO   
 
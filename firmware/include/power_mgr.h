@@ -1,12 +1,58 @@
 #pragma once
 #include <Arduino.h>
 
+// ------------------------------------------------------------
+// Enable outputs (EN_CHARGE, EN_DCDC, EN_RELAY, EN_LOAD_DSG, EN_BYPASS).
+//
+// PowerMgr owns all five: a shadow register holds what they drive, a
+// request only touches the hardware if it changes something, and the
+// pins that go in one direction switch together in one GPIO W1TC / W1TS
+// write.
+//
+// Break-before-make: within the bbm group (relay and DC-DC by default)
+// an output is only switched on once deadUs have passed since the last
+// output of the group went off. A transition is therefore "all offs now,
+// the group's ons deadUs later"; the second half is written by the
+// "power" scheduler task, set() never waits.
+// ------------------------------------------------------------
 namespace PowerMgr {
-  void begin();
 
-  void setRelay(bool on);     // relay enable (active-high)
-  void setDcdc(bool on);      // DC-DC enable (active-high)
+// Same bit order as TlmProto::PinBit, so outputs() can go into the
+// telemetry "pins" byte as it is
+enum Out : uint8_t {
+  OUT_CHARGE   = 1 << 0,
+  OUT_DCDC     = 1 << 1,
+  OUT_RELAY    = 1 << 2,
+  OUT_LOAD_DSG = 1 << 3,
+  OUT_BYPASS   = 1 << 4,
+  OUT_ALL      = 0x1F,
+};
 
-  // Convenience: apply your rule
-  void applyChargingMode(bool charging);
-}
+struct Timing {
+  uint32_t deadUs  = 10000;                 // relay contacts need a few ms to open
+  uint8_t  bbmMask = OUT_RELAY | OUT_DCDC;  // never on together
+};
+
+// Drives everything low, then to the boot state (charge, load, bypass
+// and DC-DC on, relay off). Adds the "power" task.
+void begin(const Timing& t = Timing());
+void setTiming(const Timing& t);
+const Timing& timing();
+
+// New levels for the outputs in mask, the others keep theirs
+void set(uint8_t mask, uint8_t levels);
+
+void setRelay(bool on);     // relay enable (active-high)
+void setDcdc(bool on);      // DC-DC enable (active-high)
+
+// Relay on only while charging, DC-DC otherwise
+void applyChargingMode(bool charging);
+
+// Block until a pending make half is written (before deep sleep)
+void settle();
+
+uint8_t outputs();          // what the pins drive now (Out bits)
+uint8_t target();           // where the current transition ends
+bool    busy();             // make half still waiting
+
+} // namespace PowerMgr
@@ -0,0 +1,106 @@
+#pragma once
+#include <Arduino.h>
+
+// ------------------------------------------------------------
+// Hot-path profiler: scoped zones timed with the CPU cycle counter
+// (CCOUNT).
+//
+//   void UIMgr::drawValues(...) {
+//     PROF_ZONE(ProfMgr::Z_UI_DRAW);
+//     ...
+//
+// Every zone keeps count, min / max / total cycles and a log2 histogram
+// in static memory: bucket b counts runs of [2^b, 2^(b+1)) cycles. Times
+// are inclusive (a nested zone is also counted in its parent) and raw:
+// each one carries the zone's own bias, reported as "bias_cyc".
+//
+// Zones must only be used from the loop task: CCOUNT is per core and
+// the counters are not locked.
+//
+// Build with -DPROF_ENABLE=0 to remove it: PROF_ZONE expands to nothing,
+// begin() is empty and the "prof" command is not registered.
+//
+// BT command:
+//   {"cmd":"prof"}            "mhz", "ovh_cyc" (cost of one zone),
+//                             "bias_cyc" and "zones": per zone
+//                             [name,n,min,avg,max,b0,[hist from bucket b0]]
+//                             in cycles; "next":N if more follow (ask
+//                             again with "from":N)
+//   {"cmd":"prof","reset":1}  clear the counters
+// host-tools/prof-view renders it.
+// ------------------------------------------------------------
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 1
+#endif
+
+namespace ProfMgr {
+
+enum ZoneId : uint8_t {
+  Z_ADC_SERVICE = 0,   // ADCMgr::service
+  Z_SOC_UPDATE,        // SocMgr::update
+  Z_LOAD_PROT,         // LoadProt::update
+  Z_UI_DRAW,           // UIMgr::drawValues
+  Z_TLM_JSON,          // full JSON telemetry line
+  Z_TLM_BIN,           // full binary telemetry frame
+  ZONE_COUNT
+};
+
+static constexpr size_t HIST_BUCKETS = 32;
+
+struct ZoneStats {
+  uint32_t n;
+  uint32_t minCyc;     // UINT32_MAX until the first run
+  uint32_t maxCyc;
+  uint64_t totalCyc;
+  uint32_t hist[HIST_BUCKETS];
+};
+
+#if PROF_ENABLE
+
+// Calibrates the zone overhead and registers the "prof" command
+void begin();
+
+void record(uint8_t zone, uint32_t cyc);
+void reset();
+
+const char*      zoneName(uint8_t zone);
+const ZoneStats& stats(uint8_t zone);
+uint32_t         overheadCycles();   // one empty zone, start to finish
+uint32_t         biasCycles();       // what an empty zone records
+
+// CCOUNT read inline; ESP.getCycleCount() elsewhere (and in the sim)
+static inline uint32_t cycles() {
+#if defined(__XTENSA__)
+  uint32_t c;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(c));
+  return c;
+#else
+  return ESP.getCycleCount();
+#endif
+}
+
+class Zone {
+public:
+  explicit Zone(uint8_t id) : id_(id), t0_(cycles()) {}
+  ~Zone() { record(id_, cycles() - t0_); }
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+private:
+  uint8_t  id_;
+  uint32_t t0_;
+};
+
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b)  PROF_CAT2(a, b)
+#define PROF_ZONE(id)   ProfMgr::Zone PROF_CAT(prof_zone_, __LINE__)(id)
+
+#else
+
+inline void begin() {}
+inline void reset() {}
+
+#define PROF_ZONE(id) do {} while (0)
+
+#endif
+
+} // namespace ProfMgr
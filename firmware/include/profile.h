@@ -0,0 +1,185 @@
+#pragma once
+#include <stdint.h>
+
+// ------------------------------------------------------------
+// Compile-time battery and board profiles.
+//
+// Everything that changes with the pack or the board revision sits in one
+// constexpr struct, and every module reads its constants from there:
+//   Board   - pin map (pins.h), analog front end (ADCMgr, the sim model),
+//             I2C shunt monitors (InaSrc), board current draw and reading
+//             floors (SocMgr, UIMgr, IdleSleep), DC-DC output (EnergyMgr),
+//             brownout level (RtcState)
+//   Battery - nominal capacity and dynamic FCC fit, full / empty / cutoff
+//             voltages (SocMgr), temperature windows (ThermalMgr)
+// A second pack or board is one more entry below. Nothing is looked up at
+// runtime: BOARD and BATTERY are constexpr, so every conversion and
+// threshold folds into the code the same way a literal would. Values
+// that can also be set over BT (AppConfig) only take their defaults from
+// here.
+//
+// Select with build flags (see the platformio.ini envs):
+//   -DBOARD_PROFILE=BOARD_REV_B -DBATTERY_PROFILE=BATT_NMC_3500
+// The sim's model (sim_model.cpp, sim_i2c.cpp) builds the board's front
+// end and monitors from the same values.
+// ------------------------------------------------------------
+namespace Profile {
+
+struct Pins {
+  // outputs, active high
+  int enCharge, enDcdc, enRelay, enLoadDsg, enBypass;
+  // digital inputs
+  int chgDone, charging, btnSleep;
+  // ADC
+  int adcVolt, adcLoadDsg, adcBattChg, adcBattDsg, adcNtc;
+  // I2C, -1 = no bus
+  int i2cSda, i2cScl;
+};
+
+// An INA219 / INA226 on the I2C bus (InaSrc)
+struct Ina {
+  uint16_t chip;        // 219, 226; 0 = not fitted
+  uint8_t  addr;
+  float    shuntOhm;
+  float    maxA;        // largest current it has to read
+};
+
+struct Board {
+  const char* name;
+  Pins  pins;
+  // Analog front end
+  float vinScale;       // vbat divider: vbat = V(adc) * vinScale
+  float vbatOffV;       // what the divider + ADC read low, added back (bench-calibrated per board)
+  float shuntOhm;
+  float gainLoad;       // load shunt amplifier
+  float gainBatt;       // battery charge / discharge shunt amplifiers
+  float offLoadA;       // amplifier offsets, added back after the conversion
+  float offChgA;
+  float offDsgA;
+  float ntcVref;        // divider: Rfixed on top, NTC to GND
+  float ntcRfixed;
+  float ntcR25;
+  float ntcBeta;
+  // Board draw and what the shunts can resolve
+  float iActiveA;       // LCD + MCU, used when discharge is below adcMinA
+  float iSleepA;
+  float adcMinA;        // shunt readings below this are noise (SocMgr)
+  float naChgA;         // UI shows "NA" below these
+  float naDsgA;
+  float naLoadA;
+  float idleLoadA;      // IdleSleep: the load counts as off below this
+  // Supplies
+  float dcdcV;          // DC-DC nominal output
+  float brownoutV;      // vbat where the 3.3 V rail reaches the ESP32 brownout level
+  // I2C shunt monitors; where fitted they replace the ADC channels
+  Ina   inaBatt;        // in the cell lead, charge positive: vbat, chg / dsg current
+  Ina   inaLoad;        // in the load lead: load current
+};
+
+struct Battery {
+  const char* name;
+  float capacityMah;    // nominal; the starting FCC
+  float vbatFull;
+  float vbatEmpty;
+  float vbatCutoff;     // loaded vbat: empty whatever the OCV says
+  // Dynamic FCC while discharging: fcc = fccSlope * I_dsg + fccIcept
+  float fccSlope;
+  float fccIcept;
+  float fccMin;
+  float fccMax;
+  // Temperature windows
+  float chgColdC;
+  float chgHotC;
+  float dsgColdC;
+  float dsgHotC;
+};
+
+// ------------------------------------------------------------
+// Boards
+// ------------------------------------------------------------
+// Rev A: the first board (x29.5 / x16 amplifiers on 50 mOhm)
+static constexpr Board BOARD_REV_A = {
+  "rev_a",
+  // en_chg dcdc relay load_dsg bypass | done chg btn | volt load bchg bdsg ntc | sda scl
+  { 4, 14, 27, 13, 2,   22, 25, 26,   34, 33, 39, 36, 35,   -1, -1 },
+  2.0f, 0.037f,                       // divider, vbat offset
+  0.050f, 29.5f, 16.0f,               // shunt, gains
+  0.015f, 0.020f, 0.040f,             // offsets load / chg / dsg
+  3.0f, 10000.0f, 10000.0f, 4250.0f,  // NTC
+  0.180f, 0.003f, 0.200f,             // active, sleep, adc floor
+  0.218f, 0.218f, 0.120f, 0.112f,     // NA chg / dsg / load, idle load
+  5.0f, 3.00f,                        // DC-DC, brownout
+  { 0, 0, 0.0f, 0.0f },               // INA batt / load: not fitted
+  { 0, 0, 0.0f, 0.0f },
+};
+
+// Rev B: 25 mOhm shunts behind x50 / x32 zero-drift amplifiers (no
+// offsets, finer floors), vbat divider 1:3, NTC moved to GPIO 32. No
+// vbat offset measured on it yet.
+static constexpr Board BOARD_REV_B = {
+  "rev_b",
+  { 4, 14, 27, 13, 2,   22, 25, 26,   34, 33, 39, 36, 32,   -1, -1 },
+  3.0f, 0.0f,
+  0.025f, 50.0f, 32.0f,
+  0.0f, 0.0f, 0.0f,
+  3.0f, 10000.0f, 10000.0f, 3950.0f,
+  0.150f, 0.002f, 0.050f,
+  0.060f, 0.060f, 0.060f, 0.060f,
+  5.0f, 3.00f,
+  { 0, 0, 0.0f, 0.0f },
+  { 0, 0, 0.0f, 0.0f },
+};
+
+// Rev C: rev A plus an INA226 on a 10 mOhm shunt in the cell lead and an
+// INA219 on 100 mOhm in the load lead, I2C on GPIO 21 / 17. The amplifiers
+// stay fitted and take over if a monitor stops answering. The monitors
+// resolve a few mA, so the floors drop to 5-10 mA. Rev A's 37 mV vbat
+// offset was measured on rev A boards; rev C has none measured yet.
+static constexpr Board BOARD_REV_C = {
+  "rev_c",
+  { 4, 14, 27, 13, 2,   22, 25, 26,   34, 33, 39, 36, 35,   21, 17 },
+  2.0f, 0.0f,
+  0.050f, 29.5f, 16.0f,
+  0.015f, 0.020f, 0.040f,
+  3.0f, 10000.0f, 10000.0f, 4250.0f,
+  0.180f, 0.003f, 0.010f,
+  0.005f, 0.005f, 0.005f, 0.010f,
+  5.0f, 3.00f,
+  { 226, 0x40, 0.010f, 4.0f },
+  { 219, 0x41, 0.100f, 1.5f },
+};
+
+// ------------------------------------------------------------
+// Batteries
+// ------------------------------------------------------------
+// 2000 mAh NMC pack (bench-tuned FCC fit)
+static constexpr Battery BATT_NMC_2000 = {
+  "nmc_2000",
+  2000.0f,
+  4.100f, 3.20f, 3.00f,
+  -280.0f, 2130.0f, 1200.0f, 2130.0f,
+  0.0f, 45.0f, -20.0f, 60.0f,
+};
+
+// 3500 mAh NMC 18650 (high capacity, loses more of it at high current)
+static constexpr Battery BATT_NMC_3500 = {
+  "nmc_3500",
+  3500.0f,
+  4.100f, 3.20f, 2.90f,
+  -450.0f, 3650.0f, 2400.0f, 3650.0f,
+  0.0f, 45.0f, -20.0f, 60.0f,
+};
+
+// ------------------------------------------------------------
+
+#ifndef BOARD_PROFILE
+#define BOARD_PROFILE BOARD_REV_A
+#endif
+#ifndef BATTERY_PROFILE
+#define BATTERY_PROFILE BATT_NMC_2000
+#endif
+
+static constexpr Board   BOARD   = BOARD_PROFILE;
+static constexpr Battery BATTERY = BATTERY_PROFILE;
+
+} // namespace Profile
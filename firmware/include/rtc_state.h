@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+#include "adc_mgr.h"
+
+namespace CmdMgr { struct AppConfig; }
+
+// ------------------------------------------------------------
+// Module state in RTC memory, for a fast restart after a reset.
+//
+// After a watchdog reset, a panic or a brownout, NVS can be up to
+// SocMgr's SAVE_MS stale. It also never held the LoadProt trip, the
+// ChargeMgr debounce, the ThermalMgr flags or the user enables. update()
+// copies all of that into one block in RTC_NOINIT memory after every
+// frame (about 100 bytes plus a CRC-16). restore() runs at boot once the
+// modules have begun from NVS. If the block is intact it replaces their
+// state, so NVS is only the fallback after a power cycle.
+// RTC_NOINIT rather than RTC_DATA: the bootloader re-initialises
+// RTC_DATA on every reset that is not a deep sleep wake.
+//
+// Brownout: RTC memory only survives while the supply holds. update()
+// also follows the vbat slope. If vbat would reach boV within boLeadS
+// at that slope, or is within BO_MARGIN_V of it, the NVS records
+// (SocMgr, EnergyMgr) and the open log block are committed once. The
+// test re-arms once vbat is back BO_REARM_V above boV.
+//
+// BT command:
+//   {"cmd":"boot"}   reset reason, state source, staleness, restore time
+// ------------------------------------------------------------
+namespace RtcState {
+
+struct Config {
+  float boV     = Profile::BOARD.brownoutV;  // vbat where the 3.3 V rail reaches the ESP32 brownout level
+  float boLeadS = 5.0f;      // commit this long before it at the current slope; 0 = level only
+};
+
+enum Source : uint8_t { SRC_NVS = 0, SRC_RTC = 1 };
+
+struct Info {
+  Source   src;
+  uint8_t  reason;           // esp_reset_reason()
+  uint64_t staleMs;          // block age at restore (SRC_RTC)
+  uint32_t restoreUs;        // validate + apply
+  uint32_t atMs;             // millis() when the state was back
+  uint32_t restores;         // RTC restores since power-on
+  uint32_t boCommits;        // brownout commits since power-on
+  float    slopeVs;          // current vbat slope
+};
+
+// Early in setup(), after TimeMgr::begin(): checks the block, registers "boot"
+void begin(const Config& cfg = Config{});
+void setConfig(const Config& cfg);
+const Config& config();
+
+// After every module's begin(): true if the RTC block was applied
+bool restore(CmdMgr::AppConfig& cfg);
+
+// End of every frame; tUs = frame stamp
+void update(const AdcReadings& adc, uint64_t tUs, const CmdMgr::AppConfig& cfg);
+
+Info info();
+const char* reasonName(uint8_t reason);
+
+} // namespace RtcState
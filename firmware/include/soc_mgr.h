@@ -4,7 +4,61 @@
 
 namespace SocMgr {
 
+  // Model constants. Defaults come from the board and battery profile
+  // (profile.h); host tools (trace-replay) override them to try a change
+  // against a recording.
+  struct Params {
+    float    i_active_a    = Profile::BOARD.iActiveA;   // LCD + MCU, used when discharge is below adc_min_a
+    float    i_sleep_a     = Profile::BOARD.iSleepA;
+    float    adc_min_a     = Profile::BOARD.adcMinA;    // shunt readings below this are noise
+    float    vbat_full     = Profile::BATTERY.vbatFull;
+    float    vbat_empty    = Profile::BATTERY.vbatEmpty;
+    uint32_t empty_time_ms = 15000;    // below vbat_empty this long => empty
+
+    // Empty test on the open-circuit voltage vbat + I_dsg * R, with R
+    // learnt from load steps (IrEst, lib/ir_est). Until R is known, and
+    // with ir_comp off, it is the plain loaded vbat.
+    bool     ir_comp       = true;
+    float    ir_min_step_a = 0.10f;
+    float    ir_lambda     = 0.98f;    // RLS forgetting factor per step
+    float    vbat_cutoff   = Profile::BATTERY.vbatCutoff;  // loaded vbat: empty whatever the OCV says
+
+    // Dynamic FCC while discharging: fcc = fcc_slope * I_dsg + fcc_icept
+    float    fcc_slope     = Profile::BATTERY.fccSlope;
+    float    fcc_icept     = Profile::BATTERY.fccIcept;
+    float    fcc_min       = Profile::BATTERY.fccMin;
+    float    fcc_max       = Profile::BATTERY.fccMax;
+  };
+
+  void setParams(const Params& p);
+  const Params& params();
+
+  // Internal resistance: the health indicator is ohm / refOhm, the
+  // growth since the first estimate this cell got
+  struct IrInfo {
+    float    ohm;        // NAN until MIN_STEPS steps were seen
+    float    refOhm;     // first estimate, kept in NVS; NAN if none yet
+    float    ocv;        // last empty-test voltage
+    uint32_t steps;      // accepted since boot
+    uint32_t rejects;
+  };
+  IrInfo ir();
+  void   resetIr();      // new cell: forget R and the reference
+
   void begin(float batteryCapacity_mAh);
+
+  // Coulomb counter state for RtcState (after begin(): replaces what
+  // begin() read from NVS)
+  struct State {
+    float usedMah;
+    float fccMah;
+    float irOhm;         // NAN while learning
+  };
+  State state();
+  void  restore(const State& s);
+
+  // Store to NVS now (also done every SAVE_MS from update())
+  void  save();
   void update(const AdcReadings& a, bool isCharging, bool isSleeping, bool isFull);
 
   // Call every time ADC updates
@@ -12,9 +66,15 @@ namespace SocMgr {
               bool isCharging,
               bool isSleeping);
 
+  // Calibration point the last update() latched, once per approach:
+  // full (used = 0) or empty (used = FCC)
+  enum Cal : uint8_t { CAL_NONE = 0, CAL_FULL, CAL_EMPTY };
+  Cal lastCal();
+
   float soc();        // 0–100 %
   float remaining();  // mAh (REM = USED mAh, starts at 0 and increases with discharge)
 
   float fcc();        // ✅ ADD
+  void  setCapacity(float capacity_mAh);  // new FCC, saved to flash
   float inet();       // ✅ ADD
 }
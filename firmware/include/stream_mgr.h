@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+#include "adc_mgr.h"
+
+// High-rate raw ADC streaming over BT (TlmProto SCHEMA_RAW_V1 frames).
+// Every ADC read is tapped from ADCMgr::service(), batched into large
+// packets and queued as telemetry. If the BT TX queue backs up, the
+// stream decimates itself instead of flooding the link.
+namespace StreamMgr {
+  void begin(ADCMgr& adc);
+
+  // tick_us: ADC tick while streaming (normal rate is restored on stop)
+  // chMask : bit per ADC channel to forward (bit0 = VOLT ... bit4 = BDSG)
+  bool start(uint32_t tick_us, uint8_t chMask);
+  void stop();
+  bool active();
+
+  // Adds the "adc" scheduler task (adc.service() + service())
+  // service(): flushes aged packets and adapts decimation
+  void service();
+
+  // Max ADC reads per adc.service() call while streaming
+  uint8_t readsPerService();
+
+  // Counters since boot. A dropped batch (no room on the TX queue) still
+  // takes a frame seq, so the receiver sees it as a gap.
+  uint8_t  decimation();
+  uint32_t packetsSent();
+  uint32_t packetsDropped();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+
+// ------------------------------------------------------------
+// Cooperative scheduler: loop() is one TaskSched::runPass().
+//
+// Modules add their own task in begin(); main.cpp only adds the glue
+// tasks (frame, charge, ui). Each pass runs every task that is due, in
+// priority order, and records run time, release jitter and deadline
+// misses per task. Nothing preempts: a slow task delays everything
+// behind it, which is exactly what the stats are there to show.
+//
+// BT command:
+//   {"cmd":"sched"}                 all tasks (compact arrays; "next":N
+//                                   if more follow: ask again with "from":N)
+//   {"cmd":"sched","task":"adc"}    one task in full
+//   {"cmd":"sched","reset":1}       clear the counters
+// ------------------------------------------------------------
+namespace TaskSched {
+
+// What to do when a periodic task is released a full period (or more) late
+enum class Overrun : uint8_t {
+  Skip,      // drop the missed releases, next one is a period from now
+  CatchUp,   // run the missed releases back to back (up to MAX_CATCHUP)
+};
+
+struct TaskDef {
+  const char* name;
+  void      (*fn)();
+  uint32_t    periodUs;     // 0 = every pass
+  uint8_t     prio;         // 0 runs first; equal prio keeps add() order
+  uint32_t    deadlineUs;   // release -> finished, 0 = no deadline
+  Overrun     overrun;
+};
+
+struct Stats {
+  uint32_t runs;
+  uint32_t misses;          // finished later than release + deadline
+  uint32_t skipped;         // releases dropped (Overrun::Skip or catch-up limit)
+  uint32_t runMaxUs;
+  uint32_t jitMaxUs;        // start - release
+  uint64_t runTotalUs;
+  uint64_t jitTotalUs;
+};
+
+static constexpr size_t   MAX_TASKS   = 16;
+static constexpr uint32_t MAX_CATCHUP = 4;
+
+// Registers the "sched" command
+void begin();
+
+// Returns the task id (stable), -1 if the table is full. Adding a name
+// that is already there replaces its definition, keeps id and stats.
+int  add(const TaskDef& def);
+int  find(const char* name);
+void setPeriod(int id, uint32_t periodUs);
+void setEnabled(int id, bool on);
+
+// Call from loop()
+void runPass();
+
+void resetStats();
+
+// Enumeration in run order (i is not an id)
+size_t         count();
+const TaskDef* def(size_t i);
+Stats          stats(size_t i);
+uint32_t       passes();
+uint32_t       passMaxUs();
+
+} // namespace TaskSched
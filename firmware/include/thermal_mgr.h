@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+#include "adc_mgr.h"
+
+// ------------------------------------------------------------
+// Thermal protection from the NTC (AdcReadings::temp_c, once per frame).
+//
+// Charging and discharging each have a temperature window. Outside it
+// that direction is blocked until the cell is hystC back inside. dT/dt
+// is the least-squares slope over the last minute. A rise faster than
+// rateCMin blocks both directions until the slope is below half that.
+// NTC_FAULT_FRAMES invalid readings in a row (NAN: open or shorted
+// NTC) are a fault and block both as well.
+//
+// main.cpp ANDs allowCharge() / allowLoad() into the EN_CHARGE /
+// EN_LOAD_DSG enable logic next to the user enables and LoadProt.
+// ------------------------------------------------------------
+namespace ThermalMgr {
+
+struct Config {
+  bool  enabled  = true;     // false: report only, never block
+  // windows: battery profile (profile.h)
+  float chgColdC = Profile::BATTERY.chgColdC;   // Li-ion: no charging below 0 C
+  float chgHotC  = Profile::BATTERY.chgHotC;
+  float dsgColdC = Profile::BATTERY.dsgColdC;
+  float dsgHotC  = Profile::BATTERY.dsgHotC;
+  float hystC    = 3.0f;
+  float rateCMin = 2.0f;     // C/min, 0 = no rate trip
+};
+
+// flags(), also the "therm" telemetry field
+enum Flag : uint8_t {
+  TH_CHG_COLD = 1 << 0,
+  TH_CHG_HOT  = 1 << 1,
+  TH_DSG_COLD = 1 << 2,
+  TH_DSG_HOT  = 1 << 3,
+  TH_RATE     = 1 << 4,
+  TH_NTC      = 1 << 5,      // NTC reading invalid
+};
+
+void begin(const Config& cfg = Config{});
+
+// Thresholds change at runtime without clearing the state
+void setConfig(const Config& cfg);
+const Config& config();
+
+// Once per ADC frame
+void update(const AdcReadings& adc);
+
+bool allowCharge();
+bool allowLoad();
+
+uint8_t  flags();
+float    rateCMin();         // C/min, NAN until 15 s of valid readings
+uint32_t sinceS();           // since flags() last changed
+uint32_t trips();            // flags set since boot
+uint64_t lastTripMs();       // TimeMgr ms, 0 = none
+
+// Flags for RtcState, so a reset doesn't skip the hysteresis. The dT/dt
+// window starts empty again.
+struct State {
+  uint8_t  flags;
+  uint64_t sinceMs;
+};
+State state();
+void  restore(const State& s);
+
+} // namespace ThermalMgr
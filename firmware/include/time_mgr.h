@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+// One clock for every module: monotonic µs since power-on, 64 bit, from
+// esp_timer_get_time() plus a base carried across deep sleep and soft
+// resets in RTC memory (see lib/time_sync). Only a power cycle restarts
+// it at 0.
+//
+// The host maps it to wall time with:
+//   {"cmd":"time"}                               -> mono_us, epoch_us (if synced), drift
+//   {"cmd":"time","epoch_us":1760000000000000}   sample "now"
+//   {"cmd":"time","epoch_us":E,"at_us":M}        sample for device time M
+// The second form lets the host take M from a previous reply and E from
+// the midpoint of its round trip, so BT latency cancels out.
+//
+// Nothing else may call settimeofday(): the RTC side of the bridge reads
+// gettimeofday(), which IDF keeps running through sleep.
+namespace TimeMgr {
+
+void begin();            // first thing in setup()
+void service();          // "time" scheduler task, refreshes the RTC anchor
+void prepareSleep();     // right before esp_deep_sleep_start()
+
+uint64_t nowUs();
+uint64_t nowMs();
+// Low 32 bits of nowMs() for fixed 32-bit wire fields (unwrap on the host)
+inline uint32_t ms32() { return (uint32_t)nowMs(); }
+
+bool     synced();
+int64_t  epochUs(uint64_t monoUs);     // 0 if not synced
+int32_t  driftPpb();
+uint32_t boots();                      // wakes/resets since power-on
+uint64_t lastGapUs();                  // time bridged at the last boot
+
+} // namespace TimeMgr
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+// Telemetry fan-out: a frame is encoded once into a pooled, ref-counted
+// buffer and handed to every connected transport. Transports that need
+// the bytes after send() returns take a reference instead of copying.
+namespace TlmBus {
+
+enum class Fmt : uint8_t { Json = 0, Bin = 1 };
+
+struct FrameBuf {
+  // the full JSON line runs ~600 bytes and can reach 735 (main.cpp
+  // checks JSON_FULL_FMT against this)
+  static constexpr size_t CAP = 768;
+  uint8_t  data[CAP];
+  uint16_t len;
+  Fmt      fmt;
+  bool     urgent;   // BT: queued as a command reply, telemetry never evicts it
+  std::atomic<uint8_t> refs;
+};
+
+// refs = 1 for the caller. nullptr if the pool is exhausted.
+FrameBuf* alloc(Fmt fmt);
+void retain(FrameBuf* f);
+void release(FrameBuf* f);
+size_t poolFree();
+
+class Transport {
+public:
+  virtual ~Transport() {}
+  virtual const char* name() const = 0;
+  virtual bool connected() = 0;
+  // Must not block. Take a reference (retain) to keep f past the call.
+  // Return false if the frame had to be dropped.
+  virtual bool send(FrameBuf* f) = 0;
+  // Called from the "tlm_bus" task to push out queued bytes (and track
+  // the connection)
+  virtual void service() {}
+
+  Fmt      fmt = Fmt::Json;
+  bool     custom = false;   // fed by TlmSub, skipped by the shared full frame
+  uint32_t framesSent = 0;
+  uint32_t framesDropped = 0;
+};
+
+static constexpr size_t MAX_TRANSPORTS = 4;
+
+// Adds the "tlm_bus" scheduler task
+void begin();
+
+bool add(Transport* t);
+size_t count();
+Transport* get(size_t i);
+
+// Is any connected, non-custom transport using this format? (skip encoding if not)
+bool wants(Fmt fmt);
+
+// Send f to every connected transport with f->fmt, then drop the
+// caller's reference.
+void publish(FrameBuf* f);
+
+// Send f to t alone, custom or not, and drop the caller's reference.
+// For frames every client gets in order (EventMgr), one transport at a
+// time. false if t refused it.
+bool sendTo(Transport* t, FrameBuf* f);
+
+void service();
+
+// Built-in transports
+Transport* bt();    // BtMgr (SPP), telemetry priority
+Transport* usb();   // USB Serial, non-blocking via availableForWrite()
+void usbBegin(unsigned long baud);
+void usbEnable(bool on);
+uint32_t usbStalls();   // times the USB port took nothing for 2 s and was dropped
+
+} // namespace TlmBus
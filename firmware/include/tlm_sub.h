@@ -0,0 +1,47 @@
+#pragma once
+#include <Arduino.h>
+#include "tlm_bus.h"
+#include "tlm_proto.h"
+
+// Per-client telemetry subscriptions.
+// A subscribed transport stops getting the shared full frame and instead
+// gets only its fields, at its own period, and only when a field moved
+// by at least its threshold (plus a keyframe every KEYFRAME_MS).
+//
+// BT command:
+//   {"cmd":"sub","fields":["soc"],"period_ms":10000,"th":{"soc":0.5}}
+//   {"cmd":"sub","mask":7,"period_ms":50}
+//   {"cmd":"sub","off":1}        back to the full frame
+//   {"cmd":"sub"}                current subscription + counters
+namespace TlmSub {
+
+struct Snapshot {
+  uint64_t ms;             // TimeMgr ms
+  float v[TlmProto::FIELD_COUNT];
+};
+
+// Fills only the fields in mask (others may be left stale)
+typedef void (*FillFn)(Snapshot& s, uint16_t mask);
+
+struct Stats {
+  uint32_t frames;
+  uint32_t bytes;
+  uint32_t fieldsSent;
+  uint32_t fieldsSkipped;   // due but unchanged
+};
+
+static constexpr uint32_t MIN_PERIOD_MS = 20;
+static constexpr uint32_t KEYFRAME_MS   = 30000;
+
+void begin(FillFn fill);
+
+// th: per-field threshold array (FIELD_COUNT) or nullptr for 1 LSB
+bool subscribe(TlmBus::Transport* t, uint16_t mask, uint32_t periodMs, const float* th);
+void unsubscribe(TlmBus::Transport* t);
+bool subscribed(TlmBus::Transport* t);
+Stats stats(TlmBus::Transport* t);
+
+// Run by the "tlm_sub" scheduler task (added in begin())
+void service();
+
+} // namespace TlmSub
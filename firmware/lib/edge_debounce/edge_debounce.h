@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// ------------------------------------------------------------
+// Debounce from edge timestamps.
+//
+// A pin-change interrupt push()es (time, level) into a small ring, the
+// task side update()s from it. A level counts as stable once it has been
+// held for debounceUs, measured between the edge time stamps, so the
+// stable state and stableSinceUs() come out the same however late
+// update() runs; a late update() only reports the change later.
+//
+// One producer (the ISR), everything else is the task side. A full ring
+// drops the edge and counts it; the owner then resync()s from the pin.
+// ------------------------------------------------------------
+template <size_t QLEN = 16>
+class EdgeDebounce {
+  static_assert(QLEN >= 2 && (QLEN & (QLEN - 1)) == 0, "EdgeDebounce: QLEN must be a power of two");
+
+public:
+  // Before the interrupt is attached
+  void begin(uint64_t nowUs, bool level, uint32_t debounceUs) {
+    debounceUs_ = debounceUs;
+    raw_ = stable_ = level;
+    rawUs_ = stableUs_ = nowUs;
+    head_.store(0);
+    tail_.store(0);
+    dropped_.store(0);
+    edges_ = changes_ = 0;
+  }
+
+  // ---- ISR side ----
+  inline __attribute__((always_inline)) void push(uint64_t tUs, bool level) {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) >= QLEN) {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    ring_[h % QLEN].tUs = tUs;
+    ring_[h % QLEN].level = level;
+    head_.store(h + 1, std::memory_order_release);
+  }
+
+  // ---- task side ----
+
+  // Takes the queued edges; true if the stable level changed
+  bool update(uint64_t nowUs) {
+    const uint32_t before = changes_;
+    uint32_t t = tail_.load(std::memory_order_relaxed);
+    const uint32_t h = head_.load(std::memory_order_acquire);
+    for (; t != h; t++) {
+      const Edge& e = ring_[t % QLEN];
+      edge(e.tUs, e.level);
+    }
+    tail_.store(t, std::memory_order_release);
+    settle(nowUs);
+    return changes_ != before;
+  }
+
+  // After drops: the pin as read now counts as an edge now
+  bool resync(uint64_t nowUs, bool level) {
+    const bool changed = update(nowUs);
+    edge(nowUs, level);
+    return changed;
+  }
+
+  bool     stable() const        { return stable_; }
+  uint64_t stableSinceUs() const { return stableUs_; }   // first edge + debounceUs
+  bool     pending() const       { return raw_ != stable_; }
+  // Nothing queued and nothing to wait for: update() would be a no-op
+  bool     idle() const {
+    return !pending() && head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+  }
+
+  uint32_t edges() const   { return edges_; }
+  uint32_t changes() const { return changes_; }
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  struct Edge {
+    uint64_t tUs;
+    bool     level;
+  };
+
+  void edge(uint64_t tUs, bool level) {
+    edges_++;
+    settle(tUs);                 // the level before it may have been held long enough
+    if (level == raw_) return;   // same level twice: an edge in between was missed
+    raw_ = level;
+    rawUs_ = tUs;
+  }
+
+  void settle(uint64_t tUs) {
+    // tUs < rawUs_: an edge came in after the caller read the clock
+    if (raw_ != stable_ && tUs >= rawUs_ && tUs - rawUs_ >= debounceUs_) {
+      stable_ = raw_;
+      stableUs_ = rawUs_ + debounceUs_;
+      changes_++;
+    }
+  }
+
+  Edge                  ring_[QLEN];
+  std::atomic<uint32_t> head_{0};       // ISR
+  std::atomic<uint32_t> tail_{0};       // task
+  std::atomic<uint32_t> dropped_{0};    // ISR
+  uint32_t              debounceUs_ = 0;
+  bool                  raw_ = false;
+  bool                  stable_ = false;
+  uint64_t              rawUs_ = 0;
+  uint64_t              stableUs_ = 0;
+  uint32_t              edges_ = 0;
+  uint32_t              changes_ = 0;
+};
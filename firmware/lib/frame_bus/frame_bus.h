@@ -0,0 +1,253 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// ------------------------------------------------------------
+// Zero-copy frame bus: one producer, any number of consumers, no locks.
+//
+// Frames live in a pool of SLOTS slots. The producer claims a free slot,
+// fills it in place and commits it, which gives it the next sequence
+// number and a stamp from the bus clock (TimeMgr::nowUs on the device).
+// A consumer gets a Ref: a read reference counted on the slot, so the
+// producer never reuses a slot somebody is still reading. The consumer
+// reads the frame where it lies, with no copy and no lock, and drops the
+// Ref when done.
+//
+// Each consumer owns a Sub (its cursor and counters, written only by
+// that consumer):
+//   Mode::Every   every frame in order; frames that were already reused
+//                 when it got to them count as drops
+//   Mode::Latest  only the newest; the frames in between count as
+//                 skipped (by design, not a loss)
+// plus lag (frames published after the one it got) and latency (commit
+// to read). Consumers may run on any task or core.
+//
+// Claiming never blocks: if every slot is held or is the newest frame,
+// claim() returns nullptr and counts it (noSlot). Keep SLOTS above
+// "Refs held at once" + 1. host-tools/frame-bench builds it too,
+// through adc_mgr.h.
+// ------------------------------------------------------------
+template <typename T, size_t SLOTS = 8, size_t MAX_SUBS = 8>
+class FrameBus {
+  static_assert(SLOTS >= 3 && SLOTS <= 255, "FrameBus: 3..255 slots");
+
+  struct Slot {
+    std::atomic<uint32_t> seq;    // EMPTY, CLAIMED or the frame's seq
+    std::atomic<uint32_t> refs;
+    uint64_t              tUs;
+    T                     data;
+  };
+
+public:
+  typedef uint64_t (*Clock)();
+
+  enum class Mode : uint8_t { Every, Latest };
+
+  struct Sub {
+    const char* name;
+    Mode        mode;
+    uint32_t    next;         // seq wanted next (Latest: anything >= next)
+    uint32_t    frames;
+    uint32_t    drops;        // Every: reused before it was read
+    uint32_t    skipped;      // Latest: superseded before it was read
+    uint32_t    lagMax;       // frames published after the one read
+    uint32_t    latMaxUs;     // commit -> read
+    uint64_t    latTotalUs;
+  };
+
+  // Read reference to one frame; the slot stays valid until it goes
+  class Ref {
+  public:
+    Ref() {}
+    ~Ref() { release(); }
+    Ref(const Ref&) = delete;
+    Ref& operator=(const Ref&) = delete;
+
+    explicit operator bool() const { return slot_ != nullptr; }
+    const T& operator*()  const { return slot_->data; }
+    const T* operator->() const { return &slot_->data; }
+    uint32_t seq() const { return seq_; }
+    uint64_t tUs() const { return slot_->tUs; }
+
+    void release() {
+      if (slot_) slot_->refs.fetch_sub(1);
+      slot_ = nullptr;
+    }
+
+  private:
+    friend class FrameBus;
+    Slot*    slot_ = nullptr;
+    uint32_t seq_ = 0;
+  };
+
+  explicit FrameBus(Clock clock) : clock_(clock) {
+    for (Slot& s : slots_) { s.seq.store(EMPTY); s.refs.store(0); s.tUs = 0; }
+    for (auto& h : hist_) h.store(0);
+  }
+
+  // ---- producer (one task) ----
+
+  // Slot to fill in place, nullptr if none is free. Its previous content
+  // is stale, not cleared. Call commit() before the next claim().
+  T* claim() {
+    const uint32_t newestSlot = hist_[last_.load() % HIST].load();
+    for (size_t n = 0; n < SLOTS; n++) {
+      const uint32_t i = cursor_;
+      cursor_ = (cursor_ + 1) % SLOTS;
+      if (i == newestSlot && last_.load()) continue;   // peek() keeps working
+
+      // Mark it claimed, then look for readers: a reader takes its ref
+      // first and then checks seq, so one of the two sides always sees
+      // the other (both seq_cst)
+      Slot& s = slots_[i];
+      const uint32_t old = s.seq.exchange(CLAIMED);
+      if (s.refs.load() == 0) {
+        claimed_ = (int)i;
+        return &s.data;
+      }
+      s.seq.store(old);
+    }
+    noSlot_++;
+    return nullptr;
+  }
+
+  // Publishes the claimed slot as the next frame
+  void commit() {
+    if (claimed_ < 0) return;
+    Slot& s = slots_[claimed_];
+    const uint32_t seq = last_.load() + 1;
+    s.tUs = clock_();
+    hist_[seq % HIST].store((uint32_t)claimed_);
+    s.seq.store(seq);
+    last_.store(seq);
+    claimed_ = -1;
+  }
+
+  // ---- consumers ----
+
+  // Registers s for the stats listing. Every starts with the next frame,
+  // Latest with the current one.
+  bool subscribe(Sub& s, const char* name, Mode mode) {
+    s.name = name;
+    s.mode = mode;
+    const uint32_t last = last_.load();
+    s.next = (mode == Mode::Latest && last) ? last : last + 1;
+    resetStats(s);
+    for (size_t i = 0; i < subCount_; i++) {
+      if (subs_[i] == &s) return true;
+    }
+    if (subCount_ >= MAX_SUBS) return false;
+    subs_[subCount_++] = &s;
+    return true;
+  }
+
+  // Next frame for s by its mode; false if there is nothing new.
+  // Releases whatever out held before.
+  bool read(Sub& s, Ref& out) {
+    out.release();
+    uint32_t last = last_.load();
+
+    if (s.mode == Mode::Latest) {
+      for (int tries = 0; tries < RETRIES && (int32_t)(last - s.next) >= 0; tries++) {
+        if (acquire(last, out)) {
+          s.skipped += last - s.next;
+          s.next = last + 1;
+          delivered(s, out);
+          return true;
+        }
+        last = last_.load();   // reused under us: a newer one is out
+      }
+      return false;
+    }
+
+    // Every: frames more than HIST behind cannot be found any more
+    if ((int32_t)(last - s.next) >= (int32_t)HIST) {
+      const uint32_t oldest = last - HIST + 1;
+      s.drops += oldest - s.next;
+      s.next = oldest;
+    }
+    while ((int32_t)(last - s.next) >= 0) {
+      const uint32_t want = s.next++;
+      if (acquire(want, out)) {
+        delivered(s, out);
+        return true;
+      }
+      s.drops++;
+    }
+    return false;
+  }
+
+  // Newest frame, no subscription and no counters
+  bool peek(Ref& out) {
+    out.release();
+    for (int tries = 0; tries < RETRIES; tries++) {
+      const uint32_t last = last_.load();
+      if (!last) return false;
+      if (acquire(last, out)) return true;
+    }
+    return false;
+  }
+
+  static void resetStats(Sub& s) {
+    s.frames = s.drops = s.skipped = s.lagMax = s.latMaxUs = 0;
+    s.latTotalUs = 0;
+  }
+
+  // ---- stats ----
+  uint32_t   seq() const      { return last_.load(); }
+  uint32_t   noSlot() const   { return noSlot_; }
+  size_t     subCount() const { return subCount_; }
+  Sub*       sub(size_t i)    { return i < subCount_ ? subs_[i] : nullptr; }
+  void       resetStats() {
+    noSlot_ = 0;
+    for (size_t i = 0; i < subCount_; i++) resetStats(*subs_[i]);
+  }
+
+  static constexpr size_t slots() { return SLOTS; }
+
+private:
+  static constexpr uint32_t EMPTY   = 0;
+  static constexpr uint32_t CLAIMED = 0xFFFFFFFFu;
+  static constexpr size_t   HIST    = SLOTS * 2;   // seq -> slot, newest HIST seqs
+  static constexpr int      RETRIES = 3;
+
+  // Takes a ref on the slot holding seq, if it still does
+  bool acquire(uint32_t seq, Ref& out) {
+    if (seq == EMPTY || seq == CLAIMED) return false;
+    for (int tries = 0; tries < RETRIES; tries++) {
+      Slot& s = slots_[hist_[seq % HIST].load()];
+      s.refs.fetch_add(1);
+      const uint32_t have = s.seq.load();
+      if (have == seq) {
+        out.slot_ = &s;
+        out.seq_ = seq;
+        return true;
+      }
+      s.refs.fetch_sub(1);
+      // CLAIMED may be a producer that backs off again right away
+      if (have != CLAIMED) return false;
+    }
+    return false;
+  }
+
+  void delivered(Sub& s, const Ref& r) {
+    s.frames++;
+    const uint32_t lag = last_.load() - r.seq();
+    if (lag > s.lagMax) s.lagMax = lag;
+    const uint64_t now = clock_();
+    const uint32_t lat = now > r.tUs() ? (uint32_t)(now - r.tUs()) : 0;
+    s.latTotalUs += lat;
+    if (lat > s.latMaxUs) s.latMaxUs = lat;
+  }
+
+  Clock                 clock_;
+  Slot                  slots_[SLOTS];
+  std::atomic<uint32_t> hist_[HIST];
+  std::atomic<uint32_t> last_{0};
+  uint32_t              cursor_ = 0;
+  int                   claimed_ = -1;
+  uint32_t              noSlot_ = 0;
+  Sub*                  subs_[MAX_SUBS] = {};
+  size_t                subCount_ = 0;
+};
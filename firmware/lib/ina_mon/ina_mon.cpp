@@ -0,0 +1,205 @@
+#include "ina_mon.h"
+
+namespace InaMon {
+
+// ------------------------------------------------------------
+// Register level
+// ------------------------------------------------------------
+// INA219: BRNG 16 V, BADC / SADC 8 x 12 bit (4.26 ms each), continuous
+static constexpr uint16_t INA219_ADC_8X = 0xB;
+static constexpr uint32_t INA219_CONV_US = 2 * 4260;
+// INA226: AVG 16, VBUSCT / VSHCT 1.1 ms, continuous
+static constexpr uint16_t INA226_AVG_16 = 0x2;
+static constexpr uint16_t INA226_CT_1100 = 0x4;
+static constexpr uint32_t INA226_CONV_US = 16 * 2 * 1100;
+static constexpr uint16_t MODE_CONT_BOTH = 0x7;
+
+uint8_t ina219Pga(const Config& c) {
+  const float v = c.maxA * c.shuntOhm;
+  uint8_t pg = 0;
+  while (pg < 3 && v > 0.040f * (1 << pg)) pg++;
+  return pg;
+}
+
+uint16_t configWord(const Config& c) {
+  if (c.chip == INA226) {
+    return 0x4000 | (INA226_AVG_16 << 9) | (INA226_CT_1100 << 6) | (INA226_CT_1100 << 3) | MODE_CONT_BOTH;
+  }
+  return (uint16_t)(ina219Pga(c) << 11) | (INA219_ADC_8X << 7) | (INA219_ADC_8X << 3) | MODE_CONT_BOTH;
+}
+
+uint32_t conversionUs(const Config& c) {
+  return c.chip == INA226 ? INA226_CONV_US : INA219_CONV_US;
+}
+
+int16_t shuntFullScale(const Config& c) {
+  return c.chip == INA226 ? 32767 : (int16_t)(4000 << ina219Pga(c));
+}
+
+float shuntLsbV(uint16_t chip) {
+  return chip == INA226 ? INA226_SHUNT_LSB_V : INA219_SHUNT_LSB_V;
+}
+
+float busVolts(uint16_t chip, uint16_t raw) {
+  return chip == INA226 ? raw * INA226_BUS_LSB_V : (raw >> 3) * INA219_BUS_LSB_V;
+}
+
+const char* stateName(State s) {
+  switch (s) {
+    case State::Off:   return "off";
+    case State::Reset: return "reset";
+    case State::Setup: return "setup";
+    case State::Check: return "check";
+    case State::Run:   return "run";
+    case State::Fault: return "fault";
+  }
+  return "?";
+}
+
+// ------------------------------------------------------------
+// Monitor
+// ------------------------------------------------------------
+void Monitor::begin(const Config& c, uint64_t nowUs) {
+  cfg_ = c;
+  stats_ = Stats{};
+  sumA_ = sumV_ = 0;
+  n_ = 0;
+  convUs_ = conversionUs(c);
+  setState(c.chip ? State::Reset : State::Off, nowUs);
+}
+
+void Monitor::setState(State s, uint64_t nowUs) {
+  state_ = s;
+  phase_ = 0;
+  errRun_ = 0;
+  dueUs_ = nowUs;
+}
+
+void Monitor::fail(uint64_t nowUs) {
+  stats_.faults++;
+  sumA_ = sumV_ = 0;
+  n_ = 0;
+  setState(State::Fault, nowUs + RETRY_US);
+}
+
+void Monitor::readReg(Xfer& x, uint8_t reg) {
+  x.w[0] = reg;
+  x.wlen = 1;
+  x.r = rx_;
+  x.rlen = 2;
+}
+
+bool Monitor::next(uint64_t nowUs, Xfer& x) {
+  if (state_ == State::Off) return false;
+  if (state_ == State::Fault) {
+    if (nowUs < dueUs_) return false;
+    setState(State::Reset, nowUs);
+  }
+  x.addr = cfg_.addr;
+  x.r = nullptr;
+  x.rlen = 0;
+  switch (state_) {
+    case State::Reset:
+    case State::Setup: {
+      const uint16_t v = state_ == State::Reset ? CONFIG_RESET : configWord(cfg_);
+      x.w[0] = REG_CONFIG;
+      x.w[1] = (uint8_t)(v >> 8);
+      x.w[2] = (uint8_t)v;
+      x.wlen = 3;
+      return true;
+    }
+    case State::Check:
+      readReg(x, cfg_.chip == INA226 ? REG_DIE_ID : REG_CONFIG);
+      return true;
+    case State::Run:
+      // the bus read follows its shunt read straight away
+      if (phase_ == 0 && nowUs < dueUs_) return false;
+      readReg(x, phase_ == 0 ? REG_SHUNT : REG_BUS);
+      return true;
+    default:
+      return false;
+  }
+}
+
+void Monitor::done(Status st, uint64_t nowUs) {
+  if (st != Status::Done) {
+    stats_.errors++;
+    if (++errRun_ >= FAULT_ERRORS) fail(nowUs);
+    return;
+  }
+  errRun_ = 0;
+  const uint16_t v = (uint16_t)((rx_[0] << 8) | rx_[1]);
+  switch (state_) {
+    case State::Reset:
+      setState(State::Setup, nowUs);
+      break;
+    case State::Setup:
+      setState(State::Check, nowUs);
+      break;
+    case State::Check:
+      if (v != (cfg_.chip == INA226 ? INA226_DIE_ID : configWord(cfg_))) { fail(nowUs); break; }
+      // the first conversion with our settings is ready one period later
+      setState(State::Run, nowUs + convUs_);
+      break;
+    case State::Run:
+      if (phase_ == 0) {
+        shunt_ = (int16_t)v;
+        phase_ = 1;
+        break;
+      }
+      phase_ = 0;
+      stats_.reads++;
+      if (shunt_ >= shuntFullScale(cfg_) || shunt_ <= -shuntFullScale(cfg_)) stats_.clipped++;
+      if (n_ < 0xFFFF) {
+        sumA_ += shunt_ * shuntLsbV(cfg_.chip) / cfg_.shuntOhm;
+        sumV_ += busVolts(cfg_.chip, v);
+        n_++;
+      }
+      // one read per conversion; after a stall, start over from now
+      dueUs_ += convUs_;
+      if (dueUs_ <= nowUs) dueUs_ = nowUs + convUs_;
+      break;
+    default:
+      break;
+  }
+}
+
+bool Monitor::take(Sample& s) {
+  if (!n_) return false;
+  s.amps = sumA_ / n_;
+  s.volts = sumV_ / n_;
+  s.n = n_;
+  sumA_ = sumV_ = 0;
+  n_ = 0;
+  return true;
+}
+
+// ------------------------------------------------------------
+// Poller
+// ------------------------------------------------------------
+bool Poller::add(Monitor* m) {
+  if (!m || n_ >= MAX_MONITORS) return false;
+  m_[n_++] = m;
+  return true;
+}
+
+void Poller::service(uint64_t nowUs) {
+  if (!bus_ || !n_) return;
+  if (active_ >= 0) {
+    const Status st = bus_->poll();
+    if (st == Status::Busy) return;
+    m_[active_]->done(st == Status::Idle ? Status::Error : st, nowUs);
+    active_ = -1;
+  }
+  for (uint8_t k = 0; k < n_; k++) {
+    const uint8_t i = (uint8_t)((rr_ + k) % n_);
+    Xfer x;
+    if (!m_[i]->next(nowUs, x)) continue;
+    if (!bus_->start(x.addr, x.w, x.wlen, x.r, x.rlen)) return;
+    active_ = (int8_t)i;
+    rr_ = (uint8_t)((i + 1) % n_);
+    return;
+  }
+}
+
+} // namespace InaMon
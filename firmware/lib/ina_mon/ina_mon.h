@@ -0,0 +1,176 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// INA219 / INA226 shunt monitors behind an asynchronous I2C master.
+//
+// I2cIf runs one transfer at a time in the background: start() queues a
+// write, optionally followed by a repeated-start read, and poll() says
+// when it has finished. Nothing here waits for the bus.
+//
+// Monitor drives one chip. It resets and configures the chip, checks
+// that it is there (INA226: die ID, INA219: the config reads back), and
+// then reads the shunt and bus voltage registers once per conversion.
+// Conversions are summed until take() hands out their average, so a
+// slower consumer still sees every one. The current is shunt voltage /
+// shuntOhm in float, so the calibration and current registers are not
+// used. A NAK or bus error repeats the transfer. FAULT_ERRORS in a row,
+// or a wrong ID, put the chip in Fault; it is set up again RETRY_US later.
+//
+// Poller shares one I2cIf between up to MAX_MONITORS chips and gives
+// each of them the bus in turn.
+// The bus comes in through I2cIf: the ESP-IDF driver on the board
+// (i2c_bus.cpp), simulated chips in the sim (sim_i2c.cpp).
+// ------------------------------------------------------------
+namespace InaMon {
+
+enum class Status : uint8_t { Idle, Busy, Done, Nak, Error };
+
+class I2cIf {
+public:
+  virtual ~I2cIf() {}
+  // Write wlen bytes to addr, then, if rlen, read rlen bytes into r after
+  // a repeated start. r must stay valid until poll() stops saying Busy.
+  // false: the last transfer is still running.
+  virtual bool start(uint8_t addr, const uint8_t* w, uint8_t wlen, uint8_t* r, uint8_t rlen) = 0;
+  virtual Status poll() = 0;
+};
+
+// ------------------------------------------------------------
+// Registers (both chips, INA226 only where noted)
+// ------------------------------------------------------------
+enum Reg : uint8_t {
+  REG_CONFIG = 0x00,
+  REG_SHUNT  = 0x01,
+  REG_BUS    = 0x02,
+  REG_POWER  = 0x03,
+  REG_CURRENT = 0x04,
+  REG_CALIB  = 0x05,
+  REG_MASK   = 0x06,   // INA226
+  REG_MFG_ID = 0xFE,   // INA226: 0x5449 "TI"
+  REG_DIE_ID = 0xFF,   // INA226: 0x2260
+};
+
+static constexpr uint16_t CONFIG_RESET   = 0x8000;
+static constexpr uint16_t INA219_CONFIG_POR = 0x399F;
+static constexpr uint16_t INA226_CONFIG_POR = 0x4127;
+static constexpr uint16_t INA226_MFG_ID  = 0x5449;
+static constexpr uint16_t INA226_DIE_ID  = 0x2260;
+
+static constexpr float INA219_SHUNT_LSB_V = 10e-6f;
+static constexpr float INA219_BUS_LSB_V   = 4e-3f;    // bits 15..3
+static constexpr float INA226_SHUNT_LSB_V = 2.5e-6f;
+static constexpr float INA226_BUS_LSB_V   = 1.25e-3f;
+
+enum Chip : uint16_t { NONE = 0, INA219 = 219, INA226 = 226 };
+
+struct Config {
+  uint16_t chip = NONE;
+  uint8_t  addr = 0x40;
+  float    shuntOhm = 0.1f;
+  float    maxA = 1.0f;        // INA219: picks the smallest PGA range that holds it
+};
+
+// INA219 PGA setting (0..3 = 40 / 80 / 160 / 320 mV) for c.maxA
+uint8_t ina219Pga(const Config& c);
+// The value written to REG_CONFIG: continuous shunt + bus, averaging
+// (INA219: 8 x 12 bit, INA226: 16 x 1.1 ms)
+uint16_t configWord(const Config& c);
+// Time for one shunt + bus conversion with configWord()
+uint32_t conversionUs(const Config& c);
+// Largest |raw| REG_SHUNT can report with configWord()
+int16_t shuntFullScale(const Config& c);
+float shuntLsbV(uint16_t chip);
+// REG_BUS to volts (INA219: drops the CNVR / OVF bits)
+float busVolts(uint16_t chip, uint16_t raw);
+
+// ------------------------------------------------------------
+// One chip
+// ------------------------------------------------------------
+enum class State : uint8_t { Off, Reset, Setup, Check, Run, Fault };
+const char* stateName(State s);
+
+struct Xfer {
+  uint8_t  addr;
+  uint8_t  w[3];
+  uint8_t  wlen;
+  uint8_t* r;
+  uint8_t  rlen;
+};
+
+struct Sample {
+  float    amps;     // IN+ -> IN- positive
+  float    volts;    // bus
+  uint16_t n;        // conversions in the average
+};
+
+struct Stats {
+  uint32_t reads;      // conversions read
+  uint32_t errors;     // NAKs / bus errors
+  uint32_t faults;     // times in Fault
+  uint32_t clipped;    // conversions at shunt full scale
+};
+
+class Monitor {
+public:
+  static constexpr uint8_t  FAULT_ERRORS = 3;
+  static constexpr uint32_t RETRY_US = 1000000;
+
+  void begin(const Config& c, uint64_t nowUs);
+  const Config& config() const { return cfg_; }
+  State state() const { return state_; }
+  bool  ok() const { return state_ == State::Run; }
+
+  // The next transfer this chip wants; false: nothing due yet
+  bool next(uint64_t nowUs, Xfer& x);
+  // How the transfer from the last next() ended
+  void done(Status st, uint64_t nowUs);
+
+  // Average since the last take(); false if there was no conversion
+  bool take(Sample& s);
+  const Stats& stats() const { return stats_; }
+
+private:
+  void fail(uint64_t nowUs);
+  void setState(State s, uint64_t nowUs);
+  void readReg(Xfer& x, uint8_t reg);
+
+  Config   cfg_;
+  State    state_ = State::Off;
+  uint64_t dueUs_ = 0;
+  uint32_t convUs_ = 0;
+  uint8_t  phase_ = 0;        // Run: 0 = shunt next, 1 = bus next
+  uint8_t  errRun_ = 0;
+  uint8_t  rx_[2] = {0, 0};
+  int16_t  shunt_ = 0;
+  float    sumA_ = 0;
+  float    sumV_ = 0;
+  uint16_t n_ = 0;
+  Stats    stats_ = {};
+};
+
+// ------------------------------------------------------------
+// Several chips on one bus
+// ------------------------------------------------------------
+class Poller {
+public:
+  static constexpr uint8_t MAX_MONITORS = 4;
+
+  void begin(I2cIf* bus) { bus_ = bus; n_ = 0; active_ = -1; rr_ = 0; }
+  bool add(Monitor* m);
+  uint8_t count() const { return n_; }
+  Monitor* get(uint8_t i) const { return i < n_ ? m_[i] : nullptr; }
+
+  // Never waits: collects a finished transfer, starts at most one new one
+  void service(uint64_t nowUs);
+
+private:
+  I2cIf*   bus_ = nullptr;
+  Monitor* m_[MAX_MONITORS] = {};
+  uint8_t  n_ = 0;
+  int8_t   active_ = -1;
+  uint8_t  rr_ = 0;
+};
+
+} // namespace InaMon
@@ -0,0 +1,153 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+// ------------------------------------------------------------
+// Online cell internal resistance from natural load steps.
+//
+// push() takes one averaged frame: terminal voltage and the current out
+// of the cell (discharge positive). A current change of at least
+// minStepA opens a step. The step is measured against the last quiet
+// frame before it and the first frame after it where the current holds
+// still again. The ADC reads the channels one after the other, so the
+// frame the step lands in can hold the old voltage next to the new
+// current; that frame is never used.
+//
+// Each step gives dV = -R * dI. R follows by scalar recursive least
+// squares with forgetting factor lambda per step, so large steps weigh
+// more than small ones and old steps fade out. A step is rejected when:
+// - its own dV/dI is outside [rMinOhm, rMaxOhm] (charger / relay
+//   switching, a step that was still moving), or
+// - once MIN_STEPS are in, it is more than gate sigmas from the estimate,
+//   where sigma is the running spread of the accepted steps.
+// GATE_RESTART gate rejections in a row mean the estimate no longer
+// fits (other cell, bad value from flash): learning starts over.
+// host-tools/trace-replay builds it too, through SocMgr.
+// ------------------------------------------------------------
+class IrEst {
+public:
+  struct Config {
+    float minStepA = 0.10f;
+    float quietA   = 0.02f;    // frame-to-frame change that counts as still
+    float lambda   = 0.98f;    // per accepted step
+    float rMinOhm  = 0.005f;
+    float rMaxOhm  = 1.0f;
+    float gate     = 4.0f;     // sigmas
+    uint32_t maxGapMs = 5000;  // frames further apart don't form a step
+  };
+
+  static constexpr uint32_t MIN_STEPS = 3;
+  static constexpr uint8_t  GATE_RESTART = 8;
+
+  void setConfig(const Config& c) { cfg_ = c; }
+  const Config& config() const { return cfg_; }
+
+  // r0: previous estimate (e.g. from flash) or NAN to learn from scratch
+  void reset(float r0 = NAN) {
+    havePrev_ = pending_ = false;
+    prevQuiet_ = false;
+    accepted_ = rejected_ = restarts_ = 0;
+    gated_ = 0;
+    if (isnan(r0)) {
+      restart();
+    } else {
+      r_ = r0;
+      p_ = P_RESUME;
+      var_ = 0;
+      n_ = MIN_STEPS;          // trusted, but a fresh spread
+    }
+  }
+
+  // One frame; true if it completed an accepted step
+  bool push(uint32_t ms, float v, float i) {
+    bool took = false;
+    if (!havePrev_ || ms - prevMs_ > cfg_.maxGapMs) {
+      pending_ = false;
+      prevQuiet_ = false;
+    } else {
+      const float di = i - prevI_;
+      const bool still = fabsf(di) < cfg_.quietA;
+      if (pending_) {
+        if (still) { took = step(v - baseV_, i - baseI_); pending_ = false; }
+        else if (++pendingFrames_ > MAX_PENDING) pending_ = false;
+      } else if (fabsf(di) >= cfg_.minStepA && prevQuiet_) {
+        pending_ = true;
+        pendingFrames_ = 0;
+        baseV_ = prevV_;
+        baseI_ = prevI_;
+      }
+      prevQuiet_ = still;
+    }
+    havePrev_ = true;
+    prevMs_ = ms;
+    prevV_ = v;
+    prevI_ = i;
+    return took;
+  }
+
+  bool     valid() const    { return n_ >= MIN_STEPS; }
+  float    ohm() const      { return valid() ? r_ : NAN; }
+  float    sigmaOhm() const { return sqrtf(var_); }
+  uint32_t accepted() const { return accepted_; }
+  uint32_t rejected() const { return rejected_; }
+  uint32_t restarts() const { return restarts_; }
+
+  // Open-circuit voltage behind the IR drop; v if R is not known yet
+  float ocv(float v, float i) const { return valid() ? v + i * r_ : v; }
+
+private:
+  static constexpr float   P_MAX = 1e4f;
+  static constexpr float   P_RESUME = 10.0f;    // ~ a few 0.3 A steps worth
+  static constexpr float   SIGMA_FLOOR = 0.005f;
+  static constexpr float   VAR_ALPHA = 0.1f;        // spread over ~ the last 10 steps
+  static constexpr uint8_t MAX_PENDING = 3;
+
+  bool step(float dv, float di) {
+    if (fabsf(di) < cfg_.minStepA) return reject();
+    const float rs = -dv / di;
+    if (!(rs >= cfg_.rMinOhm && rs <= cfg_.rMaxOhm)) return reject();
+    if (n_ >= MIN_STEPS) {
+      const float s = fmaxf(sqrtf(var_), SIGMA_FLOOR);
+      if (fabsf(rs - r_) > cfg_.gate * s) {
+        if (++gated_ >= GATE_RESTART) { restart(); restarts_++; }
+        return reject();
+      }
+    }
+    gated_ = 0;
+
+    // scalar RLS on y = x * R with x = dI, y = -dV
+    const float x = di, y = -dv;
+    const float k = p_ * x / (cfg_.lambda + x * p_ * x);
+    const float e = rs - r_;
+    r_ += k * (y - x * r_);
+    p_ = (p_ - k * x * p_) / cfg_.lambda;
+    if (p_ > P_MAX) p_ = P_MAX;
+    // spread of the accepted step values around the estimate
+    if (n_ > 0) var_ += (e * e - var_) * VAR_ALPHA;
+    if (n_ < MIN_STEPS) n_++;
+    accepted_++;
+    return true;
+  }
+
+  bool reject() { rejected_++; return false; }
+
+  void restart() {
+    r_ = 0;
+    p_ = P_MAX;
+    var_ = 0;
+    n_ = 0;
+    gated_ = 0;
+  }
+
+  Config   cfg_;
+  float    r_ = 0, p_ = P_MAX, var_ = 0;
+  uint32_t n_ = 0;
+  uint32_t accepted_ = 0, rejected_ = 0, restarts_ = 0;
+  uint8_t  gated_ = 0;
+
+  bool     havePrev_ = false, prevQuiet_ = false, pending_ = false;
+  uint8_t  pendingFrames_ = 0;
+  uint32_t prevMs_ = 0;
+  float    prevV_ = 0, prevI_ = 0;
+  float    baseV_ = 0, baseI_ = 0;
+};
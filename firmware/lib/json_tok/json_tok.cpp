@@ -0,0 +1,169 @@
+#include "json_tok.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace JsonTok {
+
+static bool isWs(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+static bool isPrimChar(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         c == '-' || c == '+' || c == '.';
+}
+
+int parse(char* s, size_t len, Token* toks, size_t maxToks) {
+  if (len >= 0xFFFF) return ERR_INVAL;
+
+  int stack[MAX_DEPTH];     // open containers
+  int depth = 0;
+  int n = 0;
+
+  // What may come next. Right after '{' or '[' the container may also
+  // close; after ',' it may not (no trailing commas). Once the root value
+  // is complete only whitespace may follow.
+  enum Want : uint8_t { VALUE, KEY, COLON, NEXT, END };
+  Want want = VALUE;
+  bool canClose = false;
+
+  auto addTok = [&](Type type, size_t start, size_t end) -> int {
+    if ((size_t)n >= maxToks) return ERR_NOMEM;
+    toks[n].type = type;
+    toks[n].start = (uint16_t)start;
+    toks[n].end = (uint16_t)end;
+    toks[n].size = 0;
+    if (depth > 0) toks[stack[depth - 1]].size++;
+    return n++;
+  };
+  auto afterValue = [&]() { want = depth > 0 ? NEXT : END; canClose = false; };
+
+  for (size_t i = 0; i < len; i++) {
+    const char c = s[i];
+    if (isWs(c)) continue;
+
+    switch (c) {
+      case '{':
+      case '[': {
+        if (want != VALUE) return ERR_INVAL;
+        if (depth >= (int)MAX_DEPTH) return ERR_NOMEM;
+        int k = addTok(c == '{' ? OBJECT : ARRAY, i, 0);
+        if (k < 0) return k;
+        stack[depth++] = k;
+        want = (c == '{') ? KEY : VALUE;
+        canClose = true;
+        break;
+      }
+      case '}':
+      case ']': {
+        if (depth == 0) return ERR_INVAL;
+        Token& t = toks[stack[depth - 1]];
+        if (t.type != (c == '}' ? OBJECT : ARRAY)) return ERR_INVAL;
+        if (want != NEXT && !canClose) return ERR_INVAL;   // after ',' or ':', or a key alone
+        t.end = (uint16_t)(i + 1);
+        depth--;
+        afterValue();
+        break;
+      }
+      case '"': {
+        if (want != VALUE && want != KEY) return ERR_INVAL;
+        size_t start = ++i;
+        for (; i < len && s[i] != '"'; i++) {
+          if (s[i] == '\\' && i + 1 < len) i++;
+        }
+        if (i >= len) return ERR_PART;
+        int k = addTok(STRING, start, i);
+        if (k < 0) return k;
+        if (want == KEY) { want = COLON; canClose = false; }
+        else             afterValue();
+        break;
+      }
+      case ':':
+        if (want != COLON) return ERR_INVAL;
+        want = VALUE;
+        break;
+      case ',':
+        if (want != NEXT) return ERR_INVAL;
+        want = (toks[stack[depth - 1]].type == OBJECT) ? KEY : VALUE;
+        break;
+      default: {
+        if (!isPrimChar(c) || want != VALUE) return ERR_INVAL;
+        size_t start = i;
+        while (i + 1 < len && isPrimChar(s[i + 1])) i++;
+        int k = addTok(PRIMITIVE, start, i + 1);
+        if (k < 0) return k;
+        afterValue();
+        break;
+      }
+    }
+  }
+  if (want != END) return ERR_PART;
+
+  // Terminate every scalar in place (the char at end is a quote or a delimiter)
+  for (int k = 0; k < n; k++) {
+    if (toks[k].type == STRING || toks[k].type == PRIMITIVE) s[toks[k].end] = '\0';
+  }
+  return n;
+}
+
+int skip(const Token* t, int n, int i) {
+  const uint16_t end = t[i].end;
+  int j = i + 1;
+  while (j < n && t[j].start < end) j++;
+  return j;
+}
+
+int find(const char* s, const Token* t, int n, int obj, const char* key) {
+  if (obj < 0 || obj >= n || t[obj].type != OBJECT) return -1;
+  int i = obj + 1;
+  for (uint16_t k = 0; k < t[obj].size; k += 2) {
+    if (i + 1 >= n) return -1;
+    if (t[i].type == STRING && eq(s, t[i], key)) return i + 1;
+    i = skip(t, n, i + 1);
+  }
+  return -1;
+}
+
+bool eq(const char* s, const Token& t, const char* str) {
+  const size_t len = (size_t)(t.end - t.start);
+  return strlen(str) == len && memcmp(s + t.start, str, len) == 0;
+}
+
+// Base 10 only: "010" is 10, not octal 8, and "0x10" is no number.
+// Out of range is an error, not LONG_MAX.
+bool toLong(const char* s, const Token& t, long& out) {
+  if (t.type != PRIMITIVE) return false;
+  char* endp = nullptr;
+  errno = 0;
+  long v = strtol(s + t.start, &endp, 10);
+  if (endp != s + t.end || errno == ERANGE) return false;
+  out = v;
+  return true;
+}
+
+bool toInt64(const char* s, const Token& t, int64_t& out) {
+  if (t.type != PRIMITIVE) return false;
+  char* endp = nullptr;
+  errno = 0;
+  long long v = strtoll(s + t.start, &endp, 10);
+  if (endp != s + t.end || errno == ERANGE) return false;
+  out = (int64_t)v;
+  return true;
+}
+
+bool toFloat(const char* s, const Token& t, float& out) {
+  if (t.type != PRIMITIVE) return false;
+  char* endp = nullptr;
+  float v = strtof(s + t.start, &endp);
+  if (endp != s + t.end || v != v) return false;
+  out = v;
+  return true;
+}
+
+bool toBool(const char* s, const Token& t, bool& out) {
+  if (t.type != PRIMITIVE) return false;
+  if (eq(s, t, "true")  || eq(s, t, "1")) { out = true;  return true; }
+  if (eq(s, t, "false") || eq(s, t, "0")) { out = false; return true; }
+  return false;
+}
+
+} // namespace JsonTok
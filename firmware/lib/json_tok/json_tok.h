@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// Tiny in-place JSON tokenizer (jsmn style, no heap, no copies).
+//
+// parse() fills a caller-provided token array and then writes a '\0'
+// at the end of every string/primitive token, so each value can be
+// used directly as a C string at (s + tok.start). The input buffer is
+// therefore modified and must be NUL-terminated.
+//
+// The input must be exactly one value: trailing commas, a missing ','
+// or ':', and anything but whitespace after the root are ERR_INVAL.
+// String escapes are skipped over but not decoded (commands never
+// need them). json-bench, proto-bench, prof-view and trace-replay in
+// host-tools build it too.
+// ------------------------------------------------------------
+namespace JsonTok {
+
+enum Type : uint8_t { OBJECT = 0, ARRAY, STRING, PRIMITIVE };
+
+enum Err : int {
+  ERR_NOMEM = -1,   // more tokens than the array holds
+  ERR_INVAL = -2,   // malformed input
+  ERR_PART  = -3,   // input ends inside a value
+};
+
+struct Token {
+  Type     type;
+  uint16_t start;   // first char (after the quote for strings)
+  uint16_t end;     // one past the last char
+  uint16_t size;    // direct children (object: keys + values)
+};
+
+static constexpr size_t MAX_DEPTH = 8;
+
+// Returns number of tokens (>0) or an Err. len must be < 65535.
+int parse(char* s, size_t len, Token* toks, size_t maxToks);
+
+// Index of the token after t[i] and all its children
+int skip(const Token* t, int n, int i);
+
+// Value token for key in object t[obj], or -1
+int find(const char* s, const Token* t, int n, int obj, const char* key);
+
+bool eq(const char* s, const Token& t, const char* str);
+
+// Strict conversions: the whole token must be a number / bool. Integers
+// are base 10 and must fit.
+bool toLong(const char* s, const Token& t, long& out);
+bool toInt64(const char* s, const Token& t, int64_t& out);   // long is 32 bit on the ESP32
+bool toFloat(const char* s, const Token& t, float& out);
+bool toBool(const char* s, const Token& t, bool& out);   // true/false/0/1
+
+} // namespace JsonTok
@@ -0,0 +1,255 @@
+#include "ota_img.h"
+#include <string.h>
+
+namespace OtaImg {
+
+using TlmProto::OtaChunkV1;
+
+// ------------------------------------------------------------
+// CRC-32, reflected poly 0xEDB88320, nibble table like crc16()
+// ------------------------------------------------------------
+static const uint32_t CRC32_NIB[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ CRC32_NIB[crc & 0x0F];
+    crc = (crc >> 4) ^ CRC32_NIB[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+// ------------------------------------------------------------
+// LZ4 block format: sequences of
+//   token (literal count << 4 | match length - 4), [more literal count],
+//   literals, offset (2 bytes LE), [more match length]
+// where a nibble of 15 continues in bytes of 255 until one is smaller.
+// The last sequence is literals only; the last 5 bytes are always
+// literals and no match starts in the last 12.
+// ------------------------------------------------------------
+static constexpr size_t MIN_MATCH     = 4;
+static constexpr size_t LAST_LITERALS = 5;
+static constexpr size_t MF_LIMIT      = 12;
+
+static inline uint32_t read32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t hash4(uint32_t v) {
+  return (v * 2654435761u) >> (32 - 12);
+}
+static_assert(LZ4_HASH_SIZE == 1u << 12, "hash4() bits");
+
+// Length continuation bytes for a nibble of 15
+static bool putLen(uint8_t* out, size_t cap, size_t& op, size_t n) {
+  for (; n >= 255; n -= 255) {
+    if (op >= cap) return false;
+    out[op++] = 255;
+  }
+  if (op >= cap) return false;
+  out[op++] = (uint8_t)n;
+  return true;
+}
+
+static bool putSequence(uint8_t* out, size_t cap, size_t& op,
+                        const uint8_t* lit, size_t litLen, size_t offset, size_t matchLen) {
+  if (op >= cap) return false;
+  const size_t ml = matchLen ? matchLen - MIN_MATCH : 0;
+  out[op++] = (uint8_t)(((litLen < 15 ? litLen : 15) << 4) | (ml < 15 ? ml : 15));
+  if (litLen >= 15 && !putLen(out, cap, op, litLen - 15)) return false;
+  if (litLen > cap - op) return false;
+  memcpy(out + op, lit, litLen);
+  op += litLen;
+  if (!matchLen) return true;
+  if (cap - op < 2) return false;
+  out[op++] = (uint8_t)offset;
+  out[op++] = (uint8_t)(offset >> 8);
+  return ml < 15 || putLen(out, cap, op, ml - 15);
+}
+
+size_t lz4Compress(const uint8_t* in, size_t n, uint8_t* out, size_t cap, uint16_t* work) {
+  if (n == 0 || n > 65535) return 0;
+  if (cap > n - 1) cap = n - 1;          // no use unless it shrinks
+  memset(work, 0, LZ4_HASH_SIZE * sizeof(work[0]));
+
+  size_t op = 0, anchor = 0;
+  if (n > MF_LIMIT) {
+    const size_t matchStop = n - MF_LIMIT;
+    const size_t matchEnd = n - LAST_LITERALS;
+    size_t ip = 0;
+    while (ip < matchStop) {
+      const uint32_t seq = read32(in + ip);
+      const uint32_t h = hash4(seq);
+      const size_t cand = work[h];
+      work[h] = (uint16_t)ip;
+      if (cand >= ip || read32(in + cand) != seq) { ip++; continue; }
+
+      size_t len = MIN_MATCH;
+      while (ip + len < matchEnd && in[cand + len] == in[ip + len]) len++;
+      if (!putSequence(out, cap, op, in + anchor, ip - anchor, ip - cand, len)) return 0;
+      ip += len;
+      anchor = ip;
+      // the position just before the jump is a likely start for the next match
+      if (ip - 2 < matchStop) work[hash4(read32(in + ip - 2))] = (uint16_t)(ip - 2);
+    }
+  }
+  if (!putSequence(out, cap, op, in + anchor, n - anchor, 0, 0)) return 0;
+  return op;
+}
+
+size_t lz4Decompress(const uint8_t* in, size_t n, uint8_t* out, size_t cap) {
+  size_t ip = 0, op = 0;
+  while (ip < n) {
+    const uint8_t token = in[ip++];
+    size_t lit = token >> 4;
+    if (lit == 15) {
+      uint8_t b;
+      do {
+        if (ip >= n) return 0;
+        b = in[ip++];
+        lit += b;
+      } while (b == 255);
+    }
+    if (lit > n - ip || lit > cap - op) return 0;
+    memcpy(out + op, in + ip, lit);
+    ip += lit;
+    op += lit;
+    if (ip == n) return op;                  // the last sequence has no match
+
+    if (n - ip < 2) return 0;
+    const size_t offset = (size_t)in[ip] | ((size_t)in[ip + 1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op) return 0;
+    size_t len = (token & 0x0F) + MIN_MATCH;
+    if ((token & 0x0F) == 15) {
+      uint8_t b;
+      do {
+        if (ip >= n) return 0;
+        b = in[ip++];
+        len += b;
+      } while (b == 255);
+    }
+    if (len > cap - op) return 0;
+    // byte by byte: the match may overlap what it produces
+    for (size_t k = 0; k < len; k++, op++) out[op] = out[op - offset];
+  }
+  return 0;                                  // ended on a match: truncated
+}
+
+// ------------------------------------------------------------
+// Flash
+// ------------------------------------------------------------
+bool writeChunk(FlashIf& f, uint32_t idx, const uint8_t* data, size_t len) {
+  const size_t off = (size_t)idx * CHUNK;
+  if (len > CHUNK || off + CHUNK > f.size()) return false;
+  return f.erase(off, CHUNK) && f.write(off, data, len);
+}
+
+bool readCrc(FlashIf& f, uint32_t size, uint8_t* buf, size_t bufLen, uint32_t& crc) {
+  if (size > f.size() || bufLen == 0) return false;
+  crc = 0;
+  for (size_t off = 0; off < size; ) {
+    const size_t n = size - off < bufLen ? size - off : bufLen;
+    if (!f.read(off, buf, n)) return false;
+    crc = crc32(buf, n, crc);
+    off += n;
+  }
+  return true;
+}
+
+// ------------------------------------------------------------
+// Receiver
+// ------------------------------------------------------------
+const char* resultName(Result r) {
+  switch (r) {
+    case Result::Piece:     return "piece";
+    case Result::Chunk:     return "chunk";
+    case Result::Held:      return "held";
+    case Result::Dup:       return "dup";
+    case Result::Gap:       return "gap";
+    case Result::Busy:      return "busy";
+    case Result::Bad:       return "bad";
+    case Result::Malformed: return "malformed";
+  }
+  return "?";
+}
+
+void Receiver::begin(uint32_t size, uint32_t next) {
+  size_ = size;
+  want_ = next;
+  off_ = 0;
+  held_ = false;
+  ready_ = false;
+  stats_ = Stats{};
+}
+
+Result Receiver::push(const uint8_t* payload, size_t len) {
+  OtaChunkV1 h;
+  if (len < sizeof(h)) { stats_.bad++; return Result::Malformed; }
+  memcpy(&h, payload, sizeof(h));
+  const size_t raw = chunkSize(size_, h.idx);
+  if (len != sizeof(h) + h.len || h.len == 0 || raw == 0 || h.raw != raw ||
+      h.total == 0 || h.total > CHUNK || (size_t)h.off + h.len > h.total ||
+      h.method > LZ4 || (h.method == STORED && h.total != raw)) {
+    stats_.bad++;
+    return Result::Malformed;
+  }
+
+  // behind us: a resend after a rewind
+  if (h.idx < want_ || (h.idx == want_ && !held_ && (size_t)h.off + h.len <= off_)) {
+    stats_.dups++;
+    return Result::Dup;
+  }
+  if (held_) { stats_.gaps++; return Result::Busy; }
+  if (h.idx != want_ || h.off != off_) { stats_.gaps++; return Result::Gap; }
+  if (off_ && (h.total != hdr_.total || h.crc != hdr_.crc || h.method != hdr_.method)) {
+    // not the chunk the earlier pieces belonged to
+    off_ = 0;
+    stats_.bad++;
+    return Result::Bad;
+  }
+
+  hdr_ = h;
+  memcpy(packed_ + h.off, payload + sizeof(h), h.len);
+  off_ = (uint16_t)(off_ + h.len);
+  stats_.pieces++;
+  stats_.packedBytes += h.len;
+  if (off_ < h.total) return Result::Piece;
+
+  off_ = 0;
+  want_++;
+  held_ = true;
+  return ready_ ? Result::Held : unpack();
+}
+
+Result Receiver::unpack() {
+  held_ = false;
+  size_t n;
+  if (hdr_.method == STORED) {
+    memcpy(raw_, packed_, hdr_.total);
+    n = hdr_.total;
+  } else {
+    n = lz4Decompress(packed_, hdr_.total, raw_, sizeof(raw_));
+  }
+  if (n != hdr_.raw || crc32(raw_, n) != hdr_.crc) {
+    want_ = hdr_.idx;
+    stats_.bad++;
+    return Result::Bad;
+  }
+  ready_ = true;
+  readyIdx_ = hdr_.idx;
+  rawLen_ = n;
+  stats_.rawBytes += (uint32_t)n;
+  return Result::Chunk;
+}
+
+Result Receiver::release() {
+  ready_ = false;
+  return held_ ? unpack() : Result::Piece;
+}
+
+} // namespace OtaImg
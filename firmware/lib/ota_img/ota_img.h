@@ -0,0 +1,128 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "tlm_proto.h"
+
+// ------------------------------------------------------------
+// Firmware image transfer (shared by firmware + host tools)
+//
+// The image is cut into CHUNK-byte chunks, one per flash sector of the
+// target slot. Each chunk is compressed on its own (LZ4 block format,
+// or stored when that does not shrink it) and sent as OtaChunkV1 pieces
+// (tlm_proto.h, schema 5). Chunks are self-contained, so a transfer can
+// restart at any chunk and a chunk is written with one sector erase.
+//
+// Receiver reassembles pieces in order, unpacks a finished chunk and
+// checks its CRC-32. The caller writes the chunk to flash and then calls
+// release(); meanwhile the pieces of the next chunk keep arriving into a
+// second buffer. A piece that is not the next expected byte is refused
+// (Gap), and the sender is expected to go back to next().
+//
+// host-tools/ota-send builds it too, for the sender and its -B bench.
+// ------------------------------------------------------------
+namespace OtaImg {
+
+static constexpr size_t CHUNK = 4096;
+
+enum Method : uint8_t { STORED = 0, LZ4 = 1 };
+
+// CRC-32 (IEEE, as zlib): crc32(b, n) == crc32(b + k, n - k, crc32(b, k))
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+// LZ4 block, n <= 65535. work must hold LZ4_HASH_SIZE entries. Returns
+// the packed size, 0 if it would not be smaller than n (send it STORED).
+static constexpr size_t LZ4_HASH_SIZE = 4096;
+size_t lz4Compress(const uint8_t* in, size_t n, uint8_t* out, size_t cap, uint16_t* work);
+// Returns the unpacked size, 0 if the block is malformed or does not fit
+size_t lz4Decompress(const uint8_t* in, size_t n, uint8_t* out, size_t cap);
+
+// Chunks in an image, and the size of chunk idx
+inline uint32_t chunkCount(uint32_t size) { return (uint32_t)((size + CHUNK - 1) / CHUNK); }
+inline size_t chunkSize(uint32_t size, uint32_t idx) {
+  const uint32_t off = idx * (uint32_t)CHUNK;
+  return off >= size ? 0 : (size - off < CHUNK ? size - off : CHUNK);
+}
+
+// ------------------------------------------------------------
+// Flash access, sector granular (same shape as TlmLog::FlashIf)
+// ------------------------------------------------------------
+class FlashIf {
+public:
+  virtual ~FlashIf() {}
+  virtual size_t size() const = 0;
+  virtual bool erase(size_t off, size_t len) = 0;
+  virtual bool write(size_t off, const void* src, size_t len) = 0;
+  virtual bool read(size_t off, void* dst, size_t len) = 0;
+};
+
+// Erase and write chunk idx
+bool writeChunk(FlashIf& f, uint32_t idx, const uint8_t* data, size_t len);
+// CRC-32 of the first size bytes, read back in buf-sized pieces
+bool readCrc(FlashIf& f, uint32_t size, uint8_t* buf, size_t bufLen, uint32_t& crc);
+
+// ------------------------------------------------------------
+// Receiver
+// ------------------------------------------------------------
+enum class Result : uint8_t {
+  Piece,      // taken, chunk not complete yet
+  Chunk,      // a chunk checked out: chunk() / chunkIdx() until release()
+  Held,       // chunk complete, waits until release()
+  Dup,        // already have it (a resend after a rewind), ignored
+  Gap,        // not the next byte: pieces were lost, resend from next()
+  Busy,       // a chunk is held and another one started: the sender ran ahead
+  Bad,        // chunk did not unpack or failed its CRC: resend from next()
+  Malformed,  // header does not fit the image
+};
+
+const char* resultName(Result r);
+
+struct Stats {
+  uint32_t pieces;       // accepted
+  uint32_t dups;
+  uint32_t gaps;         // Gap + Busy
+  uint32_t bad;          // Bad + Malformed
+  uint32_t packedBytes;  // chunk bytes received (accepted pieces)
+  uint32_t rawBytes;     // chunk bytes unpacked and checked
+};
+
+class Receiver {
+public:
+  // Expect chunk next first (a resumed transfer skips what is on flash)
+  void begin(uint32_t size, uint32_t next);
+
+  // One OtaChunkV1 frame payload
+  Result push(const uint8_t* payload, size_t len);
+
+  bool           ready() const { return ready_; }
+  uint32_t       chunkIdx() const { return readyIdx_; }
+  const uint8_t* chunk() const { return raw_; }
+  size_t         chunkLen() const { return rawLen_; }
+
+  // The caller is done with chunk(). A held chunk is unpacked now:
+  // Chunk, Bad, or Piece when none was held.
+  Result release();
+
+  uint32_t size() const { return size_; }
+  uint32_t chunks() const { return chunkCount(size_); }
+  // First chunk not received yet; a held chunk that then fails its
+  // check moves it back
+  uint32_t next() const { return want_; }
+  const Stats& stats() const { return stats_; }
+
+private:
+  Result unpack();
+
+  uint32_t size_ = 0;
+  uint32_t want_ = 0;          // chunk being assembled
+  uint16_t off_ = 0;           // its bytes so far
+  TlmProto::OtaChunkV1 hdr_ = {};
+  bool     held_ = false;      // packed_ holds a complete chunk
+  bool     ready_ = false;     // raw_ holds a checked chunk
+  uint32_t readyIdx_ = 0;
+  size_t   rawLen_ = 0;
+  Stats    stats_ = {};
+  uint8_t  packed_[CHUNK];    // never larger: STORED instead
+  uint8_t  raw_[CHUNK];
+};
+
+} // namespace OtaImg
@@ -0,0 +1,111 @@
+#include "time_sync.h"
+#include <string.h>
+
+namespace TimeSync {
+
+// ------------------------------------------------------------
+// Sync
+// ------------------------------------------------------------
+void Sync::reset() {
+  memset(this, 0, sizeof(*this));
+}
+
+static int32_t sat32(int64_t v) {
+  if (v > INT32_MAX) return INT32_MAX;
+  if (v < INT32_MIN) return INT32_MIN;
+  return (int32_t)v;
+}
+
+int64_t Sync::toEpoch(uint64_t monoUs) const {
+  if (!valid()) return 0;
+  const int64_t d = (int64_t)(monoUs - monoRef);
+  // |d| * 5e5 stays inside int64 for ~200 days between samples
+  return epochRef + d + (d * (int64_t)driftPpb) / 1000000000LL;
+}
+
+void Sync::add(uint64_t monoUs, int64_t epochUs) {
+  if (!valid()) {
+    reset();
+    monoRef = firstMono = monoUs;
+    epochRef = firstEpoch = epochUs;
+    count = 1;
+    return;
+  }
+
+  const int64_t err = epochUs - toEpoch(monoUs);
+  lastErrUs = sat32(err);
+
+  if (err > STEP_RESET_US || err < -STEP_RESET_US || monoUs < firstMono) {
+    // host clock stepped (or samples out of order): start over
+    const uint32_t n = count;
+    reset();
+    monoRef = firstMono = monoUs;
+    epochRef = firstEpoch = epochUs;
+    count = n + 1;
+    return;
+  }
+
+  // Drift from the whole baseline: individual samples carry BT latency
+  // jitter (~10 ms), which averages out over minutes.
+  const uint64_t span = monoUs - firstMono;
+  if (span >= MIN_DRIFT_SPAN_US) {
+    const int64_t wall = epochUs - firstEpoch;
+    int64_t ppb = ((wall - (int64_t)span) * 1000000000LL) / (int64_t)span;
+    if (ppb > MAX_DRIFT_PPB)  ppb = MAX_DRIFT_PPB;
+    if (ppb < -MAX_DRIFT_PPB) ppb = -MAX_DRIFT_PPB;
+    driftPpb = (int32_t)ppb;
+  }
+
+  monoRef = monoUs;
+  epochRef = epochUs;
+  count++;
+}
+
+// ------------------------------------------------------------
+// Anchor
+// ------------------------------------------------------------
+static uint32_t fnv1a(const void* p, size_t n) {
+  const uint8_t* b = (const uint8_t*)p;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) { h ^= b[i]; h *= 16777619u; }
+  return h;
+}
+
+bool Anchor::valid() const {
+  return magic == MAGIC && check == fnv1a(this, offsetof(Anchor, check));
+}
+
+void Anchor::seal() {
+  magic = MAGIC;
+  check = fnv1a(this, offsetof(Anchor, check));
+}
+
+// ------------------------------------------------------------
+// Mono
+// ------------------------------------------------------------
+void Mono::boot(Anchor& a, uint64_t rtcNowUs, uint64_t timerNowUs) {
+  continued_ = a.valid() && rtcNowUs >= a.rtcUs;
+
+  if (continued_) {
+    // time that passed since the anchor, as seen by the RTC
+    gap_ = rtcNowUs - a.rtcUs;
+    uint64_t monoNow = a.monoUs + gap_;
+    base_ = monoNow - timerNowUs;
+    a.boots++;
+  } else {
+    // power-on (or RTC reset): start at 0, mapping to wall time is gone
+    memset(&a, 0, sizeof(a));
+    a.sync.reset();
+    gap_ = 0;
+    base_ = 0;
+  }
+  save(a, rtcNowUs, timerNowUs);
+}
+
+void Mono::save(Anchor& a, uint64_t rtcNowUs, uint64_t timerNowUs) const {
+  a.monoUs = now(timerNowUs);
+  a.rtcUs = rtcNowUs;
+  a.seal();
+}
+
+} // namespace TimeSync
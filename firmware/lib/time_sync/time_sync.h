@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// Monotonic 64-bit timebase + host wall-clock mapping.
+//
+// Mono: device time in µs since the first power-on. Runs on the per-boot
+// timer (esp_timer, resets on every boot/wake) plus a base that is carried
+// over sleep and soft resets in an RTC anchor, bridging the gap with the
+// RTC clock (which keeps counting while the CPU is off).
+//
+// Sync: maps mono time to the host's epoch from {"cmd":"time"} samples,
+// with an offset and a drift estimate (ppb) between samples.
+// ------------------------------------------------------------
+namespace TimeSync {
+
+struct Sync {
+  uint64_t monoRef;       // mono µs of the last sample
+  int64_t  epochRef;      // host epoch µs at monoRef
+  int32_t  driftPpb;      // device clock error, + = device runs slow
+  int32_t  lastErrUs;     // prediction error of the last sample (saturated)
+  uint32_t count;         // samples taken
+  uint64_t firstMono;     // mono / epoch of the drift baseline
+  int64_t  firstEpoch;
+
+  static constexpr uint64_t MIN_DRIFT_SPAN_US = 60ull * 1000000ull;   // don't guess from less
+  static constexpr int32_t  MAX_DRIFT_PPB     = 500000;               // 500 ppm
+  static constexpr int64_t  STEP_RESET_US     = 2000000;              // host clock jumped
+
+  void    reset();
+  bool    valid() const { return count > 0; }
+  // Host says: at device time monoUs the wall clock read epochUs
+  void    add(uint64_t monoUs, int64_t epochUs);
+  // 0 if never synced
+  int64_t toEpoch(uint64_t monoUs) const;
+};
+
+// Survives deep sleep / soft reset in RTC memory; check guards against
+// the garbage RTC RAM holds after power-on.
+struct Anchor {
+  uint32_t magic;
+  uint32_t boots;         // wakes + resets since power-on
+  uint64_t monoUs;        // mono time when the anchor was written
+  uint64_t rtcUs;         // RTC time at that moment
+  Sync     sync;
+  uint32_t check;
+
+  static constexpr uint32_t MAGIC = 0x54494D31;   // "TIM1"
+
+  bool     valid() const;
+  void     seal();
+};
+
+class Mono {
+public:
+  // Call once per boot. a = anchor from RTC memory (validated here), may be
+  // rewritten; rtcNowUs / timerNowUs = both clocks right now.
+  void boot(Anchor& a, uint64_t rtcNowUs, uint64_t timerNowUs);
+
+  uint64_t now(uint64_t timerNowUs) const { return base_ + timerNowUs; }
+
+  // Refresh the anchor (periodically and right before sleep)
+  void save(Anchor& a, uint64_t rtcNowUs, uint64_t timerNowUs) const;
+
+  bool     continued() const { return continued_; }  // false = cold start at 0
+  uint64_t gapUs() const { return gap_; }            // bridged sleep/reset time
+
+private:
+  uint64_t base_ = 0;
+  uint64_t gap_ = 0;
+  bool     continued_ = false;
+};
+
+} // namespace TimeSync
@@ -0,0 +1,288 @@
+#include "tlm_log.h"
+#include <string.h>
+#include <math.h>
+
+namespace TlmLog {
+
+using namespace TlmProto;
+
+static inline uint32_t zigzag(int32_t v)   { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static inline int32_t  unzigzag(uint32_t z) { return (int32_t)(z >> 1) ^ -(int32_t)(z & 1); }
+
+void quantize(const float* values, uint32_t ms, Record& out) {
+  out.ms = ms;
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    if (i == F_TEMP && isnan(values[i])) out.v[i] = TEMP_INVALID;
+    else if (FIELDS[i].isSigned)         out.v[i] = toI16(values[i], FIELDS[i].scale);
+    else                                 out.v[i] = toU16(values[i], FIELDS[i].scale);
+  }
+}
+
+float restore(const Record& r, int field) {
+  if (field == F_TEMP && r.v[field] == TEMP_INVALID) return NAN;
+  return (float)r.v[field] / FIELDS[field].scale;
+}
+
+uint16_t sectorCrc(const SectorHdr& h, const uint8_t* data) {
+  SectorHdr tmp = h;
+  tmp.crc = 0;
+  uint16_t crc = crc16((const uint8_t*)&tmp, sizeof(tmp));
+  return crc16(data, h.bytes, crc);
+}
+
+bool sectorValid(const uint8_t* sector) {
+  SectorHdr h;
+  memcpy(&h, sector, sizeof(h));
+  if (h.magic != MAGIC || h.bytes > BLOCK_DATA || h.count == 0) return false;
+  return sectorCrc(h, sector + sizeof(h)) == h.crc;
+}
+
+// ------------------------------------------------------------
+// Bits (MSB first)
+// ------------------------------------------------------------
+void BitWriter::begin(uint8_t* buf, size_t capBytes) {
+  buf_ = buf;
+  cap_ = capBytes * 8;
+  bit_ = 0;
+  memset(buf_, 0, capBytes);
+}
+
+bool BitWriter::put(uint32_t value, uint8_t bits) {
+  if (bit_ + bits > cap_) return false;
+  for (int b = bits - 1; b >= 0; b--) {
+    const size_t byte = bit_ >> 3;
+    const uint8_t mask = (uint8_t)(0x80 >> (bit_ & 7));
+    if ((value >> b) & 1u) buf_[byte] |= mask;
+    else                   buf_[byte] &= (uint8_t)~mask;
+    bit_++;
+  }
+  return true;
+}
+
+void BitReader::begin(const uint8_t* buf, size_t bytes) {
+  buf_ = buf;
+  cap_ = bytes * 8;
+  bit_ = 0;
+}
+
+bool BitReader::get(uint8_t bits, uint32_t& out) {
+  if (bit_ + bits > cap_) return false;
+  uint32_t v = 0;
+  for (uint8_t b = 0; b < bits; b++) {
+    v = (v << 1) | ((buf_[bit_ >> 3] >> (7 - (bit_ & 7))) & 1u);
+    bit_++;
+  }
+  out = v;
+  return true;
+}
+
+// ------------------------------------------------------------
+// Prefix codes
+//   value delta (zigzag z): 0 | 10+6 | 110+9 | 1110+12 | 1111+17
+//   time dd     (zigzag z): 0 | 10+7 | 110+9 | 1110+12 | 1111+32
+// ------------------------------------------------------------
+struct Bucket { uint8_t prefix; uint8_t prefixBits; uint8_t bits; };
+
+static const Bucket VALUE_BUCKETS[] = { {0x2, 2, 6}, {0x6, 3, 9}, {0xE, 4, 12}, {0xF, 4, 17} };
+static const Bucket TIME_BUCKETS[]  = { {0x2, 2, 7}, {0x6, 3, 9}, {0xE, 4, 12}, {0xF, 4, 32} };
+
+static bool putBucketed(BitWriter& w, uint32_t z, const Bucket* bk) {
+  if (z == 0) return w.put(0, 1);
+  for (int i = 0; i < 4; i++) {
+    if (i == 3 || z < (1ull << bk[i].bits)) {
+      return w.put(bk[i].prefix, bk[i].prefixBits) && w.put(z, bk[i].bits);
+    }
+  }
+  return false;
+}
+
+static bool getBucketed(BitReader& r, uint32_t& z, const Bucket* bk) {
+  uint32_t bit;
+  int ones = 0;
+  // count leading 1s (max 4)
+  while (ones < 4) {
+    if (!r.get(1, bit)) return false;
+    if (!bit) break;
+    ones++;
+  }
+  if (ones == 0) { z = 0; return true; }
+  return r.get(bk[ones - 1].bits, z);
+}
+
+bool BlockEncoder::putValue(int32_t delta) { return putBucketed(w_, zigzag(delta), VALUE_BUCKETS); }
+bool BlockEncoder::putTime(int32_t dd)     { return putBucketed(w_, zigzag(dd), TIME_BUCKETS); }
+
+void BlockEncoder::begin(uint8_t* data, size_t cap) {
+  w_.begin(data, cap);
+  count_ = 0;
+  prevDelta_ = 0;
+  memset(&prev_, 0, sizeof(prev_));
+}
+
+bool BlockEncoder::append(const Record& r) {
+  const size_t mark = w_.bits();
+  bool ok = true;
+
+  if (count_ == 0) {
+    ok = w_.put(r.ms, 32);
+    for (int i = 0; ok && i < FIELD_COUNT; i++) ok = w_.put((uint32_t)r.v[i] & 0xFFFF, 16);
+    if (ok) prevDelta_ = 0;
+  } else {
+    const int32_t delta = (int32_t)(r.ms - prev_.ms);
+    ok = putTime(delta - prevDelta_);
+    for (int i = 0; ok && i < FIELD_COUNT; i++) {
+      if (i == F_PINS) {
+        const uint32_t x = (uint32_t)(r.v[i] ^ prev_.v[i]) & 0xFF;
+        ok = x ? (w_.put(1, 1) && w_.put(x, 8)) : w_.put(0, 1);
+      } else {
+        ok = putValue(r.v[i] - prev_.v[i]);
+      }
+    }
+    if (ok) prevDelta_ = delta;
+  }
+
+  if (!ok) {
+    w_.rewind(mark);
+    return false;
+  }
+  prev_ = r;
+  count_++;
+  return true;
+}
+
+bool BlockDecoder::getValue(int32_t& delta) {
+  uint32_t z;
+  if (!getBucketed(r_, z, VALUE_BUCKETS)) return false;
+  delta = unzigzag(z);
+  return true;
+}
+
+bool BlockDecoder::getTime(int32_t& dd) {
+  uint32_t z;
+  if (!getBucketed(r_, z, TIME_BUCKETS)) return false;
+  dd = unzigzag(z);
+  return true;
+}
+
+void BlockDecoder::begin(const uint8_t* data, size_t bytes, uint16_t count) {
+  r_.begin(data, bytes);
+  left_ = count;
+  first_ = true;
+  prevDelta_ = 0;
+  memset(&prev_, 0, sizeof(prev_));
+}
+
+bool BlockDecoder::next(Record& out) {
+  if (left_ == 0) return false;
+
+  Record r;
+  if (first_) {
+    uint32_t x;
+    if (!r_.get(32, x)) return false;
+    r.ms = x;
+    for (int i = 0; i < FIELD_COUNT; i++) {
+      if (!r_.get(16, x)) return false;
+      r.v[i] = FIELDS[i].isSigned ? (int32_t)(int16_t)x : (int32_t)x;
+    }
+    first_ = false;
+  } else {
+    int32_t dd;
+    if (!getTime(dd)) return false;
+    const int32_t delta = prevDelta_ + dd;
+    r.ms = prev_.ms + (uint32_t)delta;
+    prevDelta_ = delta;
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+      if (i == F_PINS) {
+        uint32_t bit, x = 0;
+        if (!r_.get(1, bit)) return false;
+        if (bit && !r_.get(8, x)) return false;
+        r.v[i] = prev_.v[i] ^ (int32_t)x;
+      } else {
+        int32_t d;
+        if (!getValue(d)) return false;
+        r.v[i] = prev_.v[i] + d;
+      }
+    }
+  }
+
+  prev_ = r;
+  out = r;
+  left_--;
+  return true;
+}
+
+// ------------------------------------------------------------
+// Ring over flash sectors
+// ------------------------------------------------------------
+bool RingLog::mount(FlashIf* flash) {
+  f_ = flash;
+  sectors_ = (uint32_t)(flash->size() / SECTOR_SIZE);
+  if (sectors_ < 2) return false;
+
+  used_ = 0;
+  head_ = 0;
+  nextSeq_ = 0;
+  oldestSeq_ = 0;
+
+  bool any = false;
+  uint32_t newest = 0, newestIdx = 0, oldest = 0;
+
+  for (uint32_t i = 0; i < sectors_; i++) {
+    SectorHdr h;
+    if (!f_->read((size_t)i * SECTOR_SIZE, &h, sizeof(h))) continue;
+    if (h.magic != MAGIC || h.bytes > BLOCK_DATA || h.count == 0) continue;
+
+    used_++;
+    if (!any || (int32_t)(h.seq - newest) > 0) { newest = h.seq; newestIdx = i; }
+    if (!any || (int32_t)(h.seq - oldest) < 0) oldest = h.seq;
+    any = true;
+  }
+
+  if (any) {
+    head_ = (newestIdx + 1) % sectors_;
+    nextSeq_ = newest + 1;
+    oldestSeq_ = oldest;
+  }
+  return true;
+}
+
+bool RingLog::writeBlock(const uint8_t* sector) {
+  if (!f_) return false;
+
+  SectorHdr h;
+  memcpy(&h, sector, sizeof(h));
+  const size_t off = (size_t)head_ * SECTOR_SIZE;
+
+  if (!f_->erase(off, SECTOR_SIZE)) return false;
+  if (!f_->write(off, sector, sizeof(SectorHdr) + h.bytes)) return false;
+
+  if (used_ < sectors_) used_++;
+  head_ = (head_ + 1) % sectors_;
+  nextSeq_ = h.seq + 1;
+  // the ring is full once every sector holds a block: the oldest is the one after head
+  oldestSeq_ = (used_ == sectors_) ? nextSeq_ - sectors_ : nextSeq_ - used_;
+  return true;
+}
+
+long RingLog::offsetOf(uint32_t seq) {
+  if (!f_ || used_ == 0) return -1;
+  if ((int32_t)(seq - oldestSeq_) < 0 || (int32_t)(seq - nextSeq_) >= 0) return -1;
+
+  // blocks are consecutive behind head
+  const uint32_t back = nextSeq_ - seq;           // 1 = newest
+  const uint32_t idx = (head_ + sectors_ - (back % sectors_)) % sectors_;
+  const size_t off = (size_t)idx * SECTOR_SIZE;
+
+  uint32_t got;
+  if (!f_->read(off + offsetof(SectorHdr, seq), &got, sizeof(got)) || got != seq) return -1;
+  return (long)off;
+}
+
+bool RingLog::read(uint32_t seq, size_t off, void* dst, size_t len) {
+  const long base = offsetOf(seq);
+  if (base < 0 || off + len > SECTOR_SIZE) return false;
+  return f_->read((size_t)base + off, dst, len);
+}
+
+} // namespace TlmLog
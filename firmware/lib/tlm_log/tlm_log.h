@@ -0,0 +1,141 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "tlm_proto.h"
+
+// ------------------------------------------------------------
+// Compressed telemetry history (shared by firmware + host tools)
+//
+// Records are the TlmProto fields, quantized with the same scales as the
+// wire format, Gorilla-style compressed into self-contained 4 KB blocks:
+//   time  : delta-of-delta, bucketed prefix codes
+//   values: per-channel delta, zigzag, bucketed prefix codes
+//   pins  : XOR with previous ('0' = unchanged)
+// The first record of a block is stored raw, so every block (= flash
+// sector) decodes on its own.
+//
+// RingLog lays the blocks out round-robin over a flash region through a
+// FlashIf, so the same code runs on the ESP32 partition and on a file.
+// ------------------------------------------------------------
+namespace TlmLog {
+
+static constexpr size_t   SECTOR_SIZE = 4096;
+static constexpr uint32_t MAGIC       = 0x33474C54;   // "TLG3": 16 fields
+
+struct Record {
+  uint32_t ms;                              // device mono ms, low 32 bits
+  int32_t  v[TlmProto::FIELD_COUNT];        // wire-scaled values
+};
+
+// Quantize / restore with the TlmProto field scales
+void quantize(const float* values, uint32_t ms, Record& out);
+float restore(const Record& r, int field);
+
+struct __attribute__((packed)) SectorHdr {
+  uint32_t magic;
+  uint32_t seq;       // monotonic block number, never reused
+  uint32_t boot;      // boot counter when the block was started
+  uint16_t count;     // records
+  uint16_t bytes;     // compressed data bytes after the header
+  uint16_t crc;       // CRC-16 over this header (crc = 0) + data
+  uint16_t rsv;
+};
+static_assert(sizeof(SectorHdr) == 20, "SectorHdr layout");
+
+static constexpr size_t BLOCK_DATA = SECTOR_SIZE - sizeof(SectorHdr);
+
+uint16_t sectorCrc(const SectorHdr& h, const uint8_t* data);
+bool     sectorValid(const uint8_t* sector);   // magic, sizes and CRC
+
+class BitWriter {
+public:
+  void   begin(uint8_t* buf, size_t capBytes);
+  bool   put(uint32_t value, uint8_t bits);   // false (and nothing written) if full
+  size_t bits() const { return bit_; }
+  size_t bytes() const { return (bit_ + 7) / 8; }
+  void   rewind(size_t bit) { bit_ = bit; }
+private:
+  uint8_t* buf_ = nullptr;
+  size_t   cap_ = 0;   // bits
+  size_t   bit_ = 0;
+};
+
+class BitReader {
+public:
+  void begin(const uint8_t* buf, size_t bytes);
+  bool get(uint8_t bits, uint32_t& out);
+private:
+  const uint8_t* buf_ = nullptr;
+  size_t cap_ = 0;
+  size_t bit_ = 0;
+};
+
+class BlockEncoder {
+public:
+  void     begin(uint8_t* data, size_t cap = BLOCK_DATA);
+  // false if the record does not fit (block unchanged) -> seal and start anew
+  bool     append(const Record& r);
+  uint16_t count() const { return count_; }
+  size_t   bytes() const { return w_.bytes(); }
+private:
+  bool putValue(int32_t delta);
+  bool putTime(int32_t dd);
+  BitWriter w_;
+  Record    prev_;
+  int32_t   prevDelta_ = 0;
+  uint16_t  count_ = 0;
+};
+
+class BlockDecoder {
+public:
+  void begin(const uint8_t* data, size_t bytes, uint16_t count);
+  bool next(Record& out);
+private:
+  bool getValue(int32_t& delta);
+  bool getTime(int32_t& dd);
+  BitReader r_;
+  Record    prev_;
+  int32_t   prevDelta_ = 0;
+  uint16_t  left_ = 0;
+  bool      first_ = true;
+};
+
+// ------------------------------------------------------------
+// Flash access, sector granular
+// ------------------------------------------------------------
+class FlashIf {
+public:
+  virtual ~FlashIf() {}
+  virtual size_t size() const = 0;
+  virtual bool erase(size_t off, size_t len) = 0;
+  virtual bool write(size_t off, const void* src, size_t len) = 0;
+  virtual bool read(size_t off, void* dst, size_t len) = 0;
+};
+
+class RingLog {
+public:
+  // Scans all sector headers; returns false if the region is unusable
+  bool mount(FlashIf* flash);
+
+  // Write one sealed block (header + data) into the next sector
+  bool writeBlock(const uint8_t* sector);
+
+  uint32_t nextSeq() const { return nextSeq_; }
+  uint32_t oldestSeq() const { return oldestSeq_; }
+  uint32_t sectors() const { return sectors_; }
+  uint32_t used() const { return used_; }
+
+  // Locate block seq on flash, -1 if overwritten / not written yet
+  long offsetOf(uint32_t seq);
+  bool read(uint32_t seq, size_t off, void* dst, size_t len);
+
+private:
+  FlashIf* f_ = nullptr;
+  uint32_t sectors_ = 0;
+  uint32_t used_ = 0;
+  uint32_t head_ = 0;        // next sector index to write
+  uint32_t nextSeq_ = 0;
+  uint32_t oldestSeq_ = 0;
+};
+
+} // namespace TlmLog
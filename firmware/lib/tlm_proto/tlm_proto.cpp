@@ -0,0 +1,177 @@
+#include "tlm_proto.h"
+#include <string.h>
+
+namespace TlmProto {
+
+const char* const PIN_NAMES[8] = {
+  "en_charge", "en_dcdc", "en_relay", "en_load_dsg",
+  "en_bypass", "chg_done", "charging", "btn_sleep"
+};
+
+const char* const EVENT_NAMES[EVT_TYPE_COUNT] = {
+  "load_step", "trip", "chg_start", "chg_stop", "full", "empty", "sleep"
+};
+
+const FieldDef FIELDS[FIELD_COUNT] = {
+  { "vbat",       1000.0f, false, 3 },
+  { "soc",          10.0f, false, 1 },
+  { "iload",      1000.0f, false, 3 },
+  { "ichg",       1000.0f, false, 3 },
+  { "idsg",       1000.0f, false, 3 },
+  { "temp",        100.0f, true,  2 },   // TEMP_INVALID = no reading
+  { "inet",       1000.0f, true,  3 },
+  { "fcc",           1.0f, false, 0 },
+  { "rem",           1.0f, false, 0 },
+  { "chg",           1.0f, false, 0 },
+  { "ui_pending",    1.0f, false, 0 },
+  { "ui_left_s",     1.0f, false, 0 },
+  { "pins",          1.0f, false, 0 },   // PinBit mask
+  { "therm",         1.0f, false, 0 },   // ThermalMgr::Flag mask
+  { "dtdt",        100.0f, true,  2 },   // C/min
+  { "ir",        10000.0f, false, 4 },   // ohm, SocMgr internal resistance, 0 = not learnt yet
+};
+
+int fieldByName(const char* name) {
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    if (strcmp(FIELDS[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+uint16_t toU16(float v, float scale) {
+  float x = v * scale + 0.5f;
+  if (!(x > 0.0f)) return 0;          // also catches NaN
+  if (x >= 65535.0f) return 65535;
+  return (uint16_t)x;
+}
+
+int16_t toI16(float v, float scale) {
+  float x = v * scale;
+  if (x != x) return 0;               // NaN
+  x += (x >= 0.0f) ? 0.5f : -0.5f;
+  if (x >= 32767.0f)  return 32767;
+  if (x <= -32767.0f) return -32767;  // keep INT16_MIN free as a marker
+  return (int16_t)x;
+}
+
+uint32_t rawNextIdx(const RawHdrV1& h, uint8_t nextDecim) {
+  const uint32_t last = h.first_idx + (h.count ? h.count - 1u : 0u) * (h.decim ? h.decim : 1u);
+  uint32_t d = h.decim > nextDecim ? h.decim : nextDecim;
+  if (d == 0) d = 1;
+  return (last / d + 1) * d;
+}
+
+// Nibble table keeps it small for flash and still ~2x faster than bitwise
+static const uint16_t CRC_NIB[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc) {
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    crc = (uint16_t)((crc << 4) ^ CRC_NIB[crc >> 12]);
+    crc = (uint16_t)((crc << 4) ^ CRC_NIB[crc >> 12]);
+  }
+  return crc;
+}
+
+size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out, size_t outCap) {
+  if (outCap < cobsMaxLen(len)) return 0;
+
+  size_t codeIdx = 0;
+  size_t o = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      out[codeIdx] = code;
+      codeIdx = o++;
+      code = 1;
+    } else {
+      out[o++] = in[i];
+      if (++code == 0xFF) {
+        out[codeIdx] = code;
+        codeIdx = o++;
+        code = 1;
+      }
+    }
+  }
+  out[codeIdx] = code;
+  return o;
+}
+
+size_t cobsDecode(const uint8_t* in, size_t len, uint8_t* out, size_t outCap) {
+  size_t i = 0;
+  size_t o = 0;
+
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0) return 0;
+    for (uint8_t k = 1; k < code; k++) {
+      if (i >= len || o >= outCap || in[i] == 0) return 0;
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < len) {
+      if (o >= outCap) return 0;
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+size_t encodeFrame(uint8_t schema, uint16_t seq,
+                   const void* payload, size_t payloadLen,
+                   uint8_t* out, size_t outCap) {
+  if (payloadLen > MAX_PAYLOAD) return 0;
+
+  uint8_t raw[MAX_RAW];
+  raw[0] = PROTO_VER;
+  raw[1] = schema;
+  raw[2] = (uint8_t)(seq & 0xFF);
+  raw[3] = (uint8_t)(seq >> 8);
+  memcpy(raw + HEADER_LEN, payload, payloadLen);
+
+  size_t n = HEADER_LEN + payloadLen;
+  uint16_t crc = crc16(raw, n);
+  raw[n++] = (uint8_t)(crc & 0xFF);
+  raw[n++] = (uint8_t)(crc >> 8);
+
+  if (outCap < 1) return 0;
+  size_t enc = cobsEncode(raw, n, out, outCap - 1);
+  if (enc == 0) return 0;
+  out[enc++] = 0x00;
+  return enc;
+}
+
+bool Decoder::push(uint8_t b) {
+  if (b != 0x00) {
+    if (len_ < sizeof(buf_)) {
+      buf_[len_++] = b;
+    } else {
+      overflow_ = true;
+    }
+    return false;
+  }
+
+  // delimiter: try to close the current frame
+  const size_t n = len_;
+  const bool wasOverflow = overflow_;
+  len_ = 0;
+  overflow_ = false;
+
+  if (n == 0) return false;           // back-to-back delimiters
+  if (wasOverflow) { overruns_++; return false; }
+
+  size_t raw = cobsDecode(buf_, n, buf_, sizeof(buf_));
+  if (raw < HEADER_LEN + CRC_LEN) { badFrames_++; return false; }
+
+  uint16_t got = (uint16_t)(buf_[raw - 2] | (buf_[raw - 1] << 8));
+  if (crc16(buf_, raw - CRC_LEN) != got) { crcErrors_++; return false; }
+
+  payloadLen_ = raw - HEADER_LEN - CRC_LEN;
+  frames_++;
+  return true;
+}
+
+} // namespace TlmProto
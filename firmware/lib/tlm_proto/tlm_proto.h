@@ -0,0 +1,250 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ------------------------------------------------------------
+// Binary telemetry protocol (shared by firmware + host tools)
+//
+// Wire format (one frame):
+//   COBS( header | payload | crc16 ) 0x00
+//
+//   header  : ver(1) schema(1) seq(2, little-endian)
+//   payload : fixed-layout packed record, selected by schema id
+//   crc16   : CRC-16/CCITT-FALSE over header+payload, little-endian
+//
+// 0x00 never appears inside a COBS block, so a receiver can resync on
+// any zero byte. Plain C++ only - no Arduino headers in here.
+// ------------------------------------------------------------
+namespace TlmProto {
+
+static constexpr uint8_t  PROTO_VER        = 1;
+static constexpr uint8_t  SCHEMA_FULL_V1   = 1;   // FullV1 below
+static constexpr uint8_t  SCHEMA_RAW_V1    = 2;   // RawHdrV1 + RawSampleV1[]
+static constexpr uint8_t  SCHEMA_DELTA_V1  = 3;   // DeltaHdrV1 + 2 bytes per field
+static constexpr uint8_t  SCHEMA_LOG_V1    = 4;   // LogChunkV1 + history sector bytes
+static constexpr uint8_t  SCHEMA_OTA_V1    = 5;   // host -> device: OtaChunkV1 + image bytes
+static constexpr uint8_t  SCHEMA_EVENT_V1  = 6;   // EventV1, header seq = event seq (low 16 bits)
+
+static constexpr size_t   HEADER_LEN       = 4;
+static constexpr size_t   CRC_LEN          = 2;
+static constexpr size_t   MAX_PAYLOAD      = 512;
+static constexpr size_t   MAX_RAW          = HEADER_LEN + MAX_PAYLOAD + CRC_LEN;
+
+// COBS adds at most 1 byte per 254 + leading code byte, plus 0x00 delimiter
+static constexpr size_t cobsMaxLen(size_t rawLen) { return rawLen + rawLen / 254 + 1; }
+static constexpr size_t MAX_FRAME = cobsMaxLen(MAX_RAW) + 1;
+
+// Temperature value used when the NTC reading is invalid
+static constexpr int16_t TEMP_INVALID = INT16_MIN;
+
+// Pin bits in FullV1::pins (same order as the JSON "pins" object)
+enum PinBit : uint8_t {
+  PIN_BIT_EN_CHARGE   = 1 << 0,
+  PIN_BIT_EN_DCDC     = 1 << 1,
+  PIN_BIT_EN_RELAY    = 1 << 2,
+  PIN_BIT_EN_LOAD_DSG = 1 << 3,
+  PIN_BIT_EN_BYPASS   = 1 << 4,
+  PIN_BIT_CHG_DONE    = 1 << 5,
+  PIN_BIT_CHARGING    = 1 << 6,
+  PIN_BIT_BTN_SLEEP   = 1 << 7,
+};
+
+// JSON names for the PinBit bits, bit 0 first
+extern const char* const PIN_NAMES[8];
+
+enum FlagBit : uint8_t {
+  FLAG_CHARGING   = 1 << 0,
+  FLAG_UI_PENDING = 1 << 1,
+  FLAG_TH_NO_CHG  = 1 << 2,   // ThermalMgr blocks charging
+  FLAG_TH_NO_DSG  = 1 << 3,   // ThermalMgr blocks the load
+  FLAG_ADC_IDLE   = 1 << 4,   // ADCMgr at its idle rate
+  FLAG_ADC_BURST  = 1 << 5,   //   at its burst rate (neither: normal)
+};
+
+// Schema 1: everything printJsonLineFull() sends, as scaled integers.
+// Little-endian on the wire (ESP32 and x86 hosts are both LE).
+struct __attribute__((packed)) FullV1 {
+  uint32_t ms;          // device mono ms (TimeMgr), low 32 bits
+  uint16_t vbat_mv;
+  uint16_t soc_x10;     // 0..1000 => 0.0..100.0 %
+  uint16_t iload_ma;
+  uint16_t ichg_ma;
+  uint16_t idsg_ma;
+  int16_t  temp_cx100;  // TEMP_INVALID if no reading
+  int16_t  inet_ma;
+  uint16_t fcc_mah;
+  uint16_t rem_mah;
+  uint8_t  flags;       // FlagBit
+  uint8_t  ui_left_s;
+  uint8_t  pins;        // PinBit
+};
+static_assert(sizeof(FullV1) == 25, "FullV1 layout changed - bump the schema id");
+
+// Schema 2: batch of raw ADC reads (stream mode).
+// first_idx counts every read of a streamed channel, kept or decimated
+// away; a batch holds the reads first_idx, +decim, +2*decim, ... So the
+// next batch starts at rawNextIdx(), and a dropped batch also leaves a
+// gap in the frame seq.
+struct __attribute__((packed)) RawHdrV1 {
+  uint32_t t0_us;       // device mono µs of the first sample, low 32 bits
+  uint32_t first_idx;   // read counter of the first sample
+  uint16_t tick_us;     // ADC tick period
+  uint8_t  decim;       // 1 = every read kept, N = every Nth (idx % N == 0, N = 2^k)
+  uint8_t  count;       // samples that follow
+};
+
+struct __attribute__((packed)) RawSampleV1 {
+  uint16_t ch_mv;       // channel << RAW_CH_SHIFT | millivolts
+  uint16_t dt_us;       // since previous sample in this batch (saturates)
+};
+
+static constexpr unsigned RAW_CH_SHIFT = 13;
+static constexpr uint16_t RAW_MV_MASK  = (1u << RAW_CH_SHIFT) - 1;
+static constexpr size_t   RAW_MAX_SAMPLES =
+    (MAX_PAYLOAD - sizeof(RawHdrV1)) / sizeof(RawSampleV1);
+static_assert(RAW_MAX_SAMPLES <= 255, "RawHdrV1::count is 8 bit");
+
+// ------------------------------------------------------------
+// Field ids for subscriptions (SCHEMA_DELTA_V1). Bit i of a field mask
+// is Field i; values follow the header in bit order, 2 bytes each,
+// scaled like FullV1.
+// ------------------------------------------------------------
+enum Field : uint8_t {
+  F_VBAT = 0, F_SOC, F_ILOAD, F_ICHG, F_IDSG, F_TEMP, F_INET,
+  F_FCC, F_REM, F_CHG, F_UI_PENDING, F_UI_LEFT, F_PINS,
+  F_THERM, F_DTDT, F_IR,
+  FIELD_COUNT
+};
+
+static constexpr uint16_t FIELD_MASK_ALL = (1u << FIELD_COUNT) - 1;
+static_assert(FIELD_COUNT <= 16, "field masks are 16 bit");
+
+struct FieldDef {
+  const char* name;       // JSON key
+  float       scale;      // wire value = round(value * scale)
+  bool        isSigned;   // int16 instead of uint16
+  uint8_t     decimals;   // for JSON / display
+};
+
+extern const FieldDef FIELDS[FIELD_COUNT];
+
+// Field id for a JSON key, -1 if unknown
+int fieldByName(const char* name);
+
+struct __attribute__((packed)) DeltaHdrV1 {
+  uint32_t ms;
+  uint16_t mask;          // fields present in this frame
+  uint8_t  key;           // 1 = all subscribed fields (keyframe), 0 = changes only
+};
+
+// Schema 4: one piece of a stored history sector (see tlm_log.h).
+// The host reassembles by (seq, off) and checks the sector's own CRC,
+// so a download can resume at any chunk. len == 0 marks the end.
+struct __attribute__((packed)) LogChunkV1 {
+  uint32_t seq;           // history block number
+  uint16_t off;           // byte offset inside the sector
+  uint16_t total;         // sector bytes in use (header + data)
+  uint16_t len;           // chunk bytes that follow
+};
+
+static constexpr size_t LOG_CHUNK_MAX = 480;
+static_assert(sizeof(LogChunkV1) + LOG_CHUNK_MAX <= MAX_PAYLOAD, "log chunk too big");
+
+// Schema 5, host -> device: one piece of a firmware image chunk (see
+// ota_img.h). A chunk is one 4 KB flash sector of the image, compressed on
+// its own; the device reassembles it by (idx, off), unpacks it and checks
+// the CRC-32 of the result. Every piece repeats the chunk fields, so any
+// piece can start a chunk after a loss.
+struct __attribute__((packed)) OtaChunkV1 {
+  uint16_t idx;           // chunk = sector number in the image
+  uint16_t off;           // byte offset inside the packed chunk
+  uint16_t total;         // packed chunk bytes
+  uint16_t len;           // piece bytes that follow
+  uint16_t raw;           // chunk bytes once unpacked
+  uint8_t  method;        // OtaImg::Method
+  uint32_t crc;           // CRC-32 of the unpacked chunk
+};
+
+static constexpr size_t OTA_PIECE_MAX = 480;
+static_assert(sizeof(OtaChunkV1) + OTA_PIECE_MAX <= MAX_PAYLOAD, "ota piece too big");
+
+// Schema 6: one event (EventMgr), sent as it happens. seq counts every
+// event since boot, so a gap is an event this client did not get; boot
+// tells a restart from a gap.
+enum EventType : uint8_t {
+  EVT_LOAD_STEP = 0,   // value: the step, + attach / - detach
+  EVT_TRIP,            //   load current at the trip
+  EVT_CHG_START,
+  EVT_CHG_STOP,
+  EVT_FULL,            // SocMgr full latch (used = 0)
+  EVT_EMPTY,           // SocMgr empty latch (used = FCC)
+  EVT_SLEEP,           // deep sleep entry, the last event of a boot
+  EVT_TYPE_COUNT
+};
+
+// JSON names for the EventType values
+extern const char* const EVENT_NAMES[EVT_TYPE_COUNT];
+
+struct __attribute__((packed)) EventV1 {
+  uint64_t t_us;        // device mono µs (TimeMgr) of the event itself
+  uint32_t seq;
+  uint16_t boot;        // TimeMgr::boots(), low 16 bits
+  uint8_t  type;        // EventType
+  int16_t  value_ma;    // 0 for the types without a value
+};
+static_assert(sizeof(EventV1) == 17, "EventV1 layout changed - bump the schema id");
+
+// Fixed-point helpers (round to nearest, saturate)
+uint16_t toU16(float v, float scale);
+int16_t  toI16(float v, float scale);
+
+// first_idx of the batch after h if none was lost in between and the
+// device then keeps every nextDecim-th read: the first read after h's
+// last that both decimations keep
+uint32_t rawNextIdx(const RawHdrV1& h, uint8_t nextDecim);
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF);
+
+// COBS. Return encoded/decoded length, 0 on overflow or malformed input.
+// cobsDecode may run in place (out == in).
+size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out, size_t outCap);
+size_t cobsDecode(const uint8_t* in, size_t len, uint8_t* out, size_t outCap);
+
+// Build one complete frame (including trailing 0x00) into out.
+// Returns bytes written, 0 if it does not fit.
+size_t encodeFrame(uint8_t schema, uint16_t seq,
+                   const void* payload, size_t payloadLen,
+                   uint8_t* out, size_t outCap);
+
+// Streaming receiver: feed bytes, get whole CRC-checked frames back.
+class Decoder {
+public:
+  // Returns true when a valid frame has just completed; the frame stays
+  // readable through the accessors until the next push().
+  bool push(uint8_t b);
+
+  uint8_t        version()    const { return buf_[0]; }
+  uint8_t        schema()     const { return buf_[1]; }
+  uint16_t       seq()        const { return (uint16_t)(buf_[2] | (buf_[3] << 8)); }
+  const uint8_t* payload()    const { return buf_ + HEADER_LEN; }
+  size_t         payloadLen() const { return payloadLen_; }
+
+  uint32_t frames()    const { return frames_; }
+  uint32_t crcErrors() const { return crcErrors_; }
+  uint32_t badFrames() const { return badFrames_; }   // COBS / length errors
+  uint32_t overruns()  const { return overruns_; }
+
+private:
+  uint8_t  buf_[MAX_FRAME] = {0};
+  size_t   len_ = 0;
+  size_t   payloadLen_ = 0;
+  bool     overflow_ = false;
+
+  uint32_t frames_ = 0;
+  uint32_t crcErrors_ = 0;
+  uint32_t badFrames_ = 0;
+  uint32_t overruns_ = 0;
+};
+
+} // namespace TlmProto
@@ -0,0 +1,97 @@
+#pragma once
+// Native simulator: the subset of the Arduino-ESP32 API the firmware uses.
+// Time is virtual (see sim_hal.h); pins and ADC are driven by the model.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT          0x01
+#define OUTPUT         0x03
+#define INPUT_PULLUP   0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))   // see Sim::restart()
+
+enum adc_attenuation_t { ADC_0db, ADC_2_5db, ADC_6db, ADC_11db };
+
+using std::min;
+using std::max;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int  digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+uint32_t analogReadMilliVolts(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t att);
+
+uint32_t esp_random();
+
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode);
+void detachInterrupt(uint8_t pin);
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* b, size_t n) {
+    size_t k = 0;
+    while (k < n && write(b[k])) k++;
+    return k;
+  }
+  size_t print(const char* s)   { return write((const uint8_t*)s, strlen(s)); }
+  size_t println(const char* s) { size_t n = print(s); return n + print("\r\n"); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// USB serial: output is discarded unless the sim was started with --usb;
+// a stalled port (Sim::usbStall) takes nothing
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* b, size_t n) override;
+  int availableForWrite();
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() {}
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// getCycleCount() is host time in 240 MHz cycles: profiler numbers from
+// the sim are what the code costs on the host, not on the ESP32.
+// The heap figures are fixed: the host heap says nothing about the ESP32's.
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getFreeHeap() { return 180000; }
+  uint32_t getMinFreeHeap() { return 180000; }
+  uint32_t getMaxAllocHeap() { return 110000; }
+};
+
+extern EspClass ESP;
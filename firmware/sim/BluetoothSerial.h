@@ -0,0 +1,17 @@
+#pragma once
+#include <Arduino.h>
+
+// SPP stand-in. With --pty the sim opens a pseudo terminal and a host tool
+// connected to it is the BT client; otherwise a scenario can connect a
+// scripted client ("bt connect" / "send {...}") whose output is dropped.
+class BluetoothSerial : public Print {
+public:
+  bool   begin(const char* name, bool isMaster = false);
+  void   enableSSP() {}
+  bool   setPin(const char*) { return true; }
+  bool   hasClient();
+  int    available();
+  int    read();
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* b, size_t n) override;
+};
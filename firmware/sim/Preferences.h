@@ -0,0 +1,33 @@
+#pragma once
+#include <Arduino.h>
+
+// NVS stand-in: one in-memory key/value store per sim process
+class Preferences {
+public:
+  bool   begin(const char* ns, bool readOnly = false);
+  void   end() {}
+  bool   isKey(const char* key);
+  bool   remove(const char* key);
+  bool   clear();
+
+  float    getFloat(const char* key, float def = 0.0f);
+  size_t   putFloat(const char* key, float v);
+  double   getDouble(const char* key, double def = 0.0);
+  size_t   putDouble(const char* key, double v);
+  uint32_t getUInt(const char* key, uint32_t def = 0);
+  size_t   putUInt(const char* key, uint32_t v);
+  int32_t  getInt(const char* key, int32_t def = 0);
+  size_t   putInt(const char* key, int32_t v);
+  uint64_t getULong64(const char* key, uint64_t def = 0);
+  size_t   putULong64(const char* key, uint64_t v);
+  bool     getBool(const char* key, bool def = false);
+  size_t   putBool(const char* key, bool v);
+  size_t   getBytesLength(const char* key);
+  size_t   getBytes(const char* key, void* buf, size_t len);
+  size_t   putBytes(const char* key, const void* buf, size_t len);
+
+private:
+  size_t get(const char* key, void* buf, size_t len);
+  size_t put(const char* key, const void* buf, size_t len);
+  char ns_[16] = {0};
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+#define TFT_BLACK 0x0000
+#define TFT_WHITE 0xFFFF
+#define TFT_RED   0xF800
+#define TFT_GREEN 0x07E0
+
+// Display stand-in: drawing is a no-op
+class TFT_eSPI : public Print {
+public:
+  TFT_eSPI(int16_t w = 240, int16_t h = 320) { (void)w; (void)h; }
+  void init() {}
+  void setRotation(uint8_t) {}
+  void fillScreen(uint32_t) {}
+  void fillRect(int32_t, int32_t, int32_t, int32_t, uint32_t) {}
+  void setTextColor(uint16_t, uint16_t) {}
+  void setTextColor(uint16_t) {}
+  void setTextSize(uint8_t) {}
+  void setCursor(int16_t, int16_t) {}
+  void writecommand(uint8_t) {}
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t n) override { return n; }
+};
@@ -0,0 +1,4 @@
+#pragma once
+typedef int gpio_num_t;
+void gpio_deep_sleep_hold_en();
+void gpio_deep_sleep_hold_dis();
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+typedef enum { RTC_GPIO_MODE_INPUT_ONLY, RTC_GPIO_MODE_OUTPUT_ONLY, RTC_GPIO_MODE_INPUT_OUTPUT } rtc_gpio_mode_t;
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t pin);
+int  rtc_gpio_init(gpio_num_t pin);
+int  rtc_gpio_deinit(gpio_num_t pin);
+int  rtc_gpio_set_direction(gpio_num_t pin, rtc_gpio_mode_t mode);
+int  rtc_gpio_set_level(gpio_num_t pin, uint32_t level);
+int  rtc_gpio_hold_en(gpio_num_t pin);
+int  rtc_gpio_hold_dis(gpio_num_t pin);
+int  rtc_gpio_pullup_en(gpio_num_t pin);
+int  rtc_gpio_pullup_dis(gpio_num_t pin);
+int  rtc_gpio_pulldown_en(gpio_num_t pin);
+int  rtc_gpio_pulldown_dis(gpio_num_t pin);
@@ -0,0 +1,29 @@
+#pragma once
+#include "esp_partition.h"
+
+#define ESP_ERR_NOT_FOUND            0x105
+#define ESP_ERR_OTA_VALIDATE_FAILED  0x1503
+
+typedef enum {
+  ESP_OTA_IMG_NEW            = 0x0,
+  ESP_OTA_IMG_PENDING_VERIFY = 0x1,
+  ESP_OTA_IMG_VALID          = 0x2,
+  ESP_OTA_IMG_INVALID        = 0x3,
+  ESP_OTA_IMG_ABORTED        = 0x4,
+  ESP_OTA_IMG_UNDEFINED      = 0xFFFFFFFF,
+} esp_ota_img_states_t;
+
+// RAM-backed app0 / app1 (partitions.csv) and an otadata stand-in.
+// Sim::reboot() / restart() play the bootloader with rollback enabled:
+// a NEW boot slot starts as PENDING_VERIFY, and a PENDING_VERIFY one that
+// boots again is ABORTED and the other slot runs.
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_boot_partition();
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+// Fails unless the slot starts with the image magic (0xE9); the running
+// slot always passes
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* p);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* p, esp_ota_img_states_t* state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback();
+// Marks the running slot INVALID and restarts (esp_restart())
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot();
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_timer.h"
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t    type;
+  esp_partition_subtype_t subtype;
+  uint32_t                address;
+  uint32_t                size;
+  char                    label[17];
+} esp_partition_t;
+
+// RAM-backed partitions named in partitions.csv (only "tlmlog" so far)
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t sub, const char* label);
+esp_err_t esp_partition_read(const esp_partition_t* p, size_t off, void* dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t* p, size_t off, const void* src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t* p, size_t off, size_t len);
@@ -0,0 +1,30 @@
+#pragma once
+// Native simulator: tasks are std::threads, critical sections one mutex.
+#include <stdint.h>
+
+typedef int           BaseType_t;
+typedef unsigned      UBaseType_t;
+typedef uint32_t      TickType_t;
+typedef struct SimTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+#define portMAX_DELAY     0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define pdFAIL  0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+void simEnterCritical();
+void simExitCritical();
+// One mutex for all; the mux is still evaluated, so a file-static one
+// counts as used, as it does on the target
+#define portENTER_CRITICAL(m)     ((void)(m), simEnterCritical())
+#define portEXIT_CRITICAL(m)      ((void)(m), simExitCritical())
+#define portENTER_CRITICAL_ISR(m) ((void)(m), simEnterCritical())
+#define portEXIT_CRITICAL_ISR(m)  ((void)(m), simExitCritical())
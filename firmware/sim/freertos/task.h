@@ -0,0 +1,13 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+                                   void* arg, UBaseType_t prio, TaskHandle_t* out, BaseType_t core);
+void         vTaskDelay(TickType_t ticks);
+uint32_t     ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void         xTaskNotifyGive(TaskHandle_t t);
+void         vTaskNotifyGiveFromISR(TaskHandle_t t, BaseType_t* woken);
+UBaseType_t  uxTaskGetStackHighWaterMark(TaskHandle_t t);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TaskHandle_t xTaskGetHandle(const char* name);
+#define portYIELD_FROM_ISR(x) (void)(x)
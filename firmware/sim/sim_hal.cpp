@@ -0,0 +1,915 @@
+#include "sim_hal.h"
+#include <Arduino.h>
+#include <Preferences.h>
+#include <BluetoothSerial.h>
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "driver/rtc_io.h"
+#include "soc/gpio_reg.h"
+#include "freertos/task.h"
+#include "pins.h"
+
+#include <sys/time.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static void otaBoot();
+
+namespace Sim {
+static void btCatchUp();
+
+static Model    s_model;
+static uint64_t s_now = 0;
+static uint64_t s_boot = 0;
+static uint32_t s_rng = 1;
+static bool     s_asleep = false;
+static int      s_wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static int      s_resetReason = ESP_RST_POWERON;
+static FILE*    s_usb = nullptr;
+static bool     s_usbStall = false;
+
+static std::recursive_mutex s_crit;
+
+// ------------------------------------------------------------
+// Pins
+// ------------------------------------------------------------
+static constexpr int NUM_PINS = 40;
+static uint8_t s_mode[NUM_PINS];
+static uint8_t s_out[NUM_PINS];
+
+// Break-before-make monitor for the relay / DC-DC pair: one switching on
+// while the other is on is an overlap; one switching on shortly after the
+// other went off is a changeover, and the gap is its dead time
+static constexpr uint64_t NEVER = UINT64_MAX;
+static constexpr uint64_t CHANGEOVER_WINDOW_US = 1000000;
+static uint64_t s_offUs[NUM_PINS];
+static BbmStats s_bbm = { 0, 0, NEVER };
+
+static void setOut(int pin, uint8_t level) {
+  level = level ? 1 : 0;
+  if (s_out[pin] == level) return;
+  s_out[pin] = level;
+  if (pin != PIN_EN_RELAY && pin != PIN_EN_DCDC) return;
+
+  const int other = (pin == PIN_EN_RELAY) ? PIN_EN_DCDC : PIN_EN_RELAY;
+  if (!level) { s_offUs[pin] = s_now; return; }
+  if (s_out[other]) { s_bbm.overlaps++; return; }
+  if (s_offUs[other] != NEVER && s_now - s_offUs[other] < CHANGEOVER_WINDOW_US) {
+    s_bbm.changeovers++;
+    s_bbm.deadMinUs = std::min(s_bbm.deadMinUs, s_now - s_offUs[other]);
+  }
+}
+
+static PinOut outputs() {
+  PinOut p;
+  p.en_charge   = s_out[PIN_EN_CHARGE] != 0;
+  p.en_load_dsg = s_out[PIN_EN_LOAD_DSG] != 0;
+  p.en_dcdc     = s_out[PIN_EN_DCDC] != 0;
+  p.en_relay    = s_out[PIN_EN_RELAY] != 0;
+  return p;
+}
+
+static int inputLevel(int pin);
+static uint32_t rnd();
+
+// Charger status inputs as the firmware sees them: they follow the model,
+// with contact bounce if enabled, and fire the attached pin interrupts
+struct Isr {
+  void (*fn)();
+  int  mode;
+};
+struct Bounce {
+  uint64_t us;
+  uint8_t  level;
+};
+static const int TRACKED[] = { PIN_CHARGING, PIN_CHG_DONE };
+static int      s_seen[NUM_PINS];          // -1: not sampled yet
+static Isr      s_isr[NUM_PINS];
+static std::deque<Bounce> s_bounce[NUM_PINS];
+static uint64_t s_bounceUs = 0;
+static uint32_t s_edges = 0;
+
+static void edge(int pin, uint8_t level) {
+  if (s_seen[pin] == level) return;
+  s_seen[pin] = level;
+  s_edges++;
+  const Isr& isr = s_isr[pin];
+  if (!isr.fn) return;
+  if (isr.mode == CHANGE || (isr.mode == RISING && level) || (isr.mode == FALLING && !level)) isr.fn();
+}
+
+// Model level changed: the new level, after a burst of chatter if enabled
+static void pollInputs() {
+  for (int pin : TRACKED) {
+    const uint8_t level = (uint8_t)inputLevel(pin);
+    std::deque<Bounce>& q = s_bounce[pin];
+    const uint8_t heading = q.empty() ? (uint8_t)s_seen[pin] : q.back().level;
+    if (s_seen[pin] < 0) { s_seen[pin] = level; continue; }
+    if (level == heading) continue;
+    if (!s_bounceUs) { q.clear(); edge(pin, level); continue; }
+    // 2..6 extra toggles over s_bounceUs, ending on the new level
+    const int extra = 2 * (1 + (int)(rnd() % 3));
+    uint64_t t = q.empty() ? s_now : q.back().us;
+    for (int i = 0; i <= extra; i++) {
+      t += 1 + rnd() % (s_bounceUs / (extra + 1) + 1);
+      q.push_back({ t, (uint8_t)((i % 2 == 0) ? level : !level) });
+    }
+  }
+}
+
+static uint64_t nextBounceUs() {
+  uint64_t next = UINT64_MAX;
+  for (int pin : TRACKED) {
+    if (!s_bounce[pin].empty()) next = std::min(next, s_bounce[pin].front().us);
+  }
+  return next;
+}
+
+static void fireBounces() {
+  for (int pin : TRACKED) {
+    std::deque<Bounce>& q = s_bounce[pin];
+    while (!q.empty() && q.front().us <= s_now) {
+      edge(pin, q.front().level);
+      q.pop_front();
+    }
+  }
+}
+
+// ------------------------------------------------------------
+// Timers (esp_timer)
+// ------------------------------------------------------------
+struct Timer {
+  esp_timer_cb_t cb;
+  void*    arg;
+  uint64_t period;   // 0 = one-shot
+  uint64_t due;      // absolute sim µs
+  bool     armed;
+  bool     alive;
+};
+static std::vector<Timer*> s_timers;
+
+static Timer* nextDue(uint64_t limit) {
+  Timer* best = nullptr;
+  for (Timer* t : s_timers) {
+    if (t->alive && t->armed && t->due <= limit && (!best || t->due < best->due)) best = t;
+  }
+  return best;
+}
+
+Model& model() { return s_model; }
+uint64_t nowUs() { return s_now; }
+uint64_t bootUs() { return s_boot; }
+bool asleep() { return s_asleep; }
+void usbEcho(FILE* f) { s_usb = f; }
+void usbStall(bool on) { s_usbStall = on; }
+
+static uint32_t rnd() {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+void advance(uint64_t us) {
+  const uint64_t end = s_now + us;
+  pollInputs();
+  for (;;) {
+    Timer* t = nextDue(end);
+    const uint64_t b = nextBounceUs();
+    if (b <= end && (!t || b < t->due)) {
+      s_model.step((b - s_now) * 1e-6, outputs(), s_asleep);
+      s_now = b;
+      fireBounces();
+      pollInputs();
+      continue;
+    }
+    if (!t) break;
+    s_model.step((t->due - s_now) * 1e-6, outputs(), s_asleep);
+    s_now = t->due;
+    if (t->period) t->due += t->period;
+    else           t->armed = false;
+    t->cb(t->arg);
+    pollInputs();
+  }
+  s_model.step((end - s_now) * 1e-6, outputs(), s_asleep);
+  s_now = end;
+  pollInputs();
+  btCatchUp();
+}
+
+static void resetPins() {
+  for (int i = 0; i < NUM_PINS; i++) { setOut(i, 0); s_mode[i] = INPUT; s_isr[i] = { nullptr, 0 }; }
+}
+
+// Statics survive a warm restart, so handles stay valid; they just stop
+static void dropTimers() {
+  for (Timer* t : s_timers) t->armed = false;
+}
+
+BbmStats bbmStats() { return s_bbm; }
+
+void setBounce(uint64_t us) { s_bounceUs = us; }
+uint32_t inputEdges() { return s_edges; }
+
+void reset(uint32_t seed) {
+  s_now = 0;
+  for (uint64_t& t : s_offUs) t = NEVER;
+  s_bbm = { 0, 0, NEVER };
+  for (int& v : s_seen) v = -1;
+  for (std::deque<Bounce>& q : s_bounce) q.clear();
+  s_bounceUs = 0;
+  s_edges = 0;
+  s_boot = 0;
+  s_rng = seed ? seed : 1;
+  s_asleep = false;
+  s_wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+  s_resetReason = ESP_RST_POWERON;
+  s_usbStall = false;
+  resetPins();
+  dropTimers();
+}
+
+void enterSleep() {
+  s_asleep = true;
+  dropTimers();
+  for (Isr& i : s_isr) i = { nullptr, 0 };
+}
+
+void reboot(int cause) {
+  s_boot = s_now;
+  s_asleep = false;
+  s_wakeCause = cause;
+  s_resetReason = ESP_RST_DEEPSLEEP;
+  resetPins();
+  dropTimers();
+  otaBoot();
+}
+
+// RTC_NOINIT_ATTR variables (sim Arduino.h puts them in this section)
+extern "C" char __start_rtc_noinit[] __attribute__((weak));
+extern "C" char __stop_rtc_noinit[] __attribute__((weak));
+
+void restart(int reason) {
+  reboot(ESP_SLEEP_WAKEUP_UNDEFINED);
+  s_resetReason = reason;
+  if (reason != ESP_RST_POWERON) return;
+  // power was gone: RTC memory holds whatever it comes up with
+  char* p = __start_rtc_noinit;
+  char* end = __stop_rtc_noinit;
+  for (uint32_t i = 0; p && p < end; p++, i++) *p = (char)(0xA5 ^ (i * 37));
+}
+
+// ------------------------------------------------------------
+// Deep sleep wake sources
+// ------------------------------------------------------------
+static int      s_ext0Pin = -1, s_ext0Level = 1;
+static uint64_t s_ext1Mask = 0;
+static int      s_ext1Mode = ESP_EXT1_WAKEUP_ALL_LOW;
+
+static int inputLevel(int pin) {
+  switch (pin) {
+    case PIN_CHARGING:  return s_model.pinCharging();
+    case PIN_CHG_DONE:  return s_model.pinChgDone();
+    case PIN_BTN_SLEEP: return s_model.pinButton();
+    default:            return s_mode[pin] == INPUT_PULLUP ? 1 : 0;
+  }
+}
+
+int wakeCause() {
+  if (s_ext0Pin >= 0 && inputLevel(s_ext0Pin) == s_ext0Level) return ESP_SLEEP_WAKEUP_EXT0;
+  if (s_ext1Mask) {
+    bool all = true, any = false;
+    for (int p = 0; p < NUM_PINS; p++) {
+      if (!(s_ext1Mask & (1ull << p))) continue;
+      const int lv = inputLevel(p);
+      all = all && lv == 0;
+      any = any || lv == 1;
+    }
+    if (s_ext1Mode == ESP_EXT1_WAKEUP_ALL_LOW ? all : any) return ESP_SLEEP_WAKEUP_EXT1;
+  }
+  return 0;
+}
+
+// ------------------------------------------------------------
+// BT client: scripted (lines from the scenario) or a pty
+// ------------------------------------------------------------
+static std::mutex       s_btMu;
+static bool             s_btConnected = false;
+static std::deque<char> s_btRx;
+static int              s_ptyFd = -1;
+static FILE*            s_btLog = nullptr;
+static uint64_t         s_btOut = 0;
+static uint32_t         s_btWrites = 0;
+static uint32_t         s_btLoopWrites = 0;
+static uint32_t         s_btRate = 0;       // bytes per sim second, 0 = no limit
+static uint64_t         s_btFreeUs = 0;     // sim time the client has taken all it got
+static uint64_t         s_btBusyUs = 0;     // a write blocks until then, 0 = none
+static std::condition_variable s_btCv;
+static void           (*s_btTap)(const uint8_t*, size_t) = nullptr;
+static bool           (*s_btIdle)() = nullptr;
+
+void btConnect(bool on) {
+  std::lock_guard<std::mutex> l(s_btMu);
+  s_btConnected = on;
+  if (!on) s_btRx.clear();
+  s_btCv.notify_all();
+}
+
+// A write to a rate-limited client ends once the clock passes what the
+// client took. Let the TX task return from it, and write what else is
+// queued up to the next write that blocks, before time runs on. The rate
+// and the queue then hold in sim time however the host schedules the
+// threads. (A second of real time is the bound for a stuck task.)
+static void btCatchUp() {
+  const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  std::unique_lock<std::mutex> l(s_btMu);
+  if (s_btBusyUs && s_btBusyUs <= s_now) {
+    s_btCv.notify_all();
+    s_btCv.wait_until(l, until, [] { return !s_btBusyUs || s_btBusyUs > s_now; });
+  }
+  while (s_btIdle && s_btConnected && s_btBusyUs <= s_now && std::chrono::steady_clock::now() < until) {
+    l.unlock();
+    const bool idle = s_btIdle();
+    std::this_thread::yield();
+    l.lock();
+    if (idle) break;
+  }
+}
+
+void btSend(const char* line) {
+  std::lock_guard<std::mutex> l(s_btMu);
+  for (const char* p = line; *p; p++) s_btRx.push_back(*p);
+  s_btRx.push_back('\n');
+}
+
+bool btOpenPty(char* path, size_t cap) {
+  int slave = -1;
+  char name[64];
+  if (openpty(&s_ptyFd, &slave, name, nullptr, nullptr) != 0) return false;
+  // raw, or the slave's line discipline echoes our output back in as commands
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  fcntl(s_ptyFd, F_SETFL, fcntl(s_ptyFd, F_GETFL) | O_NONBLOCK);
+  snprintf(path, cap, "%s", name);
+  // keep the slave open so the master doesn't see EOF between clients
+  s_btConnected = true;
+  return true;
+}
+
+void btSetLog(FILE* f) { s_btLog = f; }
+uint64_t btBytesOut() { return s_btOut; }
+uint32_t btWrites() { return s_btWrites; }
+uint32_t btLoopWrites() { return s_btLoopWrites; }
+
+void btSetRate(uint32_t bytesPerS) {
+  std::lock_guard<std::mutex> l(s_btMu);
+  s_btRate = bytesPerS;
+  s_btFreeUs = s_now;
+  s_btCv.notify_all();
+}
+
+uint32_t btRate() {
+  std::lock_guard<std::mutex> l(s_btMu);
+  return s_btRate;
+}
+void btSetTap(void (*fn)(const uint8_t*, size_t)) { s_btTap = fn; }
+void btSetIdle(bool (*fn)()) { s_btIdle = fn; }
+
+static void ptyPoll() {
+  if (s_ptyFd < 0) return;
+  char buf[256];
+  ssize_t n;
+  while ((n = ::read(s_ptyFd, buf, sizeof(buf))) > 0) {
+    for (ssize_t i = 0; i < n; i++) s_btRx.push_back(buf[i]);
+  }
+}
+
+// Allocations the firmware is not to be charged with (see sim_heap.cpp)
+static thread_local int t_heapQuiet = 0;
+
+HeapQuiet::HeapQuiet()  { t_heapQuiet++; }
+HeapQuiet::~HeapQuiet() { t_heapQuiet--; }
+bool heapQuiet() { return t_heapQuiet > 0; }
+
+// ------------------------------------------------------------
+// Tasks: one std::thread each, notifications via condition variable
+// ------------------------------------------------------------
+} // namespace Sim
+
+struct SimTask {
+  SimTask(const char* n, uint32_t s) : name(n), stack(s) {}
+
+  std::string name;
+  uint32_t stack = 0;
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+namespace Sim {
+static thread_local SimTask* t_self = nullptr;
+// The Arduino loop task: the main thread (stack as in arduino-esp32)
+static SimTask s_mainTask("loopTask", 8192);
+} // namespace Sim
+
+// ============================================================
+// Shim entry points
+// ============================================================
+using namespace Sim;
+
+void simEnterCritical() { s_crit.lock(); }
+void simExitCritical()  { s_crit.unlock(); }
+
+uint32_t millis() { return (uint32_t)((s_now - s_boot) / 1000); }
+uint32_t micros() { return (uint32_t)(s_now - s_boot); }
+void delay(uint32_t ms) { advance((uint64_t)ms * 1000); std::this_thread::yield(); }
+void delayMicroseconds(uint32_t us) { advance(us); }
+uint32_t esp_random() { return rnd(); }
+
+// Host ns * 0.24. On x86 the TSC is scaled (ratio measured once against
+// the monotonic clock), a clock_gettime() per zone slowed the sim down.
+static uint64_t hostNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t EspClass::getCycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+  static double s_cycPerTick = 0;
+  if (s_cycPerTick == 0) {
+    const uint64_t n0 = hostNs(), t0 = __builtin_ia32_rdtsc();
+    while (hostNs() - n0 < 10000000) {}
+    const uint64_t n1 = hostNs(), t1 = __builtin_ia32_rdtsc();
+    s_cycPerTick = (double)(n1 - n0) * 0.24 / (double)(t1 - t0);
+  }
+  return (uint32_t)(uint64_t)((double)__builtin_ia32_rdtsc() * s_cycPerTick);
+#else
+  return (uint32_t)(hostNs() * 240 / 1000);
+#endif
+}
+
+// gettimeofday() is the RTC side of TimeMgr's sleep bridge: make it virtual.
+// (The sim measures its own wall time with steady_clock, not with this.)
+extern "C" int gettimeofday(struct timeval* tv, void* tz) __THROW {
+  (void)tz;
+  tv->tv_sec = (time_t)(s_now / 1000000);
+  tv->tv_usec = (suseconds_t)(s_now % 1000000);
+  return 0;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) { if (pin < NUM_PINS) s_mode[pin] = mode; }
+
+void digitalWrite(uint8_t pin, uint8_t val) { if (pin < NUM_PINS) setOut(pin, val); }
+
+// GPIO 0..31 output set / clear, one register write for several pins
+void simRegWrite(uint32_t reg, uint32_t val) {
+  if (reg != GPIO_OUT_W1TS_REG && reg != GPIO_OUT_W1TC_REG) return;
+  const uint8_t level = (reg == GPIO_OUT_W1TS_REG) ? 1 : 0;
+  for (int pin = 0; pin < 32 && pin < NUM_PINS; pin++) {
+    if (val & (1u << pin)) setOut(pin, level);
+  }
+}
+
+uint32_t simRegRead(uint32_t reg) {
+  if (reg != GPIO_OUT_REG && reg != GPIO_IN_REG) return 0;
+  uint32_t v = 0;
+  for (int pin = 0; pin < 32 && pin < NUM_PINS; pin++) {
+    const int level = (reg == GPIO_OUT_REG) ? s_out[pin] : digitalRead((uint8_t)pin);
+    if (level) v |= 1u << pin;
+  }
+  return v;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= NUM_PINS) return 0;
+  if (s_mode[pin] == OUTPUT) return s_out[pin];
+  if (s_seen[pin] >= 0) return s_seen[pin];
+  return inputLevel(pin);
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin) { return (uint32_t)s_model.adcMv(pin, rnd()); }
+void analogReadResolution(uint8_t) {}
+void analogSetPinAttenuation(uint8_t, adc_attenuation_t) {}
+
+// Only the TRACKED inputs ever fire (between loop() passes, at the edge time)
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode) { if (pin < NUM_PINS) s_isr[pin] = { fn, mode }; }
+void detachInterrupt(uint8_t pin) { if (pin < NUM_PINS) s_isr[pin] = { nullptr, 0 }; }
+
+size_t Print::printf(const char* fmt, ...) {
+  char buf[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* b, size_t n) {
+  HeapQuiet q;
+  if (s_usbStall) return 0;
+  if (s_usb) fwrite(b, 1, n, s_usb);
+  return n;
+}
+
+int HardwareSerial::availableForWrite() { return s_usbStall ? 0 : 256; }
+
+// ---- esp_timer ----
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+  Timer* t = new Timer{ args->callback, args->arg, 0, 0, false, true };
+  s_timers.push_back(t);
+  *out = (esp_timer_handle_t)t;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t h, uint64_t period) {
+  Timer* t = (Timer*)h;
+  if (!t || !t->alive || period == 0) return ESP_FAIL;
+  t->period = period;
+  t->due = s_now + period;
+  t->armed = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t h, uint64_t timeout) {
+  Timer* t = (Timer*)h;
+  if (!t || !t->alive) return ESP_FAIL;
+  t->period = 0;
+  t->due = s_now + timeout;
+  t->armed = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t h) {
+  Timer* t = (Timer*)h;
+  if (!t) return ESP_FAIL;
+  t->armed = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t h) {
+  Timer* t = (Timer*)h;
+  if (!t) return ESP_FAIL;
+  t->armed = false;
+  t->alive = false;   // kept in the list so a stale handle fails cleanly
+  return ESP_OK;
+}
+
+int64_t esp_timer_get_time() { return (int64_t)(s_now - s_boot); }
+
+esp_reset_reason_t esp_reset_reason() { return (esp_reset_reason_t)s_resetReason; }
+
+// ---- sleep ----
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return (esp_sleep_wakeup_cause_t)s_wakeCause; }
+
+uint64_t esp_sleep_get_ext1_wakeup_status() {
+  return s_wakeCause == ESP_SLEEP_WAKEUP_EXT1 ? s_ext1Mask : 0;
+}
+
+int esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) { s_ext0Pin = pin; s_ext0Level = level; return 0; }
+
+int esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+  s_ext1Mask = mask;
+  s_ext1Mode = mode;
+  return 0;
+}
+
+void esp_deep_sleep_start() {
+  HeapQuiet q;   // the exception object is the sim's
+  throw DeepSleep();
+}
+
+void esp_restart() {
+  HeapQuiet q;
+  throw SoftReset();
+}
+
+void gpio_deep_sleep_hold_en() {}
+void gpio_deep_sleep_hold_dis() {}
+bool rtc_gpio_is_valid_gpio(gpio_num_t pin) { return pin >= 0 && pin < NUM_PINS; }
+int  rtc_gpio_init(gpio_num_t) { return 0; }
+int  rtc_gpio_deinit(gpio_num_t) { return 0; }
+int  rtc_gpio_set_direction(gpio_num_t pin, rtc_gpio_mode_t) { s_mode[pin] = OUTPUT; return 0; }
+int  rtc_gpio_set_level(gpio_num_t pin, uint32_t level) { setOut(pin, level); return 0; }
+int  rtc_gpio_hold_en(gpio_num_t) { return 0; }
+int  rtc_gpio_hold_dis(gpio_num_t) { return 0; }
+int  rtc_gpio_pullup_en(gpio_num_t) { return 0; }
+int  rtc_gpio_pullup_dis(gpio_num_t) { return 0; }
+int  rtc_gpio_pulldown_en(gpio_num_t) { return 0; }
+int  rtc_gpio_pulldown_dis(gpio_num_t) { return 0; }
+
+// ---- FreeRTOS ----
+// A warm restart runs setup() again; the thread started on the first boot
+// is still running the same code on the same statics, so hand it back.
+static std::vector<SimTask*> s_tasks;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* arg,
+                                   UBaseType_t, TaskHandle_t* out, BaseType_t) {
+  for (SimTask* t : s_tasks) {
+    if (t->name == name) { if (out) *out = t; return pdPASS; }
+  }
+  SimTask* t = new SimTask(name, stack);
+  s_tasks.push_back(t);
+  if (out) *out = t;
+  std::thread([t, fn, arg]() { t_self = t; fn(arg); }).detach();
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  SimTask* t = t_self ? t_self : &s_mainTask;
+  std::unique_lock<std::mutex> l(t->m);
+  auto ready = [t] { return t->notify > 0; };
+  if (ticks == portMAX_DELAY) t->cv.wait(l, ready);
+  else t->cv.wait_for(l, std::chrono::milliseconds(ticks), ready);
+  const uint32_t v = t->notify;
+  if (v) t->notify = clear ? 0 : v - 1;
+  return v;
+}
+
+void xTaskNotifyGive(TaskHandle_t t) {
+  if (!t) return;
+  { std::lock_guard<std::mutex> l(t->m); t->notify++; }
+  t->cv.notify_one();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t t, BaseType_t* woken) {
+  xTaskNotifyGive(t);
+  if (woken) *woken = pdFALSE;
+}
+
+// Stacks are not measured: the whole stack counts as never used
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t t) {
+  if (!t) t = xTaskGetCurrentTaskHandle();
+  return t->stack;
+}
+TaskHandle_t xTaskGetCurrentTaskHandle() { return t_self ? t_self : &s_mainTask; }
+
+TaskHandle_t xTaskGetHandle(const char* name) {
+  if (s_mainTask.name == name) return &s_mainTask;
+  for (SimTask* t : s_tasks) {
+    if (t->name == name) return t;
+  }
+  return nullptr;
+}
+
+// ---- NVS ----
+// The map and key strings allocate: none of that is the firmware's (HeapQuiet)
+static std::mutex s_nvsMu;
+static std::map<std::string, std::vector<uint8_t>> s_nvs;
+
+bool Preferences::begin(const char* ns, bool) { snprintf(ns_, sizeof(ns_), "%s", ns); return true; }
+
+size_t Preferences::get(const char* key, void* buf, size_t len) {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_nvsMu);
+  auto it = s_nvs.find(std::string(ns_) + "/" + key);
+  if (it == s_nvs.end() || it->second.size() > len) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::put(const char* key, const void* buf, size_t len) {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_nvsMu);
+  const uint8_t* b = (const uint8_t*)buf;
+  s_nvs[std::string(ns_) + "/" + key].assign(b, b + len);
+  return len;
+}
+
+bool Preferences::isKey(const char* key) {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_nvsMu);
+  return s_nvs.count(std::string(ns_) + "/" + key) != 0;
+}
+
+bool Preferences::remove(const char* key) {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_nvsMu);
+  return s_nvs.erase(std::string(ns_) + "/" + key) != 0;
+}
+
+bool Preferences::clear() {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_nvsMu);
+  const std::string pre = std::string(ns_) + "/";
+  for (auto it = s_nvs.begin(); it != s_nvs.end();) {
+    if (it->first.compare(0, pre.size(), pre) == 0) it = s_nvs.erase(it);
+    else ++it;
+  }
+  return true;
+}
+
+#define SIM_PREF_SCALAR(Name, T)                                              \
+  T Preferences::get##Name(const char* key, T def) {                          \
+    T v; return get(key, &v, sizeof(v)) == sizeof(v) ? v : def;               \
+  }                                                                           \
+  size_t Preferences::put##Name(const char* key, T v) { return put(key, &v, sizeof(v)); }
+
+SIM_PREF_SCALAR(Float, float)
+SIM_PREF_SCALAR(Double, double)
+SIM_PREF_SCALAR(UInt, uint32_t)
+SIM_PREF_SCALAR(Int, int32_t)
+SIM_PREF_SCALAR(ULong64, uint64_t)
+SIM_PREF_SCALAR(Bool, bool)
+#undef SIM_PREF_SCALAR
+
+size_t Preferences::getBytesLength(const char* key) {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_nvsMu);
+  auto it = s_nvs.find(std::string(ns_) + "/" + key);
+  return it == s_nvs.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t len) { return get(key, buf, len); }
+size_t Preferences::putBytes(const char* key, const void* buf, size_t len) { return put(key, buf, len); }
+
+// ---- flash partitions (NOR semantics: write can only clear bits) ----
+struct SimPartition {
+  esp_partition_t info;
+  std::vector<uint8_t> mem;
+};
+static SimPartition* s_tlmlog = nullptr;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t sub, const char* label) {
+  if (type != ESP_PARTITION_TYPE_DATA || sub != 0x40 || (label && strcmp(label, "tlmlog"))) return nullptr;
+  if (!s_tlmlog) {
+    s_tlmlog = new SimPartition();
+    s_tlmlog->info = { ESP_PARTITION_TYPE_DATA, 0x40, 0x310000, 0xE0000, "tlmlog" };
+    s_tlmlog->mem.assign(s_tlmlog->info.size, 0xFF);
+  }
+  return &s_tlmlog->info;
+}
+
+// ota_0 / ota_1; the image memory comes on first use
+static SimPartition s_app[2] = {
+  { { ESP_PARTITION_TYPE_APP, 0x10, 0x10000,  0x180000, "app0" }, {} },
+  { { ESP_PARTITION_TYPE_APP, 0x11, 0x190000, 0x180000, "app1" }, {} },
+};
+
+static SimPartition* part(const esp_partition_t* p) {
+  if (s_tlmlog && p == &s_tlmlog->info) return s_tlmlog;
+  for (SimPartition& a : s_app) {
+    if (p != &a.info) continue;
+    if (a.mem.empty()) { HeapQuiet q; a.mem.assign(a.info.size, 0xFF); }
+    return &a;
+  }
+  return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* p, size_t off, void* dst, size_t len) {
+  SimPartition* sp = part(p);
+  if (!sp || off + len > sp->mem.size()) return ESP_FAIL;
+  memcpy(dst, sp->mem.data() + off, len);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* p, size_t off, const void* src, size_t len) {
+  SimPartition* sp = part(p);
+  if (!sp || off + len > sp->mem.size()) return ESP_FAIL;
+  const uint8_t* b = (const uint8_t*)src;
+  for (size_t i = 0; i < len; i++) sp->mem[off + i] &= b[i];
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* p, size_t off, size_t len) {
+  SimPartition* sp = part(p);
+  if (!sp || off % 4096 || len % 4096 || off + len > sp->mem.size()) return ESP_FAIL;
+  memset(sp->mem.data() + off, 0xFF, len);
+  return ESP_OK;
+}
+
+// ---- OTA slots (otadata) ----
+static int s_running = 0;                    // app slot running
+static int s_bootSel = 0;                    // app slot the next boot picks
+static esp_ota_img_states_t s_imgState[2] = { ESP_OTA_IMG_UNDEFINED, ESP_OTA_IMG_UNDEFINED };
+
+static int appSlot(const esp_partition_t* p) {
+  for (int i = 0; i < 2; i++) if (p == &s_app[i].info) return i;
+  return -1;
+}
+
+// The bootloader's pick, with rollback enabled
+static void otaBoot() {
+  if (s_imgState[s_bootSel] == ESP_OTA_IMG_PENDING_VERIFY) {
+    // booted once and never confirmed
+    s_imgState[s_bootSel] = ESP_OTA_IMG_ABORTED;
+    s_bootSel ^= 1;
+  } else if (s_imgState[s_bootSel] == ESP_OTA_IMG_NEW) {
+    s_imgState[s_bootSel] = ESP_OTA_IMG_PENDING_VERIFY;
+  }
+  s_running = s_bootSel;
+}
+
+const esp_partition_t* esp_ota_get_running_partition() { return &s_app[s_running].info; }
+const esp_partition_t* esp_ota_get_boot_partition() { return &s_app[s_bootSel].info; }
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+  const int i = appSlot(start_from ? start_from : esp_ota_get_running_partition());
+  return i < 0 ? nullptr : &s_app[i ^ 1].info;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* p) {
+  const int i = appSlot(p);
+  if (i < 0) return ESP_ERR_NOT_FOUND;
+  if (i != s_running) {
+    // the running image was never written here: it is this program
+    uint8_t magic = 0;
+    if (esp_partition_read(p, 0, &magic, 1) != ESP_OK || magic != 0xE9) return ESP_ERR_OTA_VALIDATE_FAILED;
+    s_imgState[i] = ESP_OTA_IMG_NEW;
+  }
+  s_bootSel = i;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* p, esp_ota_img_states_t* state) {
+  const int i = appSlot(p);
+  if (i < 0 || !state) return ESP_ERR_NOT_FOUND;
+  *state = s_imgState[i];
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+  s_imgState[s_running] = ESP_OTA_IMG_VALID;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot() {
+  s_imgState[s_running] = ESP_OTA_IMG_INVALID;
+  s_bootSel = s_running ^ 1;
+  esp_restart();
+}
+
+// ---- BluetoothSerial ----
+bool BluetoothSerial::begin(const char*, bool) { return true; }
+
+bool BluetoothSerial::hasClient() {
+  std::lock_guard<std::mutex> l(s_btMu);
+  return s_btConnected;
+}
+
+int BluetoothSerial::available() {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_btMu);
+  ptyPoll();
+  return (int)s_btRx.size();
+}
+
+int BluetoothSerial::read() {
+  HeapQuiet q;
+  std::lock_guard<std::mutex> l(s_btMu);
+  ptyPoll();
+  if (s_btRx.empty()) return -1;
+  const int c = (uint8_t)s_btRx.front();
+  s_btRx.pop_front();
+  return c;
+}
+
+size_t BluetoothSerial::write(const uint8_t* b, size_t n) {
+  HeapQuiet q;
+  std::unique_lock<std::mutex> l(s_btMu);
+  s_btOut += n;
+  s_btWrites++;
+  if (!t_self) s_btLoopWrites++;
+  if (s_btTap) s_btTap(b, n);
+  if (s_ptyFd >= 0) {
+    size_t off = 0;
+    while (off < n) {
+      ssize_t k = ::write(s_ptyFd, b + off, n - off);
+      if (k <= 0) break;   // nobody reading: drop like a congested link
+      off += (size_t)k;
+    }
+  } else if (s_btLog) {
+    fwrite(b, 1, n, s_btLog);
+  }
+  if (s_btRate) {
+    // the client takes the bytes as sim time passes, unless it goes away
+    // or the limit is lifted (the loop thread keeps the clock running)
+    s_btFreeUs = std::max(s_btFreeUs, s_now) + (uint64_t)n * 1000000 / s_btRate;
+    s_btBusyUs = s_btFreeUs;
+    s_btCv.wait(l, [] { return s_now >= s_btBusyUs || !s_btConnected || !s_btRate; });
+    s_btBusyUs = 0;
+    s_btCv.notify_all();
+  }
+  return n;
+}
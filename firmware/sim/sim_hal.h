@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "sim_model.h"
+
+// ------------------------------------------------------------
+// Simulator core: virtual clock, timers, pins, deep sleep, BT client.
+// Everything the shims (Arduino.h, esp_timer.h, ...) call ends up here.
+// ------------------------------------------------------------
+namespace Sim {
+
+// Thrown by esp_deep_sleep_start(); the driver sleeps the model and boots again
+struct DeepSleep {};
+// Thrown by esp_restart(); the driver restarts with ESP_RST_SW
+struct SoftReset {};
+
+Model& model();
+
+uint64_t nowUs();        // since sim start; survives sleep (RTC)
+uint64_t bootUs();       // nowUs() at the last boot
+
+// Advance virtual time: fires due timers, steps the model
+void advance(uint64_t us);
+
+// Power-on state (clock 0, pins floating, no timers, empty NVS/flash)
+void reset(uint32_t seed);
+
+// After deep sleep: drops timers and pin modes, restarts esp_timer at 0,
+// keeps RTC time, NVS, flash and the model. Picks the app slot to run
+// (esp_ota_ops.h).
+void reboot(int wakeCause);
+
+// Reset without sleep (esp_reset_reason_t): like reboot(), and for
+// ESP_RST_POWERON the RTC_NOINIT variables come up as garbage
+void restart(int reason);
+
+// Deep sleep: esp_timer stops, the model draws sleep current
+void enterSleep();
+bool asleep();
+
+// Configured wake sources vs the current inputs; 0 = stay asleep
+int  wakeCause();
+
+// BT client
+void btConnect(bool on);
+void btSend(const char* line);          // host -> device
+bool btOpenPty(char* path, size_t cap); // real client on a pseudo terminal
+void btSetLog(FILE* f);                 // device -> host bytes (scripted mode)
+uint64_t btBytesOut();
+uint32_t btWrites();                    // SerialBT.write() calls: frames on the link
+uint32_t btLoopWrites();                //   made on the loop task (must stay 0)
+// A slow client: the link takes bytesPerS in sim time (0 = no limit).
+// SerialBT.write() returns once the client has taken the bytes, so
+// BtMgr's TX task blocks as it would on a congested SPP link.
+void btSetRate(uint32_t bytesPerS);
+uint32_t btRate();
+// Every SerialBT.write() of BtMgr's TX task (one queued line or frame),
+// on that thread
+void btSetTap(void (*fn)(const uint8_t* b, size_t n));
+// True once BtMgr's TX task has written all it queued. While connected,
+// the clock does not run on until it has, or until the task is blocked
+// in a rate-limited write: what the link takes then depends on sim time
+// only, not on how the host schedules the thread.
+void btSetIdle(bool (*fn)());
+
+void usbEcho(FILE* f);                  // Serial output, nullptr = drop
+void usbStall(bool on);                 // no host reading: Serial takes nothing
+
+// Relay / DC-DC switching seen on the pins since reset()
+struct BbmStats {
+  uint32_t overlaps;      // one switched on while the other was on
+  uint32_t changeovers;   // one switched on < 1 s after the other went off
+  uint64_t deadMinUs;     // shortest off -> on gap of a changeover (UINT64_MAX: none)
+};
+BbmStats bbmStats();
+
+// Heap guard (sim_heap.cpp, -DHEAP_GUARD=1): every malloc in the process
+// goes to MemMgr::noteAlloc(), which counts the ones firmware tasks make
+// once MemMgr is armed. The driver and the shims put their own
+// allocations in a HeapQuiet scope so that only the firmware's count.
+struct HeapQuiet {
+  HeapQuiet();
+  ~HeapQuiet();
+};
+bool heapQuiet();                       // this thread is in a HeapQuiet scope
+// Backtrace of the first counted allocation to f (nullptr = off)
+void heapTraceFirst(FILE* f);
+
+// Contact bounce on the charger status inputs: each change of level comes
+// as a burst of edges over about us (0 = clean edges)
+void setBounce(uint64_t us);
+uint32_t inputEdges();      // edges on those inputs since reset()
+
+// I2C bus (sim_i2c.cpp): the board profile's INA219 / INA226 as register
+// devices fed by the model. While failed, every device NAKs.
+void i2cFail(bool on);
+uint32_t i2cXfers();        // transfers since the start
+
+} // namespace Sim
@@ -0,0 +1,68 @@
+// ------------------------------------------------------------
+// Heap guard for the sim: malloc / calloc / realloc interposed over
+// glibc's, so new, std::string and the firmware's own calls all pass
+// through here. The ESP32 build gets the same hook from -Wl,--wrap (see
+// mem_mgr.h); --wrap would miss the calls made inside libstdc++ here.
+// ------------------------------------------------------------
+#include "sim_hal.h"
+#include "mem_mgr.h"
+
+#include <execinfo.h>
+#include <stddef.h>
+#include <unistd.h>
+
+namespace Sim {
+
+static FILE* s_traceFile = nullptr;
+static bool  s_traced = false;
+
+void heapTraceFirst(FILE* f) {
+  // backtrace() loads libgcc on its first call, which allocates: do that now
+  void* pc[1];
+  { HeapQuiet q; backtrace(pc, 1); }
+  s_traceFile = f;
+  s_traced = false;
+}
+
+} // namespace Sim
+
+#if HEAP_GUARD
+
+extern "C" {
+void* __libc_malloc(size_t n);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t n);
+
+static void note(size_t n, const void* pc) {
+  using namespace Sim;
+  if (!MemMgr::armed() || heapQuiet()) return;
+  const uint32_t before = MemMgr::stats().allocs[0];
+  MemMgr::noteAlloc(n, pc);
+  if (s_traceFile && !s_traced && MemMgr::stats().allocs[0] != before) {
+    s_traced = true;
+    HeapQuiet q;
+    void* frames[24];
+    const int k = backtrace(frames, 24);
+    fprintf(s_traceFile, "heap: first allocation after setup(), %zu bytes:\n", n);
+    fflush(s_traceFile);
+    backtrace_symbols_fd(frames, k, fileno(s_traceFile));
+  }
+}
+
+void* malloc(size_t n) {
+  note(n, __builtin_return_address(0));
+  return __libc_malloc(n);
+}
+
+void* calloc(size_t n, size_t size) {
+  note(n * size, __builtin_return_address(0));
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t n) {
+  if (n) note(n, __builtin_return_address(0));
+  return __libc_realloc(p, n);
+}
+} // extern "C"
+
+#endif // HEAP_GUARD
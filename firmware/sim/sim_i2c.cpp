@@ -0,0 +1,157 @@
+#include "i2c_bus.h"
+#include "sim_hal.h"
+#include "profile.h"
+#include <math.h>
+#include <string.h>
+
+// ------------------------------------------------------------
+// The sim's I2cBus: the board profile's shunt monitors as INA219 /
+// INA226 register files on a bus with a transfer time. A transfer
+// completes once the virtual clock has passed its bit time; poll()
+// carries it out against the device then, so the firmware sees the
+// model as it is at the end of the transfer.
+// ------------------------------------------------------------
+namespace Sim {
+
+using namespace InaMon;
+
+static bool     s_fail = false;
+static uint32_t s_xfers = 0;
+
+void i2cFail(bool on) { s_fail = on; }
+uint32_t i2cXfers() { return s_xfers; }
+
+class InaDev {
+public:
+  // cell: in the cell lead, charge positive; else the load lead. Both
+  // have IN- on the cell side, so the bus voltage is vbat.
+  InaDev(const Profile::Ina& fit, bool cell) : fit_(fit), cell_(cell) { reset(); }
+
+  bool fitted() const { return fit_.chip != NONE; }
+  uint8_t addr() const { return fit_.addr; }
+
+  void write(const uint8_t* w, uint8_t n) {
+    if (n >= 1) ptr_ = w[0];
+    if (n < 3) return;
+    const uint16_t v = (uint16_t)((w[1] << 8) | w[2]);
+    if (ptr_ == REG_CONFIG) {
+      if (v & CONFIG_RESET) reset();
+      else config_ = v;
+    } else if (ptr_ == REG_CALIB) {
+      calib_ = v;
+    }
+  }
+
+  uint16_t read() {
+    const bool ina226 = fit_.chip == INA226;
+    switch (ptr_) {
+      case REG_CONFIG: return config_;
+      case REG_SHUNT:  return (uint16_t)shuntRaw();
+      case REG_BUS: {
+        const float v = model().vbat();
+        if (ina226) return (uint16_t)lroundf(v / INA226_BUS_LSB_V + noise());
+        // bits 15..3, CNVR set
+        return (uint16_t)((lroundf(v / INA219_BUS_LSB_V + noise()) << 3) | 0x2);
+      }
+      case REG_CALIB:  return calib_;
+      case REG_MFG_ID: return ina226 ? INA226_MFG_ID : 0;
+      case REG_DIE_ID: return ina226 ? INA226_DIE_ID : 0;
+      default:         return 0;
+    }
+  }
+
+private:
+  void reset() {
+    config_ = fit_.chip == INA226 ? INA226_CONFIG_POR : INA219_CONFIG_POR;
+    calib_ = 0;
+  }
+
+  // about one LSB of noise, deterministic
+  float noise() {
+    rnd_ ^= rnd_ << 13; rnd_ ^= rnd_ >> 17; rnd_ ^= rnd_ << 5;
+    return ((rnd_ & 0xFFFF) / 65535.0f - 0.5f) * 2.0f;
+  }
+
+  int16_t shuntRaw() {
+    const float a = cell_ ? model().ichg() - model().idsg() : model().iload();
+    int32_t fs = 32767;
+    if (fit_.chip == INA219) fs = 4000 << ((config_ >> 11) & 0x3);
+    int32_t raw = lroundf(a * fit_.shuntOhm / shuntLsbV(fit_.chip) + noise());
+    if (raw > fs) raw = fs;
+    if (raw < -fs) raw = -fs;
+    return (int16_t)raw;
+  }
+
+  Profile::Ina fit_;
+  bool     cell_;
+  uint8_t  ptr_ = 0;
+  uint16_t config_ = 0;
+  uint16_t calib_ = 0;
+  uint32_t rnd_ = 0x2545F491;
+};
+
+static InaDev s_devs[] = {
+  InaDev(Profile::BOARD.inaBatt, true),
+  InaDev(Profile::BOARD.inaLoad, false),
+};
+
+class SimI2c : public I2cIf {
+public:
+  bool start(uint8_t addr, const uint8_t* w, uint8_t wlen, uint8_t* r, uint8_t rlen) override {
+    if (status_ == Status::Busy || wlen > sizeof(w_)) return false;
+    addr_ = addr;
+    memcpy(w_, w, wlen);
+    wlen_ = wlen;
+    r_ = r;
+    rlen_ = rlen;
+    // start, address + data bytes with ACK, repeated start, stop
+    const uint32_t bits = 9 * (1 + wlen) + (rlen ? 9 * (1 + rlen) + 1 : 0) + 2;
+    doneUs_ = nowUs() + (bits * 1000000ull + hz_ - 1) / hz_;
+    status_ = Status::Busy;
+    s_xfers++;
+    return true;
+  }
+
+  Status poll() override {
+    if (status_ != Status::Busy || nowUs() < doneUs_) return status_;
+    InaDev* d = nullptr;
+    for (InaDev& x : s_devs) if (x.fitted() && x.addr() == addr_) d = &x;
+    if (!d || s_fail) return status_ = Status::Nak;
+    d->write(w_, wlen_);
+    if (rlen_) {
+      const uint16_t v = d->read();
+      r_[0] = (uint8_t)(v >> 8);
+      if (rlen_ > 1) r_[1] = (uint8_t)v;
+    }
+    return status_ = Status::Done;
+  }
+
+  // a boot starts with an idle bus, whatever was in flight before
+  void reset(uint32_t hz) { hz_ = hz; status_ = Status::Idle; }
+
+private:
+  uint32_t hz_ = I2cBus::DEFAULT_HZ;
+  Status   status_ = Status::Idle;
+  uint64_t doneUs_ = 0;
+  uint8_t  addr_ = 0;
+  uint8_t  w_[4];
+  uint8_t  wlen_ = 0;
+  uint8_t* r_ = nullptr;
+  uint8_t  rlen_ = 0;
+};
+
+static SimI2c s_bus;
+
+} // namespace Sim
+
+namespace I2cBus {
+
+bool begin(int sda, int scl, uint32_t hz) {
+  if (sda < 0 || scl < 0 || !hz) return false;
+  Sim::s_bus.reset(hz);
+  return true;
+}
+
+InaMon::I2cIf& bus() { return Sim::s_bus; }
+
+} // namespace I2cBus
@@ -0,0 +1,907 @@
+// ------------------------------------------------------------
+// Native simulator driver.
+//
+// Runs the real setup()/loop() against the shims in this directory on a
+// virtual clock: after every loop() pass time jumps by --loop-us and the
+// esp_timer callbacks that fell due in between run in order. Each
+// scenario runs in its own forked process (statics start clean, -j runs
+// several at once). See README.md.
+// ------------------------------------------------------------
+#include "sim_hal.h"
+#include "sim_scenario.h"
+#include "sim_sink.h"
+#include "soc_mgr.h"
+#include "load_prot.h"
+#include "charge_mgr.h"
+#include "thermal_mgr.h"
+#include "energy_mgr.h"
+#include "rtc_state.h"
+#include "prof_mgr.h"
+#include "mem_mgr.h"
+#include "ina_src.h"
+#include "adc_mgr.h"
+#include "time_mgr.h"
+#include "event_mgr.h"
+#include "bt_mgr.h"
+#include "stream_mgr.h"
+#include "tlm_bus.h"
+#include "tlm_sub.h"
+#include "json_tok.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <map>
+#include <math.h>
+#include <string.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void setup();
+void loop();
+extern ADCMgr adc;
+
+namespace {
+
+struct Options {
+  uint64_t    loopUs = 1000;    // virtual time per loop() pass (ADC tick is 2 ms)
+  uint32_t    seed = 1;
+  const char* trace = nullptr;  // CSV per sim-second, "%s" = scenario name
+  bool        usb = false;
+  bool        pty = false;
+  const char* sink = nullptr;   // TlmBus sink on a Unix socket ("%s" = scenario) or "pty"
+  bool        sinkBin = false;
+  bool        prof = false;     // print the ProfMgr zones after each scenario
+  double      speed = 0;        // 0 = as fast as possible, 1 = real time
+  int         jobs = 1;
+};
+
+// The raw ADC stream (StreamMgr) at the BT client. Within a boot the frame
+// seq counts every batch, sent or dropped, and each batch's first_idx
+// carries on where the last one ended (rawNextIdx()).
+struct RawRx {
+  uint32_t boot = UINT32_MAX;
+  uint16_t seq = 0;
+  TlmProto::RawHdrV1 last = {};
+  uint32_t packets = 0, lostPackets = 0;
+  uint64_t samples = 0, lostSamples = 0;
+  uint32_t idxGaps = 0;                  // first_idx skipped ahead without a seq gap
+  uint32_t idxBack = 0;                  //   or went back
+  uint8_t  maxDecim = 0;
+};
+
+// A TlmBus sink the sim reads (scenario verb "sink"). Every frame TlmBus
+// handed it has to arrive whole: a JSON line that parses as one object,
+// or a binary frame with a good CRC.
+struct SinkRx {
+  char     name[12] = "";
+  bool     bin = false;
+  uint32_t sent = 0, dropped = 0;        // TlmBus: taken by the sink / refused (queue full)
+  Sim::SinkStats out = {};               // written to the socket
+  uint32_t frames = 0, bad = 0;          // at the reader
+  uint64_t bytes = 0;
+};
+
+struct Result {
+  double   simH = 0, wallS = 0;
+  double   socErrEnd = 0, socErrMax = 0;
+  float    vbatMin = 99.0f;
+  uint32_t trips = 0, sleeps = 0, loops = 0;
+  uint32_t chgFlips = 0, chgEdges = 0;   // ChargeMgr::isCharging() changes, input edges
+  uint32_t thTrips = 0;                  // ThermalMgr flags set
+  double   thNoChgS = 0, thNoDsgS = 0;   // time ThermalMgr blocked charging / the load
+  float    tempMax = -99.0f;             // model cell temperature
+  EnergyMgr::Totals enFw, enTrue;        // firmware lifetime vs model
+  float    effFw = NAN, effTrue = 0;     // at the end
+  float    effErrMax = 0;                // |fw - model| once the load has been steady EFF_STEADY_US
+  SocMgr::IrInfo ir = {};                // at the end
+  float    rTrue = 0;
+  double   emptyAt = NAN;                // model SOC % when SocMgr first said 0
+  uint64_t btOut = 0;
+  Sim::BbmStats bbm = {};
+  uint32_t resets = 0;                   // scripted resets
+  uint32_t rtcBoots = 0;                 // boots RtcState restored from RTC memory
+  uint64_t staleMax = 0;                 //   the oldest block among them, ms
+  uint32_t restoreMaxUs = 0;
+  uint32_t boCommits = 0;                // at the end, since the last power-on
+  uint32_t heapAllocs = 0;               // loop task allocations after setup() (HEAP_GUARD)
+  uint32_t heapMaxPass = 0;              //   the most in one loop() pass + its timer callbacks
+  bool     inaFitted = false;            // InaSrc, summed over the fitted monitors
+  InaMon::Stats ina = {};
+  uint64_t awakeUs = 0;                  // loop() passes
+  uint64_t adcRateUs[ADCMgr::RATE_COUNT] = {};
+  uint64_t adcReads = 0, adcBusyUs = 0;  // ADCMgr, summed over the boots
+  uint32_t adcBursts = 0;
+  uint32_t steps = 0, stepsUnseen = 0;   // model current steps; not seen before the next one
+  double   stepLatSumMs = 0, stepLatMaxMs = 0;
+  uint32_t evtPushed[TlmProto::EVT_TYPE_COUNT] = {};   // EventMgr, summed over the boots
+  uint32_t evtBtSent = 0, evtLost = 0;
+  uint32_t evtRx = 0;                    // the BT client got them
+  uint32_t evtMissing = 0;               //   fewer than EventMgr handed to BT, per boot
+  uint32_t evtOrderErr = 0;              //   seq not rising, or a type's time going back
+  uint32_t evtTrips = 0, evtChg = 0;     // truth for the trip / charge events (loop() passes)
+  bool     evtFail = false;
+  BtMgr::TxStats tx = {};                // BtMgr at the end, once the TX task is idle
+  uint32_t linkFrames = 0;               // SerialBT.write() calls the client saw
+  uint64_t linkBytes = 0;
+  uint32_t loopWrites = 0;               //   made on the loop task
+  uint32_t acks = 0, acksWant = 0;       // command replies at the client / scripted commands
+  uint32_t ackMax = 0, ackFull = 0;      //   longest one, ones that were ERR_REPLY_FULL
+  bool     txFail = false;
+  uint64_t streamUs = 0;                 // loop() passes with StreamMgr on
+  uint32_t streamSent = 0, streamDropped = 0;   // StreamMgr's batches
+  RawRx    raw;                          // at the client
+  bool     streamFail = false;
+  SinkRx   sinks[Sim::MAX_SINKS];
+  size_t   sinkCount = 0;
+  uint32_t usbSent = 0, usbDropped = 0, usbStalls = 0;
+  bool     sinkFail = false;
+  TlmSub::Stats sub = {};                // BT's last subscription, at the end
+  uint32_t subRx = 0;                    // subscription frames at the BT client
+  uint64_t subRxBytes = 0;
+  uint64_t fullBytes = 0;                // the first JSON sink's, the full stream
+  bool     subFail = false;
+};
+
+// A model load or charge current step: STEP_A within one pass. It counts
+// as seen once the newest ADC frame has moved STEP_SEEN of the way.
+struct StepWatch {
+  float    last;
+  bool     pending;
+  uint64_t atUs;      // firmware clock
+  float    fwFrom;    // newest frame's current at the step
+  float    delta;
+};
+
+static const uint64_t SLEEP_STEP_US = 100000;   // model step while asleep
+static const uint64_t TRACE_US = 1000000;
+static const uint64_t EFF_STEADY_US = 60000000;
+static const float    STEP_A = 0.1f;
+static const float    STEP_SEEN = 0.9f;
+
+// The event channel as the BT client sees it (EventMgr). The tap runs on
+// BtMgr's TX thread; each write is one JSON line or one binary frame.
+// Events are filed under the sim's boot count: the firmware's boot number
+// starts over at a power-on.
+struct EvtRx {
+  uint32_t boot, seq;
+  uint64_t tUs;
+  uint8_t  type;
+};
+
+static std::mutex            s_evtMu;
+static std::vector<EvtRx>    s_evtRx;
+static std::atomic<uint32_t> s_evtBoot{0};
+static std::atomic<uint32_t> s_acks{0};      // {"ver":1,"ack":..} lines at the client
+static std::atomic<uint32_t> s_ackMax{0};
+static std::atomic<uint32_t> s_ackFull{0};
+static std::atomic<uint32_t> s_subRx{0};     // TlmSub frames at the client
+static std::atomic<uint64_t> s_subRxBytes{0};
+static uint32_t              s_acksWant = 0; // command lines sent while connected
+static bool                  s_linkUp = false;
+static std::mutex            s_rawMu;
+static RawRx                 s_raw;
+
+static void onRawBatch(const TlmProto::Decoder& dec) {
+  TlmProto::RawHdrV1 h;
+  if (dec.payloadLen() < sizeof(h)) return;
+  memcpy(&h, dec.payload(), sizeof(h));
+  std::lock_guard<std::mutex> l(s_rawMu);
+  RawRx& x = s_raw;
+  if (x.boot == s_evtBoot) {
+    const uint16_t gap = (uint16_t)(dec.seq() - x.seq - 1);
+    x.lostPackets += gap;
+    const int32_t d = (int32_t)(h.first_idx - TlmProto::rawNextIdx(x.last, h.decim));
+    if (d > 0) x.lostSamples += (uint32_t)d / h.decim;
+    if (d > 0 && !gap) x.idxGaps++;
+    if (d < 0) x.idxBack++;
+  }
+  x.boot = s_evtBoot;
+  x.seq = dec.seq();
+  x.last = h;
+  x.packets++;
+  x.samples += h.count;
+  x.maxDecim = std::max(x.maxDecim, h.decim);
+}
+
+static void onBtTx(const uint8_t* b, size_t n) {
+  static const char ACK[] = "{\"ver\":1,\"ack\":";
+  if (n >= sizeof(ACK) - 1 && !memcmp(b, ACK, sizeof(ACK) - 1)) {
+    static const char FULL[] = "\"msg\":\"reply_full\"";
+    s_acks++;
+    if (n > s_ackMax) s_ackMax = (uint32_t)n;   // TX thread only
+    if (std::search(b, b + n, FULL, FULL + sizeof(FULL) - 1) != b + n) s_ackFull++;
+    return;
+  }
+  EvtRx e = {};
+  if (n && b[n - 1] == 0) {
+    TlmProto::Decoder dec;
+    bool got = false;
+    for (size_t i = 0; i < n && !got; i++) got = dec.push(b[i]);
+    if (got && dec.schema() == TlmProto::SCHEMA_RAW_V1) { onRawBatch(dec); return; }
+    if (got && dec.schema() == TlmProto::SCHEMA_DELTA_V1) { s_subRx++; s_subRxBytes += n; return; }
+    if (!got || dec.schema() != TlmProto::SCHEMA_EVENT_V1 || dec.payloadLen() != sizeof(TlmProto::EventV1))
+      return;
+    TlmProto::EventV1 r;
+    memcpy(&r, dec.payload(), sizeof(r));
+    e = { s_evtBoot, r.seq, r.t_us, r.type };
+  } else {
+    static const char SUB[] = ",\"key\":";   // {"ver":1,"ms":..,"key":..
+    const uint8_t* head = b + std::min(n, (size_t)40);
+    if (std::search(b, head, SUB, SUB + sizeof(SUB) - 1) != head) {
+      s_subRx++;
+      s_subRxBytes += n;
+      return;
+    }
+    const std::string line((const char*)b, n);
+    const size_t at = line.find("{\"ver\":1,\"evt\":{\"type\":\"");
+    if (at == std::string::npos) return;
+    char type[16];
+    unsigned long seq;
+    unsigned long long t;
+    if (sscanf(line.c_str() + at, "{\"ver\":1,\"evt\":{\"type\":\"%15[^\"]\",\"seq\":%lu,\"boot\":%*u,\"t_us\":%llu",
+               type, &seq, &t) != 3)
+      return;
+    e = { s_evtBoot, (uint32_t)seq, t, TlmProto::EVT_TYPE_COUNT };
+    for (uint8_t i = 0; i < TlmProto::EVT_TYPE_COUNT; i++)
+      if (!strcmp(type, TlmProto::EVENT_NAMES[i])) e.type = i;
+  }
+  std::lock_guard<std::mutex> l(s_evtMu);
+  s_evtRx.push_back(e);
+}
+
+// Sinks the sim reads: a thread each on the far end of the socketpair
+struct SinkReader {
+  TlmBus::Transport* t = nullptr;
+  int                fd = -1;
+  std::thread        th;
+  SinkRx             rx;
+};
+static SinkReader s_sinkRd[Sim::MAX_SINKS];
+static size_t     s_sinkRdCount = 0;
+static bool       s_sinkErr = false;    // a scripted sink could not be opened
+
+static void readSink(SinkReader* s) {
+  Sim::HeapQuiet q;
+  SinkRx& x = s->rx;
+  std::vector<char> line;
+  std::vector<JsonTok::Token> toks(256);
+  TlmProto::Decoder dec;
+  uint8_t buf[4096];
+  ssize_t n;
+  while ((n = ::read(s->fd, buf, sizeof(buf))) > 0) {
+    x.bytes += (uint64_t)n;
+    for (ssize_t i = 0; i < n; i++) {
+      if (x.bin) {
+        if (dec.push(buf[i])) x.frames++;
+        continue;
+      }
+      line.push_back((char)buf[i]);
+      if (buf[i] != '\n') continue;
+      const int k = JsonTok::parse(line.data(), line.size(), toks.data(), toks.size());
+      if (k > 0 && toks[0].type == JsonTok::OBJECT) x.frames++;
+      else                                          x.bad++;
+      line.clear();
+    }
+  }
+  if (x.bin) x.bad += dec.crcErrors() + dec.badFrames() + dec.overruns();
+  if (!line.empty()) x.bad++;   // a line cut off
+  ::close(s->fd);
+}
+
+static void openSink(bool bin) {
+  Sim::HeapQuiet q;
+  SinkReader* s = s_sinkRdCount < Sim::MAX_SINKS ? &s_sinkRd[s_sinkRdCount] : nullptr;
+  if (s) s->t = Sim::sinkPair(bin ? TlmBus::Fmt::Bin : TlmBus::Fmt::Json, &s->fd);
+  if (!s || !s->t || !TlmBus::add(s->t)) {
+    fprintf(stderr, "sink: no room (TlmBus takes %zu transports, BT and USB are two)\n", TlmBus::MAX_TRANSPORTS);
+    s_sinkErr = true;
+    return;
+  }
+  s->rx.bin = bin;
+  s->th = std::thread(readSink, s);
+  s_sinkRdCount++;
+}
+
+// Real time for BtMgr's TX thread to write what is queued (no virtual time
+// passes, so a rate limit is lifted meanwhile)
+static void btDrain() {
+  const uint32_t rate = Sim::btRate();
+  Sim::btSetRate(0);
+  for (int i = 0; i < 100000 && BtMgr::connected() && !BtMgr::flush(0); i++) std::this_thread::yield();
+  Sim::btSetRate(rate);
+}
+
+// Every frame BtMgr queued is sent, dropped or pending. Once a lost link
+// is flushed (the TX task looks every 20 ms) and the last write is
+// counted, that has to add up, and the client has to have seen each
+// frame sent.
+static bool txSettled(const BtMgr::TxStats& st) {
+  return st.queuedFrames == st.sentFrames + st.droppedFrames + st.pendingFrames &&
+         st.queuedBytes == st.sentBytes + st.droppedBytes + st.pendingBytes &&
+         st.sentFrames == Sim::btWrites() && st.sentBytes == Sim::btBytesOut();
+}
+
+// Nothing queued and nothing in flight (see Sim::btSetIdle)
+static bool btIdle() {
+  const BtMgr::TxStats st = BtMgr::txStats();
+  return st.pendingFrames == 0 && txSettled(st);
+}
+
+// CmdMgr answers a line that starts with '{' after blanks, and drops others
+static bool answered(const std::string& line) {
+  const size_t at = line.find_first_not_of(" \t");
+  return at != std::string::npos && line[at] == '{';
+}
+
+static Options s_opt;
+static int     s_resetReason = -1;      // scripted reset due before the next loop()
+
+static void applyEvent(const Sim::Event& e) {
+  Sim::Model& m = Sim::model();
+  switch (e.verb) {
+    case Sim::Event::LOAD:    m.setLoad(e.value, e.alt, e.dwellUs * 1e-6f); break;
+    case Sim::Event::CHARGER: m.setCharger(e.on, e.value); break;
+    case Sim::Event::BUTTON:  m.setButton(e.on); break;
+    case Sim::Event::AMBIENT: m.setAmbient(e.value, e.rate); break;
+    case Sim::Event::NTC:     m.setNtcOpen(e.on); break;
+    case Sim::Event::BOUNCE:  Sim::setBounce((uint64_t)(e.value * 1000.0f)); break;
+    case Sim::Event::I2C:     Sim::i2cFail(e.on); break;
+    case Sim::Event::BT:      if (!e.on) btDrain();   // what was sent before the disconnect
+                              Sim::btConnect(s_linkUp = e.on); break;
+    case Sim::Event::BT_LOST: Sim::btConnect(s_linkUp = false); break;
+    case Sim::Event::BT_RATE: Sim::btSetRate((uint32_t)e.value); break;
+    case Sim::Event::USB:     Sim::usbStall(e.on); break;
+    case Sim::Event::SINK:    openSink(e.on); break;
+    case Sim::Event::RESET:   s_resetReason = (int)e.value; break;
+    case Sim::Event::SEND:    if (s_linkUp && answered(e.text)) s_acksWant++;
+                              Sim::btSend(e.text.c_str()); break;
+    case Sim::Event::END:     break;
+  }
+}
+
+static Result run(const Sim::Scenario& sc) {
+  Result r;
+  Sim::reset(s_opt.seed);
+  Sim::model().reset(sc.battery);
+  Sim::usbEcho(s_opt.usb ? stdout : nullptr);
+
+  FILE* trace = nullptr;
+  if (s_opt.trace) {
+    char path[256];
+    snprintf(path, sizeof(path), s_opt.trace, sc.name.c_str());
+    trace = fopen(path, "w");
+    if (trace) fprintf(trace, "t_s,soc_true,soc_fw,vbat,ichg,idsg,iload,temp_c,charging,chg_done,asleep,tripped,"
+                              "r_true,ir_fw\n");
+  }
+
+  if (s_opt.pty) {
+    char path[64];
+    if (Sim::btOpenPty(path, sizeof(path))) fprintf(stderr, "%s: BT client on %s\n", sc.name.c_str(), path);
+  }
+
+  if (s_opt.sink) {
+    char path[108];
+    const TlmBus::Fmt fmt = s_opt.sinkBin ? TlmBus::Fmt::Bin : TlmBus::Fmt::Json;
+    TlmBus::Transport* t = nullptr;
+    if (!strcmp(s_opt.sink, "pty")) {
+      t = Sim::sinkPty(fmt, path, sizeof(path));
+    } else {
+      snprintf(path, sizeof(path), s_opt.sink, sc.name.c_str());
+      t = Sim::sinkListen(path, fmt);
+    }
+    if (t && TlmBus::add(t)) fprintf(stderr, "%s: telemetry sink on %s\n", sc.name.c_str(), path);
+    else                     fprintf(stderr, "%s: no telemetry sink on %s\n", sc.name.c_str(), path);
+  }
+
+  Sim::heapTraceFirst(stderr);
+  s_evtRx.clear();
+  s_evtBoot = 0;
+  s_acks = 0;
+  s_ackMax = 0;
+  s_ackFull = 0;
+  s_subRx = 0;
+  s_subRxBytes = 0;
+  s_acksWant = 0;
+  s_linkUp = false;
+  s_raw = RawRx();
+  Sim::btSetTap(onBtTx);
+  Sim::btSetIdle(btIdle);
+  const auto wall0 = std::chrono::steady_clock::now();
+  size_t next = 0;
+  bool booted = false;
+  bool wasTripped = false;
+  bool wasCharging = false;
+  uint8_t wasTherm = 0;
+  uint64_t nextTrace = 0;
+  float lastIload = 0;
+  uint64_t loadSinceUs = 0;
+  StepWatch steps[2] = {};
+  uint32_t adcReads0 = 0;
+  uint64_t adcBusy0 = 0;
+  uint32_t adcBursts0 = 0;
+  std::map<uint32_t, uint32_t> evtBtSent;   // boot -> events EventMgr handed to BT
+
+  auto fireEvents = [&]() {
+    Sim::HeapQuiet q;
+    while (next < sc.events.size() && sc.events[next].us <= Sim::nowUs()) applyEvent(sc.events[next++]);
+  };
+
+  auto sample = [&]() {
+    Sim::HeapQuiet q;
+    const Sim::Model& m = Sim::model();
+    if (m.vbat() < r.vbatMin) r.vbatMin = m.vbat();
+    if (m.tempC() > r.tempMax) r.tempMax = m.tempC();
+    if (!booted || Sim::nowUs() < nextTrace) return;
+    nextTrace += TRACE_US;
+    const double err = fabs(SocMgr::soc() - m.soc() * 100.0);
+    r.socErrEnd = err;
+    if (err > r.socErrMax) r.socErrMax = err;
+    if (isnan(r.emptyAt) && SocMgr::soc() <= 0.0f) r.emptyAt = m.soc() * 100.0;
+    if (fabsf(m.iload() - lastIload) > 0.001f) { lastIload = m.iload(); loadSinceUs = Sim::nowUs(); }
+    const float eff = EnergyMgr::efficiency();
+    if (!isnan(eff) && m.dcdcEff() > 0 && Sim::nowUs() - loadSinceUs >= EFF_STEADY_US &&
+        fabsf(eff - m.dcdcEff()) > r.effErrMax)
+      r.effErrMax = fabsf(eff - m.dcdcEff());
+    if (trace) {
+      fprintf(trace, "%.0f,%.2f,%.2f,%.3f,%.3f,%.3f,%.3f,%.2f,%d,%d,%d,%d,%.4f,%.4f\n",
+              Sim::nowUs() * 1e-6, m.soc() * 100.0, SocMgr::soc(), m.vbat(), m.ichg(),
+              m.idsg(), m.iload(), m.tempC(), m.pinCharging(), m.pinChgDone() == 0 ? 1 : 0,
+              Sim::asleep() ? 1 : 0, LoadProt::tripped() ? 1 : 0, m.rOhm(), SocMgr::ir().ohm);
+    }
+  };
+
+  // Step latency: model current against the newest frame, every pass
+  auto watchSteps = [&]() {
+    const Sim::Model& m = Sim::model();
+    AdcBus::Ref f;
+    const bool have = adc.bus().peek(f);
+    const uint64_t now = TimeMgr::nowUs();
+    const float truth[2] = { m.iload(), m.ichg() };
+    for (int i = 0; i < 2; i++) {
+      StepWatch& w = steps[i];
+      const float fw = have ? (i ? f->ibatt_chg_a : f->iload_a) : 0.0f;
+      if (fabsf(truth[i] - w.last) >= STEP_A) {
+        if (w.pending) r.stepsUnseen++;
+        w = { truth[i], have, now, fw, truth[i] - w.last };
+        continue;
+      }
+      w.last = truth[i];
+      if (!w.pending || f.tUs() <= w.atUs || fabsf(fw - w.fwFrom) < STEP_SEEN * fabsf(w.delta)) continue;
+      const double ms = (now - w.atUs) / 1000.0;
+      w.pending = false;
+      r.steps++;
+      r.stepLatSumMs += ms;
+      r.stepLatMaxMs = std::max(r.stepLatMaxMs, ms);
+    }
+  };
+
+  // ADCMgr's counters start over in begin()
+  auto adcTotals = [&]() {
+    r.adcReads += adc.reads() - adcReads0;
+    r.adcBusyUs += adc.busyUs() - adcBusy0;
+    r.adcBursts += adc.bursts() - adcBursts0;
+    adcReads0 = adc.reads();
+    adcBusy0 = adc.busyUs();
+    adcBursts0 = adc.bursts();
+  };
+
+  // EventMgr's counters start over in begin(): add them up at each boot's
+  // end, once BT has written this boot's events
+  auto evtTotals = [&]() {
+    Sim::HeapQuiet q;
+    btDrain();
+    const EventMgr::Stats st = EventMgr::stats();
+    for (int i = 0; i < TlmProto::EVT_TYPE_COUNT; i++) r.evtPushed[i] += st.byType[i];
+    for (size_t i = 0; i < TlmBus::count(); i++) {
+      r.evtLost += st.lost[i];
+      if (TlmBus::get(i) != TlmBus::bt()) continue;
+      r.evtBtSent += st.sent[i];
+      evtBtSent[s_evtBoot] += st.sent[i];
+    }
+    s_evtBoot++;
+  };
+
+  auto pace = [&]() {
+    if (s_opt.speed <= 0) return;
+    const double ahead = Sim::nowUs() * 1e-6 / s_opt.speed -
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+    if (ahead > 0.002) usleep((useconds_t)(ahead * 1e6));
+  };
+
+  while (Sim::nowUs() < sc.endUs) {
+    fireEvents();
+    if (s_resetReason >= 0) {
+      if (booted) evtTotals();
+      Sim::restart(s_resetReason);
+      s_resetReason = -1;
+      booted = false;
+      r.resets++;
+    }
+    // allocations in loop() and the timer callbacks after it
+    uint32_t allocs0 = MemMgr::stats().allocs[0];
+    const uint64_t pass0 = Sim::nowUs();
+    bool looped = false;
+    try {
+      if (!booted) {
+        setup();
+        booted = true;
+        allocs0 = 0;   // arm() cleared the counters
+        const RtcState::Info bi = RtcState::info();
+        if (bi.src == RtcState::SRC_RTC) {
+          r.rtcBoots++;
+          r.staleMax = std::max(r.staleMax, bi.staleMs);
+          r.restoreMaxUs = std::max(r.restoreMaxUs, bi.restoreUs);
+        }
+        nextTrace = Sim::nowUs();
+        adcReads0 = adcBursts0 = 0;
+        adcBusy0 = 0;
+        adcTotals();
+        for (StepWatch& w : steps) { if (w.pending) r.stepsUnseen++; w.pending = false; }
+      } else {
+        loop();
+        r.loops++;
+        looped = true;
+        adcTotals();
+        watchSteps();
+      }
+      const bool t = LoadProt::tripped();
+      if (t && !wasTripped) { r.trips++; if (looped) r.evtTrips++; }
+      wasTripped = t;
+      const bool c = ChargeMgr::isCharging();
+      if (c != wasCharging) { r.chgFlips++; if (looped) r.evtChg++; }
+      wasCharging = c;
+      const uint8_t th = ThermalMgr::flags();
+      if (th & ~wasTherm) r.thTrips++;
+      wasTherm = th;
+      const bool noChg = !ThermalMgr::allowCharge();
+      const bool noDsg = !ThermalMgr::allowLoad();
+      const ADCMgr::Rate rate = adc.rate();
+      Sim::advance(s_opt.loopUs);
+      // the pass plus what delay() and the jitter added inside it
+      const uint64_t passUs = Sim::nowUs() - pass0;
+      if (noChg) r.thNoChgS += passUs * 1e-6;
+      if (noDsg) r.thNoDsgS += passUs * 1e-6;
+      if (looped) {
+        r.awakeUs += passUs;
+        r.adcRateUs[(int)rate] += passUs;
+        if (StreamMgr::active()) r.streamUs += passUs;
+      }
+      const uint32_t da = MemMgr::armed() ? MemMgr::stats().allocs[0] - allocs0 : 0;
+      r.heapAllocs += da;
+      r.heapMaxPass = std::max(r.heapMaxPass, da);
+    } catch (const Sim::DeepSleep&) {
+      // The chip is off: step the model until a wake source fires, then boot
+      r.sleeps++;
+      evtTotals();
+      Sim::enterSleep();
+      int cause = 0;
+      while (Sim::nowUs() < sc.endUs && (cause = Sim::wakeCause()) == 0) {
+        uint64_t step = SLEEP_STEP_US;
+        if (next < sc.events.size() && sc.events[next].us > Sim::nowUs())
+          step = std::min(step, sc.events[next].us - Sim::nowUs());
+        Sim::advance(step);
+        fireEvents();
+        sample();
+      }
+      Sim::reboot(cause ? cause : ESP_SLEEP_WAKEUP_UNDEFINED);
+      booted = false;
+    } catch (const Sim::SoftReset&) {
+      // esp_restart(): an OTA reboot or rollback
+      evtTotals();
+      Sim::restart(ESP_RST_SW);
+      booted = false;
+      r.resets++;
+    }
+    sample();
+    pace();
+  }
+
+  if (booted) evtTotals();
+  {
+    Sim::HeapQuiet q;
+    // Per boot: seq rising, each type's time never going back, and every
+    // event EventMgr handed to BT at the client
+    std::lock_guard<std::mutex> l(s_evtMu);
+    std::map<uint32_t, uint32_t> rx, lastSeq;
+    std::map<uint32_t, uint64_t> lastT;     // boot << 8 | type
+    for (const EvtRx& e : s_evtRx) {
+      r.evtRx++;
+      if (e.type >= TlmProto::EVT_TYPE_COUNT) { r.evtOrderErr++; continue; }
+      auto seq = lastSeq.find(e.boot);
+      if (seq != lastSeq.end() && e.seq <= seq->second) r.evtOrderErr++;
+      lastSeq[e.boot] = e.seq;
+      const uint32_t k = e.boot << 8 | e.type;
+      auto t = lastT.find(k);
+      if (t != lastT.end() && e.tUs < t->second) r.evtOrderErr++;
+      lastT[k] = e.tUs;
+      rx[e.boot]++;
+    }
+    for (const auto& b : evtBtSent)
+      if (rx[b.first] < b.second) r.evtMissing += b.second - rx[b.first];
+  }
+  using namespace TlmProto;
+  r.evtFail = r.evtMissing || r.evtOrderErr || r.evtLost ||
+              r.evtPushed[EVT_TRIP] != r.evtTrips ||
+              r.evtPushed[EVT_CHG_START] + r.evtPushed[EVT_CHG_STOP] != r.evtChg ||
+              r.evtPushed[EVT_SLEEP] != r.sleeps;
+
+  {
+    Sim::HeapQuiet q;
+    btDrain();
+    for (int i = 0; i < 2000 && !txSettled(r.tx = BtMgr::txStats()); i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    r.linkFrames = Sim::btWrites();
+    r.linkBytes = Sim::btBytesOut();
+    r.loopWrites = Sim::btLoopWrites();
+    r.acks = s_acks;
+    r.acksWant = s_acksWant;
+    r.ackMax = s_ackMax;
+    r.ackFull = s_ackFull;
+    r.sub = TlmSub::stats(TlmBus::bt());
+    r.subRx = s_subRx;
+    r.subRxBytes = s_subRxBytes;
+    r.txFail = !txSettled(r.tx) || r.loopWrites || r.ackFull || r.acks != r.acksWant;
+    r.streamSent = StreamMgr::packetsSent();
+    r.streamDropped = StreamMgr::packetsDropped();
+    std::lock_guard<std::mutex> l(s_rawMu);
+    r.raw = s_raw;
+    r.streamFail = r.raw.idxGaps || r.raw.idxBack;
+  }
+  {
+    Sim::HeapQuiet q;
+    for (size_t i = 0; i < s_sinkRdCount; i++) {
+      SinkReader& s = s_sinkRd[i];
+      Sim::sinkClose(s.t, 1000);
+      s.th.join();
+      SinkRx& x = r.sinks[r.sinkCount++] = s.rx;
+      snprintf(x.name, sizeof(x.name), "%s", s.t->name());
+      x.sent = s.t->framesSent;
+      x.dropped = s.t->framesDropped;
+      x.out = Sim::sinkStats(s.t);
+      if (x.bad || !x.frames || x.frames != x.out.frames || x.bytes != x.out.bytes || x.out.frames != x.sent)
+        r.sinkFail = true;
+      if (!x.bin && !r.fullBytes) r.fullBytes = x.bytes;
+    }
+    // next to a full JSON stream, a subscription must cost less
+    r.subFail = r.subRx && r.fullBytes && r.subRxBytes >= r.fullBytes;
+    r.sinkFail = r.sinkFail || s_sinkErr;
+    r.usbSent = TlmBus::usb()->framesSent;
+    r.usbDropped = TlmBus::usb()->framesDropped;
+    r.usbStalls = TlmBus::usbStalls();
+  }
+
+  r.simH = Sim::nowUs() / 3.6e9;
+  r.wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+  r.btOut = Sim::btBytesOut();
+  r.bbm = Sim::bbmStats();
+  r.chgEdges = Sim::inputEdges();
+  const Sim::Model& m = Sim::model();
+  r.enFw = EnergyMgr::lifetime();
+  r.enTrue.chgInWh = m.inWh();
+  r.enTrue.dsgOutWh = m.outWh();
+  r.enTrue.loadWh = m.loadWh();
+  r.effFw = EnergyMgr::efficiency();
+  r.effTrue = m.dcdcEff();
+  r.ir = SocMgr::ir();
+  r.rTrue = m.rOhm();
+  r.boCommits = RtcState::info().boCommits;
+  for (uint8_t i = 0; i < InaSrc::MON_COUNT; i++) {
+    if (!InaSrc::fitted(i)) continue;
+    const InaMon::Stats& st = InaSrc::monitor(i).stats();
+    r.inaFitted = true;
+    r.ina.reads += st.reads;
+    r.ina.errors += st.errors;
+    r.ina.faults += st.faults;
+    r.ina.clipped += st.clipped;
+  }
+  for (const StepWatch& w : steps) if (w.pending) r.stepsUnseen++;
+  if (trace) fclose(trace);
+  return r;
+}
+
+static void report(const Sim::Scenario& sc, const Result& r) {
+  Sim::HeapQuiet q;
+  char deadMin[24] = "-";
+  if (r.bbm.changeovers) snprintf(deadMin, sizeof(deadMin), "%.1fms", r.bbm.deadMinUs / 1000.0);
+  char emptyAt[24] = "-";
+  if (!isnan(r.emptyAt)) snprintf(emptyAt, sizeof(emptyAt), "%.1f%%", r.emptyAt);
+  char ina[80] = "-";
+  if (r.inaFitted) snprintf(ina, sizeof(ina), "reads %u err %u faults %u clipped %u",
+                            r.ina.reads, r.ina.errors, r.ina.faults, r.ina.clipped);
+  char adcLine[160];
+  const double awakeS = r.awakeUs * 1e-6;
+  const double pct = r.awakeUs ? 100.0 / r.awakeUs : 0.0;
+  snprintf(adcLine, sizeof(adcLine),
+           "reads/s %.0f busy %.1fms/s idle/norm/burst %.0f/%.0f/%.0f%% bursts %u  "
+           "step lat avg %.0f max %.0f ms n %u unseen %u",
+           awakeS > 0 ? r.adcReads / awakeS : 0.0, awakeS > 0 ? r.adcBusyUs / 1000.0 / awakeS : 0.0,
+           r.adcRateUs[0] * pct, r.adcRateUs[1] * pct, r.adcRateUs[2] * pct, r.adcBursts,
+           r.steps ? r.stepLatSumMs / r.steps : 0.0, r.stepLatMaxMs, r.steps, r.stepsUnseen);
+  char evt[200];
+  const uint32_t* n = r.evtPushed;
+  snprintf(evt, sizeof(evt),
+           "load/trip/chg/full/empty/sleep %u/%u/%u/%u/%u/%u (truth trips %u chg %u sleeps %u) "
+           "bt %u rx %u missing %u order_err %u lost %u%s",
+           n[0], n[1], n[2] + n[3], n[4], n[5], n[6], r.evtTrips, r.evtChg, r.sleeps,
+           r.evtBtSent, r.evtRx, r.evtMissing, r.evtOrderErr, r.evtLost, r.evtFail ? " FAIL" : "");
+  char tx[160];
+  snprintf(tx, sizeof(tx),
+           "q/sent/drop/rej/pend %u/%u/%u/%u/%u frames (%llu B at client) max_block %.1fms "
+           "loop_writes %u acks %u/%u max %uB reply_full %u%s",
+           r.tx.queuedFrames, r.tx.sentFrames, r.tx.droppedFrames, r.tx.rejectedFrames,
+           r.tx.pendingFrames, (unsigned long long)r.linkBytes, r.tx.maxBlockUs / 1000.0,
+           r.loopWrites, r.acks, r.acksWant, r.ackMax, r.ackFull, r.txFail ? " FAIL" : "");
+  char stream[200];
+  const RawRx& x = r.raw;
+  snprintf(stream, sizeof(stream),
+           "batches sent/drop %u/%u rx %u lost %u  samples %llu (%.0f/s) lost %llu "
+           "max_decim %u idx_gaps %u idx_back %u%s",
+           r.streamSent, r.streamDropped, x.packets, x.lostPackets, (unsigned long long)x.samples,
+           r.streamUs ? x.samples / (r.streamUs * 1e-6) : 0.0, (unsigned long long)x.lostSamples,
+           x.maxDecim, x.idxGaps, x.idxBack, r.streamFail ? " FAIL" : "");
+  char sink[240];
+  int at = snprintf(sink, sizeof(sink), "usb sent/drop %u/%u stalls %u",
+                    r.usbSent, r.usbDropped, r.usbStalls);
+  for (size_t i = 0; i < r.sinkCount && at > 0 && (size_t)at < sizeof(sink); i++) {
+    const SinkRx& x = r.sinks[i];
+    at += snprintf(sink + at, sizeof(sink) - at, " %s %s sent/drop %u/%u rx %u/%u %lluB bad %u",
+                   x.name, x.bin ? "bin" : "json", x.sent, x.dropped, x.frames, x.out.frames,
+                   (unsigned long long)x.bytes, x.bad);
+  }
+  if (r.sinkFail && at > 0 && (size_t)at < sizeof(sink)) snprintf(sink + at, sizeof(sink) - at, " FAIL");
+  char sub[160];
+  at = snprintf(sub, sizeof(sub), "frames %u rx %u %lluB fields sent/skipped %u/%u full ",
+                r.sub.frames, r.subRx, (unsigned long long)r.subRxBytes, r.sub.fieldsSent, r.sub.fieldsSkipped);
+  if (r.subRx && r.fullBytes && at > 0 && (size_t)at < sizeof(sub))
+    snprintf(sub + at, sizeof(sub) - at, "%lluB saved %.1f%%%s", (unsigned long long)r.fullBytes,
+             100.0 * (1.0 - (double)r.subRxBytes / r.fullBytes), r.subFail ? " FAIL" : "");
+  else if (at > 0 && (size_t)at < sizeof(sub))
+    snprintf(sub + at, sizeof(sub) - at, "-");
+  char heap[48] = "guard off";
+  if (HEAP_GUARD) snprintf(heap, sizeof(heap), "allocs %u max_pass %u%s", r.heapAllocs, r.heapMaxPass,
+                           r.heapAllocs ? " FAIL" : "");
+  printf("%-20s sim %7.2f h  wall %7.2f s  %8.1f sim-h/wall-s  loops %9lu  "
+         "soc_err end %5.2f max %5.2f  vmin %.3f  trips %u  sleeps %u  bt_out %llu  "
+         "bbm overlap %u changeover %u dead_min %s  chg flips %u edges %u  "
+         "therm trips %u no_chg %.0fs no_dsg %.0fs tmax %.1f  "
+         "energy in %.3f/%.3f out %.3f/%.3f load %.3f/%.3f Wh eff %.3f/%.3f err_max %.3f  "
+         "ir %.1f/%.1f mOhm steps %u rej %u empty_at %s  "
+         "boot resets %u rtc %u stale_max %.1fs restore_max %uus bo %u  ina %s  adc %s  evt %s  tx %s  stream %s  sink %s  sub %s  heap %s\n",
+         sc.name.c_str(), r.simH, r.wallS, r.wallS > 0 ? r.simH / r.wallS : 0.0,
+         (unsigned long)r.loops, r.socErrEnd, r.socErrMax, r.vbatMin, r.trips, r.sleeps,
+         (unsigned long long)r.btOut, r.bbm.overlaps, r.bbm.changeovers, deadMin,
+         r.chgFlips, r.chgEdges, r.thTrips, r.thNoChgS, r.thNoDsgS, r.tempMax,
+         r.enFw.chgInWh, r.enTrue.chgInWh, r.enFw.dsgOutWh, r.enTrue.dsgOutWh,
+         r.enFw.loadWh, r.enTrue.loadWh, r.effFw, r.effTrue, r.effErrMax,
+         r.ir.ohm * 1000.0f, r.rTrue * 1000.0f, r.ir.steps, r.ir.rejects, emptyAt,
+         r.resets, r.rtcBoots, r.staleMax / 1000.0, r.restoreMaxUs, r.boCommits, ina, adcLine, evt, tx, stream, sink, sub, heap);
+#if PROF_ENABLE
+  // Host cost of each zone since the last boot (the sim's cycle counter
+  // is host time at 240 MHz)
+  if (s_opt.prof) {
+    const double ns = 1000.0 / ESP.getCpuFreqMHz();
+    printf("  %-12s %10s %9s %9s %9s   zone overhead %.0f ns, bias %.0f ns\n", "zone", "n",
+           "min_ns", "avg_ns", "max_ns", ProfMgr::overheadCycles() * ns, ProfMgr::biasCycles() * ns);
+    for (uint8_t z = 0; z < ProfMgr::ZONE_COUNT; z++) {
+      const ProfMgr::ZoneStats& st = ProfMgr::stats(z);
+      if (!st.n) continue;
+      printf("  %-12s %10lu %9.0f %9.0f %9.0f\n", ProfMgr::zoneName(z), (unsigned long)st.n,
+             st.minCyc * ns, (double)st.totalCyc / st.n * ns, st.maxCyc * ns);
+    }
+  }
+#endif
+  fflush(stdout);
+}
+
+static void usage() {
+  fprintf(stderr,
+    "usage: fw_sim [options] <scenario file | builtin name | all>...\n"
+    "  -l              list built-in scenarios\n"
+    "  -j N            run N scenarios in parallel (one process each)\n"
+    "  --seed N        ADC noise seed (default 1)\n"
+    "  --loop-us N     virtual time per loop() pass (default 1000)\n"
+    "  --trace FMT     per-second CSV, %%s = scenario name (e.g. trace_%%s.csv)\n"
+    "  --usb           echo the firmware's USB serial output to stdout\n"
+    "  --prof          print profiler zones (host time) after each scenario\n"
+    "  --pty           expose the BT link on a pseudo terminal\n"
+    "  --sink PATH     JSON telemetry on a Unix socket (%%s = scenario name), or pty\n"
+    "  --sink-bin      the --sink gets binary frames instead\n"
+    "  --speed X       pace to X times real time (with --pty, 1 = real time)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::vector<Sim::Scenario> scenarios;
+  std::string err;
+
+  auto addBuiltin = [&](const Sim::Builtin& b) {
+    Sim::Scenario sc;
+    if (!Sim::parseScenario(b.text, sc, err)) {
+      fprintf(stderr, "builtin %s: %s\n", b.name, err.c_str());
+      exit(2);
+    }
+    sc.name = b.name;
+    scenarios.push_back(sc);
+  };
+
+  for (int i = 1; i < argc; i++) {
+    const std::string a = argv[i];
+    auto val = [&]() -> const char* {
+      if (i + 1 >= argc) { usage(); exit(2); }
+      return argv[++i];
+    };
+    if (a == "-h" || a == "--help") { usage(); return 0; }
+    else if (a == "-l") {
+      for (const Sim::Builtin* b = Sim::BUILTINS; b->name; b++) printf("%s\n", b->name);
+      return 0;
+    }
+    else if (a == "-j")        s_opt.jobs = std::max(1, atoi(val()));
+    else if (a == "--seed")    s_opt.seed = (uint32_t)strtoul(val(), nullptr, 0);
+    else if (a == "--loop-us") s_opt.loopUs = std::max(1ul, strtoul(val(), nullptr, 0));
+    else if (a == "--trace")   s_opt.trace = val();
+    else if (a == "--usb")     s_opt.usb = true;
+    else if (a == "--pty")     s_opt.pty = true;
+    else if (a == "--sink")    s_opt.sink = val();
+    else if (a == "--sink-bin") s_opt.sinkBin = true;
+    else if (a == "--prof")    s_opt.prof = true;
+    else if (a == "--speed")   s_opt.speed = atof(val());
+    else if (a == "all") {
+      for (const Sim::Builtin* b = Sim::BUILTINS; b->name; b++) addBuiltin(*b);
+    } else {
+      const Sim::Builtin* b = Sim::BUILTINS;
+      while (b->name && a != b->name) b++;
+      if (b->name) { addBuiltin(*b); continue; }
+      Sim::Scenario sc;
+      if (!Sim::loadScenario(argv[i], sc, err)) { fprintf(stderr, "%s\n", err.c_str()); return 2; }
+      scenarios.push_back(sc);
+    }
+  }
+
+  if (scenarios.empty()) { usage(); return 2; }
+
+  // One process per scenario: the firmware's statics, tasks and NVS start
+  // fresh, and -j spreads them over cores.
+  int running = 0, failed = 0;
+  const auto wall0 = std::chrono::steady_clock::now();
+  for (const Sim::Scenario& sc : scenarios) {
+    if (running >= s_opt.jobs) {
+      int st;
+      if (wait(&st) > 0) { running--; if (!WIFEXITED(st) || WEXITSTATUS(st)) failed++; }
+    }
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid < 0) { perror("fork"); return 1; }
+    if (pid == 0) {
+      const Result r = run(sc);
+      report(sc, r);
+      // the soak check: the loop task must not allocate once setup() is done;
+      // the event check: every event reached the BT client, in order;
+      // the TX check: every queued frame was sent, dropped or is pending;
+      // the stream check: no batch lost without a seq gap;
+      // the sink check: every frame a sink took arrived whole
+      _exit(r.heapAllocs || r.evtFail || r.txFail || r.streamFail || r.sinkFail || r.subFail ? 1 : 0);   // skip static destructors; task threads are still running
+    }
+    running++;
+  }
+  int st;
+  while (running > 0 && wait(&st) > 0) {
+    running--;
+    if (!WIFEXITED(st) || WEXITSTATUS(st)) failed++;
+  }
+
+  if (scenarios.size() > 1) {
+    printf("%zu scenarios, profile %s/%s, %.2f s wall%s\n", scenarios.size(),
+           Profile::BOARD.name, Profile::BATTERY.name,
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count(),
+           failed ? ", some FAILED" : "");
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include "sim_model.h"
+#include "pins.h"
+#include "profile.h"
+#include <math.h>
+
+namespace Sim {
+
+// The board's front end, from the same profile ADCMgr converts with
+static constexpr const Profile::Board& B = Profile::BOARD;
+static constexpr float VIN_SCALE   = B.vinScale;
+static constexpr float SHUNT_OHMS  = B.shuntOhm;
+static constexpr float GAIN_LOAD   = B.gainLoad;
+static constexpr float GAIN_BATT   = B.gainBatt;
+static constexpr float NTC_VREF    = B.ntcVref;
+static constexpr float NTC_RFIXED  = B.ntcRfixed;
+static constexpr float NTC_R25     = B.ntcR25;
+static constexpr float NTC_BETA    = B.ntcBeta;
+static constexpr float ADC_MAX_MV  = 3100.0f;
+
+static constexpr float V_TERM      = 4.20f;   // charger CV
+static constexpr float V_RECHARGE  = 4.05f;   // OCV that restarts a finished charge
+
+// Typical Li-ion NMC OCV, SOC 0..100 % in 10 % steps
+static const float OCV_TABLE[11] = {
+  3.00f, 3.45f, 3.58f, 3.65f, 3.71f, 3.77f, 3.84f, 3.92f, 4.00f, 4.08f, 4.18f
+};
+
+float Model::ocv(double soc) {
+  if (soc <= 0.0) return OCV_TABLE[0];
+  if (soc >= 1.0) return OCV_TABLE[10];
+  const double x = soc * 10.0;
+  const int i = (int)x;
+  const float f = (float)(x - i);
+  return OCV_TABLE[i] + f * (OCV_TABLE[i + 1] - OCV_TABLE[i]);
+}
+
+void Model::reset(const ModelParams& p) {
+  p_ = p;
+  soc_ = p.soc;
+  in_ah_ = out_ah_ = 0;
+  in_wh_ = out_wh_ = load_wh_ = 0;
+  dcdc_eff_ = 0;
+  temp_c_ = p.ambient_c;
+  setLoad(0);
+  charger_in_ = false;
+  done_ = false;
+  button_down_ = false;
+  ntc_open_ = false;
+  amb_target_ = p.ambient_c;
+  amb_rate_ = 0;
+  ichg_ = idsg_ = iload_ = 0;
+  vbat_ = ocv(soc_);
+}
+
+void Model::setAmbient(float c, float perMin) {
+  amb_target_ = c;
+  amb_rate_ = perMin / 60.0f;
+  if (perMin <= 0) p_.ambient_c = c;
+}
+
+void Model::step(double dt, const PinOut& pins, bool asleep) {
+  if (dt <= 0) return;
+  if (p_.ambient_c != amb_target_) {
+    const float d = amb_rate_ * (float)dt;
+    const float left = amb_target_ - p_.ambient_c;
+    p_.ambient_c = fabsf(left) <= d ? amb_target_ : p_.ambient_c + (left > 0 ? d : -d);
+  }
+  const float v_oc = ocv(soc_);
+
+  // Charger (only with input present and CE high)
+  ichg_ = 0;
+  if (charger_in_ && pins.en_charge && !asleep) {
+    if (done_ && v_oc < V_RECHARGE) done_ = false;
+    if (!done_) {
+      const float cv = (V_TERM - v_oc) / p_.r_ohm;
+      ichg_ = cv < p_.chg_limit_a ? cv : p_.chg_limit_a;
+      if (ichg_ < 0) ichg_ = 0;
+      if (v_oc + ichg_ * p_.r_ohm >= V_TERM - 0.001f && ichg_ < p_.chg_limit_a * 0.1f) {
+        done_ = true;
+        ichg_ = 0;
+      }
+    }
+  } else if (!charger_in_) {
+    done_ = false;
+  }
+
+  // Load: from the input path while it's there, else from the cell
+  float load = load_a_;
+  if (load_dwell_s_ > 0) {
+    load_phase_s_ = fmod(load_phase_s_ + dt, 2.0 * load_dwell_s_);
+    if (load_phase_s_ >= load_dwell_s_) load = load_alt_;
+  }
+  iload_ = (!asleep && pins.en_load_dsg && soc_ > 0.0) ? load : 0.0f;
+  const float board = asleep ? p_.sleep_a : p_.quiescent_a;
+  const float loadV = p_.dcdc_v > 0 ? p_.dcdc_v : 5.0f;
+  dcdc_eff_ = 0;
+  if (charger_in_ && pins.en_relay) {
+    idsg_ = board;
+  } else if (p_.dcdc_v > 0 && pins.en_dcdc) {
+    // boost: the cell supplies the output power plus the converter loss
+    // (vbat_ of the last step, the difference is well below the noise)
+    const float icell = iload_ * p_.dcdc_v / (p_.dcdc_eff * vbat_);
+    idsg_ = icell + board;
+    if (iload_ > 0) dcdc_eff_ = iload_ * p_.dcdc_v / (idsg_ * vbat_);
+  } else {
+    idsg_ = iload_ + board;
+  }
+
+  const double net = (double)ichg_ - (double)idsg_;   // + = into the cell
+  soc_ += net * dt / 3600.0 / (p_.capacity_mah / 1000.0);
+  if (soc_ < 0) soc_ = 0;
+  if (soc_ > 1) soc_ = 1;
+  in_ah_  += ichg_ * dt / 3600.0;
+  out_ah_ += idsg_ * dt / 3600.0;
+
+  vbat_ = ocv(soc_) + (float)net * p_.r_ohm;
+  in_wh_   += ichg_ * vbat_ * dt / 3600.0;
+  out_wh_  += idsg_ * vbat_ * dt / 3600.0;
+  load_wh_ += iload_ * loadV * dt / 3600.0;
+
+  // Self-heating, first order towards ambient + I^2 R * K/W
+  const float ibat = (float)fabs(net);
+  const float target = p_.ambient_c + ibat * ibat * p_.r_ohm * p_.thermal_k_per_w;
+  const float a = (float)(dt / (p_.thermal_tau_s + dt));
+  temp_c_ += (target - temp_c_) * a;
+}
+
+// Box-Muller is overkill here: sum of 4 uniforms is close enough to normal
+static float noise(uint32_t rnd, float sigma) {
+  float s = 0;
+  for (int i = 0; i < 4; i++) {
+    s += (float)((rnd >> (i * 8)) & 0xFF) / 255.0f - 0.5f;
+  }
+  return s * sigma * 1.732f;   // var of the sum = 4/12
+}
+
+static float shuntMv(float amps, float offset_a, float gain) {
+  const float a = amps - offset_a;   // ADCMgr adds the offset back
+  return a > 0 ? a * gain * SHUNT_OHMS * 1000.0f : 0.0f;
+}
+
+int Model::adcMv(int pin, uint32_t rnd) const {
+  float mv = 0;
+  switch (pin) {
+    case PIN_ADC_VOLT:     mv = (vbat_ - B.vbatOffV) / VIN_SCALE * 1000.0f; break;   // ADCMgr adds it back
+    case PIN_ADC_LOAD_DSG: mv = shuntMv(iload_, B.offLoadA, GAIN_LOAD); break;
+    case PIN_ADC_BATT_CHG: mv = shuntMv(ichg_,  B.offChgA, GAIN_BATT); break;
+    case PIN_ADC_BATT_DSG: mv = shuntMv(idsg_,  B.offDsgA, GAIN_BATT); break;
+    case PIN_ADC_NTC: {
+      if (ntc_open_) { mv = ADC_MAX_MV; break; }
+      const float t = temp_c_ + 273.15f;
+      const float r = NTC_R25 * expf(NTC_BETA * (1.0f / t - 1.0f / 298.15f));
+      mv = NTC_VREF * r / (NTC_RFIXED + r) * 1000.0f;
+      break;
+    }
+    default: return 0;
+  }
+  mv += noise(rnd, p_.adc_noise_mv);
+  if (mv < 0) mv = 0;
+  if (mv > ADC_MAX_MV) mv = ADC_MAX_MV;
+  return (int)(mv + 0.5f);
+}
+
+} // namespace Sim
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include "profile.h"
+
+// ------------------------------------------------------------
+// Battery / charger / load / NTC model behind the simulated pins.
+//
+// Single cell, OCV(SOC) table + series resistance, TP4056-style CC/CV
+// charger with termination at C/10, first-order thermal model. The ADC
+// side mirrors the board's front end (divider, shunt amps, NTC divider)
+// so ADCMgr's own conversions turn the mV back into volts and amps.
+// ------------------------------------------------------------
+namespace Sim {
+
+struct ModelParams {
+  float capacity_mah  = Profile::BATTERY.capacityMah;  // true capacity (the firmware may think otherwise)
+  float soc           = 1.0f;     // initial true SOC, 0..1
+  float r_ohm         = 0.08f;    // cell series resistance
+  float chg_limit_a   = 1.0f;     // charger CC current
+  float quiescent_a   = 0.015f;   // board draw while awake (from the cell)
+  float sleep_a       = 0.0003f;  // board draw in deep sleep
+  float ambient_c     = 25.0f;
+  float thermal_k_per_w = 12.0f;  // cell self-heating
+  float thermal_tau_s   = 600.0f;
+  float adc_noise_mv  = 4.0f;     // 1 sigma
+  float dcdc_v        = Profile::BOARD.dcdcV;   // DC-DC output; 0 = the load current comes straight off the cell
+  float dcdc_eff      = 0.9f;
+};
+
+// Outputs the firmware drives, sampled by the model
+struct PinOut {
+  bool en_charge;
+  bool en_load_dsg;
+  bool en_dcdc;
+  bool en_relay;
+};
+
+class Model {
+public:
+  void reset(const ModelParams& p);
+
+  // Scenario inputs
+  // dwellS > 0: square wave, amps and alt for dwellS each
+  void setLoad(float amps, float alt = 0, float dwellS = 0) {
+    load_a_ = amps; load_alt_ = alt; load_dwell_s_ = dwellS; load_phase_s_ = 0;
+  }
+  void setCharger(bool in, float amps) { charger_in_ = in; if (amps > 0) p_.chg_limit_a = amps; }
+  void setAmbient(float c, float perMin = 0);   // perMin > 0: ramp to c
+  void setNtcOpen(bool open)           { ntc_open_ = open; }
+  void setButton(bool down)            { button_down_ = down; }
+
+  void step(double dt_s, const PinOut& pins, bool asleep);
+
+  // Digital inputs as the board wires them
+  int pinCharging() const  { return charger_in_ ? 1 : 0; }       // HIGH = input present
+  int pinChgDone() const   { return (charger_in_ && done_) ? 0 : 1; }  // open drain, LOW = done
+  int pinButton() const    { return button_down_ ? 0 : 1; }      // pull-up, LOW = pressed
+
+  // ADC node voltage for one of the PIN_ADC_* pins, with noise
+  int adcMv(int pin, uint32_t rnd) const;
+
+  // Truth, for reports
+  double soc() const      { return soc_; }
+  float  vbat() const     { return vbat_; }
+  float  ichg() const     { return ichg_; }
+  float  idsg() const     { return idsg_; }
+  float  iload() const    { return iload_; }
+  float  tempC() const    { return temp_c_; }
+  float  rOhm() const     { return p_.r_ohm; }
+  bool   chgDone() const  { return done_; }
+  bool   chargerIn() const { return charger_in_; }
+  double inAh() const     { return in_ah_; }
+  double outAh() const    { return out_ah_; }
+  double inWh() const     { return in_wh_; }     // into the cell
+  double outWh() const    { return out_wh_; }    // out of the cell
+  double loadWh() const   { return load_wh_; }   // at the output (dcdc_v, else 5 V)
+  float  dcdcEff() const  { return dcdc_eff_; }  // true Pload / Pcell while on the DC-DC, 0 = not
+
+  static float ocv(double soc);
+
+private:
+  ModelParams p_;
+  double soc_ = 1.0;
+  double in_ah_ = 0, out_ah_ = 0;
+  double in_wh_ = 0, out_wh_ = 0, load_wh_ = 0;
+  float  dcdc_eff_ = 0;
+  float  vbat_ = 4.2f, ichg_ = 0, idsg_ = 0, iload_ = 0;
+  float  temp_c_ = 25.0f;
+  float  load_a_ = 0;
+  float  load_alt_ = 0, load_dwell_s_ = 0;
+  double load_phase_s_ = 0;
+  bool   charger_in_ = false;
+  bool   done_ = false;
+  bool   button_down_ = false;
+  bool   ntc_open_ = false;
+  float  amb_target_ = 25.0f;
+  float  amb_rate_ = 0;         // C/s
+};
+
+} // namespace Sim
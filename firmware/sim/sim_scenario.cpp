@@ -0,0 +1,505 @@
+#include "sim_scenario.h"
+#include "esp_system.h"
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Sim {
+
+// shared by adc_adapt / adc_fixed (IdleSleep's 10 minutes never run out)
+#define ADC_ACTIVITY \
+    "8m      load 0.3\n" \
+    "10m     load 0.35 0.25 20s\n" \
+    "16m10s  load 0\n" \
+    "20m     charger on 1.0\n" \
+    "30m     charger off\n" \
+    "38m     end\n"
+
+const Builtin BUILTINS[] = {
+  // just under the 0.6 A trip, full to empty
+  { "discharge_05a",
+    "battery soc=1.0\n"
+    "0s      load 0.5\n"
+    "4h30m   end\n" },
+
+  { "charge_cc_cv",
+    "battery soc=0.1\n"
+    "0s      charger on 1.0\n"
+    "4h      end\n" },
+
+  // trip at 0.6 A, auto retry every 10 s while the fault lasts, clear later
+  { "overcurrent_retry",
+    "battery soc=0.8\n"
+    "0s      load 0.2\n"
+    "1m      load 1.5\n"
+    "3m      load 0.2\n"
+    "10m     end\n" },
+
+  // idle timeout -> deep sleep, charger plug wakes it, button wakes it
+  { "idle_sleep_wake",
+    "battery soc=0.6\n"
+    "0s      load 0\n"
+    "30m     charger on 1.0\n"
+    "45m     charger off\n"
+    "1h10m   button down\n"
+    "1h10m4s button up\n"
+    "1h30m   end\n" },
+
+  // a day of use: morning charge, daytime load, client poking at it
+  { "cycle_24h",
+    "battery soc=0.5 r=0.1\n"
+    "0s      charger on 1.0\n"
+    "3h      charger off\n"
+    "3h      load 0.4\n"
+    "3h      bt connect\n"
+    "3h1s    send {\"cmd\":\"get\",\"id\":1}\n"
+    "3h2s    send {\"cmd\":\"log\",\"op\":\"info\",\"id\":2}\n"
+    "3h5m    bt disconnect\n"
+    "7h      ambient 35\n"
+    "9h      load 0.05\n"
+    "12h     ambient 20\n"
+    "16h     load 0\n"
+    "20h     charger on 1.0\n"
+    "24h     end\n" },
+
+  // charger contacts that chatter for 30 ms on every plug / unplug, and
+  // a 100 ms glitch ChargeMgr has to ignore
+  { "charger_bounce",
+    "battery soc=0.6\n"
+    "0s      bounce 30\n"
+    "0s      load 0.2\n"
+    "10s     charger on 1.0\n"
+    "40s     charger off\n"
+    "41s     charger on 1.0\n"
+    "41s100ms charger off\n"
+    "70s     charger on 1.0\n"
+    "2m      end\n" },
+
+  // ThermalMgr: a slow ramp past the charge limit (45 C) and the
+  // discharge limit (60 C) and back, a step that trips on dT/dt, and an
+  // NTC that comes loose for 5 minutes
+  { "thermal_ramps",
+    "battery soc=0.3\n"
+    "0s      charger on 1.0\n"
+    "0s      load 0.2\n"
+    "1m      ambient 68 0.5\n"
+    "1h40m   ambient 20 0.5\n"
+    "3h30m   ambient 25\n"
+    "3h40m   ambient 50\n"
+    "3h50m   ambient 25\n"
+    "4h30m   ntc open\n"
+    "4h35m   ntc ok\n"
+    "5h      end\n" },
+
+  // EnergyMgr: a 5 V boost at 88% under a load that steps every few
+  // minutes, a charge session, and back on the battery. The model
+  // integrates the true Wh to compare the accumulators against.
+  { "energy_profile",
+    "battery soc=0.8 dcdc_eff=0.88\n"
+    "0s      load 0.3\n"
+    "5m      load 0.1\n"
+    "10m     load 0.4\n"
+    "12m     load 0.05\n"
+    "20m     load 0.25\n"
+    "20m30s  load 0.35\n"
+    "21m     load 0.25\n"
+    "21m30s  load 0.35\n"
+    "22m     load 0.25\n"
+    "40m     charger on 1.0\n"
+    "1h40m   charger off\n"
+    "1h40m   load 0.2\n"
+    "2h      end\n" },
+
+  // SocMgr internal resistance: a 0.5 / 0.1 A square wave down to empty
+  // on a 150 mOhm cell. IrEst learns R from the steps; the empty test
+  // then runs on the OCV instead of the sagging loaded voltage.
+  { "ir_steps",
+    "battery soc=0.35 r=0.15\n"
+    "0s      load 0.5 0.1 1m\n"
+    "3h      end\n" },
+
+  // RtcState: a watchdog reset while a short is tripped and cooling
+  // down, and a panic while the user has the load off. Both have to
+  // survive, and the SOC carries on from the last frame. A power cut
+  // then falls back to NVS, and the cell runs down to the brownout
+  // commit. The load comes straight off the cell (dcdc_v=0): through the
+  // converter 0.55 A is ~1 A at the cell, which sags 0.3 V on r and
+  // browns out every few seconds near the end.
+  { "reset_restore",
+    "battery soc=1.0 r=0.3 dcdc_v=0\n"
+    "0s      load 0.3\n"
+    "0s      bt connect\n"
+    "20m     load 1.5\n"
+    "20m5s   reset task_wdt\n"
+    "20m30s  load 0.3\n"
+    "30m     send {\"cmd\":\"set\",\"en_load_dsg\":0,\"id\":1}\n"
+    "40m     reset panic\n"
+    "50m     send {\"cmd\":\"set\",\"en_load_dsg\":1,\"id\":2}\n"
+    "1h      reset poweron\n"
+    "1h      load 0.55\n"
+    "5h      end\n" },
+
+  // InaSrc: a 50 mA load, below what the ADC channels resolve, then the
+  // I2C bus fails for 5 minutes. The monitors go to fault, the ADC takes
+  // over, and they come back. Without monitors the ADC cannot see the
+  // load at all, and IdleSleep takes it for off and sleeps.
+  { "i2c_fault",
+    "battery soc=1.0\n"
+    "0s      load 0.05\n"
+    "1h      i2c fail\n"
+    "1h5m    i2c ok\n"
+    "3h      end\n" },
+
+  // MemMgr heap guard: every BT command, malformed lines, format switches,
+  // a stream, a log download and reconnects while the cell cycles. With
+  // -DHEAP_GUARD=1 the loop task must not allocate anywhere in this.
+  { "soak_bt",
+    "battery soc=0.6 r=0.1\n"
+    "0s      load 0.4 0.1 2m\n"
+    "0s      bt connect\n"
+    "10s     send {\"cmd\":\"set\",\"mem_period_ms\":1000,\"ui_period_ms\":200,\"log_period_ms\":500,\"id\":1}\n"
+    "11s     send {\"cmd\":\"sub\",\"fields\":[\"vbat\",\"soc\",\"iload\"],\"period_ms\":100,\"id\":2}\n"
+    "12s     send {\"cmd\":\"get\",\"id\":3}\n"
+    "13s     send {\"cmd\":\"get\",\"keys\":[\"trip_a\",\"bo_v\"],\"id\":4}\n"
+    "14s     send {\"cmd\":\"mem\",\"id\":5}\n"
+    "15s     send {\"cmd\":\"time\",\"epoch_us\":1760000000000000,\"id\":6}\n"
+    "16s     send {\"cmd\":\"sched\",\"id\":7}\n"
+    "17s     send {\"cmd\":\"prof\",\"id\":8}\n"
+    "18s     send {\"cmd\":\"bus\",\"id\":9}\n"
+    "19s     send {\"cmd\":\"energy\",\"id\":10}\n"
+    "20s     send {\"cmd\":\"ir\",\"id\":11}\n"
+    "21s     send {\"cmd\":\"boot\",\"id\":12}\n"
+    "21s500ms send {\"cmd\":\"ina\",\"id\":29}\n"
+    "22s     send {\"cmd\":\"log\",\"op\":\"info\",\"id\":13}\n"
+    "23s     send {\"cmd\":\"nope\",\"id\":14}\n"
+    "24s     send {\"cmd\":\"set\",\"trip_a\":\"x\",\"id\":15}\n"
+    "25s     send {\"cmd\":\"set\",\"trip_a\":99,\"id\":16}\n"
+    "26s     send {\"cmd\":\"get\",[[[\n"
+    "27s     send not json at all\n"
+    "30s     send {\"cmd\":\"proto\",\"fmt\":\"bin\",\"id\":17}\n"
+    "1m      send {\"cmd\":\"proto\",\"fmt\":\"json\",\"id\":18}\n"
+    "2m      send {\"cmd\":\"stream\",\"on\":1,\"tick_us\":1000,\"id\":19}\n"
+    "2m10s   send {\"cmd\":\"stream\",\"on\":0,\"id\":20}\n"
+    "5m      send {\"cmd\":\"log\",\"op\":\"get\",\"id\":21}\n"
+    "6m      send {\"cmd\":\"log\",\"op\":\"stop\",\"id\":22}\n"
+    "6m1s    send {\"cmd\":\"proto\",\"fmt\":\"json\",\"id\":23}\n"
+    "10m     bt disconnect\n"
+    "11m     bt connect\n"
+    "11m1s   send {\"cmd\":\"mem\",\"id\":24}\n"
+    "30m     charger on 1.0\n"
+    "1h      send {\"cmd\":\"prof\",\"reset\":1,\"id\":25}\n"
+    "1h      send {\"cmd\":\"sched\",\"reset\":1,\"id\":26}\n"
+    "1h30m   charger off\n"
+    "2h      send {\"cmd\":\"sub\",\"off\":1,\"id\":27}\n"
+    "2h      send {\"cmd\":\"mem\",\"id\":28}\n"
+    "3h      end\n" },
+
+  // BtMgr's TX queue against a client that reads 2 kB/s: the 10 Hz JSON
+  // lines need about 6 kB/s, so frames are evicted all along and the TX
+  // task blocks in write(). Then the link drops with frames queued and
+  // comes back, and the client catches up. Every queued frame must be
+  // sent, dropped or pending, and every command still answered.
+  { "bt_slow",
+    "battery soc=0.6\n"
+    "0s      load 0.3\n"
+    "0s      bt connect\n"
+    "0s      bt rate 2000\n"
+    "1s      send {\"cmd\":\"set\",\"ui_period_ms\":100,\"id\":1}\n"
+    "1m      send {\"cmd\":\"get\",\"id\":2}\n"
+    "1m1s    send {\"cmd\":\"mem\",\"id\":3}\n"
+    "1m2s    send {\"cmd\":\"txstats\",\"id\":4}\n"
+    "5m      bt lost\n"
+    "5m10s   bt connect\n"
+    "5m11s   send {\"cmd\":\"txstats\",\"id\":5}\n"
+    "8m      bt rate 0\n"
+    "10m     end\n" },
+
+  // StreamMgr's raw stream through the BT link: 1 kHz, then 4 kHz, then
+  // 1 kHz into a client that reads 3 kB/s, so batches drop and the
+  // stream decimates; stopped and started again. Every lost batch has to
+  // show as a seq gap, and first_idx has to carry on across all of it.
+  { "stream_bt",
+    "battery soc=0.6\n"
+    "0s      load 0.3 0.1 5s\n"
+    "0s      bt connect\n"
+    "1s      send {\"cmd\":\"stream\",\"on\":1,\"tick_us\":1000,\"id\":1}\n"
+    "1m      send {\"cmd\":\"stream\",\"on\":1,\"tick_us\":250,\"id\":2}\n"
+    "2m      send {\"cmd\":\"stream\",\"on\":1,\"tick_us\":1000,\"id\":3}\n"
+    "2m      bt rate 3000\n"
+    "4m      bt rate 0\n"
+    "4m      send {\"cmd\":\"stream\",\"on\":0,\"id\":4}\n"
+    "4m10s   send {\"cmd\":\"stream\",\"on\":1,\"tick_us\":500,\"mask\":4,\"id\":5}\n"
+    "5m      send {\"cmd\":\"stream\",\"on\":0,\"id\":6}\n"
+    "5m30s   end\n" },
+
+  // TlmBus fan-out: BT, USB and two sinks the sim reads, one on JSON and
+  // one on binary frames. BT goes binary and back, the USB port stalls
+  // for a minute and BT drops out. Every frame a sink took has to arrive
+  // whole.
+  { "fanout",
+    "battery soc=0.6\n"
+    "0s      load 0.3 0.1 10s\n"
+    "0s      sink json\n"
+    "0s      sink bin\n"
+    "0s      bt connect\n"
+    "1s      send {\"cmd\":\"set\",\"ui_period_ms\":200,\"id\":1}\n"
+    "1m      send {\"cmd\":\"proto\",\"fmt\":\"bin\",\"id\":2}\n"
+    "2m      usb stall\n"
+    "3m      usb ok\n"
+    "3m      send {\"cmd\":\"proto\",\"fmt\":\"json\",\"id\":3}\n"
+    "4m      bt disconnect\n"
+    "5m      end\n" },
+
+  // A BT subscription (4 fields, thresholds) next to a sink taking the
+  // full JSON frame at the same 1 s period: the bytes it saves
+  { "sub_bytes",
+    "battery soc=0.6\n"
+    "0s      load 0.3 0.1 2m\n"
+    "0s      sink json\n"
+    "0s      bt connect\n"
+    "0s      send {\"cmd\":\"sub\",\"fields\":[\"vbat\",\"soc\",\"iload\",\"temp\"],\"period_ms\":1000,"
+    "\"th\":{\"vbat\":0.005,\"soc\":0.5,\"iload\":0.02,\"temp\":0.5},\"id\":1}\n"
+    "30m     end\n" },
+
+  // ADCMgr's adaptive rate: on the shelf, a load plugged in, 0.1 A steps,
+  // unplugged, a charge, and the shelf again. adc_fixed is the same with
+  // the adaptive rate off, for the reads and the step latency it saves.
+  { "adc_adapt",
+    "battery soc=0.7\n"
+    "0s      bt connect\n"
+    ADC_ACTIVITY },
+
+  { "adc_fixed",
+    "battery soc=0.7\n"
+    "0s      bt connect\n"
+    "0s      send {\"cmd\":\"set\",\"adc_adapt\":0,\"id\":1}\n"
+    ADC_ACTIVITY },
+
+  { nullptr, nullptr },
+};
+
+#undef ADC_ACTIVITY
+
+static const struct { const char* name; int reason; } RESETS[] = {
+  { "poweron",  ESP_RST_POWERON },
+  { "sw",       ESP_RST_SW },
+  { "panic",    ESP_RST_PANIC },
+  { "task_wdt", ESP_RST_TASK_WDT },
+  { "wdt",      ESP_RST_WDT },
+  { "brownout", ESP_RST_BROWNOUT },
+};
+
+// "1h30m", "90s", "250ms", "0" -> µs
+static bool parseTime(const char* s, uint64_t& out) {
+  out = 0;
+  bool any = false;
+  while (*s) {
+    char* end;
+    const double v = strtod(s, &end);
+    if (end == s) return false;
+    s = end;
+    double mul;
+    if      (!strncmp(s, "ms", 2)) { mul = 1e3;  s += 2; }
+    else if (*s == 'h')            { mul = 3.6e9; s++; }
+    else if (*s == 'm')            { mul = 6e7;  s++; }
+    else if (*s == 's')            { mul = 1e6;  s++; }
+    else if (*s == '\0' && v == 0) { mul = 0; }
+    else return false;
+    out += (uint64_t)(v * mul + 0.5);
+    any = true;
+  }
+  return any;
+}
+
+static bool setBattery(char* args, ModelParams& p) {
+  for (char* kv = strtok(args, " \t"); kv; kv = strtok(nullptr, " \t")) {
+    char* eq = strchr(kv, '=');
+    if (!eq) return false;
+    *eq = '\0';
+    const float v = strtof(eq + 1, nullptr);
+    if      (!strcmp(kv, "capacity_mah")) p.capacity_mah = v;
+    else if (!strcmp(kv, "soc"))          p.soc = v;
+    else if (!strcmp(kv, "r"))            p.r_ohm = v;
+    else if (!strcmp(kv, "quiescent_a"))  p.quiescent_a = v;
+    else if (!strcmp(kv, "sleep_a"))      p.sleep_a = v;
+    else if (!strcmp(kv, "ambient"))      p.ambient_c = v;
+    else if (!strcmp(kv, "noise_mv"))     p.adc_noise_mv = v;
+    else if (!strcmp(kv, "dcdc_v"))       p.dcdc_v = v;
+    else if (!strcmp(kv, "dcdc_eff"))     p.dcdc_eff = v;
+    else return false;
+  }
+  return true;
+}
+
+static bool parseEvent(const char* verb, char* rest, Event& e) {
+  char* arg = strtok(rest, " \t");
+  e.on = false;
+  e.value = 0;
+  e.rate = 0;
+  e.alt = 0;
+  e.dwellUs = 0;
+  if (!strcmp(verb, "load")) {
+    e.verb = Event::LOAD;
+    if (!arg) return false;
+    e.value = strtof(arg, nullptr);
+    if (char* a = strtok(nullptr, " \t")) {
+      e.alt = strtof(a, nullptr);
+      char* d = strtok(nullptr, " \t");
+      if (!d || !parseTime(d, e.dwellUs) || e.dwellUs == 0) return false;
+    }
+  } else if (!strcmp(verb, "charger")) {
+    e.verb = Event::CHARGER;
+    if (!arg) return false;
+    e.on = !strcmp(arg, "on");
+    if (!e.on && strcmp(arg, "off")) return false;
+    if (char* a = strtok(nullptr, " \t")) e.value = strtof(a, nullptr);
+  } else if (!strcmp(verb, "button")) {
+    e.verb = Event::BUTTON;
+    if (!arg) return false;
+    e.on = !strcmp(arg, "down");
+    if (!e.on && strcmp(arg, "up")) return false;
+  } else if (!strcmp(verb, "ambient")) {
+    e.verb = Event::AMBIENT;
+    if (!arg) return false;
+    e.value = strtof(arg, nullptr);
+    if (char* a = strtok(nullptr, " \t")) e.rate = strtof(a, nullptr);
+  } else if (!strcmp(verb, "ntc")) {
+    e.verb = Event::NTC;
+    if (!arg) return false;
+    e.on = !strcmp(arg, "open");
+    if (!e.on && strcmp(arg, "ok")) return false;
+  } else if (!strcmp(verb, "i2c")) {
+    e.verb = Event::I2C;
+    if (!arg) return false;
+    e.on = !strcmp(arg, "fail");
+    if (!e.on && strcmp(arg, "ok")) return false;
+  } else if (!strcmp(verb, "bounce")) {
+    e.verb = Event::BOUNCE;
+    if (!arg) return false;
+    e.value = strtof(arg, nullptr);
+  } else if (!strcmp(verb, "bt")) {
+    e.verb = Event::BT;
+    if (!arg) return false;
+    if (!strcmp(arg, "lost")) { e.verb = Event::BT_LOST; return true; }
+    if (!strcmp(arg, "rate")) {
+      e.verb = Event::BT_RATE;
+      char* a = strtok(nullptr, " \t");
+      if (!a) return false;
+      e.value = strtof(a, nullptr);
+      return e.value >= 0;
+    }
+    e.on = !strcmp(arg, "connect");
+    if (!e.on && strcmp(arg, "disconnect")) return false;
+  } else if (!strcmp(verb, "usb")) {
+    e.verb = Event::USB;
+    if (!arg) return false;
+    e.on = !strcmp(arg, "stall");
+    if (!e.on && strcmp(arg, "ok")) return false;
+  } else if (!strcmp(verb, "sink")) {
+    e.verb = Event::SINK;
+    if (!arg) return false;
+    e.on = !strcmp(arg, "bin");
+    if (!e.on && strcmp(arg, "json")) return false;
+  } else if (!strcmp(verb, "reset")) {
+    e.verb = Event::RESET;
+    e.value = ESP_RST_TASK_WDT;
+    if (!arg) return true;
+    for (const auto& r : RESETS) {
+      if (!strcmp(arg, r.name)) { e.value = (float)r.reason; return true; }
+    }
+    return false;
+  } else if (!strcmp(verb, "end")) {
+    e.verb = Event::END;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parseScenario(const char* text, Scenario& out, std::string& err) {
+  out = Scenario();
+  int lineNo = 0;
+  const char* p = text;
+  char buf[512];
+  char msg[64];
+
+  while (*p) {
+    const char* nl = strchr(p, '\n');
+    const size_t n = nl ? (size_t)(nl - p) : strlen(p);
+    lineNo++;
+    snprintf(buf, sizeof(buf), "%.*s", (int)std::min(n, sizeof(buf) - 1), p);
+    p += n + (nl ? 1 : 0);
+
+    char* s = buf;
+    while (isspace((unsigned char)*s)) s++;
+    if (*s == '\0' || *s == '#') continue;
+
+    char* sp = s;
+    while (*sp && !isspace((unsigned char)*sp)) sp++;
+    char* rest = *sp ? sp + 1 : sp;
+    *sp = '\0';
+    while (isspace((unsigned char)*rest)) rest++;
+
+    if (!strcmp(s, "name")) { out.name = rest; continue; }
+    if (!strcmp(s, "battery")) {
+      if (!setBattery(rest, out.battery)) {
+        snprintf(msg, sizeof(msg), "line %d: bad battery key", lineNo);
+        err = msg;
+        return false;
+      }
+      continue;
+    }
+
+    Event e;
+    if (!parseTime(s, e.us)) {
+      snprintf(msg, sizeof(msg), "line %d: bad time '%.16s'", lineNo, s);
+      err = msg;
+      return false;
+    }
+
+    char* verb = rest;
+    char* args = verb;
+    while (*args && !isspace((unsigned char)*args)) args++;
+    if (*args) *args++ = '\0';
+    while (isspace((unsigned char)*args)) args++;
+
+    if (!strcmp(verb, "send")) {
+      e.verb = Event::SEND;
+      e.on = false;
+      e.value = 0;
+      e.rate = 0;
+      e.text = args;
+    } else if (!parseEvent(verb, args, e)) {
+      snprintf(msg, sizeof(msg), "line %d: bad event '%.16s'", lineNo, verb);
+      err = msg;
+      return false;
+    }
+    out.events.push_back(e);
+    if (e.verb == Event::END) out.endUs = e.us;
+  }
+
+  if (out.endUs == 0) { err = "no 'end' event"; return false; }
+  std::stable_sort(out.events.begin(), out.events.end(),
+                   [](const Event& a, const Event& b) { return a.us < b.us; });
+  return true;
+}
+
+bool loadScenario(const char* path, Scenario& out, std::string& err) {
+  FILE* f = fopen(path, "r");
+  if (!f) { err = std::string("cannot open ") + path; return false; }
+  std::string text;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+  fclose(f);
+
+  if (!parseScenario(text.c_str(), out, err)) { err = std::string(path) + ": " + err; return false; }
+  if (out.name.empty()) {
+    const char* base = strrchr(path, '/');
+    out.name = base ? base + 1 : path;
+  }
+  return true;
+}
+
+} // namespace Sim
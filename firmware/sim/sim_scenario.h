@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "sim_model.h"
+
+// ------------------------------------------------------------
+// Scenario scripts: battery setup plus timed input events.
+//
+//   # comment
+//   name     charge_cc_cv
+//   battery  capacity_mah=2000 soc=0.2 r=0.08
+//   0s       charger on 1.0
+//   90m      load 0.3
+//   2h       ambient 45 0.5
+//   2h30m    bounce 20
+//   2h30m    button down
+//   2h30m3s  button up
+//   3h       send {"cmd":"get"}
+//   6h       end
+//
+// Times are absolute (h/m/s/ms, combinable). Verbs: load <A> [<A> <time>],
+// charger on [A] | off, button down | up, ambient <C> [C/min],
+// ntc open | ok, bounce <ms>, i2c fail | ok, bt connect | disconnect |
+// lost | rate <bytes/s> (disconnect: the client first reads what was
+// sent; lost: the link drops with whatever is still queued; rate 0 = no
+// limit), usb stall | ok (stall: no host reads the USB port),
+// sink json | bin (one more TlmBus transport, read and checked by the
+// sim; two at most, with --sink one),
+// reset [poweron | sw | panic | task_wdt | wdt | brownout],
+// send <json line>, end.
+// ------------------------------------------------------------
+namespace Sim {
+
+struct Event {
+  enum Verb { LOAD, CHARGER, BUTTON, AMBIENT, NTC, BOUNCE, I2C, BT, BT_LOST, BT_RATE, USB, SINK, RESET, SEND, END };
+  uint64_t    us;
+  Verb        verb;
+  bool        on;       // SINK: binary frames
+  float       value;    // RESET: esp_reset_reason_t, BT_RATE: bytes/s
+  float       rate;     // ambient ramp, C/min
+  float       alt;      // load square wave: second level, A
+  uint64_t    dwellUs;  //   and time at each level
+  std::string text;
+};
+
+struct Scenario {
+  std::string        name;
+  ModelParams        battery;
+  std::vector<Event> events;    // sorted by time
+  uint64_t           endUs = 0;
+};
+
+// Parse a script; on error returns false and sets err ("line N: ...")
+bool parseScenario(const char* text, Scenario& out, std::string& err);
+bool loadScenario(const char* path, Scenario& out, std::string& err);
+
+// Scripts compiled into the sim (name -> text), nullptr-terminated
+struct Builtin { const char* name; const char* text; };
+extern const Builtin BUILTINS[];
+
+} // namespace Sim
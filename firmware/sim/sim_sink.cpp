@@ -0,0 +1,194 @@
+#include "sim_sink.h"
+#include "sim_hal.h"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Sim {
+
+class FdSink : public TlmBus::Transport {
+public:
+  const char* name() const override { return name_; }
+  bool connected() override { return fd_ >= 0 && !stalled_; }
+
+  bool send(TlmBus::FrameBuf* f) override {
+    if (fd_ < 0 || count_ >= QLEN) return false;
+    if (count_ == 0) lastMs_ = millis();
+    TlmBus::retain(f);
+    q_[(head_ + count_) % QLEN] = f;
+    count_++;
+    return true;
+  }
+
+  void service() override {
+    HeapQuiet q;
+    if (listen_ >= 0 && fd_ < 0) {
+      fd_ = accept4(listen_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd_ >= 0) st_.clients++;
+    }
+    if (fd_ >= 0 && stalled_) {
+      pollfd p = { fd_, POLLOUT, 0 };
+      if (poll(&p, 1, 0) <= 0) return;
+      stalled_ = false;
+    }
+    while (fd_ >= 0 && count_ > 0) {
+      TlmBus::FrameBuf* f = q_[head_];
+      const ssize_t n = sock_ ? ::send(fd_, f->data + off_, f->len - off_, MSG_NOSIGNAL | MSG_DONTWAIT)
+                              : ::write(fd_, f->data + off_, f->len - off_);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          hangUp();   // the reader went away
+        } else if (millis() - lastMs_ >= STALL_MS) {
+          stalled_ = true;   // nobody reads: free the pool buffers, as UsbTransport does
+          drop();
+        }
+        return;
+      }
+      st_.bytes += (uint64_t)n;
+      off_ += (size_t)n;
+      lastMs_ = millis();
+      if (off_ < f->len) return;
+      pop();
+      st_.frames++;
+    }
+  }
+
+  void open(int fd, int listenFd, bool sock, TlmBus::Fmt f, const char* kind, size_t i) {
+    fd_ = fd;
+    listen_ = listenFd;
+    sock_ = sock;
+    fmt = f;
+    snprintf(name_, sizeof(name_), "%s%u", kind, (unsigned)i);
+  }
+
+  bool empty() const { return count_ == 0; }
+  SinkStats stats() const { return st_; }
+
+  void close() {
+    if (fd_ >= 0) ::close(fd_);
+    if (listen_ >= 0) ::close(listen_);
+    fd_ = listen_ = -1;
+    stalled_ = false;
+    drop();
+  }
+
+private:
+  // the frames a sink holds come out of TlmBus' small pool
+  static constexpr size_t   QLEN = 3;
+  static constexpr uint32_t STALL_MS = 2000;
+
+  void pop() {
+    TlmBus::release(q_[head_]);
+    q_[head_] = nullptr;
+    head_ = (head_ + 1) % QLEN;
+    count_--;
+    off_ = 0;
+  }
+
+  void drop() {
+    while (count_ > 0) pop();
+  }
+
+  // a socket waits for the next client; a pair or pty is done
+  void hangUp() {
+    ::close(fd_);
+    fd_ = -1;
+    stalled_ = false;
+    drop();
+  }
+
+  TlmBus::FrameBuf* q_[QLEN] = {nullptr};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  size_t off_ = 0;
+  int fd_ = -1;
+  int listen_ = -1;
+  uint32_t lastMs_ = 0;
+  bool sock_ = false;
+  bool stalled_ = false;
+  char name_[12] = "";
+  SinkStats st_ = {};
+};
+
+static FdSink s_sinks[MAX_SINKS];
+static size_t s_sinkCount = 0;
+
+static FdSink* next() {
+  return s_sinkCount < MAX_SINKS ? &s_sinks[s_sinkCount] : nullptr;
+}
+
+TlmBus::Transport* sinkListen(const char* path, TlmBus::Fmt fmt) {
+  FdSink* s = next();
+  if (!s || strlen(path) >= sizeof(sockaddr_un::sun_path)) return nullptr;
+  const int l = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (l < 0) return nullptr;
+  sockaddr_un a = {};
+  a.sun_family = AF_UNIX;
+  snprintf(a.sun_path, sizeof(a.sun_path), "%s", path);
+  unlink(path);
+  if (bind(l, (const sockaddr*)&a, sizeof(a)) != 0 || listen(l, 1) != 0) {
+    ::close(l);
+    return nullptr;
+  }
+  s->open(-1, l, true, fmt, "sock", s_sinkCount++);
+  return s;
+}
+
+TlmBus::Transport* sinkPty(TlmBus::Fmt fmt, char* path, size_t cap) {
+  FdSink* s = next();
+  int master = -1, slave = -1;
+  char name[64];
+  if (!s || openpty(&master, &slave, name, nullptr, nullptr) != 0) return nullptr;
+  // raw, or the line discipline turns the binary frames' bytes into something else
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  snprintf(path, cap, "%s", name);
+  // the slave stays open so the master never sees EOF between readers
+  s->open(master, -1, false, fmt, "pty", s_sinkCount++);
+  return s;
+}
+
+TlmBus::Transport* sinkPair(TlmBus::Fmt fmt, int* peer) {
+  FdSink* s = next();
+  int sv[2];
+  if (!s || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) return nullptr;
+  fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+  *peer = sv[1];
+  s->open(sv[0], -1, true, fmt, "sink", s_sinkCount++);
+  return s;
+}
+
+SinkStats sinkStats(const TlmBus::Transport* t) {
+  return static_cast<const FdSink*>(t)->stats();
+}
+
+bool sinkFlush(TlmBus::Transport* t, uint32_t timeoutMs) {
+  FdSink* s = static_cast<FdSink*>(t);
+  const auto t0 = std::chrono::steady_clock::now();
+  for (;;) {
+    s->service();
+    if (s->empty() || !s->connected()) return s->empty();
+    if (std::chrono::steady_clock::now() - t0 >= std::chrono::milliseconds(timeoutMs)) return false;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+}
+
+void sinkClose(TlmBus::Transport* t, uint32_t timeoutMs) {
+  sinkFlush(t, timeoutMs);
+  static_cast<FdSink*>(t)->close();
+}
+
+} // namespace Sim
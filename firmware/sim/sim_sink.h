@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "tlm_bus.h"
+
+// ------------------------------------------------------------
+// Host stand-in transports for TlmBus, next to BT and USB: telemetry
+// on a Unix socket, a pseudo terminal or a socketpair the sim reads
+// itself. A sink queues references to the frames it is sent and writes
+// what the non-blocking fd takes in service() (the "tlm_bus" task), as
+// UsbTransport does with the UART: a slow reader costs dropped frames,
+// never a blocked loop(), and one that takes nothing for 2 s is passed
+// by until the fd takes bytes again.
+// ------------------------------------------------------------
+namespace Sim {
+
+// TlmBus takes this many transports in all; in the sim BT and USB are two
+static constexpr size_t MAX_SINKS = TlmBus::MAX_TRANSPORTS;
+
+struct SinkStats {
+  uint64_t bytes;     // written to the fd
+  uint32_t frames;    //   whole frames
+  uint32_t clients;   // connections (a socket takes one client at a time)
+};
+
+// Listens on a Unix socket at path (e.g. socat - UNIX-CONNECT:path);
+// connected() while a client is. nullptr if it can't.
+TlmBus::Transport* sinkListen(const char* path, TlmBus::Fmt fmt);
+// Pseudo terminal, path set to the slave's name; always connected
+TlmBus::Transport* sinkPty(TlmBus::Fmt fmt, char* path, size_t cap);
+// socketpair; *peer is the reading end, for the caller
+TlmBus::Transport* sinkPair(TlmBus::Fmt fmt, int* peer);
+
+SinkStats sinkStats(const TlmBus::Transport* t);
+// Writes out what is queued, up to timeoutMs of real time; true once empty
+bool sinkFlush(TlmBus::Transport* t, uint32_t timeoutMs);
+// Flushes and closes the fd (the reader sees EOF); from then on the sink
+// is not connected() and TlmBus passes it by
+void sinkClose(TlmBus::Transport* t, uint32_t timeoutMs);
+
+} // namespace Sim
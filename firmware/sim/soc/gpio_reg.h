@@ -0,0 +1,8 @@
+#pragma once
+// Native simulator: the ESP32 GPIO registers for GPIO 0..31
+#include "soc/soc.h"
+
+#define GPIO_OUT_REG      0x3FF44004
+#define GPIO_OUT_W1TS_REG 0x3FF44008
+#define GPIO_OUT_W1TC_REG 0x3FF4400C
+#define GPIO_IN_REG       0x3FF4403C
@@ -0,0 +1,10 @@
+#pragma once
+// Native simulator: register access. Only the GPIO output set/clear and
+// input registers do anything (see sim_hal.cpp), the rest is ignored.
+#include <stdint.h>
+
+void     simRegWrite(uint32_t reg, uint32_t val);
+uint32_t simRegRead(uint32_t reg);
+
+#define REG_WRITE(reg, val) simRegWrite((uint32_t)(reg), (uint32_t)(val))
+#define REG_READ(reg)       simRegRead((uint32_t)(reg))
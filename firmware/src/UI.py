@@ -415,7 +415,11 @@ def worker():
             for s in objs:
                 try:
                     pkt = json.loads(s)
-                    if isinstance(pkt, dict):
+                    if isinstance(pkt, dict) and "ack" in pkt:
+                        # command reply, not telemetry
+                        with state_lock:
+                            latest_parse_msg = f"Ack {pkt.get('ack')}: {pkt.get('msg')}"
+                    elif isinstance(pkt, dict):
                         with state_lock:
                             latest_pkt = pkt
                             latest_parse_msg = f"Parsed OK ✅ keys={len(pkt.keys())}"
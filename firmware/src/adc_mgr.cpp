@@ -2,6 +2,8 @@
 #include "pins.h"
 #include <math.h>
 #include "esp_timer.h"
+#include "time_mgr.h"
+#include "prof_mgr.h"
 
 static esp_timer_handle_t s_adc_timer = nullptr;
 
@@ -14,6 +16,7 @@ static const int CH_PINS[NUM_CH] = {
   PIN_ADC_BATT_CHG,
   PIN_ADC_BATT_DSG
 };
+static constexpr uint8_t CH_LOAD = 2;   // LOAD, BCHG, BDSG: the current channels
 
 static void timerCb(void *arg) {
   // Timer context: DO NOT read ADC here. Just schedule.
@@ -32,6 +35,7 @@ static void timerCbThin(void *arg) {
 }
 
 void ADCMgr::begin() {
+  s_adc_timer = nullptr;   // a fresh boot has no timer yet
   analogReadResolution(12);
 
   // ADC attenuation: 11dB gives range 0-3.9V with ~150mV sensitivity loss
@@ -41,6 +45,13 @@ void ADCMgr::begin() {
   analogSetPinAttenuation(PIN_ADC_LOAD_DSG, ADC_11db);
   analogSetPinAttenuation(PIN_ADC_BATT_CHG, ADC_11db);
   analogSetPinAttenuation(PIN_ADC_BATT_DSG, ADC_11db);
+
+  rate_ = Rate::Normal;
+  rate_since_us_ = TimeMgr::nowUs();
+  for (uint64_t& t : rate_us_) t = 0;
+  bursts_ = 0;
+  reads_ = 0;
+  busy_us_ = 0;
 }
 
 void ADCMgr::setZeroOffsetsMv(int load0_mv, int bchg0_mv, int bdsg0_mv) {
@@ -63,21 +74,16 @@ int ADCMgr::readMilliVoltsAvg(int pin, int samples) {
   return (int)(sum / samples);
 }
 
-float ADCMgr::currentFromMv(int mv, float gain) {
-  return (mv / 1000.0f) / (gain * SHUNT_SENSE_OHMS);
-}
-
-
 float ADCMgr::ntcTempFromMv(int mv_node)
 {
-    const float VREF = 3.0f;
+    const float VREF = Profile::BOARD.ntcVref;
     const float T0   = 298.15f;   // 25°C in Kelvin
 
     float v = mv_node / 1000.0f;
 
     // enforce ADC validity
     if (v <= 0.150f || v >= (VREF - 0.01f))
-        return NULL;                                             /// changed the Nan to NULL
+        return NAN;     // open / shorted NTC: ThermalMgr counts it as a fault
 
     // Divider: Rfixed on top, NTC to GND
     float r_ntc = ntc_r_fixed * (v / (VREF - v));
@@ -96,8 +102,7 @@ void ADCMgr::sample(AdcReadings &out, int samples) {
   out.mv_vmid_sys = readMilliVoltsAvg(PIN_ADC_VOLT, samples);
   out.mv_ntc_sys  = readMilliVoltsAvg(PIN_ADC_NTC,  samples);
 
-  out.vbat_meas_sys_v = (out.mv_vmid_sys / 1000.0f) * VIN_SCALE;
-   out.vbat_meas_sys_v=out.vbat_meas_sys_v+0.037;                              //calibration offset  for the Vbattery is 37mV manually added
+  out.vbat_meas_sys_v = (out.mv_vmid_sys / 1000.0f) * VIN_SCALE + VBAT_OFF_V;
 
   out.temp_c = ntcTempFromMv(out.mv_ntc_sys);
 
@@ -110,9 +115,9 @@ void ADCMgr::sample(AdcReadings &out, int samples) {
   out.mv_bchg = applyZeroAndFloor(raw_bchg, zero_bchg_mv);
   out.mv_bdsg = applyZeroAndFloor(raw_bdsg, zero_bdsg_mv);
 
-  out.iload_a     = max(0.0f, currentFromMv(out.mv_load, GAIN_LOAD) + 0.015f);
-  out.ibatt_chg_a = max(0.0f, currentFromMv(out.mv_bchg, GAIN_BATT) + 0.020f);
-  out.ibatt_dsg_a = max(0.0f, currentFromMv(out.mv_bdsg, GAIN_BATT) + 0.040f);
+  out.iload_a     = max(0.0f, currentFromMv(out.mv_load, A_PER_MV_LOAD) + Profile::BOARD.offLoadA);
+  out.ibatt_chg_a = max(0.0f, currentFromMv(out.mv_bchg, A_PER_MV_BATT) + Profile::BOARD.offChgA);
+  out.ibatt_dsg_a = max(0.0f, currentFromMv(out.mv_bdsg, A_PER_MV_BATT) + Profile::BOARD.offDsgA);
 }
 
 // ---- Timer-driven part ----
@@ -126,9 +131,30 @@ void adcTickCb(void *arg) {
 
 
 bool ADCMgr::startTimer(uint32_t tick_us, int samples_per_channel) {
+  if (samples_per_channel <= 0) samples_per_channel = 1;
+  if (tick_us == 0) tick_us = 2000; // default safe
+  base_tick_us_ = tick_us;
+  base_spc_ = samples_per_channel;
+
+  // a new base rate starts from Normal with no step reference
+  if (rate_ != Rate::Normal) {
+    const uint64_t now = TimeMgr::nowUs();
+    rate_us_[(int)rate_] += now - rate_since_us_;
+    rate_since_us_ = now;
+    rate_ = Rate::Normal;
+  }
+  busy_since_us_ = TimeMgr::nowUs();
+  have_frame_ = false;
+  load_skip_ = false;
+  for (int i = 0; i < NUM_CH; i++) latest_mv_[i] = 0;
+
+  return restartTimer(tick_us, samples_per_channel);
+}
+
+// Rate change: the frame in progress is dropped, latest_mv_ stays
+bool ADCMgr::restartTimer(uint32_t tick_us, int samples_per_channel) {
   stopTimer();
 
-  if (samples_per_channel <= 0) samples_per_channel = 1;
   samples_per_ch_ = samples_per_channel;
 
   // reset state
@@ -137,72 +163,191 @@ bool ADCMgr::startTimer(uint32_t tick_us, int samples_per_channel) {
   samp_ = 0;
   for (int i = 0; i < NUM_CH; i++) {
     sum_[i] = 0;
-    latest_mv_[i] = 0;
+    over_[i] = 0;
   }
-  latest_ready_ = false;
-
-  if (tick_us == 0) tick_us = 2000; // default safe
-
-  esp_timer_create_args_t args = {};
-  args.callback = &adcTickCb;
-  args.arg = this;
-  args.dispatch_method = ESP_TIMER_TASK;
-  args.name = "adc_sched";
-
-  if (esp_timer_create(&args, &s_adc_timer) != ESP_OK) {
-    s_adc_timer = nullptr;
-    return false;
-  }
-  if (esp_timer_start_periodic(s_adc_timer, tick_us) != ESP_OK) {
-    esp_timer_delete(s_adc_timer);
-    s_adc_timer = nullptr;
-    return false;
+  load_over_ = 0;
+
+  tick_us_ = tick_us;
+
+  // Created once and then only restarted: esp_timer_create() allocates,
+  // and a rate change comes from a BT command or the adaptive rate at runtime
+  if (!s_adc_timer) {
+    esp_timer_create_args_t args = {};
+    args.callback = &adcTickCb;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "adc_sched";
+
+    if (esp_timer_create(&args, &s_adc_timer) != ESP_OK) {
+      s_adc_timer = nullptr;
+      return false;
+    }
   }
-  return true;
+  return esp_timer_start_periodic(s_adc_timer, tick_us) == ESP_OK;
 }
 
 void ADCMgr::stopTimer() {
-  if (s_adc_timer) {
-    esp_timer_stop(s_adc_timer);
-    esp_timer_delete(s_adc_timer);
-    s_adc_timer = nullptr;
-  }
+  if (s_adc_timer) esp_timer_stop(s_adc_timer);
 }
 
 void ADCMgr::service(uint8_t max_reads_per_call) {
-  if (max_reads_per_call == 0) return;
+  if (src_) src_->service();
+  if (max_reads_per_call == 0 || pending_ticks_ == 0) return;
+  PROF_ZONE(ProfMgr::Z_ADC_SERVICE);   // only calls that read something
+  const uint64_t t0 = TimeMgr::nowUs();
 
   // Consume a limited number of scheduled ticks to keep loop responsive
   while (pending_ticks_ > 0 && max_reads_per_call--) {
     pending_ticks_--;
 
-    // One ADC read per tick
-    delayMicroseconds(esp_random() & 0x3FF); // jitter
-int mv = analogReadMilliVolts(CH_PINS[ch_]);
+    // One ADC read per tick, the channels round-robin: every channel's
+    // average spans the whole frame, and a current step shows within 5 ticks.
+    // Burst reads at 1 kHz for a short frame, no room for the jitter.
+    if (jitter_ && rate_ != Rate::Burst) delayMicroseconds(esp_random() & 0x3FF); // jitter
+    const uint8_t ch = ch_;
+    int mv = analogReadMilliVolts(CH_PINS[ch]);
+    reads_++;
+
+    sum_[ch] += (uint32_t)mv;
+    const uint64_t now = TimeMgr::nowUs();
+    if (raw_sink_) raw_sink_(ch, mv, (uint32_t)now);
+    if (ch == CH_LOAD && step_sink_) watchLoad(mv, now);
+
+    if (watchStep(ch, mv, now)) {
+      setRate(Rate::Burst);   // a fresh frame at the burst rate
+      break;
+    }
+
+    if (++ch_ < NUM_CH) continue;
+    ch_ = 0;
+    if (++samp_ < samples_per_ch_) continue;
+
+    // every channel has its samples: finalize the frame
+    samp_ = 0;
+    for (int i = 0; i < NUM_CH; i++) {
+      latest_mv_[i] = (int)(sum_[i] / (uint32_t)samples_per_ch_);
+      sum_[i] = 0;
+    }
+    have_frame_ = true;
+    if (load_skip_) load_skip_ = false;
+    else            load_lvl_mv_ = latest_mv_[CH_LOAD];
+
+    // no free slot (consumers holding them all): frame lost, counted
+    AdcReadings* out = bus_.claim();
+    if (!out) continue;
+    convertLatest(*out);
+    const Rate next = frameRate(*out, now);
+    bus_.commit();
+    if (next != rate_) {
+      setRate(next);
+      break;
+    }
+  }
+  busy_us_ += TimeMgr::nowUs() - t0;
+}
 
-    sum_[ch_] += (uint32_t)mv;
+// ---- Adaptive rate ----
+void ADCMgr::setAdapt(const AdcAdaptConfig& cfg) {
+  adapt_ = cfg;
+  for (int i = 0; i < NUM_CH; i++) {
+    const float aPerMv = (i == CH_LOAD) ? A_PER_MV_LOAD : A_PER_MV_BATT;
+    step_mv_[i] = (i < CH_LOAD) ? 0 : (int)(cfg.stepA / aPerMv + 0.5f);
+  }
+  if (!cfg.enabled && !held_ && rate_ != Rate::Normal) setRate(Rate::Normal);
+}
 
-    samp_++;
-    if (samp_ >= samples_per_ch_) {
-      // finalize this channel
-      latest_mv_[ch_] = (int)(sum_[ch_] / (uint32_t)samples_per_ch_);
-      sum_[ch_] = 0;
+void ADCMgr::burst() {
+  if (!adapt_.enabled || held_) return;
+  step_us_ = busy_since_us_ = TimeMgr::nowUs();
+  if (rate_ != Rate::Burst) setRate(Rate::Burst);
+}
 
-      samp_ = 0;
-      ch_++;
+// Per read: true when a step should start a burst. In Burst a step only
+// extends it.
+bool ADCMgr::watchStep(uint8_t ch, int mv, uint64_t now) {
+  if (ch < CH_LOAD || !have_frame_ || !adapt_.enabled || held_) return false;
+  const int d = mv - latest_mv_[ch];
+  if (d <= step_mv_[ch] && d >= -step_mv_[ch]) {
+    over_[ch] = 0;
+    return false;
+  }
+  if (++over_[ch] < STEP_READS) return false;
+  over_[ch] = 0;
+  step_us_ = busy_since_us_ = now;
+  return rate_ != Rate::Burst;
+}
 
-      if (ch_ >= NUM_CH) {
-        ch_ = 0;
-        latest_ready_ = true;
-      }
-    }
+// Per load read: a step off the load level, reported once. After a step
+// the level is the step's own reads, until a frame has averaged only the
+// new current.
+void ADCMgr::watchLoad(int mv, uint64_t now) {
+  const int step = step_mv_[CH_LOAD];
+  if (!have_frame_ || step <= 0) return;
+  const int d = mv - load_lvl_mv_;
+  if (d <= step && d >= -step) {
+    load_over_ = 0;
+    return;
   }
+  const bool up = d > 0;
+  if (load_over_ == 0 || up != load_up_) {
+    load_over_ = 0;
+    load_sum_mv_ = 0;
+    load_up_ = up;
+    load_first_us_ = now;
+  }
+  load_sum_mv_ += mv;
+  if (++load_over_ < STEP_READS) return;
+
+  const int lvl = load_sum_mv_ / load_over_;
+  step_sink_((lvl - load_lvl_mv_) * A_PER_MV_LOAD, load_first_us_);
+  load_lvl_mv_ = lvl;
+  load_over_ = 0;
+  load_skip_ = true;
+}
+
+// Per frame: the rate the next one should run at
+ADCMgr::Rate ADCMgr::frameRate(const AdcReadings& d, uint64_t now) {
+  if (!adapt_.enabled || held_) return rate_;
+  const bool quiet = d.iload_a < adapt_.idleA && d.ibatt_chg_a < adapt_.idleA;
+  if (!quiet) busy_since_us_ = now;
+
+  switch (rate_) {
+    case Rate::Burst:
+      return (now - step_us_ >= (uint64_t)adapt_.burstMs * 1000) ? Rate::Normal : Rate::Burst;
+    case Rate::Normal:
+      return (now - busy_since_us_ >= (uint64_t)adapt_.idleMs * 1000) ? Rate::Idle : Rate::Normal;
+    case Rate::Idle:
+      return quiet ? Rate::Idle : Rate::Normal;   // crept up without a step
+  }
+  return rate_;
 }
 
-bool ADCMgr::fetchLatest(AdcReadings &out) {
-  if (!latest_ready_) return false;
-  latest_ready_ = false;
+void ADCMgr::setRate(Rate r) {
+  const uint64_t now = TimeMgr::nowUs();
+  rate_us_[(int)rate_] += now - rate_since_us_;
+  rate_since_us_ = now;
+  rate_ = r;
+  switch (r) {
+    case Rate::Idle:   restartTimer(adapt_.idleTickUs, adapt_.idleSpc); break;
+    case Rate::Normal: busy_since_us_ = now;   // idleMs counts from here
+                       restartTimer(base_tick_us_, base_spc_); break;
+    case Rate::Burst:  bursts_++;
+                       restartTimer(adapt_.burstTickUs, adapt_.burstSpc); break;
+  }
+}
 
+uint64_t ADCMgr::rateUs(Rate r) const {
+  uint64_t t = rate_us_[(int)r];
+  if (r == rate_) t += TimeMgr::nowUs() - rate_since_us_;
+  return t;
+}
+
+const char* ADCMgr::rateName(Rate r) {
+  static const char* const NAMES[RATE_COUNT] = { "idle", "normal", "burst" };
+  return NAMES[(int)r];
+}
+
+void ADCMgr::convertLatest(AdcReadings &out) {
   // Map channels
   const int mv_vmid = latest_mv_[0];
   const int mv_ntc  = latest_mv_[1];
@@ -213,7 +358,7 @@ bool ADCMgr::fetchLatest(AdcReadings &out) {
   out.mv_vmid_sys = mv_vmid;
   out.mv_ntc_sys  = mv_ntc;
 
-  out.vbat_meas_sys_v = (out.mv_vmid_sys / 1000.0f) * VIN_SCALE;
+  out.vbat_meas_sys_v = (out.mv_vmid_sys / 1000.0f) * VIN_SCALE + VBAT_OFF_V;
   out.temp_c = ntcTempFromMv(out.mv_ntc_sys);
 
   // Use YOUR intended floor compensation
@@ -221,9 +366,8 @@ bool ADCMgr::fetchLatest(AdcReadings &out) {
   out.mv_bchg = applyZeroAndFloor(raw_bchg, zero_bchg_mv);
   out.mv_bdsg = applyZeroAndFloor(raw_bdsg, zero_bdsg_mv);
 int mv = analogReadMilliVolts(CH_PINS[ch_]);  // ← This uses 3.3V calibration
-  out.iload_a     = max(0.0f, currentFromMv(out.mv_load, GAIN_LOAD) + 0.015f);
-  out.ibatt_chg_a = max(0.0f, currentFromMv(out.mv_bchg, GAIN_BATT) + 0.020f);
-  out.ibatt_dsg_a = max(0.0f, currentFromMv(out.mv_bdsg, GAIN_BATT) + 0.040f);
-
-  return true;
+  out.iload_a     = max(0.0f, currentFromMv(out.mv_load, A_PER_MV_LOAD) + Profile::BOARD.offLoadA);
+  out.ibatt_chg_a = max(0.0f, currentFromMv(out.mv_bchg, A_PER_MV_BATT) + Profile::BOARD.offChgA);
+  out.ibatt_dsg_a = max(0.0f, currentFromMv(out.mv_bdsg, A_PER_MV_BATT) + Profile::BOARD.offDsgA);
+  if (src_) src_->fill(out);
 }
@@ -1,18 +1,197 @@
 #include "bt_mgr.h"
 #include "BluetoothSerial.h"
 #include <stdarg.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 static BluetoothSerial SerialBT;
 static bool btInitDone = false;
 
 namespace BtMgr {
 
+// ------------------------------------------------------------
+// TX queue
+// Two byte rings of length-prefixed frames. loop() only memcpy's into
+// them; a separate task drains them into SerialBT, replies first.
+// ------------------------------------------------------------
+static constexpr size_t TX_TLM_BYTES   = 4096;
+static constexpr size_t TX_REPLY_BYTES = 1024;
+static constexpr size_t TX_MAX_FRAME   = MAX_FRAME;   // = printf buffer
+static constexpr size_t LEN_HDR        = 2;
+
+static constexpr uint32_t TX_TASK_STACK = 3072;
+static constexpr UBaseType_t TX_TASK_PRIO = 1;
+static constexpr BaseType_t  TX_TASK_CORE = 0;  // loop() runs on core 1
+
+struct TxRing {
+  uint8_t* buf;
+  size_t   cap;
+  size_t   head;   // write index
+  size_t   tail;   // read index
+  size_t   used;
+  size_t   frames;
+};
+
+static uint8_t s_tlmMem[TX_TLM_BYTES];
+static uint8_t s_replyMem[TX_REPLY_BYTES];
+static TxRing  s_tlm   = { s_tlmMem,   sizeof(s_tlmMem),   0, 0, 0, 0 };
+static TxRing  s_reply = { s_replyMem, sizeof(s_replyMem), 0, 0, 0, 0 };
+
+static portMUX_TYPE s_txMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_txTask = nullptr;
+static TxStats s_stats = {};
+static bool s_txBusy = false;   // the TX task holds a dequeued frame (flush())
+
+static void ringPut(TxRing& r, const uint8_t* src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    r.buf[r.head] = src[i];
+    if (++r.head == r.cap) r.head = 0;
+  }
+  r.used += n;
+}
+
+static void ringGet(TxRing& r, uint8_t* dst, size_t n) {
+  if (!dst) {   // skip
+    r.tail = (r.tail + n) % r.cap;
+    r.used -= n;
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = r.buf[r.tail];
+    if (++r.tail == r.cap) r.tail = 0;
+  }
+  r.used -= n;
+}
+
+static size_t ringFrontLen(TxRing& r) {
+  if (r.used < LEN_HDR) return 0;
+  size_t t = r.tail;
+  uint8_t lo = r.buf[t];
+  if (++t == r.cap) t = 0;
+  uint8_t hi = r.buf[t];
+  return (size_t)lo | ((size_t)hi << 8);
+}
+
+// Caller holds s_txMux. Drops the oldest frame, returns its payload size.
+static size_t ringDropFront(TxRing& r) {
+  size_t n = ringFrontLen(r);
+  ringGet(r, nullptr, LEN_HDR + n);
+  r.frames--;
+  return n;
+}
+
+static void ringClear(TxRing& r) {
+  r.head = r.tail = r.used = r.frames = 0;
+}
+
+static size_t ringPayload(const TxRing& r) {
+  return r.used - r.frames * LEN_HDR;
+}
+
+static bool enqueue(const uint8_t* data, size_t len, TxPrio prio) {
+  if (!data || len == 0) return true;
+
+  TxRing& r = (prio == TxPrio::Reply) ? s_reply : s_tlm;
+  const size_t need = LEN_HDR + len;
+  bool ok = true;
+
+  portENTER_CRITICAL(&s_txMux);
+  if (len > TX_MAX_FRAME || need > r.cap) {
+    ok = false;
+  } else if (prio == TxPrio::Telemetry) {
+    // Stale telemetry is worthless: make room by evicting the oldest
+    while (r.cap - r.used < need) {
+      size_t dropped = ringDropFront(r);
+      s_stats.droppedBytes += dropped;
+      s_stats.droppedFrames++;
+    }
+  } else if (r.cap - r.used < need) {
+    ok = false;
+  }
+
+  if (ok) {
+    const uint8_t hdr[LEN_HDR] = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    ringPut(r, hdr, LEN_HDR);
+    ringPut(r, data, len);
+    r.frames++;
+    s_stats.queuedBytes += len;
+    s_stats.queuedFrames++;
+  } else {
+    s_stats.rejectedBytes += len;
+    s_stats.rejectedFrames++;
+  }
+  portEXIT_CRITICAL(&s_txMux);
+
+  if (ok && s_txTask) xTaskNotifyGive(s_txTask);
+  return ok;
+}
+
+// Pops one frame (replies first) into out. Returns payload length, 0 if none.
+static size_t dequeue(uint8_t* out) {
+  size_t n = 0;
+  portENTER_CRITICAL(&s_txMux);
+  TxRing* r = (s_reply.used > 0) ? &s_reply : (s_tlm.used > 0 ? &s_tlm : nullptr);
+  if (r) {
+    n = ringFrontLen(*r);
+    ringGet(*r, nullptr, LEN_HDR);
+    ringGet(*r, out, n);
+    r->frames--;
+    s_txBusy = true;
+  }
+  portEXIT_CRITICAL(&s_txMux);
+  return n;
+}
+
+// Caller holds s_txMux
+static void flushRing(TxRing& r) {
+  s_stats.droppedBytes += ringPayload(r);
+  s_stats.droppedFrames += r.frames;
+  ringClear(r);
+}
+
+static void flushQueues() {
+  portENTER_CRITICAL(&s_txMux);
+  flushRing(s_tlm);
+  flushRing(s_reply);
+  portEXIT_CRITICAL(&s_txMux);
+}
+
+static void txTask(void*) {
+  static uint8_t frame[TX_MAX_FRAME];
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+
+    if (!connected()) {
+      flushQueues();
+      continue;
+    }
+
+    size_t n;
+    while ((n = dequeue(frame)) > 0) {
+      const uint32_t t0 = micros();
+      SerialBT.write(frame, n);   // may block on a congested link - fine here
+      const uint32_t blocked = micros() - t0;
+
+      portENTER_CRITICAL(&s_txMux);
+      s_stats.sentBytes += n;
+      s_stats.sentFrames++;
+      if (blocked > s_stats.maxBlockUs) s_stats.maxBlockUs = blocked;
+      s_txBusy = false;
+      portEXIT_CRITICAL(&s_txMux);
+    }
+  }
+}
+
 void begin(const char* deviceName) {
   if (btInitDone) return;
   SerialBT.enableSSP();
   SerialBT.setPin("1234"); // optional
   SerialBT.begin(deviceName);
   btInitDone = true;
+
+  xTaskCreatePinnedToCore(txTask, "bt_tx", TX_TASK_STACK, nullptr,
+                          TX_TASK_PRIO, &s_txTask, TX_TASK_CORE);
 }
 
 bool connected() {
@@ -21,25 +200,76 @@ bool connected() {
 
 // -------- TX ----------
 void print(const char* s) {
-  if (connected()) SerialBT.print(s);
+  if (connected() && s) enqueue((const uint8_t*)s, strlen(s), TxPrio::Telemetry);
 }
 
+// Format buffer for println / printf / reply. Static rather than 1 KB
+// on the caller's stack; those calls come from the loop task only.
+// IMPORTANT: big enough so JSON doesn't truncate
+static char s_fmtBuf[TX_MAX_FRAME];
+
 void println(const char* s) {
-  if (connected()) SerialBT.println(s);
+  if (!connected() || !s) return;
+  int n = snprintf(s_fmtBuf, sizeof(s_fmtBuf), "%s\r\n", s);
+  if (n > 0) enqueue((const uint8_t*)s_fmtBuf, min((size_t)n, sizeof(s_fmtBuf) - 1), TxPrio::Telemetry);
+}
+
+static void vqueue(TxPrio prio, const char* fmt, va_list args) {
+  int n = vsnprintf(s_fmtBuf, sizeof(s_fmtBuf), fmt, args);
+  if (n <= 0) return;
+  enqueue((const uint8_t*)s_fmtBuf, min((size_t)n, sizeof(s_fmtBuf) - 1), prio);
 }
 
 void printf(const char* fmt, ...) {
   if (!connected()) return;
 
-  // IMPORTANT: big enough so JSON doesn't truncate
-  char buf[1024];
+  va_list args;
+  va_start(args, fmt);
+  vqueue(TxPrio::Telemetry, fmt, args);
+  va_end(args);
+}
+
+void reply(const char* fmt, ...) {
+  if (!connected()) return;
 
   va_list args;
   va_start(args, fmt);
-  vsnprintf(buf, sizeof(buf), fmt, args);
+  vqueue(TxPrio::Reply, fmt, args);
   va_end(args);
+}
 
-  SerialBT.print(buf);
+bool write(const uint8_t* data, size_t len, TxPrio prio) {
+  if (!connected()) return false;
+  return enqueue(data, len, prio);
+}
+
+TxStats txStats() {
+  portENTER_CRITICAL(&s_txMux);
+  TxStats st = s_stats;
+  st.pendingBytes = ringPayload(s_tlm) + ringPayload(s_reply);
+  st.pendingFrames = s_tlm.frames + s_reply.frames;
+  portEXIT_CRITICAL(&s_txMux);
+  return st;
+}
+
+bool flush(uint32_t timeoutMs) {
+  const uint32_t t0 = millis();
+  for (;;) {
+    portENTER_CRITICAL(&s_txMux);
+    const bool empty = s_tlm.used + s_reply.used == 0 && !s_txBusy;
+    portEXIT_CRITICAL(&s_txMux);
+    if (empty) return true;
+    if (!connected() || millis() - t0 >= timeoutMs) return false;
+    delay(1);
+  }
+}
+
+size_t txFree(TxPrio prio) {
+  portENTER_CRITICAL(&s_txMux);
+  const TxRing& r = (prio == TxPrio::Reply) ? s_reply : s_tlm;
+  size_t free = r.cap - r.used;
+  portEXIT_CRITICAL(&s_txMux);
+  return free > LEN_HDR ? free - LEN_HDR : 0;
 }
 
 // -------- RX (NEW) ----------
@@ -53,35 +283,74 @@ int read() {
   return SerialBT.read();
 }
 
-// Reads one line ending with '\n'. Returns number of bytes copied (excluding '\0').
-// If no full line yet, returns 0 (keeps partial data in internal buffer of BTSerial).
-size_t readLine(char* out, size_t outLen) {
-  if (!connected() || outLen < 2) return 0;
+static constexpr size_t RX_LINE_BYTES = 256;
+static char   s_rxLine[RX_LINE_BYTES];
+static size_t s_rxLen = 0;
+static bool   s_rxOverflow = false;   // discard until the next '\n'
+
+static TlmProto::Decoder s_rxDec;
+static FrameFn s_frameFn = nullptr;
+static bool    s_rxInFrame = false;   // after an opening 0x00
+static size_t  s_rxFrameLen = 0;
+
+void onFrame(FrameFn fn) { s_frameFn = fn; }
+const TlmProto::Decoder& rxFrames() { return s_rxDec; }
+
+// One byte of an open frame; false once the frame is closed
+static bool frameByte(uint8_t c) {
+  if (c == 0x00 && s_rxFrameLen == 0) return true;   // back-to-back openers
+  s_rxFrameLen++;
+  if (s_rxDec.push(c) && s_frameFn) s_frameFn(s_rxDec);
+  if (c != 0x00) return true;
+  s_rxFrameLen = 0;
+  return false;
+}
+
+char* readLine(size_t* lenOut) {
+  if (!connected()) {
+    s_rxLen = 0;
+    if (s_rxInFrame) s_rxDec.push(0x00);   // drops the torn frame
+    s_rxInFrame = false;
+    s_rxFrameLen = 0;
+    return nullptr;
+  }
 
-  size_t n = 0;
   while (SerialBT.available() > 0) {
     int c = SerialBT.read();
     if (c < 0) break;
 
+    if (s_rxInFrame) {
+      s_rxInFrame = frameByte((uint8_t)c);
+      continue;
+    }
+    if (c == 0x00) {
+      s_rxInFrame = true;
+      s_rxLen = 0;
+      s_rxOverflow = false;
+      continue;
+    }
+
     // ignore '\r'
     if (c == '\r') continue;
 
     if (c == '\n') {
-      out[n] = '\0';
-      return n; // got a full line
-    }
+      const bool dropped = s_rxOverflow;
+      const size_t n = s_rxLen;
+      s_rxLen = 0;
+      s_rxOverflow = false;
+      if (dropped || n == 0) continue;   // an overlong line is never a valid command
 
-    if (n < outLen - 1) {
-      out[n++] = (char)c;
-    } else {
-      // buffer full -> terminate and return what we have
-      out[n] = '\0';
-      return n;
+      s_rxLine[n] = '\0';
+      if (lenOut) *lenOut = n;
+      return s_rxLine;
     }
+
+    if (s_rxLen < RX_LINE_BYTES - 1) s_rxLine[s_rxLen++] = (char)c;
+    else                             s_rxOverflow = true;
   }
 
-  // no newline received yet -> indicate "not ready"
-  return 0;
+  // no newline received yet -> partial line stays buffered
+  return nullptr;
 }
 
 } // namespace BtMgr
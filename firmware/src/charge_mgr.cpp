@@ -1,60 +1,115 @@
 #include "charge_mgr.h"
+#include "pins.h"
+#include "time_mgr.h"
+#include "edge_debounce.h"
+#include "esp_timer.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
 
 namespace ChargeMgr {
 
-static constexpr uint32_t DEBOUNCE_MS = 200;
+static constexpr uint32_t DEBOUNCE_US = 200000;
 
-static bool s_stable = false;
-static bool s_lastRead = false;
-static uint32_t s_lastChangeMs = 0;
+static_assert(PIN_CHARGING < 32 && PIN_CHG_DONE < 32, "the ISRs read GPIO_IN_REG (GPIO 0..31)");
+
+static EdgeDebounce<16> s_charging;
+static EdgeDebounce<16> s_done;       // pin level: LOW = done
+static uint32_t s_droppedSeen = 0;
 static bool s_changedFlag = false;
 
 // UI re-init scheduling
 static bool s_uiPending = false;
-static uint32_t s_uiRequestMs = 0;
+static uint64_t s_uiRequestMs = 0;
 static uint32_t s_uiDelayMs = 100;
 
-void begin(bool initialCharging) {
-  s_stable = initialCharging;
-  s_lastRead = initialCharging;
-  s_lastChangeMs = millis();
+static inline bool pinLevel(int pin) {
+  return (REG_READ(GPIO_IN_REG) >> pin) & 1u;
+}
+
+static void IRAM_ATTR isrCharging() {
+  s_charging.push((uint64_t)esp_timer_get_time(), pinLevel(PIN_CHARGING));
+}
+
+static void IRAM_ATTR isrDone() {
+  s_done.push((uint64_t)esp_timer_get_time(), pinLevel(PIN_CHG_DONE));
+}
+
+void begin() {
+  const uint64_t now = (uint64_t)esp_timer_get_time();
+  s_charging.begin(now, digitalRead(PIN_CHARGING) == HIGH, DEBOUNCE_US);
+  s_done.begin(now, digitalRead(PIN_CHG_DONE) == HIGH, DEBOUNCE_US);
+  s_droppedSeen = 0;
   s_changedFlag = false;
+  attachInterrupt(digitalPinToInterrupt(PIN_CHARGING), isrCharging, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(PIN_CHG_DONE), isrDone, CHANGE);
 
   s_uiPending = false;
   s_uiRequestMs = 0;
 }
 
-void update(bool rawCharging) {
-  s_changedFlag = false;
+State state() {
+  State s;
+  s.charging = isCharging();
+  s.done = isDone();
+  return s;
+}
 
-  if (rawCharging != s_lastRead) {
-    s_lastRead = rawCharging;
-    s_lastChangeMs = millis();
-  }
+void restore(const State& s) {
+  detachInterrupt(digitalPinToInterrupt(PIN_CHARGING));
+  detachInterrupt(digitalPinToInterrupt(PIN_CHG_DONE));
+  const uint64_t now = (uint64_t)esp_timer_get_time();
+  s_charging.begin(now, s.charging, DEBOUNCE_US);
+  s_done.begin(now, !s.done, DEBOUNCE_US);
+  s_charging.resync(now, digitalRead(PIN_CHARGING) == HIGH);
+  s_done.resync(now, digitalRead(PIN_CHG_DONE) == HIGH);
+  s_droppedSeen = 0;
+  s_changedFlag = false;
+  attachInterrupt(digitalPinToInterrupt(PIN_CHARGING), isrCharging, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(PIN_CHG_DONE), isrDone, CHANGE);
+}
 
-  if ((millis() - s_lastChangeMs) > DEBOUNCE_MS && s_stable != s_lastRead) {
-    s_stable = s_lastRead;
-    s_changedFlag = true;
+void update() {
+  s_changedFlag = false;
+  if (s_charging.idle() && s_done.idle()) return;
+
+  const uint64_t now = (uint64_t)esp_timer_get_time();
+  const uint32_t dropped = s_charging.dropped() + s_done.dropped();
+  if (dropped != s_droppedSeen) {
+    // a ring overflowed: the pins as they are now count as edges now
+    s_droppedSeen = dropped;
+    s_changedFlag = s_charging.resync(now, digitalRead(PIN_CHARGING) == HIGH);
+    s_done.resync(now, digitalRead(PIN_CHG_DONE) == HIGH);
   }
+  if (s_charging.update(now)) s_changedFlag = true;
+  s_done.update(now);
 }
 
 bool isCharging() {
-  return s_stable;
+  return s_charging.stable();
+}
+
+bool isDone() {
+  return !s_done.stable();
 }
 
 bool stableChanged() {
   return s_changedFlag;
 }
 
+uint64_t changedAtUs() {
+  const uint64_t edgeUs = s_charging.stableSinceUs() - DEBOUNCE_US;   // esp_timer time
+  return TimeMgr::nowUs() - ((uint64_t)esp_timer_get_time() - edgeUs);
+}
+
 void scheduleUiReinit(uint32_t delayMs) {
   s_uiDelayMs = delayMs;
   s_uiPending = true;
-  s_uiRequestMs = millis();
+  s_uiRequestMs = TimeMgr::nowMs();
 }
 
 bool uiReinitDue() {
   if (!s_uiPending) return false;
-  if (millis() - s_uiRequestMs >= s_uiDelayMs) {
+  if (TimeMgr::nowMs() - s_uiRequestMs >= s_uiDelayMs) {
     s_uiPending = false;
     return true;
   }
@@ -67,9 +122,9 @@ bool uiReinitPending() {
 
 uint32_t uiReinitSecondsLeft() {
   if (!s_uiPending) return 0;
-  uint32_t elapsed = millis() - s_uiRequestMs;
+  const uint64_t elapsed = TimeMgr::nowMs() - s_uiRequestMs;
   if (elapsed >= s_uiDelayMs) return 0;
-  return (s_uiDelayMs - elapsed + 999) / 1000; // ceil seconds
+  return (uint32_t)((s_uiDelayMs - elapsed + 999) / 1000); // ceil seconds
 }
 
 } // namespace ChargeMgr
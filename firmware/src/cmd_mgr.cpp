@@ -0,0 +1,373 @@
+#include "cmd_mgr.h"
+#include "bt_mgr.h"
+#include "task_sched.h"
+#include <stdarg.h>
+#include <stddef.h>
+
+namespace CmdMgr {
+
+using namespace JsonTok;
+
+static constexpr size_t MAX_TOKENS   = 48;
+static constexpr size_t MAX_EXT_CMDS = 24;
+static constexpr size_t REPLY_BYTES  = 832;
+static constexpr size_t ID_BYTES     = 32;    // ,"id": and a 64-bit long on the sim
+static constexpr size_t KEY_BYTES    = 40;
+
+static AppConfig* s_live = nullptr;
+static ApplyFn    s_apply = nullptr;
+
+// ------------------------------------------------------------
+// Config field table
+// ------------------------------------------------------------
+enum FieldType : uint8_t { F_FLOAT, F_U32, F_U16, F_BOOL };
+
+struct Field {
+  const char* key;
+  FieldType   type;
+  size_t      off;
+  float       lo;
+  float       hi;
+};
+
+#define CFG_FIELD(key, type, member, lo, hi) { key, type, offsetof(AppConfig, member), lo, hi }
+
+static constexpr Field FIELDS[] = {
+  CFG_FIELD("trip_a",       F_FLOAT, lp.trip_A,       0.05f, 5.0f),
+  CFG_FIELD("trip_ms",      F_U32,   lp.tripDelayMs,  0.0f,  10000.0f),
+  CFG_FIELD("reset_safe_a", F_FLOAT, lp.resetSafe_A,  0.0f,  1.0f),
+  CFG_FIELD("latch",        F_BOOL,  lp.latch,        0.0f,  1.0f),
+  CFG_FIELD("retry_ms",     F_U32,   lp.retryDelayMs, 0.0f,  600000.0f),
+  CFG_FIELD("th_en",        F_BOOL,  th.enabled,      0.0f,  1.0f),
+  CFG_FIELD("th_chg_cold_c", F_FLOAT, th.chgColdC,    -30.0f, 30.0f),
+  CFG_FIELD("th_chg_hot_c", F_FLOAT, th.chgHotC,      20.0f, 70.0f),
+  CFG_FIELD("th_dsg_cold_c", F_FLOAT, th.dsgColdC,    -40.0f, 30.0f),
+  CFG_FIELD("th_dsg_hot_c", F_FLOAT, th.dsgHotC,      20.0f, 80.0f),
+  CFG_FIELD("th_hyst_c",    F_FLOAT, th.hystC,        0.5f,  10.0f),
+  CFG_FIELD("th_rate_c_min", F_FLOAT, th.rateCMin,    0.0f,  20.0f),
+  CFG_FIELD("dcdc_v",       F_FLOAT, en.dcdcV,        1.0f,  30.0f),
+  CFG_FIELD("eff_tau_s",    F_FLOAT, en.effTauS,      1.0f,  600.0f),
+  CFG_FIELD("energy_min_a", F_FLOAT, en.minA,         0.0f,  0.5f),
+  CFG_FIELD("bo_v",         F_FLOAT, rs.boV,          2.5f,  4.0f),
+  CFG_FIELD("bo_lead_s",    F_FLOAT, rs.boLeadS,      0.0f,  60.0f),
+  CFG_FIELD("adc_tick_us",  F_U32,   adc_tick_us,     250.0f, 100000.0f),
+  CFG_FIELD("adc_spc",      F_U16,   adc_spc,         1.0f,  1024.0f),
+  CFG_FIELD("adc_adapt",    F_BOOL,  ad.enabled,      0.0f,  1.0f),
+  CFG_FIELD("adc_step_a",   F_FLOAT, ad.stepA,        0.01f, 2.0f),
+  CFG_FIELD("adc_idle_ms",  F_U32,   ad.idleMs,       0.0f,  600000.0f),
+  CFG_FIELD("adc_burst_ms", F_U32,   ad.burstMs,      100.0f, 60000.0f),
+  CFG_FIELD("soc_cap_mah",  F_FLOAT, soc_cap_mah,     100.0f, 10000.0f),
+  CFG_FIELD("ui_period_ms", F_U32,   ui_period_ms,    100.0f, 60000.0f),
+  CFG_FIELD("en_charge",    F_BOOL,  en_charge,       0.0f,  1.0f),
+  CFG_FIELD("en_load_dsg",  F_BOOL,  en_load_dsg,     0.0f,  1.0f),
+  CFG_FIELD("usb_tlm",      F_BOOL,  usb_tlm,         0.0f,  1.0f),
+  CFG_FIELD("log_period_ms", F_U32,  log_period_ms,   100.0f, 3600000.0f),
+  CFG_FIELD("pwr_dead_us",  F_U32,   pwr_dead_us,     0.0f,  200000.0f),
+  CFG_FIELD("mem_period_ms", F_U32,  mem_period_ms,   0.0f,  3600000.0f),
+  CFG_FIELD("ota_gap_ms",   F_U32,   ota_gap_ms,      0.0f,  1000.0f),
+};
+
+#undef CFG_FIELD
+
+// Longest "get" body: ,"cfg":{ + "key":value per field + }. Floats print
+// as %.3f, so their limits bound the width; a wider limit fails the build.
+static constexpr size_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+static constexpr size_t keyLen(const char* k) { return *k ? 1 + keyLen(k + 1) : 0; }
+
+static constexpr size_t valueMax(const Field& f) {
+  return f.type == F_BOOL ? 1 : f.type == F_U16 ? 5 : f.type == F_U32 ? 10
+       : (f.lo > -100000.0f && f.hi < 100000.0f) ? 10 : 1000;   // -99999.999
+}
+
+static constexpr size_t getBodyMax(size_t i) {
+  return i == FIELD_COUNT ? 8 + 1
+       : 4 + keyLen(FIELDS[i].key) + valueMax(FIELDS[i]) + getBodyMax(i + 1);
+}
+
+static_assert(getBodyMax(0) + 64 <= REPLY_BYTES, "REPLY_BYTES too small for a full get");
+
+// The ack around the reply, with the longest name, err and msg
+static constexpr size_t ACK_BYTES =
+    sizeof("{\"ver\":1,\"ack\":\"\",\"err\":255,\"msg\":\"unknown_cmd\"}\n") + 16 + ID_BYTES + KEY_BYTES;
+static_assert(ACK_BYTES + REPLY_BYTES <= BtMgr::MAX_FRAME, "ack line longer than a BtMgr frame");
+
+static const Field* findField(const char* s, const Token& key) {
+  for (const Field& f : FIELDS) {
+    if (eq(s, key, f.key)) return &f;
+  }
+  return nullptr;
+}
+
+static Err parseField(const Field& f, const char* s, const Token& v, AppConfig& cfg) {
+  uint8_t* p = reinterpret_cast<uint8_t*>(&cfg) + f.off;
+
+  if (f.type == F_BOOL) {
+    bool b;
+    if (!toBool(s, v, b)) return ERR_BAD_VALUE;
+    *reinterpret_cast<bool*>(p) = b;
+    return ERR_OK;
+  }
+
+  float x;
+  if (!toFloat(s, v, x)) return ERR_BAD_VALUE;
+  if (x < f.lo || x > f.hi) return ERR_RANGE;
+
+  switch (f.type) {
+    case F_FLOAT: *reinterpret_cast<float*>(p)    = x; break;
+    case F_U32:   *reinterpret_cast<uint32_t*>(p) = (uint32_t)(x + 0.5f); break;
+    case F_U16:   *reinterpret_cast<uint16_t*>(p) = (uint16_t)(x + 0.5f); break;
+    default: break;
+  }
+  return ERR_OK;
+}
+
+static void printField(const Field& f, const AppConfig& cfg, Reply& r) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&cfg) + f.off;
+  switch (f.type) {
+    case F_FLOAT: r.add(",\"%s\":%.3f", f.key, (double)*reinterpret_cast<const float*>(p)); break;
+    case F_U32:   r.add(",\"%s\":%lu", f.key, (unsigned long)*reinterpret_cast<const uint32_t*>(p)); break;
+    case F_U16:   r.add(",\"%s\":%u", f.key, (unsigned)*reinterpret_cast<const uint16_t*>(p)); break;
+    case F_BOOL:  r.add(",\"%s\":%d", f.key, *reinterpret_cast<const bool*>(p) ? 1 : 0); break;
+  }
+}
+
+// Rules that involve more than one field
+static Err checkConsistent(const AppConfig& c, const char*& errKey) {
+  if (c.lp.resetSafe_A >= c.lp.trip_A) { errKey = "reset_safe_a"; return ERR_RANGE; }
+  // each window must keep room inside after both hysteresis bands
+  if (c.th.chgColdC + 2 * c.th.hystC >= c.th.chgHotC) { errKey = "th_chg_hot_c"; return ERR_RANGE; }
+  if (c.th.dsgColdC + 2 * c.th.hystC >= c.th.dsgHotC) { errKey = "th_dsg_hot_c"; return ERR_RANGE; }
+  return ERR_OK;
+}
+
+// ------------------------------------------------------------
+// Built-in commands
+// ------------------------------------------------------------
+static Err cmdGet(Args& a, Reply& r) {
+  const AppConfig& cfg = *s_live;
+  int keys = a.find("keys");
+
+  // get is answered inside one "cfg" object, so the first field has no comma
+  const size_t objStart = r.len;
+  r.add(",\"cfg\":{");
+  const size_t bodyStart = r.len;
+
+  if (keys < 0) {
+    for (const Field& f : FIELDS) printField(f, cfg, r);
+  } else {
+    if (a.t[keys].type != ARRAY) { a.errKey = "keys"; r.len = objStart; return ERR_BAD_VALUE; }
+    for (int i = keys + 1; i < a.n && a.t[i].start < a.t[keys].end; i = skip(a.t, a.n, i)) {
+      const Field* f = findField(a.s, a.t[i]);
+      if (!f) { a.errKey = a.s + a.t[i].start; r.len = objStart; return ERR_UNKNOWN_KEY; }
+      printField(*f, cfg, r);
+    }
+  }
+
+  if (r.len > bodyStart) {
+    // drop the leading comma of the first field
+    memmove(r.buf + bodyStart, r.buf + bodyStart + 1, r.len - bodyStart);
+    r.len--;
+  }
+  r.add("}");
+  return ERR_OK;
+}
+
+static Err cmdSet(Args& a, Reply& r) {
+  (void)r;
+  AppConfig next = *s_live;
+
+  const int pin = a.find("pin");
+  if (pin >= 0) {
+    // Old form from the PC UI: {"cmd":"set","pin":"en_charge","val":1}
+    const int val = a.find("val");
+    if (val < 0) { a.errKey = "val"; return ERR_BAD_VALUE; }
+    const Field* f = findField(a.s, a.t[pin]);
+    if (!f || f->type != F_BOOL) { a.errKey = a.s + a.t[pin].start; return ERR_UNKNOWN_KEY; }
+    Err e = parseField(*f, a.s, a.t[val], next);
+    if (e != ERR_OK) { a.errKey = f->key; return e; }
+  } else {
+    int changed = 0;
+    for (int i = 1; i + 1 < a.n; i = skip(a.t, a.n, i + 1)) {
+      const Token& key = a.t[i];
+      if (eq(a.s, key, "cmd") || eq(a.s, key, "id")) continue;
+
+      const Field* f = findField(a.s, key);
+      if (!f) { a.errKey = a.s + key.start; return ERR_UNKNOWN_KEY; }
+      Err e = parseField(*f, a.s, a.t[i + 1], next);
+      if (e != ERR_OK) { a.errKey = f->key; return e; }
+      changed++;
+    }
+    if (changed == 0) return ERR_OK;
+  }
+
+  Err e = checkConsistent(next, a.errKey);
+  if (e != ERR_OK) return e;
+
+  if (s_apply) {
+    e = s_apply(next, *s_live);
+    if (e != ERR_OK) return e;
+  }
+  *s_live = next;
+  return ERR_OK;
+}
+
+static Err cmdTxStats(Args& a, Reply& r) {
+  (void)a;
+  const BtMgr::TxStats st = BtMgr::txStats();
+  r.add(",\"tx\":{\"queued\":%lu,\"sent\":%lu,\"dropped\":%lu,\"rejected\":%lu,"
+        "\"queued_frames\":%lu,\"sent_frames\":%lu,\"dropped_frames\":%lu,\"rejected_frames\":%lu,"
+        "\"max_block_us\":%lu,\"pending\":%lu,\"pending_frames\":%lu}",
+        (unsigned long)st.queuedBytes, (unsigned long)st.sentBytes,
+        (unsigned long)st.droppedBytes, (unsigned long)st.rejectedBytes,
+        (unsigned long)st.queuedFrames, (unsigned long)st.sentFrames,
+        (unsigned long)st.droppedFrames, (unsigned long)st.rejectedFrames,
+        (unsigned long)st.maxBlockUs, (unsigned long)st.pendingBytes, (unsigned long)st.pendingFrames);
+  return ERR_OK;
+}
+
+struct CmdDef {
+  const char* name;
+  Handler     fn;
+};
+
+static const CmdDef BUILTIN[] = {
+  { "get",     cmdGet },
+  { "set",     cmdSet },
+  { "txstats", cmdTxStats },
+};
+
+static CmdDef s_ext[MAX_EXT_CMDS];
+static size_t s_extCount = 0;
+
+static Handler lookup(const char* s, const Token& name) {
+  for (const CmdDef& c : BUILTIN) {
+    if (eq(s, name, c.name)) return c.fn;
+  }
+  for (size_t i = 0; i < s_extCount; i++) {
+    if (eq(s, name, s_ext[i].name)) return s_ext[i].fn;
+  }
+  return nullptr;
+}
+
+// ------------------------------------------------------------
+
+bool Args::getLong(const char* key, long& out) const {
+  int v = find(key);
+  return v >= 0 && toLong(s, t[v], out);
+}
+
+bool Args::getInt64(const char* key, int64_t& out) const {
+  int v = find(key);
+  return v >= 0 && toInt64(s, t[v], out);
+}
+
+bool Args::getFloat(const char* key, float& out) const {
+  int v = find(key);
+  return v >= 0 && toFloat(s, t[v], out);
+}
+
+const char* Args::getStr(const char* key) const {
+  int v = find(key);
+  if (v < 0 || t[v].type != STRING) return nullptr;
+  return s + t[v].start;
+}
+
+void Reply::add(const char* fmt, ...) {
+  if (full || len >= cap) { full = true; return; }
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf + len, cap - len, fmt, args);
+  va_end(args);
+  if (n < 0 || (size_t)n >= cap - len) {   // keep whole fields only
+    buf[len] = '\0';
+    full = true;
+    return;
+  }
+  len += (size_t)n;
+}
+
+const char* errName(Err e) {
+  switch (e) {
+    case ERR_OK:          return "ok";
+    case ERR_PARSE:       return "parse";
+    case ERR_UNKNOWN_CMD: return "unknown_cmd";
+    case ERR_UNKNOWN_KEY: return "unknown_key";
+    case ERR_BAD_VALUE:   return "bad_value";
+    case ERR_RANGE:       return "range";
+    case ERR_BUSY:        return "busy";
+    case ERR_FAILED:      return "failed";
+    case ERR_REPLY_FULL:  return "reply_full";
+  }
+  return "?";
+}
+
+static void pollBt() {
+  if (!BtMgr::connected()) return;
+  size_t n = 0;
+  char* line;
+  while ((line = BtMgr::readLine(&n)) != nullptr) handleLine(line, n);
+}
+
+static const TaskSched::TaskDef TASK = { "cmd", pollBt, POLL_US, 3, 0, TaskSched::Overrun::Skip };
+
+void begin(AppConfig& live, ApplyFn apply) {
+  s_live = &live;
+  s_apply = apply;
+  TaskSched::add(TASK);
+}
+
+bool registerCmd(const char* name, Handler fn) {
+  if (s_extCount >= MAX_EXT_CMDS || !name || !fn) return false;
+  s_ext[s_extCount++] = { name, fn };
+  return true;
+}
+
+void handleLine(char* line, size_t len) {
+  if (!line || len == 0) return;
+
+  // skip leading blanks; anything that isn't an object is not for us
+  size_t off = 0;
+  while (off < len && (line[off] == ' ' || line[off] == '\t')) off++;
+  if (off >= len || line[off] != '{') return;
+
+  static Token toks[MAX_TOKENS];
+  static char replyBuf[REPLY_BYTES];
+  Reply r = { replyBuf, sizeof(replyBuf), 0, false };
+  replyBuf[0] = '\0';
+
+  Err err = ERR_PARSE;
+  const char* cmdName = "";
+  long id = -1;
+  const char* errKey = nullptr;
+
+  int n = parse(line + off, len - off, toks, MAX_TOKENS);
+  if (n > 0 && toks[0].type == OBJECT) {
+    Args a = { line + off, toks, n, nullptr };
+    (void)a.getLong("id", id);
+
+    int c = a.find("cmd");
+    if (c >= 0 && toks[c].type == STRING) {
+      cmdName = a.s + toks[c].start;
+      Handler fn = lookup(a.s, toks[c]);
+      err = fn ? fn(a, r) : ERR_UNKNOWN_CMD;
+      errKey = a.errKey;
+    } else {
+      err = ERR_UNKNOWN_CMD;
+    }
+  }
+
+  if (err == ERR_OK && r.full) err = ERR_REPLY_FULL;
+  if (err != ERR_OK) r.len = 0;   // no partial results on error
+  replyBuf[r.len] = '\0';
+
+  char idBuf[ID_BYTES] = "";
+  if (id >= 0) snprintf(idBuf, sizeof(idBuf), ",\"id\":%ld", id);
+  char keyBuf[KEY_BYTES] = "";
+  if (errKey) snprintf(keyBuf, sizeof(keyBuf), ",\"key\":\"%.24s\"", errKey);
+
+  BtMgr::reply("{\"ver\":1,\"ack\":\"%.16s\",\"err\":%u,\"msg\":\"%s\"%s%s%s}\n",
+               cmdName, (unsigned)err, errName(err), idBuf, keyBuf, replyBuf);
+}
+
+} // namespace CmdMgr
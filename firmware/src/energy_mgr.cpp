@@ -0,0 +1,249 @@
+#include "energy_mgr.h"
+#include <Preferences.h>
+#include <math.h>
+#include "cmd_mgr.h"
+#include "power_mgr.h"
+#include "time_mgr.h"
+
+namespace EnergyMgr {
+
+static constexpr uint64_t GAP_US      = 2000000;   // don't integrate across longer frame gaps
+static constexpr uint32_t SAVE_MS     = 300000;    // NVS wear: at most 12 writes an hour
+static constexpr float    EFF_MIN_W   = 0.05f;     // below this the shunts are mostly offset
+static constexpr float    STEP_FRAC   = 0.10f;     // current change that counts as a step
+static constexpr float    STEP_MIN_A  = 0.010f;
+static constexpr uint8_t  STEP_SKIP   = 2;         // frames skipped after a step
+
+// NVS layout. Bump REC_VER if it changes; an unknown record starts over.
+static constexpr uint16_t REC_VER = 1;
+struct Record {
+  uint16_t ver;
+  uint16_t size;
+  uint32_t sessions;
+  double   chgInWh, dsgOutWh, loadWh;
+};
+
+static Config   s_cfg;
+static Totals   s_session, s_life;
+static uint32_t s_sessions = 0;
+static uint64_t s_sessionMs = 0;
+static bool     s_charging = false;
+static bool     s_started = false;      // a session is open (first frame, or restored)
+static bool     s_dirty = false;
+static uint64_t s_lastSaveMs = 0;
+
+// previous frame, for the trapezoid
+static bool     s_havePrev = false;
+static uint64_t s_prevUs = 0;
+static float    s_prevChgW = 0, s_prevDsgW = 0, s_prevLoadW = 0;
+
+// efficiency filters
+static bool     s_path = false;
+static float    s_pinW = 0, s_poutW = 0;
+static float    s_settledS = 0;
+static uint8_t  s_skip = 0;
+static float    s_prevIload = 0, s_prevIdsg = 0;
+
+static void clearEff() {
+  s_pinW = s_poutW = 0;
+  s_settledS = 0;
+  s_skip = 0;
+}
+
+static void newSession(bool charging) {
+  s_session = Totals{};
+  s_sessionMs = TimeMgr::nowMs();
+  s_charging = charging;
+  s_started = true;
+  s_sessions++;
+  s_dirty = true;
+}
+
+static void load() {
+  Record rec;
+  Preferences prefs;
+  prefs.begin("energy", true);
+  const size_t n = prefs.getBytes("life", &rec, sizeof(rec));
+  prefs.end();
+  if (n != sizeof(rec) || rec.ver != REC_VER || rec.size != sizeof(rec)) {
+    s_life = Totals{};
+    s_sessions = 0;
+    return;
+  }
+  s_life.chgInWh  = rec.chgInWh;
+  s_life.dsgOutWh = rec.dsgOutWh;
+  s_life.loadWh   = rec.loadWh;
+  s_sessions = rec.sessions;
+}
+
+void save() {
+  s_lastSaveMs = TimeMgr::nowMs();
+  if (!s_dirty) return;
+  Record rec = { REC_VER, (uint16_t)sizeof(Record), s_sessions,
+                 s_life.chgInWh, s_life.dsgOutWh, s_life.loadWh };
+  Preferences prefs;
+  prefs.begin("energy", false);
+  prefs.putBytes("life", &rec, sizeof(rec));
+  prefs.end();
+  s_dirty = false;
+}
+
+// The ADC clamps negative currents to 0, which turns shunt noise
+// around zero into a small positive bias
+static float floorA(float a) { return a >= s_cfg.minA ? a : 0.0f; }
+
+static bool isStep(float now, float prev) {
+  const float d = fabsf(now - prev);
+  return d > STEP_MIN_A && d > STEP_FRAC * fmaxf(fabsf(now), fabsf(prev));
+}
+
+static void updateEff(const AdcReadings& adc, float dsgW, float loadW, float dtS) {
+  const bool step = isStep(adc.iload_a, s_prevIload) || isStep(adc.ibatt_dsg_a, s_prevIdsg);
+  s_prevIload = adc.iload_a;
+  s_prevIdsg  = adc.ibatt_dsg_a;
+  if (step) s_skip = STEP_SKIP;
+  if (s_skip) { s_skip--; return; }
+  if (dtS <= 0) return;
+
+  const float a = dtS / (s_cfg.effTauS + dtS);
+  s_pinW  += (dsgW  - s_pinW)  * a;
+  s_poutW += (loadW - s_poutW) * a;
+  s_settledS += dtS;
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static void addTotals(CmdMgr::Reply& r, const char* key, const Totals& t) {
+  r.add(",\"%s\":{\"in_wh\":%.4f,\"out_wh\":%.4f,\"load_wh\":%.4f}",
+        key, t.chgInWh, t.dsgOutWh, t.loadWh);
+}
+
+static CmdMgr::Err cmdEnergy(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  const char* reset = a.getStr("reset");
+  if (reset) {
+    if (!strcmp(reset, "session"))   resetSession();
+    else if (!strcmp(reset, "life")) resetLifetime();
+    else { a.errKey = "reset"; return CmdMgr::ERR_RANGE; }
+  }
+
+  char eff[16] = "null";
+  if (!isnan(efficiency())) snprintf(eff, sizeof(eff), "%.3f", efficiency());
+  addTotals(r, "session", s_session);
+  addTotals(r, "life", s_life);
+  r.add(",\"chg\":%d,\"session_s\":%lu,\"sessions\":%lu,\"eff\":%s,\"pin_w\":%.3f,\"pout_w\":%.3f",
+        s_charging ? 1 : 0, (unsigned long)sessionS(), (unsigned long)s_sessions,
+        eff, s_pinW, s_poutW);
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+void begin(const Config& cfg) {
+  s_cfg = cfg;
+  load();
+  s_session = Totals{};
+  s_sessionMs = TimeMgr::nowMs();
+  s_charging = false;
+  s_started = false;
+  s_dirty = false;
+  s_lastSaveMs = s_sessionMs;
+  s_havePrev = false;
+  s_path = false;
+  clearEff();
+  CmdMgr::registerCmd("energy", cmdEnergy);
+}
+
+void setConfig(const Config& cfg) {
+  if (cfg.effTauS != s_cfg.effTauS || cfg.dcdcV != s_cfg.dcdcV) clearEff();
+  s_cfg = cfg;
+}
+
+const Config& config() { return s_cfg; }
+
+void update(const AdcReadings& adc, uint64_t tUs, bool charging, uint8_t outputs) {
+  if (!s_started || charging != s_charging) newSession(charging);
+
+  // like SocMgr: while charging the relay feeds the system and the cell
+  // only takes charge
+  const float chgW  = charging ? adc.vbat_meas_sys_v * floorA(adc.ibatt_chg_a) : 0.0f;
+  const float dsgW  = charging ? 0.0f : adc.vbat_meas_sys_v * floorA(adc.ibatt_dsg_a);
+  const float loadW = s_cfg.dcdcV * floorA(adc.iload_a);
+
+  float dtS = 0;
+  if (s_havePrev && tUs > s_prevUs && tUs - s_prevUs <= GAP_US) {
+    dtS = (float)(tUs - s_prevUs) * 1e-6f;
+    const double h = dtS / 3600.0;
+    const double in   = 0.5 * (chgW  + s_prevChgW)  * h;
+    const double out  = 0.5 * (dsgW  + s_prevDsgW)  * h;
+    const double load = 0.5 * (loadW + s_prevLoadW) * h;
+    s_session.chgInWh  += in;   s_life.chgInWh  += in;
+    s_session.dsgOutWh += out;  s_life.dsgOutWh += out;
+    s_session.loadWh   += load; s_life.loadWh   += load;
+    if (in + out + load > 0) s_dirty = true;
+  }
+  s_havePrev = true;
+  s_prevUs = tUs;
+  s_prevChgW = chgW;
+  s_prevDsgW = dsgW;
+  s_prevLoadW = loadW;
+
+  // battery -> DC-DC -> output, with nothing else feeding the output
+  const uint8_t need = PowerMgr::OUT_DCDC | PowerMgr::OUT_LOAD_DSG;
+  const bool path = (outputs & (need | PowerMgr::OUT_RELAY)) == need;
+  if (path != s_path) {
+    s_path = path;
+    clearEff();
+    s_prevIload = adc.iload_a;
+    s_prevIdsg  = adc.ibatt_dsg_a;
+  }
+  if (path) updateEff(adc, dsgW, loadW, dtS);
+
+  if (TimeMgr::nowMs() - s_lastSaveMs >= SAVE_MS) save();
+}
+
+const Totals& session()  { return s_session; }
+const Totals& lifetime() { return s_life; }
+uint32_t sessions()      { return s_sessions; }
+uint32_t sessionS()      { return (uint32_t)((TimeMgr::nowMs() - s_sessionMs) / 1000); }
+
+float efficiency() {
+  if (!s_path || s_settledS < s_cfg.effTauS || s_pinW < EFF_MIN_W) return NAN;
+  // a converter makes no energy: above 1, dcdcV or a current is off
+  const float eff = s_poutW / s_pinW;
+  return (eff > 0.0f && eff <= 1.0f) ? eff : NAN;
+}
+
+State state() {
+  State s;
+  s.session = s_session;
+  s.life = s_life;
+  s.sessions = s_sessions;
+  s.sessionMs = s_sessionMs;
+  s.charging = s_charging;
+  return s;
+}
+
+void restore(const State& s) {
+  s_session = s.session;
+  s_life = s.life;
+  s_sessions = s.sessions;
+  s_sessionMs = s.sessionMs;
+  s_charging = s.charging;
+  s_started = true;
+  s_dirty = true;            // ahead of NVS by up to SAVE_MS
+}
+
+void resetSession() {
+  s_session = Totals{};
+  s_sessionMs = TimeMgr::nowMs();
+}
+
+void resetLifetime() {
+  s_life = Totals{};
+  s_sessions = 0;
+  s_dirty = true;
+  save();
+}
+
+} // namespace EnergyMgr
@@ -0,0 +1,145 @@
+#include "event_mgr.h"
+#include "adc_mgr.h"
+#include "bt_mgr.h"
+#include "cmd_mgr.h"
+#include "time_mgr.h"
+#include "task_sched.h"
+
+namespace EventMgr {
+
+using namespace TlmProto;
+
+struct Event {
+  uint64_t tUs;
+  float    a;
+  uint8_t  type;
+};
+
+static Event    s_ring[QLEN];
+static uint32_t s_head = 0;                          // seq of the next event
+static uint32_t s_pos[TlmBus::MAX_TRANSPORTS];       // next seq per transport
+static Stats    s_st = {};
+
+static bool hasValue(uint8_t type) {
+  return type == EVT_LOAD_STEP || type == EVT_TRIP;
+}
+
+static bool encodeJson(const Event& e, uint32_t seq, TlmBus::FrameBuf* f) {
+  char* p = (char*)f->data;
+  const size_t cap = TlmBus::FrameBuf::CAP;
+  int n = snprintf(p, cap, "{\"ver\":1,\"evt\":{\"type\":\"%s\",\"seq\":%lu,\"boot\":%lu,\"t_us\":%llu",
+                   EVENT_NAMES[e.type], (unsigned long)seq, (unsigned long)TimeMgr::boots(),
+                   (unsigned long long)e.tUs);
+  if (n > 0 && hasValue(e.type)) n += snprintf(p + n, cap - n, ",\"a\":%.3f", e.a);
+  if (n > 0 && (size_t)n < cap) n += snprintf(p + n, cap - n, "}}\n");
+  if (n <= 0 || (size_t)n >= cap) return false;
+  f->len = (uint16_t)n;
+  return true;
+}
+
+static bool encodeBin(const Event& e, uint32_t seq, TlmBus::FrameBuf* f) {
+  EventV1 r;
+  r.t_us     = e.tUs;
+  r.seq      = seq;
+  r.boot     = (uint16_t)TimeMgr::boots();
+  r.type     = e.type;
+  r.value_ma = hasValue(e.type) ? toI16(e.a, 1000.0f) : 0;
+  const size_t n = encodeFrame(SCHEMA_EVENT_V1, (uint16_t)seq, &r, sizeof(r), f->data, TlmBus::FrameBuf::CAP);
+  f->len = (uint16_t)n;
+  return n > 0;
+}
+
+// ------------------------------------------------------------
+// Detection hooks
+// ------------------------------------------------------------
+static void onLoadStep(float dA, uint64_t tUs) {
+  push(EVT_LOAD_STEP, tUs, dA);
+}
+
+void push(EventType type, uint64_t tUs, float a) {
+  if (type >= EVT_TYPE_COUNT) return;
+  Event& e = s_ring[s_head % QLEN];
+  e.tUs = tUs;
+  e.a = a;
+  e.type = type;
+  s_head++;
+  s_st.pushed = s_head;
+  s_st.byType[type]++;
+}
+
+// ------------------------------------------------------------
+// Fan-out, per transport
+// ------------------------------------------------------------
+void service() {
+  const size_t n = TlmBus::count();
+  bool behind = false;
+  for (size_t i = 0; i < n; i++) behind |= (s_pos[i] != s_head);
+  if (!behind) return;
+
+  for (size_t i = 0; i < n; i++) {
+    TlmBus::Transport* t = TlmBus::get(i);
+    uint32_t& pos = s_pos[i];
+    if (pos == s_head) continue;
+    if (!t->connected()) {
+      s_st.skipped[i] += s_head - pos;
+      pos = s_head;
+      continue;
+    }
+    if (s_head - pos > QLEN) {
+      s_st.lost[i] += s_head - pos - QLEN;
+      pos = s_head - QLEN;
+    }
+    while (pos != s_head) {
+      TlmBus::FrameBuf* f = TlmBus::alloc(t->fmt);
+      if (!f) return;   // pool busy: next pass
+      const Event& e = s_ring[pos % QLEN];
+      const bool ok = (t->fmt == TlmBus::Fmt::Json) ? encodeJson(e, pos, f) : encodeBin(e, pos, f);
+      if (!ok) { TlmBus::release(f); pos++; continue; }
+      f->urgent = true;
+      if (!TlmBus::sendTo(t, f)) { s_st.retries++; break; }
+      s_st.sent[i]++;
+      pos++;
+    }
+  }
+}
+
+void flush(uint32_t timeoutMs) {
+  service();
+  TlmBus::service();
+  BtMgr::flush(timeoutMs);
+}
+
+Stats stats() {
+  return s_st;
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static CmdMgr::Err cmdEvt(CmdMgr::Args&, CmdMgr::Reply& r) {
+  r.add(",\"seq\":%lu,\"boot\":%lu,\"types\":{", (unsigned long)s_head, (unsigned long)TimeMgr::boots());
+  for (uint8_t i = 0; i < EVT_TYPE_COUNT; i++) {
+    r.add("%s\"%s\":%lu", i ? "," : "", EVENT_NAMES[i], (unsigned long)s_st.byType[i]);
+  }
+  r.add("},\"tr\":[");
+  for (size_t i = 0; i < TlmBus::count(); i++) {
+    r.add("%s[\"%s\",%lu,%lu,%lu]", i ? "," : "", TlmBus::get(i)->name(),
+          (unsigned long)s_st.sent[i], (unsigned long)s_st.skipped[i], (unsigned long)s_st.lost[i]);
+  }
+  r.add("],\"retries\":%lu", (unsigned long)s_st.retries);
+  return CmdMgr::ERR_OK;
+}
+
+// after "frame" and "charge" (which push), before "tlm_bus" (which writes USB)
+static const TaskSched::TaskDef TASK = { "evt", service, 0, 3, 0, TaskSched::Overrun::Skip };
+
+void begin(ADCMgr& adc) {
+  s_head = 0;
+  for (uint32_t& p : s_pos) p = 0;
+  s_st = Stats{};
+  adc.setStepSink(onLoadStep);
+  CmdMgr::registerCmd("evt", cmdEvt);
+  TaskSched::add(TASK);
+}
+
+} // namespace EventMgr
@@ -0,0 +1,83 @@
+#include "i2c_bus.h"
+
+// The sim has its own bus with simulated devices (sim/sim_i2c.cpp)
+#ifdef ESP_PLATFORM
+#include <atomic>
+#include <string.h>
+#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace I2cBus {
+
+static constexpr i2c_port_t PORT = I2C_NUM_0;
+static constexpr uint32_t TASK_STACK = 2048;
+static constexpr UBaseType_t TASK_PRIO = 5;     // above bt_tx / log_wr: a transfer is short
+static constexpr BaseType_t TASK_CORE = 0;      // loop() runs on core 1
+
+using InaMon::Status;
+
+class EspI2c : public InaMon::I2cIf {
+public:
+  bool start(uint8_t addr, const uint8_t* w, uint8_t wlen, uint8_t* r, uint8_t rlen) override {
+    if (!task_ || status_.load() == Status::Busy || wlen > sizeof(w_)) return false;
+    addr_ = addr;
+    memcpy(w_, w, wlen);
+    wlen_ = wlen;
+    r_ = r;
+    rlen_ = rlen;
+    status_.store(Status::Busy);
+    xTaskNotifyGive(task_);
+    return true;
+  }
+
+  Status poll() override { return status_.load(); }
+
+  void run() {
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      if (status_.load() != Status::Busy) continue;
+      const TickType_t ticks = pdMS_TO_TICKS(XFER_TIMEOUT_MS);
+      const esp_err_t e = rlen_
+        ? i2c_master_write_read_device(PORT, addr_, w_, wlen_, r_, rlen_, ticks)
+        : i2c_master_write_to_device(PORT, addr_, w_, wlen_, ticks);
+      // ESP_FAIL: no ACK
+      status_.store(e == ESP_OK ? Status::Done : e == ESP_FAIL ? Status::Nak : Status::Error);
+    }
+  }
+
+  TaskHandle_t task_ = nullptr;
+
+private:
+  std::atomic<Status> status_{Status::Idle};
+  uint8_t  addr_ = 0;
+  uint8_t  w_[4];
+  uint8_t  wlen_ = 0;
+  uint8_t* r_ = nullptr;
+  uint8_t  rlen_ = 0;
+};
+
+static EspI2c s_bus;
+
+static void busTask(void*) { s_bus.run(); }
+
+bool begin(int sda, int scl, uint32_t hz) {
+  if (s_bus.task_) return true;
+  if (sda < 0 || scl < 0) return false;
+  i2c_config_t c = {};
+  c.mode = I2C_MODE_MASTER;
+  c.sda_io_num = sda;
+  c.scl_io_num = scl;
+  c.sda_pullup_en = GPIO_PULLUP_ENABLE;
+  c.scl_pullup_en = GPIO_PULLUP_ENABLE;
+  c.master.clk_speed = hz;
+  if (i2c_param_config(PORT, &c) != ESP_OK) return false;
+  if (i2c_driver_install(PORT, I2C_MODE_MASTER, 0, 0, 0) != ESP_OK) return false;
+  xTaskCreatePinnedToCore(busTask, "i2c", TASK_STACK, nullptr, TASK_PRIO, &s_bus.task_, TASK_CORE);
+  return s_bus.task_ != nullptr;
+}
+
+InaMon::I2cIf& bus() { return s_bus; }
+
+} // namespace I2cBus
+#endif
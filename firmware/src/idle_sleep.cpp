@@ -2,6 +2,10 @@
 #include "pins.h"
 #include "power_mgr.h"
 #include "ui_mgr.h"
+#include "log_mgr.h"
+#include "energy_mgr.h"
+#include "time_mgr.h"
+#include "event_mgr.h"
 #include "esp_sleep.h"
 #include "driver/rtc_io.h"
 #include <math.h>
@@ -12,9 +16,10 @@ namespace IdleSleep {
 
 static constexpr uint32_t IDLE_TIMEOUT_MS = 10*60UL * 1000UL;
 static constexpr uint32_t WAKE_HOLD_MS    = 3000;
-static constexpr float    LOAD_NA_A       = 0.112f; // 100mA = NA threshold
+static constexpr uint32_t EVT_FLUSH_MS    = 100;   // the sleep event out on BT
+static constexpr float    LOAD_NA_A       = Profile::BOARD.idleLoadA; // NA threshold
 
-static uint32_t s_idleStartMs = 0;
+static uint64_t s_idleStartMs = 0;
 static bool     s_idleCounting = false;
 
 static bool loadIsNA(const AdcReadings& d) {
@@ -23,18 +28,11 @@ static bool loadIsNA(const AdcReadings& d) {
 }
 
 static void prepareOutputsForSleep() {
-  // REQUIRED sleep-state outputs
-  pinMode(PIN_EN_BYPASS, OUTPUT);
-  digitalWrite(PIN_EN_BYPASS, HIGH);     // PATH_EN HIGH
-
-  pinMode(PIN_EN_RELAY, OUTPUT);
-  digitalWrite(PIN_EN_RELAY, HIGH);      // RELAY_EN HIGH
-
-  pinMode(PIN_EN_DCDC, OUTPUT);
-  digitalWrite(PIN_EN_DCDC, LOW);        // DCDC_EN OFF
-
-  pinMode(PIN_EN_LOAD_DSG, OUTPUT);
-  digitalWrite(PIN_EN_LOAD_DSG, LOW);    // LOAD_OUT LOW
+  // REQUIRED sleep-state outputs: PATH_EN HIGH, RELAY_EN HIGH, DCDC_EN OFF,
+  // LOAD_OUT LOW. The relay only closes after the DC-DC dead time.
+  using namespace PowerMgr;
+  set(OUT_BYPASS | OUT_RELAY | OUT_DCDC | OUT_LOAD_DSG, OUT_BYPASS | OUT_RELAY);
+  settle();
 }
 
 static void configureWakeSources() {
@@ -72,7 +70,12 @@ static void rtcUnhold(int pin) {
 }
 
 static void enterDeepSleepNow() {
+  EventMgr::push(TlmProto::EVT_SLEEP, TimeMgr::nowUs());
+  EventMgr::flush(EVT_FLUSH_MS);
   UIMgr::shutdown();
+  LogMgr::flush(true);   // RAM block would be lost
+  EnergyMgr::save();
+  TimeMgr::prepareSleep();
   prepareOutputsForSleep();
   configureWakeSources();
 
@@ -120,8 +123,8 @@ bool handleWakeReasonOrSleep() {
   if (cause == ESP_SLEEP_WAKEUP_EXT1) {
     uint64_t mask = esp_sleep_get_ext1_wakeup_status();
     if (mask & (1ULL << PIN_BTN_SLEEP)) {
-      uint32_t t0 = millis();
-      while (millis() - t0 < WAKE_HOLD_MS) {
+      const uint64_t t0 = TimeMgr::nowMs();
+      while (TimeMgr::nowMs() - t0 < WAKE_HOLD_MS) {
         if (digitalRead(PIN_BTN_SLEEP) == HIGH) {
           // released too early -> go back to sleep
           enterDeepSleepNow();
@@ -150,11 +153,11 @@ void update(const AdcReadings& d, bool chargingStable) {
 
   if (!s_idleCounting) {
     s_idleCounting = true;
-    s_idleStartMs = millis();
+    s_idleStartMs = TimeMgr::nowMs();
     return;
   }
 
-  if ((millis() - s_idleStartMs) >= IDLE_TIMEOUT_MS) {
+  if ((TimeMgr::nowMs() - s_idleStartMs) >= IDLE_TIMEOUT_MS) {
     enterDeepSleepNow();
   }
 }
@@ -0,0 +1,93 @@
+#include "ina_src.h"
+#include "pins.h"
+#include "i2c_bus.h"
+#include "cmd_mgr.h"
+#include "time_mgr.h"
+
+namespace InaSrc {
+
+static const char* const NAMES[MON_COUNT] = { "batt", "load" };
+static const Profile::Ina* const FIT[MON_COUNT] = { &Profile::BOARD.inaBatt, &Profile::BOARD.inaLoad };
+
+static InaMon::Poller  s_poller;
+static InaMon::Monitor s_mon[MON_COUNT];
+static InaMon::Sample  s_last[MON_COUNT];
+static bool            s_have[MON_COUNT];
+
+class Source : public AdcSource {
+public:
+  const char* name() const override { return "ina"; }
+
+  void service() override { s_poller.service(TimeMgr::nowUs()); }
+
+  void fill(AdcReadings& out) override {
+    for (uint8_t i = 0; i < MON_COUNT; i++) {
+      if (!s_mon[i].ok()) { s_have[i] = false; continue; }
+      if (s_mon[i].take(s_last[i])) s_have[i] = true;
+      if (!s_have[i]) continue;
+      const InaMon::Sample& m = s_last[i];
+      if (i == BATT) {
+        out.vbat_meas_sys_v = m.volts;
+        out.ibatt_chg_a = max(0.0f, m.amps);
+        out.ibatt_dsg_a = max(0.0f, -m.amps);
+      } else {
+        out.iload_a = max(0.0f, m.amps);
+      }
+    }
+  }
+};
+
+static Source s_source;
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static CmdMgr::Err cmdIna(CmdMgr::Args&, CmdMgr::Reply& r) {
+  r.add(",\"mon\":[");
+  bool first = true;
+  for (uint8_t i = 0; i < MON_COUNT; i++) {
+    if (!fitted(i)) continue;
+    const InaMon::Stats& st = s_mon[i].stats();
+    r.add("%s{\"name\":\"%s\",\"chip\":%u,\"addr\":%u,\"state\":\"%s\",\"reads\":%lu,\"errors\":%lu,"
+          "\"faults\":%lu,\"clipped\":%lu,",
+          first ? "" : ",", NAMES[i], (unsigned)FIT[i]->chip, (unsigned)FIT[i]->addr,
+          InaMon::stateName(s_mon[i].state()), (unsigned long)st.reads, (unsigned long)st.errors,
+          (unsigned long)st.faults, (unsigned long)st.clipped);
+    if (s_have[i]) r.add("\"a\":%.4f,\"v\":%.3f}", s_last[i].amps, s_last[i].volts);
+    else           r.add("\"a\":null,\"v\":null}");
+    first = false;
+  }
+  r.add("]");
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+bool fitted(uint8_t i) { return i < MON_COUNT && FIT[i]->chip != InaMon::NONE; }
+
+const InaMon::Monitor& monitor(uint8_t i) { return s_mon[i < MON_COUNT ? i : 0]; }
+
+AdcSource* begin() {
+  bool any = false;
+  for (uint8_t i = 0; i < MON_COUNT; i++) any = any || fitted(i);
+  if (!any || !I2cBus::begin(PIN_I2C_SDA, PIN_I2C_SCL)) return nullptr;
+
+  s_poller.begin(&I2cBus::bus());
+  const uint64_t now = TimeMgr::nowUs();
+  for (uint8_t i = 0; i < MON_COUNT; i++) {
+    InaMon::Config c;
+    if (fitted(i)) {
+      c.chip = FIT[i]->chip;
+      c.addr = FIT[i]->addr;
+      c.shuntOhm = FIT[i]->shuntOhm;
+      c.maxA = FIT[i]->maxA;
+      s_poller.add(&s_mon[i]);
+    }
+    s_mon[i].begin(c, now);
+    s_have[i] = false;
+  }
+  CmdMgr::registerCmd("ina", cmdIna);
+  return &s_source;
+}
+
+} // namespace InaSrc
@@ -1,20 +1,22 @@
 #include "load_prot.h"
+#include "time_mgr.h"
+#include "prof_mgr.h"
 
 namespace LoadProt {
 
 static Config gCfg;
 
 static bool gTripped = false;
-static uint32_t gOverStartMs = 0;
+static uint64_t gOverStartMs = 0;
 static float gLastLoadA = 0.0f;
-static uint32_t gLastTripMs = 0;
+static uint64_t gLastTripMs = 0;
 
 // Button reset config/state
 static bool gBtnEnabled = false;
 static uint8_t gBtnPin = 255;
 static bool gBtnActiveLow = true;
 static uint32_t gBtnHoldMs = 2000;
-static uint32_t gBtnHoldStartMs = 0;
+static uint64_t gBtnHoldStartMs = 0;
 
 static inline float absf_fast(float x) { return x < 0 ? -x : x; }
 
@@ -32,6 +34,12 @@ void begin(const Config& cfg) {
   gBtnHoldStartMs = 0;
 }
 
+void setConfig(const Config& cfg) {
+  gCfg = cfg;
+}
+
+const Config& config() { return gCfg; }
+
 void setResetButton(uint8_t pin, bool activeLow, uint32_t holdMs) {
   gBtnEnabled = true;
   gBtnPin = pin;
@@ -51,12 +59,13 @@ static bool isButtonPressed() {
 }
 
 void update(const AdcReadings& adc) {
+  PROF_ZONE(ProfMgr::Z_LOAD_PROT);
   gLastLoadA = absf_fast(adc.iload_a);
 
   // ---------- AUTO RETRY MODE ----------
   // If tripped and NOT latched, wait retryDelayMs then clear trip
   if (gTripped && !gCfg.latch) {
-    if (gCfg.retryDelayMs > 0 && (millis() - gLastTripMs) >= gCfg.retryDelayMs) {
+    if (gCfg.retryDelayMs > 0 && (TimeMgr::nowMs() - gLastTripMs) >= gCfg.retryDelayMs) {
       gTripped = false;     // allow load again
       gOverStartMs = 0;     // restart overcurrent timing cleanly
     } else {
@@ -72,10 +81,10 @@ void update(const AdcReadings& adc) {
 
   // ---------- TRIP DETECTION ----------
   if (gLastLoadA > gCfg.trip_A) {
-    if (gOverStartMs == 0) gOverStartMs = millis();
-    if ((millis() - gOverStartMs) >= gCfg.tripDelayMs) {
+    if (gOverStartMs == 0) gOverStartMs = TimeMgr::nowMs();
+    if ((TimeMgr::nowMs() - gOverStartMs) >= gCfg.tripDelayMs) {
       gTripped = true;
-      gLastTripMs = millis();
+      gLastTripMs = TimeMgr::nowMs();
     }
   } else {
     gOverStartMs = 0;
@@ -90,8 +99,8 @@ void serviceButton(const AdcReadings& adc) {
   const bool pressed = isButtonPressed();
 
   if (pressed) {
-    if (gBtnHoldStartMs == 0) gBtnHoldStartMs = millis();
-    if (millis() - gBtnHoldStartMs >= gBtnHoldMs) {
+    if (gBtnHoldStartMs == 0) gBtnHoldStartMs = TimeMgr::nowMs();
+    if (TimeMgr::nowMs() - gBtnHoldStartMs >= gBtnHoldMs) {
       // Safe reset: only if load current is near zero
       (void)tryReset(adc);
       gBtnHoldStartMs = 0;
@@ -106,7 +115,7 @@ bool tripped() { return gTripped; }
 
 void forceTrip() {
   gTripped = true;
-  gLastTripMs = millis();
+  gLastTripMs = TimeMgr::nowMs();
   gOverStartMs = 0;
 }
 
@@ -125,7 +134,20 @@ void resetForce() {
   gOverStartMs = 0;
 }
 
+State state() {
+  State s;
+  s.tripped = gTripped;
+  s.lastTripMs = gLastTripMs;
+  return s;
+}
+
+void restore(const State& s) {
+  gTripped = s.tripped;
+  gLastTripMs = s.lastTripMs;
+  gOverStartMs = 0;
+}
+
 float lastLoadA() { return gLastLoadA; }
-uint32_t lastTripMillis() { return gLastTripMs; }
+uint64_t lastTripMillis() { return gLastTripMs; }
 
 } // namespace LoadProt
@@ -0,0 +1,283 @@
+#include "log_mgr.h"
+#include "bt_mgr.h"
+#include "cmd_mgr.h"
+#include "tlm_bus.h"
+#include "tlm_log.h"
+#include "time_mgr.h"
+#include "task_sched.h"
+#include <Preferences.h>
+#include <atomic>
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace LogMgr {
+
+using namespace TlmLog;
+
+static constexpr esp_partition_subtype_t PART_SUBTYPE = (esp_partition_subtype_t)0x40;
+static constexpr const char* PART_LABEL = "tlmlog";
+
+static constexpr uint32_t WRITER_STACK = 3072;
+static constexpr UBaseType_t WRITER_PRIO = 1;
+static constexpr BaseType_t WRITER_CORE = 0;
+
+// ------------------------------------------------------------
+// Partition backend
+// ------------------------------------------------------------
+class PartitionFlash : public FlashIf {
+public:
+  explicit PartitionFlash(const esp_partition_t* p) : p_(p) {}
+  size_t size() const override { return p_->size; }
+  bool erase(size_t off, size_t len) override { return esp_partition_erase_range(p_, off, len) == ESP_OK; }
+  bool write(size_t off, const void* src, size_t len) override { return esp_partition_write(p_, off, src, len) == ESP_OK; }
+  bool read(size_t off, void* dst, size_t len) override { return esp_partition_read(p_, off, dst, len) == ESP_OK; }
+private:
+  const esp_partition_t* p_;
+};
+
+static PartitionFlash* s_flash = nullptr;
+static RingLog s_ring;
+static bool    s_mounted = false;
+
+static TlmSub::FillFn s_fill = nullptr;
+static uint32_t s_periodMs = 1000;
+static uint64_t s_lastMs = 0;
+static uint32_t s_boot = 0;
+
+// Open block (filled by loop) and sealed block (owned by the writer while
+// s_pending is set; the ring is only touched by whoever owns it)
+static uint8_t      s_open[SECTOR_SIZE];
+static uint8_t      s_sealed[SECTOR_SIZE];
+static BlockEncoder s_enc;
+static uint32_t     s_openSeq = 0;
+static std::atomic<bool> s_pending(false);
+static TaskHandle_t s_writer = nullptr;
+
+static uint32_t s_records = 0;
+static uint32_t s_writeErrors = 0;
+static uint32_t s_dropped = 0;
+
+// Download state
+static bool     s_dlActive = false;
+static uint32_t s_dlSeq = 0;
+static uint32_t s_dlEnd = 0;       // exclusive
+static uint16_t s_dlOff = 0;
+static uint16_t s_dlFrameSeq = 0;
+
+static void startBlock() {
+  s_enc.begin(s_open + sizeof(SectorHdr));
+}
+
+static void writerTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!s_pending.load()) continue;
+    if (!s_ring.writeBlock(s_sealed)) s_writeErrors++;
+    s_pending.store(false);
+  }
+}
+
+static void seal() {
+  if (s_enc.count() == 0) return;
+
+  if (s_pending.load()) {
+    // previous block still being written - can't happen at sane periods
+    s_dropped++;
+  } else {
+    SectorHdr h;
+    h.magic = MAGIC;
+    h.seq   = s_openSeq;
+    h.boot  = s_boot;
+    h.count = s_enc.count();
+    h.bytes = (uint16_t)s_enc.bytes();
+    h.rsv   = 0;
+    h.crc   = sectorCrc(h, s_open + sizeof(SectorHdr));
+    memcpy(s_sealed, &h, sizeof(h));
+    memcpy(s_sealed + sizeof(h), s_open + sizeof(h), h.bytes);
+    s_pending.store(true);
+    if (s_writer) xTaskNotifyGive(s_writer);
+  }
+  s_openSeq++;
+  startBlock();
+}
+
+static void record(uint64_t now) {
+  TlmSub::Snapshot snap;
+  snap.ms = now;
+  s_fill(snap, TlmProto::FIELD_MASK_ALL);
+
+  Record r;
+  quantize(snap.v, (uint32_t)now, r);
+  if (!s_enc.append(r)) {
+    seal();
+    s_enc.append(r);
+  }
+  s_records++;
+}
+
+// ------------------------------------------------------------
+// Download: one chunk per loop pass while the TX ring has room
+// ------------------------------------------------------------
+static bool emit(const TlmProto::LogChunkV1& c, const uint8_t* data) {
+  using namespace TlmProto;
+  uint8_t payload[sizeof(LogChunkV1) + LOG_CHUNK_MAX];
+  memcpy(payload, &c, sizeof(c));
+  if (c.len) memcpy(payload + sizeof(c), data, c.len);
+
+  uint8_t frame[MAX_FRAME];
+  const size_t n = encodeFrame(SCHEMA_LOG_V1, s_dlFrameSeq, payload, sizeof(c) + c.len, frame, sizeof(frame));
+  if (n == 0 || !BtMgr::write(frame, n)) return false;
+  s_dlFrameSeq++;
+  return true;
+}
+
+static void serviceDownload() {
+  using namespace TlmProto;
+  if (!s_dlActive) return;
+  if (!BtMgr::connected()) { s_dlActive = false; return; }
+  if (s_pending.load()) return;                          // writer owns the ring
+  if (BtMgr::txFree(BtMgr::TxPrio::Telemetry) < 2 * MAX_FRAME) return;
+
+  LogChunkV1 c;
+  c.seq = s_dlSeq;
+
+  // skip blocks that were overwritten meanwhile
+  if ((int32_t)(s_dlSeq - s_ring.oldestSeq()) < 0) { s_dlSeq = s_ring.oldestSeq(); s_dlOff = 0; }
+
+  if ((int32_t)(s_dlSeq - s_dlEnd) >= 0 || s_ring.offsetOf(s_dlSeq) < 0) {
+    c.seq = s_dlSeq; c.off = 0; c.total = 0; c.len = 0;
+    if (emit(c, nullptr)) s_dlActive = false;
+    return;
+  }
+
+  SectorHdr h;
+  if (!s_ring.read(s_dlSeq, 0, &h, sizeof(h))) { s_dlSeq++; s_dlOff = 0; return; }
+  const uint16_t total = (uint16_t)(sizeof(SectorHdr) + h.bytes);
+
+  uint8_t buf[LOG_CHUNK_MAX];
+  c.off = s_dlOff;
+  c.total = total;
+  c.len = (uint16_t)min<size_t>(LOG_CHUNK_MAX, total - s_dlOff);
+  if (!s_ring.read(s_dlSeq, s_dlOff, buf, c.len)) { s_dlSeq++; s_dlOff = 0; return; }
+  if (!emit(c, buf)) return;                            // retry next pass
+
+  s_dlOff += c.len;
+  if (s_dlOff >= total) { s_dlSeq++; s_dlOff = 0; }
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static CmdMgr::Err cmdLog(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  const char* op = a.getStr("op");
+  if (!op) op = "info";
+
+  if (!strcmp(op, "get")) {
+    if (!s_mounted) return CmdMgr::ERR_FAILED;
+    if (s_dlActive) return CmdMgr::ERR_BUSY;
+
+    long from = (long)s_ring.oldestSeq(), off = 0;
+    (void)a.getLong("from", from);
+    (void)a.getLong("off", off);
+    if (from < 0) { a.errKey = "from"; return CmdMgr::ERR_RANGE; }
+    if (off < 0 || off >= (long)SECTOR_SIZE) { a.errKey = "off"; return CmdMgr::ERR_RANGE; }
+
+    flush(false);   // include the open block; the writer stores it before we get there
+    s_dlSeq = (uint32_t)from;
+    s_dlOff = (uint16_t)off;
+    if ((int32_t)(s_dlSeq - s_ring.oldestSeq()) < 0) { s_dlSeq = s_ring.oldestSeq(); s_dlOff = 0; }
+    s_dlEnd = s_openSeq;
+    s_dlActive = true;
+    TlmBus::bt()->fmt = TlmBus::Fmt::Bin;
+    r.add(",\"proto\":\"bin\",\"schema\":%u,\"from\":%lu,\"to\":%lu",
+          (unsigned)TlmProto::SCHEMA_LOG_V1, (unsigned long)s_dlSeq, (unsigned long)s_dlEnd);
+    return CmdMgr::ERR_OK;
+  }
+  if (!strcmp(op, "stop"))  { s_dlActive = false; }
+  else if (!strcmp(op, "flush")) { flush(false); }
+  else if (strcmp(op, "info")) { a.errKey = "op"; return CmdMgr::ERR_RANGE; }
+
+  const Info i = info();
+  r.add(",\"mounted\":%d,\"sectors\":%lu,\"used\":%lu,\"oldest\":%lu,\"next\":%lu,"
+        "\"open_recs\":%u,\"open_bytes\":%u,\"records\":%lu,\"period_ms\":%lu,"
+        "\"werr\":%lu,\"dropped\":%lu,\"boot\":%lu,\"dl\":%d",
+        i.mounted ? 1 : 0, (unsigned long)i.sectors, (unsigned long)i.used,
+        (unsigned long)i.oldestSeq, (unsigned long)i.nextSeq,
+        (unsigned)i.openRecords, (unsigned)i.openBytes, (unsigned long)i.records,
+        (unsigned long)s_periodMs, (unsigned long)i.writeErrors,
+        (unsigned long)i.dropped, (unsigned long)i.boot, s_dlActive ? 1 : 0);
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+// 5 ms: one download chunk per run keeps up with the SPP link
+static const TaskSched::TaskDef TASK = { "log", service, 5000, 5, 20000, TaskSched::Overrun::Skip };
+
+bool begin(TlmSub::FillFn fill, uint32_t periodMs) {
+  s_fill = fill;
+  setPeriod(periodMs);
+  startBlock();
+  CmdMgr::registerCmd("log", cmdLog);
+  TaskSched::add(TASK);
+
+  const esp_partition_t* p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PART_SUBTYPE, PART_LABEL);
+  if (!p) return false;
+
+  s_flash = new PartitionFlash(p);
+  if (!s_ring.mount(s_flash)) return false;
+  s_openSeq = s_ring.nextSeq();
+  s_mounted = true;
+
+  Preferences prefs;
+  prefs.begin("tlmlog", false);
+  s_boot = prefs.getUInt("boot", 0) + 1;
+  prefs.putUInt("boot", s_boot);
+  prefs.end();
+
+  xTaskCreatePinnedToCore(writerTask, "log_wr", WRITER_STACK, nullptr,
+                          WRITER_PRIO, &s_writer, WRITER_CORE);
+  s_lastMs = TimeMgr::nowMs();
+  return true;
+}
+
+void setPeriod(uint32_t periodMs) {
+  s_periodMs = max(periodMs, MIN_PERIOD_MS);
+}
+
+void flush(bool wait) {
+  if (!s_mounted) return;
+  seal();
+  // erase + write of one sector is ~50 ms; don't hang forever on a bad flash
+  for (int i = 0; wait && i < 40 && s_pending.load(); i++) delay(5);
+}
+
+void service() {
+  if (!s_mounted || !s_fill) return;
+
+  const uint64_t now = TimeMgr::nowMs();
+  if (now - s_lastMs >= s_periodMs) {
+    s_lastMs = now;
+    record(now);
+  }
+  serviceDownload();
+}
+
+Info info() {
+  Info i;
+  i.mounted     = s_mounted;
+  i.sectors     = s_ring.sectors();
+  i.used        = s_ring.used();
+  i.oldestSeq   = s_ring.oldestSeq();
+  i.nextSeq     = s_openSeq;
+  i.openRecords = s_enc.count();
+  i.openBytes   = (uint16_t)s_enc.bytes();
+  i.records     = s_records;
+  i.writeErrors = s_writeErrors;
+  i.dropped     = s_dropped;
+  i.boot        = s_boot;
+  return i;
+}
+
+} // namespace LogMgr
@@ -1,6 +1,9 @@
 #include <Arduino.h>
 #include "idle_sleep.h"
 #include "load_prot.h"
+#include "thermal_mgr.h"
+#include "energy_mgr.h"
+#include "rtc_state.h"
 #include "pins.h"
 #include "adc_mgr.h"
 #include "power_mgr.h"
@@ -8,60 +11,184 @@
 #include "ui_mgr.h"
 #include "soc_mgr.h"
 #include "bt_mgr.h"
+#include "tlm_proto.h"
+#include "stream_mgr.h"
+#include "cmd_mgr.h"
+#include "tlm_bus.h"
+#include "tlm_sub.h"
+#include "log_mgr.h"
+#include "time_mgr.h"
+#include "task_sched.h"
+#include "prof_mgr.h"
+#include "mem_mgr.h"
+#include "ina_src.h"
+#include "ota_mgr.h"
+#include "event_mgr.h"
 
-static constexpr uint32_t UI_PERIOD_MS        = 1000;
 static constexpr uint32_t LCD_REINIT_DELAY_MS = 200;
-static bool user_en_charge   = true;
-static bool user_en_load_dsg = true;
+
+// Runtime settings (UI period, user enables, protection, ADC, capacity).
+// Readable/writable over BT through CmdMgr get/set.
+static CmdMgr::AppConfig s_cfg;
+
+// Telemetry format is per transport (TlmBus): JSON lines by default, binary
+// frames on BT once the host asks with {"cmd":"proto","fmt":"bin"}. BT falls
+// back to JSON on every new connection so an old client never sees binary
+// (TlmBus' BT transport does that).
+static uint16_t s_tlmSeq = 0;
 
 
 ADCMgr adc;
-AdcReadings adcData;
+
+// ADC frame consumers (see AdcBus in adc_mgr.h). The frame task sees
+// every frame in order; the UI only wants the newest. TlmSub / LogMgr
+// snapshots peek at the newest without a subscription.
+static AdcBus::Sub s_frameSub;
+static AdcBus::Sub s_uiSub;
+static const AdcReadings NO_FRAME{};   // until the first frame is out
+
+// LoadProt time stamps each trip; a new one is a trip event
+static uint64_t s_tripMs = 0;
 
 // ------------------------------------------------------------
-// JSON helpers (BT only)  +  Pin status fields
-// Newline-delimited JSON (one object per line) => easy app parsing
+// Telemetry encoders  +  Pin status fields
+// Newline-delimited JSON (one object per line) => easy app parsing.
+// Each encoder fills a TlmBus frame once; TlmBus fans it out.
 // ------------------------------------------------------------
 static const char* statTextSimple(bool chargingStable) {
   return chargingStable ? "Charging" : "Idle";
 }
 
-void printJsonLineFull(const AdcReadings& d) {
-  BtMgr::printf(
-    "{"
-      "\"ver\":1,"
-      "\"ms\":%lu,"
-      "\"vbat\":%.3f,"
-      "\"soc\":%.1f,"
-      "\"iload\":%.3f,"
-      "\"ichg\":%.3f,"
-      "\"idsg\":%.3f,"
-      "\"temp\":%.2f,"
-      "\"stat\":\"%s\","
-      "\"chg\":%d,"
-      "\"ui_pending\":%d,"
-      "\"ui_left_s\":%lu,"
-      "\"inet\":%.3f,"
-      "\"fcc\":%d,"
-      "\"rem\":%d,"
-      "\"pins\":{"
-        "\"en_charge\":%d,"
-        "\"en_dcdc\":%d,"
-        "\"en_relay\":%d,"
-        "\"en_load_dsg\":%d,"
-        "\"en_bypass\":%d,"
-        "\"chg_done\":%d,"
-        "\"charging\":%d,"
-        "\"btn_sleep\":%d"
-      "}"
-    "}\n",
-    (unsigned long)millis(),
+// TlmProto::PinBit byte: the enables from PowerMgr's shadow (same bit
+// order), the three inputs read live
+static_assert((unsigned)PowerMgr::OUT_CHARGE   == TlmProto::PIN_BIT_EN_CHARGE &&
+              (unsigned)PowerMgr::OUT_DCDC     == TlmProto::PIN_BIT_EN_DCDC &&
+              (unsigned)PowerMgr::OUT_RELAY    == TlmProto::PIN_BIT_EN_RELAY &&
+              (unsigned)PowerMgr::OUT_LOAD_DSG == TlmProto::PIN_BIT_EN_LOAD_DSG &&
+              (unsigned)PowerMgr::OUT_BYPASS   == TlmProto::PIN_BIT_EN_BYPASS,
+              "PowerMgr::Out must match TlmProto::PinBit");
+
+static uint8_t pinBits() {
+  using namespace TlmProto;
+  uint8_t bits = PowerMgr::outputs();
+  if (digitalRead(PIN_CHG_DONE))  bits |= PIN_BIT_CHG_DONE;
+  if (digitalRead(PIN_CHARGING))  bits |= PIN_BIT_CHARGING;
+  if (digitalRead(PIN_BTN_SLEEP)) bits |= PIN_BIT_BTN_SLEEP;
+  return bits;
+}
+
+// "%.*f", or null for NAN (JSON has no nan)
+static const char* jsonNum(char* buf, size_t cap, float v, int decimals) {
+  if (isnan(v)) return "null";
+  snprintf(buf, cap, "%.*f", decimals, v);
+  return buf;
+}
+
+// ------------------------------------------------------------
+// Full telemetry line, and the most it can take: the format's text plus
+// the widest each conversion can print, in order. The floats assume the
+// ranges the ADC and the managers give (volts and amps under 100,
+// energies under 100 kWh); a line that still doesn't fit is not sent.
+// ------------------------------------------------------------
+#define JSON_FULL_FMT \
+  "{" \
+    "\"ver\":1," \
+    "\"ms\":%llu," \
+    "\"vbat\":%.3f," \
+    "\"soc\":%.1f," \
+    "\"iload\":%.3f," \
+    "\"ichg\":%.3f," \
+    "\"idsg\":%.3f," \
+    "\"temp\":%s," \
+    "\"stat\":\"%s\"," \
+    "\"chg\":%d," \
+    "\"ui_pending\":%d," \
+    "\"ui_left_s\":%lu," \
+    "\"inet\":%.3f," \
+    "\"fcc\":%d," \
+    "\"rem\":%d," \
+    "\"pins\":{" \
+      "\"en_charge\":%d," \
+      "\"en_dcdc\":%d," \
+      "\"en_relay\":%d," \
+      "\"en_load_dsg\":%d," \
+      "\"en_bypass\":%d," \
+      "\"chg_done\":%d," \
+      "\"charging\":%d," \
+      "\"btn_sleep\":%d" \
+    "}," \
+    "\"therm\":{" \
+      "\"flags\":%u," \
+      "\"dtdt\":%s," \
+      "\"since_s\":%lu," \
+      "\"trips\":%lu" \
+    "}," \
+    "\"energy\":{" \
+      "\"in_wh\":%.4f," \
+      "\"out_wh\":%.4f," \
+      "\"load_wh\":%.4f," \
+      "\"eff\":%s" \
+    "}," \
+    "\"ir\":{" \
+      "\"r_mohm\":%s," \
+      "\"ref_mohm\":%s," \
+      "\"ocv\":%.3f" \
+    "}," \
+    "\"adc\":{" \
+      "\"rate\":\"%s\"," \
+      "\"tick_us\":%lu," \
+      "\"idle_s\":%lu," \
+      "\"norm_s\":%lu," \
+      "\"burst_s\":%lu," \
+      "\"bursts\":%lu" \
+    "}" \
+  "}\n"
+
+static constexpr uint8_t JSON_FULL_WIDTHS[] = {
+  20,                       // ms (uint64)
+  7, 5, 7, 7, 7,            // vbat soc iload ichg idsg: -99.999, 100.0
+  15,                       // temp: jsonNum() into char[16]
+  8, 1, 1, 10,              // stat ("Charging") chg ui_pending ui_left_s
+  7, 6, 6,                  // inet fcc rem
+  1, 1, 1, 1, 1, 1, 1, 1,   // pins
+  3, 15, 10, 10,            // therm: flags dtdt since_s trips
+  11, 11, 11, 15,           // energy: -99999.9999 Wh x3, eff
+  15, 15, 7,                // ir: r_mohm ref_mohm ocv
+  6, 10, 10, 10, 10, 10,    // adc: rate ("normal") tick_us idle_s norm_s burst_s bursts
+};
+
+static constexpr bool isConv(char c) { return c == 'd' || c == 'u' || c == 'f' || c == 's'; }
+static constexpr const char* convEnd(const char* p) { return isConv(*p) ? p + 1 : convEnd(p + 1); }
+
+static constexpr size_t convCount(const char* p) {
+  return !*p ? 0 : *p == '%' ? 1 + convCount(convEnd(p + 1)) : convCount(p + 1);
+}
+
+static constexpr size_t jsonFullMax(const char* p, size_t i) {
+  return !*p ? 0
+       : *p == '%' ? JSON_FULL_WIDTHS[i] + jsonFullMax(convEnd(p + 1), i + 1)
+       : 1 + jsonFullMax(p + 1, i);
+}
+
+static_assert(convCount(JSON_FULL_FMT) == sizeof(JSON_FULL_WIDTHS),
+              "JSON_FULL_WIDTHS must have one width per conversion");
+static_assert(jsonFullMax(JSON_FULL_FMT, 0) < TlmBus::FrameBuf::CAP,
+              "FrameBuf::CAP too small for the full JSON line");
+
+static bool encodeJsonFull(const AdcReadings& d, TlmBus::FrameBuf* f) {
+  PROF_ZONE(ProfMgr::Z_TLM_JSON);
+  const uint8_t outs = PowerMgr::outputs();
+  char temp[16], dtdt[16], eff[16], irR[16], irRef[16];
+  const EnergyMgr::Totals& en = EnergyMgr::session();
+  const SocMgr::IrInfo ir = SocMgr::ir();
+  int n = snprintf((char*)f->data, TlmBus::FrameBuf::CAP, JSON_FULL_FMT,
+    (unsigned long long)TimeMgr::nowMs(),
     d.vbat_meas_sys_v,
     SocMgr::soc(),
     d.iload_a,
     d.ibatt_chg_a,
     d.ibatt_dsg_a,
-    d.temp_c,
+    jsonNum(temp, sizeof(temp), d.temp_c, 2),
     ChargeMgr::isCharging() ? "Charging" : "Idle",
     ChargeMgr::isCharging() ? 1 : 0,
     ChargeMgr::uiReinitPending() ? 1 : 0,
@@ -69,66 +196,354 @@ void printJsonLineFull(const AdcReadings& d) {
     SocMgr::inet(),
     (int)SocMgr::fcc(),
     (int)SocMgr::remaining(),
-    digitalRead(PIN_EN_CHARGE),
-    digitalRead(PIN_EN_DCDC),
-    digitalRead(PIN_EN_RELAY),
-    digitalRead(PIN_EN_LOAD_DSG),
-    digitalRead(PIN_EN_BYPASS),
+    (outs & PowerMgr::OUT_CHARGE)   ? 1 : 0,
+    (outs & PowerMgr::OUT_DCDC)     ? 1 : 0,
+    (outs & PowerMgr::OUT_RELAY)    ? 1 : 0,
+    (outs & PowerMgr::OUT_LOAD_DSG) ? 1 : 0,
+    (outs & PowerMgr::OUT_BYPASS)   ? 1 : 0,
     digitalRead(PIN_CHG_DONE),
     digitalRead(PIN_CHARGING),
-    digitalRead(PIN_BTN_SLEEP)
+    digitalRead(PIN_BTN_SLEEP),
+    (unsigned)ThermalMgr::flags(),
+    jsonNum(dtdt, sizeof(dtdt), ThermalMgr::rateCMin(), 2),
+    (unsigned long)ThermalMgr::sinceS(),
+    (unsigned long)ThermalMgr::trips(),
+    en.chgInWh,
+    en.dsgOutWh,
+    en.loadWh,
+    jsonNum(eff, sizeof(eff), EnergyMgr::efficiency(), 3),
+    jsonNum(irR, sizeof(irR), ir.ohm * 1000.0f, 1),
+    jsonNum(irRef, sizeof(irRef), ir.refOhm * 1000.0f, 1),
+    ir.ocv,
+    ADCMgr::rateName(adc.rate()),
+    (unsigned long)adc.tickUs(),
+    (unsigned long)(adc.rateUs(ADCMgr::Rate::Idle) / 1000000),
+    (unsigned long)(adc.rateUs(ADCMgr::Rate::Normal) / 1000000),
+    (unsigned long)(adc.rateUs(ADCMgr::Rate::Burst) / 1000000),
+    (unsigned long)adc.bursts()
   );
+  if (n <= 0 || n >= (int)TlmBus::FrameBuf::CAP) return false;
+  f->len = (uint16_t)n;
+  return true;
+}
+// Same content as encodeJsonFull(), as a ~33 byte COBS frame
+static bool encodeBinFull(const AdcReadings& d, TlmBus::FrameBuf* f) {
+  using namespace TlmProto;
+  PROF_ZONE(ProfMgr::Z_TLM_BIN);
+
+  FullV1 r;
+  r.ms         = TimeMgr::ms32();
+  r.vbat_mv    = toU16(d.vbat_meas_sys_v, 1000.0f);
+  r.soc_x10    = toU16(SocMgr::soc(), 10.0f);
+  r.iload_ma   = toU16(d.iload_a, 1000.0f);
+  r.ichg_ma    = toU16(d.ibatt_chg_a, 1000.0f);
+  r.idsg_ma    = toU16(d.ibatt_dsg_a, 1000.0f);
+  r.temp_cx100 = isnan(d.temp_c) ? TEMP_INVALID : toI16(d.temp_c, 100.0f);
+  r.inet_ma    = toI16(SocMgr::inet(), 1000.0f);
+  r.fcc_mah    = toU16(SocMgr::fcc(), 1.0f);
+  r.rem_mah    = toU16(SocMgr::remaining(), 1.0f);
+
+  r.flags = 0;
+  if (ChargeMgr::isCharging())      r.flags |= FLAG_CHARGING;
+  if (ChargeMgr::uiReinitPending()) r.flags |= FLAG_UI_PENDING;
+  if (!ThermalMgr::allowCharge())   r.flags |= FLAG_TH_NO_CHG;
+  if (!ThermalMgr::allowLoad())     r.flags |= FLAG_TH_NO_DSG;
+  if (adc.rate() == ADCMgr::Rate::Idle)  r.flags |= FLAG_ADC_IDLE;
+  if (adc.rate() == ADCMgr::Rate::Burst) r.flags |= FLAG_ADC_BURST;
+
+  uint32_t left = ChargeMgr::uiReinitSecondsLeft();
+  r.ui_left_s = (uint8_t)(left > 255 ? 255 : left);
+
+  r.pins = pinBits();
+
+  size_t n = encodeFrame(SCHEMA_FULL_V1, s_tlmSeq++, &r, sizeof(r), f->data, TlmBus::FrameBuf::CAP);
+  f->len = (uint16_t)n;
+  return n > 0;
+}
+
+// Encode once per format that somebody listens to, then fan out
+static void publishTelemetry(const AdcReadings& d) {
+  using TlmBus::Fmt;
+  static const Fmt FMTS[] = { Fmt::Json, Fmt::Bin };
+
+  for (Fmt fmt : FMTS) {
+    if (!TlmBus::wants(fmt)) continue;
+    TlmBus::FrameBuf* f = TlmBus::alloc(fmt);
+    if (!f) continue;
+
+    const bool ok = (fmt == Fmt::Json) ? encodeJsonFull(d, f) : encodeBinFull(d, f);
+    if (ok) TlmBus::publish(f);
+    else    TlmBus::release(f);
+  }
+}
+
+// Subscription fields, computed only when a subscriber needs them
+static void fillSnapshot(TlmSub::Snapshot& s, uint16_t mask) {
+  using namespace TlmProto;
+  AdcBus::Ref f;
+  const AdcReadings& d = adc.bus().peek(f) ? *f : NO_FRAME;
+  auto want = [mask](Field f) { return (mask & (1u << f)) != 0; };
+
+  if (want(F_VBAT))  s.v[F_VBAT]  = d.vbat_meas_sys_v;
+  if (want(F_SOC))   s.v[F_SOC]   = SocMgr::soc();
+  if (want(F_ILOAD)) s.v[F_ILOAD] = d.iload_a;
+  if (want(F_ICHG))  s.v[F_ICHG]  = d.ibatt_chg_a;
+  if (want(F_IDSG))  s.v[F_IDSG]  = d.ibatt_dsg_a;
+  if (want(F_TEMP))  s.v[F_TEMP]  = d.temp_c;
+  if (want(F_INET))  s.v[F_INET]  = SocMgr::inet();
+  if (want(F_FCC))   s.v[F_FCC]   = SocMgr::fcc();
+  if (want(F_REM))   s.v[F_REM]   = SocMgr::remaining();
+  if (want(F_CHG))   s.v[F_CHG]   = ChargeMgr::isCharging() ? 1.0f : 0.0f;
+  if (want(F_UI_PENDING)) s.v[F_UI_PENDING] = ChargeMgr::uiReinitPending() ? 1.0f : 0.0f;
+  if (want(F_UI_LEFT))    s.v[F_UI_LEFT]    = (float)ChargeMgr::uiReinitSecondsLeft();
+
+  if (want(F_PINS)) s.v[F_PINS] = (float)pinBits();
+  if (want(F_THERM)) s.v[F_THERM] = (float)ThermalMgr::flags();
+  if (want(F_DTDT))  s.v[F_DTDT]  = ThermalMgr::rateCMin();
+  if (want(F_IR))    s.v[F_IR]    = SocMgr::ir().ohm;
+}
+
+// ------------------------------------------------------------
+// BT commands owned by main (get/set/txstats live in CmdMgr)
+// ------------------------------------------------------------
+
+// {"cmd":"proto","fmt":"bin"|"json"} -> switch telemetry format.
+// The ack is always a JSON line, sent before the first binary frame.
+static CmdMgr::Err cmdProto(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  const char* fmt = a.getStr("fmt");
+  if (!fmt) { a.errKey = "fmt"; return CmdMgr::ERR_BAD_VALUE; }
+
+  TlmBus::Transport* bt = TlmBus::bt();
+  if (!strcmp(fmt, "bin"))       bt->fmt = TlmBus::Fmt::Bin;
+  else if (!strcmp(fmt, "json")) bt->fmt = TlmBus::Fmt::Json;
+  else { a.errKey = "fmt"; return CmdMgr::ERR_RANGE; }
+
+  r.add(",\"proto\":\"%s\",\"pver\":%u,\"schema\":%u",
+        bt->fmt == TlmBus::Fmt::Bin ? "bin" : "json",
+        (unsigned)TlmProto::PROTO_VER,
+        (unsigned)TlmProto::SCHEMA_FULL_V1);
+  return CmdMgr::ERR_OK;
+}
+
+// {"cmd":"stream","on":1,"tick_us":500,"mask":31} -> raw ADC stream.
+// Streaming implies binary telemetry (everything on the link is COBS frames).
+static CmdMgr::Err cmdStream(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  long on = 0, tick = 1000, mask = 0x1F;
+  (void)a.getLong("on", on);
+  (void)a.getLong("tick_us", tick);
+  (void)a.getLong("mask", mask);
+
+  if (on) {
+    if (tick <= 0) { a.errKey = "tick_us"; return CmdMgr::ERR_RANGE; }
+    if (!StreamMgr::start((uint32_t)tick, (uint8_t)mask)) return CmdMgr::ERR_FAILED;
+    TlmBus::bt()->fmt = TlmBus::Fmt::Bin;
+  } else {
+    StreamMgr::stop();
+  }
+
+  r.add(",\"stream\":%d,\"tick_us\":%lu,\"proto\":\"%s\",\"decim\":%u,\"sent\":%lu,\"dropped\":%lu",
+        StreamMgr::active() ? 1 : 0,
+        (unsigned long)adc.tickUs(),
+        TlmBus::bt()->fmt == TlmBus::Fmt::Bin ? "bin" : "json",
+        (unsigned)StreamMgr::decimation(),
+        (unsigned long)StreamMgr::packetsSent(), (unsigned long)StreamMgr::packetsDropped());
+  return CmdMgr::ERR_OK;
+}
+
+// {"cmd":"bus"} -> ADC frame bus: "seq" of the newest frame, "no_slot"
+// (frames lost because every slot was held) and per consumer
+// [name,frames,drops,skipped,lag_max,lat_avg_us,lat_max_us].
+// {"cmd":"bus","reset":1} clears the counters.
+static CmdMgr::Err cmdBus(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  AdcBus& bus = adc.bus();
+  long reset = 0;
+  if (a.getLong("reset", reset) && reset) {
+    bus.resetStats();
+    return CmdMgr::ERR_OK;
+  }
+
+  r.add(",\"seq\":%lu,\"slots\":%u,\"no_slot\":%lu,\"subs\":[",
+        (unsigned long)bus.seq(), (unsigned)bus.slots(), (unsigned long)bus.noSlot());
+  for (size_t i = 0; i < bus.subCount(); i++) {
+    const AdcBus::Sub& s = *bus.sub(i);
+    r.add("%s[\"%s\",%lu,%lu,%lu,%lu,%lu,%lu]", i ? "," : "", s.name,
+          (unsigned long)s.frames, (unsigned long)s.drops, (unsigned long)s.skipped,
+          (unsigned long)s.lagMax,
+          (unsigned long)(s.frames ? s.latTotalUs / s.frames : 0),
+          (unsigned long)s.latMaxUs);
+  }
+  r.add("]");
+  return CmdMgr::ERR_OK;
 }
-static void handleBtCommandLine(const char* line) {
-  if (!line || line[0] != '{') return;
 
-  String s(line);
-  s.replace(" ", "");
-  s.replace("\t", "");
-  s.replace("\r", "");
+// {"cmd":"ir"} -> internal resistance estimate (SocMgr) and its health
+// trend: "growth_pct" = R against the first estimate for this cell.
+// {"cmd":"ir","reset":1} after fitting a new cell.
+static CmdMgr::Err cmdIr(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  long reset = 0;
+  if (a.getLong("reset", reset) && reset) SocMgr::resetIr();
 
-  if (s.indexOf("\"cmd\":\"set\"") < 0) return;
+  const SocMgr::IrInfo i = SocMgr::ir();
+  char ohm[16], ref[16], growth[16];
+  r.add(",\"r_mohm\":%s,\"ref_mohm\":%s,\"growth_pct\":%s,\"ocv\":%.3f,\"steps\":%lu,\"rej\":%lu",
+        jsonNum(ohm, sizeof(ohm), i.ohm * 1000.0f, 1),
+        jsonNum(ref, sizeof(ref), i.refOhm * 1000.0f, 1),
+        jsonNum(growth, sizeof(growth), (i.ohm / i.refOhm - 1.0f) * 100.0f, 1),
+        i.ocv, (unsigned long)i.steps, (unsigned long)i.rejects);
+  return CmdMgr::ERR_OK;
+}
 
-  int pinPos = s.indexOf("\"pin\":\"");
-  int valPos = s.indexOf("\"val\":");
-  if (pinPos < 0 || valPos < 0) return;
+// Push a validated config set from BT to the modules
+static CmdMgr::Err applyConfig(const CmdMgr::AppConfig& next, const CmdMgr::AppConfig& prev) {
+  if (next.adc_tick_us != prev.adc_tick_us || next.adc_spc != prev.adc_spc) {
+    if (StreamMgr::active()) return CmdMgr::ERR_BUSY;
+    if (!adc.startTimer(next.adc_tick_us, next.adc_spc)) {
+      adc.startTimer(prev.adc_tick_us, prev.adc_spc);
+      return CmdMgr::ERR_FAILED;
+    }
+  }
 
-  pinPos += 7;
-  int pinEnd = s.indexOf("\"", pinPos);
-  if (pinEnd < 0) return;
+  adc.setAdapt(next.ad);
+  LoadProt::setConfig(next.lp);
+  ThermalMgr::setConfig(next.th);
+  EnergyMgr::setConfig(next.en);
+  RtcState::setConfig(next.rs);
+  if (next.soc_cap_mah != prev.soc_cap_mah) SocMgr::setCapacity(next.soc_cap_mah);
+  if (next.usb_tlm != prev.usb_tlm) TlmBus::usbEnable(next.usb_tlm);
+  LogMgr::setPeriod(next.log_period_ms);
+  MemMgr::setPeriod(next.mem_period_ms);
+  OtaMgr::setGapMs(next.ota_gap_ms);
+  if (next.pwr_dead_us != prev.pwr_dead_us) {
+    PowerMgr::Timing pt = PowerMgr::timing();
+    pt.deadUs = next.pwr_dead_us;
+    PowerMgr::setTiming(pt);
+  }
+  TaskSched::setPeriod(TaskSched::find("ui"), next.ui_period_ms * 1000);
+  // the user enables are read straight from s_cfg
+  return CmdMgr::ERR_OK;
+}
 
-  String pin = s.substring(pinPos, pinEnd);
-  int val = s.substring(valPos + 6).toInt();
+// ------------------------------------------------------------
+// Glue tasks (modules add their own tasks in begin(), see task_sched.h)
+// ------------------------------------------------------------
+// Charge detect debounce, relay rule and the LCD re-init it triggers
+static void taskCharge() {
+  ChargeMgr::update();
+  // Relay rule: ON only when charging (debounced stable)
+  PowerMgr::applyChargingMode(ChargeMgr::isCharging());
+  if (ChargeMgr::stableChanged()) {
+    ChargeMgr::scheduleUiReinit(LCD_REINIT_DELAY_MS);
+    adc.burst();   // the charge current is about to step
+    EventMgr::push(ChargeMgr::isCharging() ? TlmProto::EVT_CHG_START : TlmProto::EVT_CHG_STOP,
+                   ChargeMgr::changedAtUs());
+  }
+  if (ChargeMgr::uiReinitDue()) {
+    UIMgr::reinitLayout();
+  }
+}
 
-  // We'll NOT digitalWrite here for EN_LOAD_DSG (see Fix C below)
-  if (pin == "en_charge") {
-  user_en_charge = (val != 0);
+// EN_CHARGE = user control AND temperature
+// EN_LOAD_DSG = user control AND safety
+// (PowerMgr only writes when one of them changes)
+static void applyEnables() {
+  const bool allowLoad = (SocMgr::soc() > 0.0f) && LoadProt::allowLoad() && ThermalMgr::allowLoad();
+  const bool finalChargeEnable = s_cfg.en_charge && ThermalMgr::allowCharge();
+  const bool finalLoadEnable = s_cfg.en_load_dsg && allowLoad;
+  PowerMgr::set(PowerMgr::OUT_CHARGE | PowerMgr::OUT_LOAD_DSG,
+                (finalChargeEnable ? PowerMgr::OUT_CHARGE : 0) |
+                (finalLoadEnable ? PowerMgr::OUT_LOAD_DSG : 0));
 }
-else if (pin == "en_load_dsg") {
-  user_en_load_dsg = (val != 0);
+
+// Everything that runs once per averaged ADC frame
+static void taskFrame() {
+  AdcBus::Ref f;
+  if (!adc.bus().read(s_frameSub, f)) return;
+  const AdcReadings& d = *f;
+
+  // 1) Load and thermal protection
+  LoadProt::update(d);
+  LoadProt::serviceButton(d);
+  if (LoadProt::lastTripMillis() != s_tripMs) {
+    s_tripMs = LoadProt::lastTripMillis();
+    EventMgr::push(TlmProto::EVT_TRIP, f.tUs(), LoadProt::lastLoadA());
+  }
+  ThermalMgr::update(d);
+  // 2) SOC and energy
+  SocMgr::update(d, ChargeMgr::isCharging(), false, ChargeMgr::isDone());
+  if (SocMgr::lastCal() != SocMgr::CAL_NONE) {
+    EventMgr::push(SocMgr::lastCal() == SocMgr::CAL_FULL ? TlmProto::EVT_FULL : TlmProto::EVT_EMPTY,
+                   f.tUs());
+  }
+  EnergyMgr::update(d, f.tUs(), ChargeMgr::isCharging(), PowerMgr::outputs());
+  // 3) Load enable decision
+  applyEnables();
+
+  // 4) Sleep update
+  IdleSleep::update(d, ChargeMgr::isCharging());
+  // 5) State snapshot for a reset, brownout commit
+  RtcState::update(d, f.tUs(), s_cfg);
 }
 
+// LCD + full telemetry frame, every ui_period_ms
+static void taskUi() {
+  // newest frame; redraw the current one if nothing new came in
+  AdcBus::Ref f;
+  if (!adc.bus().read(s_uiSub, f) && !adc.bus().peek(f)) return;
+  const AdcReadings& d = *f;
+  UIMgr::drawValues(d,
+                    ChargeMgr::isCharging(),
+                    ChargeMgr::uiReinitPending(),
+                    ChargeMgr::uiReinitSecondsLeft(),
+                    SocMgr::soc(),
+                    SocMgr::inet(),
+                    SocMgr::fcc(),
+                    SocMgr::remaining());
+  publishTelemetry(d);
 }
 
+// A new image is confirmed once it has run OtaMgr::CONFIRM_MS and this
+// holds: ADC frames reach the control path
+static bool otaHealthy() {
+  return s_frameSub.frames > 0;
+}
+
+static const TaskSched::TaskDef TASKS[] = {
+  // name     fn          period_us  prio deadline_us overrun
+  { "frame",  taskFrame,  0,         1,   2000,       TaskSched::Overrun::Skip },
+  { "charge", taskCharge, 10000,     2,   5000,       TaskSched::Overrun::Skip },
+  { "ui",     taskUi,     1000000,   7,   100000,     TaskSched::Overrun::Skip },
+};
 
 void setup() {
+  s_cfg = CmdMgr::AppConfig{};   // a restart begins from the defaults (the sim keeps statics)
+  TimeMgr::begin();
+  RtcState::begin(s_cfg.rs);
+  TaskSched::begin();
+  TlmBus::begin();
+  ProfMgr::begin();
+  MemMgr::begin(s_cfg.mem_period_ms);
+  TlmBus::usbBegin(115200);
   BtMgr::begin("Prototype");
+  TlmBus::add(TlmBus::bt());
+  TlmBus::add(TlmBus::usb());
   delay(300);
-  PowerMgr::begin();
+  PowerMgr::Timing pt;
+  pt.deadUs = s_cfg.pwr_dead_us;
+  PowerMgr::begin(pt);
   pinMode(PIN_CHARGING, INPUT);
   pinMode(PIN_CHG_DONE, INPUT_PULLUP);
   IdleSleep::begin();
   // During BT debugging you can keep this OFF; enable later if needed
   // IdleSleep::handleWakeReasonOrSleep();
-  const bool startCharging = (digitalRead(PIN_CHARGING) == HIGH);
-  ChargeMgr::begin(startCharging);
+  ChargeMgr::begin();
   // Relay/Power rules
   PowerMgr::applyChargingMode(ChargeMgr::isCharging());
   // ADC
   adc.begin();
   adc.setZeroOffsetsMv(0, 0, 0);
+  adc.setSource(InaSrc::begin());   // I2C monitors where the board has them
   // Load protection
-  LoadProt::Config lp;
+  LoadProt::Config& lp = s_cfg.lp;
   lp.trip_A       = 0.600f;
   lp.tripDelayMs  = 150;
   lp.resetSafe_A  = 0.050f;
@@ -136,16 +551,39 @@ void setup() {
   lp.retryDelayMs = 10000;        // 10 seconds OFF then ON
   LoadProt::begin(lp);
   LoadProt::setResetButton(PIN_BTN_SLEEP, true, 2000); // activeLow, 2s
+  ThermalMgr::begin(s_cfg.th);
+  EnergyMgr::begin(s_cfg.en);
   // NTC params
   adc.setNtcParams(
-    10000.0f,   // Rfixed
-    10000.0f,   // R25
-    4250.0f     // Beta
+    Profile::BOARD.ntcRfixed,
+    Profile::BOARD.ntcR25,
+    Profile::BOARD.ntcBeta
   );
   UIMgr::begin();
-  SocMgr::begin(2000.0f);
-  adc.startTimer(2000, 64);
-  UIMgr::drawValues(adcData,
+  SocMgr::begin(s_cfg.soc_cap_mah);
+  // the state before a reset, if RTC memory still holds it, over NVS;
+  // a trip or a user "off" holds from here, not from the first frame
+  if (RtcState::restore(s_cfg)) applyEnables();
+  s_tripMs = LoadProt::lastTripMillis();   // a restored trip is not a new one
+  adc.startTimer(s_cfg.adc_tick_us, s_cfg.adc_spc);
+  adc.setAdapt(s_cfg.ad);
+  adc.bus().subscribe(s_frameSub, "frame", AdcBus::Mode::Every);
+  adc.bus().subscribe(s_uiSub, "ui", AdcBus::Mode::Latest);
+  StreamMgr::begin(adc);
+  EventMgr::begin(adc);
+
+  TlmBus::usbEnable(s_cfg.usb_tlm);
+  CmdMgr::begin(s_cfg, applyConfig);
+  CmdMgr::registerCmd("proto",  cmdProto);
+  CmdMgr::registerCmd("stream", cmdStream);
+  CmdMgr::registerCmd("bus",    cmdBus);
+  CmdMgr::registerCmd("ir",     cmdIr);
+  TlmSub::begin(fillSnapshot);
+  LogMgr::begin(fillSnapshot, s_cfg.log_period_ms);
+  OtaMgr::begin(otaHealthy, s_cfg.ota_gap_ms);
+  for (const TaskSched::TaskDef& t : TASKS) TaskSched::add(t);
+  TaskSched::setPeriod(TaskSched::find("ui"), s_cfg.ui_period_ms * 1000);
+  UIMgr::drawValues(NO_FRAME,
                     ChargeMgr::isCharging(),
                     ChargeMgr::uiReinitPending(),
                     ChargeMgr::uiReinitSecondsLeft(),
@@ -153,75 +591,10 @@ void setup() {
                     SocMgr::inet(),
                     SocMgr::fcc(),
                     SocMgr::remaining());
+  // from here on, every buffer is one of the static ones
+  MemMgr::arm();
 }
 
 void loop() {
-  static char rxLine[256];
-
-if (BtMgr::connected()) {
-  while (BtMgr::available()) {
-    size_t n = BtMgr::readLine(rxLine, sizeof(rxLine));
-    if (n > 0) {
-      handleBtCommandLine(rxLine);
-    } else {
-      // no full line yet
-      break;
-    }
-  }
+  TaskSched::runPass();
 }
-  static uint32_t lastUiMs = 0;
-  // ---- Charge manager update ----
-  const bool rawCharging = (digitalRead(PIN_CHARGING) == HIGH);
-  const bool rawFull     = (digitalRead(PIN_CHG_DONE) == LOW);
-  ChargeMgr::update(rawCharging);
-  // Relay rule: ON only when charging (debounced stable)
-  PowerMgr::applyChargingMode(ChargeMgr::isCharging());
-  // UI re-init scheduling
-  if (ChargeMgr::stableChanged()) {
-    ChargeMgr::scheduleUiReinit(LCD_REINIT_DELAY_MS);
-  }
-  if (ChargeMgr::uiReinitDue()) {
-    UIMgr::reinitLayout();
-  }
-  // ---- ADC sampling (timer scheduled, non-blocking) ----
-  adc.service(3);
-  if (adc.fetchLatest(adcData)) {
-    // 1) Load protection
-    LoadProt::update(adcData);
-    LoadProt::serviceButton(adcData);
-    // 2) SOC
-    SocMgr::update(adcData, rawCharging, false, rawFull);
-    // 3) Load enable decision
-
-const bool allowLoad = (SocMgr::soc() > 0.0f) && LoadProt::allowLoad();
-
-// EN_CHARGE = user control (simple)
-digitalWrite(PIN_EN_CHARGE, user_en_charge ? HIGH : LOW);
-
-// EN_LOAD_DSG = user control AND safety
-const bool finalLoadEnable = user_en_load_dsg && allowLoad;
-digitalWrite(PIN_EN_LOAD_DSG, finalLoadEnable ? HIGH : LOW);
-
-    // 4) Sleep update
-    IdleSleep::update(adcData, ChargeMgr::isCharging());
-    // 5) UI + BT JSON output (1Hz)
-    if (millis() - lastUiMs >= UI_PERIOD_MS) {
-      lastUiMs = millis();
-      UIMgr::drawValues(adcData,
-                        ChargeMgr::isCharging(),
-                        ChargeMgr::uiReinitPending(),
-                        ChargeMgr::uiReinitSecondsLeft(),
-                        SocMgr::soc(),
-                        SocMgr::inet(),
-                        SocMgr::fcc(),
-                        SocMgr::remaining());
-
-      if (BtMgr::connected()) {
-        printJsonLineFull(adcData);
-      }
-    }
- 
-}
-
-  }
-
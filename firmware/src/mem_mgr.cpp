@@ -0,0 +1,176 @@
+#include "mem_mgr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "cmd_mgr.h"
+#include "tlm_bus.h"
+#include "task_sched.h"
+
+namespace MemMgr {
+
+static constexpr uint32_t MIN_PERIOD_MS = 1000;
+
+// loopTask is the Arduino loop; the others are started by BtMgr / LogMgr / I2cBus
+static const char* const TASK_NAMES[] = { "loopTask", "bt_tx", "log_wr", "i2c", "ota_wr" };
+static constexpr uint8_t TASK_COUNT = sizeof(TASK_NAMES) / sizeof(TASK_NAMES[0]);
+static_assert(TASK_COUNT <= MAX_TASKS, "MAX_TASKS");
+
+static TaskHandle_t      s_task[TASK_COUNT];
+static volatile bool     s_armed = false;
+static volatile uint32_t s_allocs[TASK_COUNT];
+static volatile uint32_t s_allocBytes = 0;
+static volatile uint32_t s_lastSize = 0;
+static volatile uintptr_t s_lastPc = 0;
+static volatile uint8_t  s_lastTask = 0;
+
+static uint32_t s_periodMs = 0;
+static int      s_taskId = -1;
+
+// "heap":..,"heap_min":..,"largest":..,"allocs":..,"stk":{..}
+static size_t formatFields(char* p, size_t cap) {
+  const Stats s = stats();
+  int n = snprintf(p, cap, "\"heap\":%lu,\"heap_min\":%lu,\"largest\":%lu,\"allocs\":",
+                   (unsigned long)s.heapFree, (unsigned long)s.heapMin, (unsigned long)s.heapLargest);
+  if (!HEAP_GUARD || !s_armed) {
+    n += snprintf(p + n, cap - n, "null");
+  } else {
+    for (uint8_t i = 0; i < TASK_COUNT && (size_t)n < cap; i++) {
+      n += snprintf(p + n, cap - n, "%s\"%s\":%lu", i ? "," : "{", TASK_NAMES[i], (unsigned long)s.allocs[i]);
+    }
+    if ((size_t)n < cap) n += snprintf(p + n, cap - n, "}");
+  }
+  for (uint8_t i = 0; i < TASK_COUNT && (size_t)n < cap; i++) {
+    n += snprintf(p + n, cap - n, "%s\"%s\":%lu", i ? "," : ",\"stk\":{", TASK_NAMES[i],
+                  (unsigned long)stackFree(i));
+  }
+  if ((size_t)n < cap) n += snprintf(p + n, cap - n, "}");
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static char s_fields[320];
+
+static CmdMgr::Err cmdMem(CmdMgr::Args&, CmdMgr::Reply& r) {
+  if (!formatFields(s_fields, sizeof(s_fields))) return CmdMgr::ERR_FAILED;
+  const Stats s = stats();
+  r.add(",%s,\"guard\":%d,\"alloc_bytes\":%lu,\"last_size\":%lu,\"last_pc\":\"0x%08lx\",\"last_task\":\"%s\"",
+        s_fields, HEAP_GUARD ? 1 : 0, (unsigned long)s.allocBytes, (unsigned long)s.lastSize,
+        (unsigned long)s.lastPc, TASK_NAMES[s.lastTask < TASK_COUNT ? s.lastTask : 0]);
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+// Periodic line, JSON transports only (a text line would cut into binary frames)
+// ------------------------------------------------------------
+static void service() {
+  if (!s_periodMs || !TlmBus::wants(TlmBus::Fmt::Json)) return;
+  TlmBus::FrameBuf* f = TlmBus::alloc(TlmBus::Fmt::Json);
+  if (!f) return;
+  char* p = (char*)f->data;
+  const size_t cap = TlmBus::FrameBuf::CAP;
+  size_t n = (size_t)snprintf(p, cap, "{\"ver\":1,\"mem\":{");
+  const size_t m = formatFields(p + n, cap - n);
+  n += m;
+  if (m) n += (size_t)snprintf(p + n, cap - n, "}}\n");
+  if (!m || n >= cap) { TlmBus::release(f); return; }
+  f->len = (uint16_t)n;
+  TlmBus::publish(f);
+}
+
+static const TaskSched::TaskDef TASK = { "mem", service, 10000000, 8, 100000, TaskSched::Overrun::Skip };
+
+// ------------------------------------------------------------
+
+void begin(uint32_t periodMs) {
+  s_armed = false;
+  CmdMgr::registerCmd("mem", cmdMem);
+  s_taskId = TaskSched::add(TASK);
+  setPeriod(periodMs);
+}
+
+void setPeriod(uint32_t periodMs) {
+  s_periodMs = periodMs ? max(periodMs, MIN_PERIOD_MS) : 0;
+  if (s_periodMs) TaskSched::setPeriod(s_taskId, s_periodMs * 1000);
+}
+
+void arm() {
+  s_task[0] = xTaskGetCurrentTaskHandle();
+  for (uint8_t i = 1; i < TASK_COUNT; i++) s_task[i] = xTaskGetHandle(TASK_NAMES[i]);
+  for (uint8_t i = 0; i < TASK_COUNT; i++) s_allocs[i] = 0;
+  s_allocBytes = 0;
+  s_lastSize = 0;
+  s_lastPc = 0;
+  s_lastTask = 0;
+  s_armed = true;
+}
+
+bool armed() { return s_armed; }
+
+void noteAlloc(size_t bytes, const void* pc) {
+  if (!s_armed) return;
+  const TaskHandle_t me = xTaskGetCurrentTaskHandle();
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    if (!s_task[i] || s_task[i] != me) continue;
+    s_allocs[i] = s_allocs[i] + 1;
+    s_allocBytes = s_allocBytes + bytes;
+    s_lastSize = bytes;
+    s_lastPc = (uintptr_t)pc;
+    s_lastTask = i;
+    return;
+  }
+}
+
+Stats stats() {
+  Stats s = {};
+  s.heapFree = ESP.getFreeHeap();
+  s.heapMin = ESP.getMinFreeHeap();
+  s.heapLargest = ESP.getMaxAllocHeap();
+  for (uint8_t i = 0; i < TASK_COUNT; i++) s.allocs[i] = s_allocs[i];
+  s.allocBytes = s_allocBytes;
+  s.lastSize = s_lastSize;
+  s.lastPc = s_lastPc;
+  s.lastTask = s_lastTask;
+  return s;
+}
+
+uint8_t taskCount() { return TASK_COUNT; }
+
+const char* taskName(uint8_t i) { return i < TASK_COUNT ? TASK_NAMES[i] : "?"; }
+
+uint32_t stackFree(uint8_t i) {
+  if (i >= TASK_COUNT) return 0;
+  // before arm() the handles are not looked up yet
+  const TaskHandle_t t = s_task[i] ? s_task[i] : (i ? xTaskGetHandle(TASK_NAMES[i]) : xTaskGetCurrentTaskHandle());
+  // ESP-IDF counts stack in bytes
+  return t ? (uint32_t)uxTaskGetStackHighWaterMark(t) : 0;
+}
+
+} // namespace MemMgr
+
+// ------------------------------------------------------------
+// Heap guard hooks: link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+// (the sim interposes malloc itself, see sim/sim_heap.cpp)
+// ------------------------------------------------------------
+#if HEAP_GUARD && defined(ESP_PLATFORM)
+extern "C" {
+void* __real_malloc(size_t n);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t n);
+
+void* __wrap_malloc(size_t n) {
+  MemMgr::noteAlloc(n, __builtin_return_address(0));
+  return __real_malloc(n);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  MemMgr::noteAlloc(n * size, __builtin_return_address(0));
+  return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t n) {
+  if (n) MemMgr::noteAlloc(n, __builtin_return_address(0));
+  return __real_realloc(p, n);
+}
+} // extern "C"
+#endif
@@ -0,0 +1,370 @@
+#include "ota_mgr.h"
+#include "bt_mgr.h"
+#include "cmd_mgr.h"
+#include "log_mgr.h"
+#include "energy_mgr.h"
+#include "task_sched.h"
+#include "ota_img.h"
+#include <Preferences.h>
+#include <atomic>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Arduino core: true = the app confirms a pending-verify image itself
+extern "C" bool verifyRollbackLater() { return true; }
+
+namespace OtaMgr {
+
+using OtaImg::Result;
+
+static constexpr uint32_t WRITER_STACK = 4096;     // esp_ota_set_boot_partition verifies the image
+static constexpr UBaseType_t WRITER_PRIO = 1;
+static constexpr BaseType_t WRITER_CORE = 0;
+
+static constexpr uint32_t RX_POLL_US = 1000;       // cmd task while receiving
+static constexpr uint32_t MAX_GAP_MS = 1000;
+static constexpr uint32_t REBOOT_DELAY_MS = 300;   // lets the ack out first
+
+// ------------------------------------------------------------
+// Slot backend
+// ------------------------------------------------------------
+class SlotFlash : public OtaImg::FlashIf {
+public:
+  void set(const esp_partition_t* p) { p_ = p; }
+  size_t size() const override { return p_ ? p_->size : 0; }
+  bool erase(size_t off, size_t len) override { return esp_partition_erase_range(p_, off, len) == ESP_OK; }
+  bool write(size_t off, const void* src, size_t len) override { return esp_partition_write(p_, off, src, len) == ESP_OK; }
+  bool read(size_t off, void* dst, size_t len) override { return esp_partition_read(p_, off, dst, len) == ESP_OK; }
+private:
+  const esp_partition_t* p_ = nullptr;
+};
+
+// What "begin" resumes: chunks 0..stored-1 of this image are in this slot
+struct Session {
+  uint32_t size;
+  uint32_t crc;
+  uint32_t addr;     // slot flash address
+  uint32_t stored;
+};
+
+static const esp_partition_t* s_slot = nullptr;   // inactive app slot
+static SlotFlash         s_flash;
+static OtaImg::Receiver  s_rx;
+static Session           s_sess = {};
+static State             s_state = State::Idle;
+static HealthFn          s_healthy = nullptr;
+static bool              s_pending = false;     // running image not confirmed yet
+static bool              s_nakSent = false;     // one error report per stall
+static uint32_t          s_rxStartMs = 0;
+static uint32_t          s_rebootAtMs = 0;
+static int               s_cmdTask = -1;
+
+// Writer job: set up by the loop, run by "ota_wr" while s_busy is set.
+// s_done comes before the pause after a write, so the loop reports the
+// chunk and the host sends the next one while flash is quiet.
+enum class Job : uint8_t { Write, Verify };
+static Job               s_job = Job::Write;
+static uint32_t          s_jobIdx = 0;
+static size_t            s_jobLen = 0;
+static bool              s_jobOk = false;
+static bool              s_collect = false;     // a job whose result is not taken yet
+static std::atomic<bool> s_done(false);         // its result is there
+static std::atomic<bool> s_busy(false);         // the writer has not finished it
+static std::atomic<uint32_t> s_gapMs(20);
+static TaskHandle_t      s_writer = nullptr;
+static uint8_t           s_readBuf[1024];
+
+static void saveSession(const Session& s) {
+  Preferences prefs;
+  prefs.begin("ota", false);
+  prefs.putBytes("sess", &s, sizeof(s));
+  prefs.end();
+}
+
+static void loadSession() {
+  Preferences prefs;
+  prefs.begin("ota", true);
+  if (prefs.getBytes("sess", &s_sess, sizeof(s_sess)) != sizeof(s_sess)) s_sess = Session{};
+  prefs.end();
+}
+
+static void writerTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!s_busy.load()) continue;
+    if (s_job == Job::Write) {
+      s_jobOk = OtaImg::writeChunk(s_flash, s_jobIdx, s_rx.chunk(), s_jobLen);
+      const uint32_t chunks = OtaImg::chunkCount(s_sess.size);
+      if (s_jobOk && ((s_jobIdx + 1) % SAVE_EVERY == 0 || s_jobIdx + 1 == chunks)) {
+        Session s = s_sess;
+        s.stored = s_jobIdx + 1;
+        saveSession(s);
+      }
+      s_done.store(true);
+      // give the loop a break from the flash stalls
+      const uint32_t gap = s_gapMs.load();
+      if (gap) vTaskDelay(pdMS_TO_TICKS(gap));
+    } else {
+      uint32_t crc = 0;
+      s_jobOk = OtaImg::readCrc(s_flash, s_sess.size, s_readBuf, sizeof(s_readBuf), crc) &&
+                crc == s_sess.crc && esp_ota_set_boot_partition(s_slot) == ESP_OK;
+      s_done.store(true);
+    }
+    s_busy.store(false);
+  }
+}
+
+static void startJob(Job j) {
+  s_job = j;
+  s_collect = true;
+  s_done.store(false);
+  s_busy.store(true);
+  if (s_writer) xTaskNotifyGive(s_writer);
+}
+
+// ------------------------------------------------------------
+// Progress
+// ------------------------------------------------------------
+static void report(const char* err) {
+  char e[24] = "";
+  if (err) snprintf(e, sizeof(e), ",\"err\":\"%s\"", err);
+  BtMgr::reply("{\"ver\":1,\"ota\":{\"state\":\"%s\",\"stored\":%lu,\"next\":%lu%s}}\n",
+               stateName(s_state), (unsigned long)s_sess.stored, (unsigned long)s_rx.next(), e);
+}
+
+static void setState(State s) {
+  const bool rx = s == State::Rx;
+  if (rx != (s_state == State::Rx)) TaskSched::setPeriod(s_cmdTask, rx ? RX_POLL_US : CmdMgr::POLL_US);
+  s_state = s;
+}
+
+static void fail(const char* err) {
+  setState(State::Failed);
+  report(err);
+}
+
+// Hand the writer its next job once it is free
+static void kick() {
+  if (s_collect || s_busy.load()) return;
+  if (s_state == State::Verify) {
+    startJob(Job::Verify);
+  } else if (s_state == State::Rx && s_rx.ready()) {
+    s_jobIdx = s_rx.chunkIdx();
+    s_jobLen = s_rx.chunkLen();
+    startJob(Job::Write);
+  }
+}
+
+// A finished writer job
+static void collect() {
+  if (!s_collect || !s_done.load()) return;
+  s_collect = false;
+
+  if (s_job == Job::Verify) {
+    if (!s_jobOk) { fail("verify"); return; }
+    setState(State::Ready);
+    report(nullptr);
+    return;
+  }
+  if (!s_jobOk) { fail("flash"); return; }
+  s_sess.stored = s_jobIdx + 1;
+  const Result r = s_rx.release();
+  if (s_sess.stored == s_rx.chunks()) setState(State::Verify);   // kick() starts it
+  report(r == Result::Bad ? OtaImg::resultName(r) : nullptr);
+}
+
+static void pump() {
+  collect();
+  kick();
+}
+
+static void onFrame(const TlmProto::Decoder& d) {
+  if (d.schema() != TlmProto::SCHEMA_OTA_V1 || s_state != State::Rx) return;
+  const Result r = s_rx.push(d.payload(), d.payloadLen());
+  switch (r) {
+    case Result::Piece:
+    case Result::Chunk:
+    case Result::Held:
+      s_nakSent = false;
+      break;
+    case Result::Dup:
+      break;
+    default:
+      // Gap, Busy, Bad, Malformed: tell the host where to go back to,
+      // once until it gets there (it also times out on its own)
+      if (!s_nakSent) report(OtaImg::resultName(r));
+      s_nakSent = true;
+      break;
+  }
+  pump();
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static const char* imgStateName(const esp_partition_t* p) {
+  esp_ota_img_states_t st;
+  if (!p || esp_ota_get_state_partition(p, &st) != ESP_OK) return "-";
+  switch (st) {
+    case ESP_OTA_IMG_NEW:            return "new";
+    case ESP_OTA_IMG_PENDING_VERIFY: return "pending";
+    case ESP_OTA_IMG_VALID:          return "valid";
+    case ESP_OTA_IMG_INVALID:        return "invalid";
+    case ESP_OTA_IMG_ABORTED:        return "aborted";
+    default:                         return "undefined";
+  }
+}
+
+// NVS and the log block would not survive the restart
+static void prepareRestart() {
+  LogMgr::flush(true);
+  EnergyMgr::save();
+}
+
+static CmdMgr::Err opBegin(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  if (s_pending) return CmdMgr::ERR_BUSY;     // the other slot is the way back: confirm first
+  if (s_busy.load() || s_collect || s_state == State::Verify) return CmdMgr::ERR_BUSY;
+  if (!s_slot) return CmdMgr::ERR_FAILED;
+
+  int64_t size = 0, crc = -1;
+  if (!a.getInt64("size", size)) { a.errKey = "size"; return CmdMgr::ERR_BAD_VALUE; }
+  if (!a.getInt64("crc", crc))   { a.errKey = "crc";  return CmdMgr::ERR_BAD_VALUE; }
+  if (size <= 0 || size > (int64_t)s_slot->size) { a.errKey = "size"; return CmdMgr::ERR_RANGE; }
+  if (crc < 0 || crc > 0xFFFFFFFFll) { a.errKey = "crc"; return CmdMgr::ERR_RANGE; }
+
+  if (s_sess.size != (uint32_t)size || s_sess.crc != (uint32_t)crc || s_sess.addr != s_slot->address) {
+    s_sess = { (uint32_t)size, (uint32_t)crc, s_slot->address, 0 };
+    saveSession(s_sess);
+  }
+  s_rx.begin(s_sess.size, s_sess.stored);
+  s_nakSent = false;
+  s_rxStartMs = millis();
+  setState(State::Rx);
+  // all on flash already: check it again (kick() starts it)
+  if (s_sess.stored == s_rx.chunks()) setState(State::Verify);
+  r.add(",\"slot\":\"%s\",\"chunk\":%u,\"piece\":%u,\"chunks\":%lu,\"next\":%lu",
+        s_slot->label, (unsigned)OtaImg::CHUNK, (unsigned)TlmProto::OTA_PIECE_MAX,
+        (unsigned long)s_rx.chunks(), (unsigned long)s_sess.stored);
+  return CmdMgr::ERR_OK;
+}
+
+static CmdMgr::Err cmdOta(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  const char* op = a.getStr("op");
+  if (!op) op = "info";
+
+  if (!strcmp(op, "begin")) return opBegin(a, r);
+
+  if (!strcmp(op, "abort")) {
+    if (s_busy.load() || s_collect) return CmdMgr::ERR_BUSY;
+    // the finished image was already the boot slot
+    if (s_state == State::Ready) esp_ota_set_boot_partition(esp_ota_get_running_partition());
+    s_sess = Session{};
+    saveSession(s_sess);
+    s_rx.begin(0, 0);
+    setState(State::Idle);
+  } else if (!strcmp(op, "reboot")) {
+    if (s_state != State::Ready) return CmdMgr::ERR_BUSY;
+    s_rebootAtMs = millis() + REBOOT_DELAY_MS;
+  } else if (!strcmp(op, "confirm")) {
+    if (s_pending && esp_ota_mark_app_valid_cancel_rollback() != ESP_OK) return CmdMgr::ERR_FAILED;
+    s_pending = false;
+  } else if (!strcmp(op, "rollback")) {
+    if (!s_pending) return CmdMgr::ERR_FAILED;     // nothing to go back to
+    prepareRestart();
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+    return CmdMgr::ERR_FAILED;                      // only returns if it could not
+  } else if (strcmp(op, "info")) {
+    a.errKey = "op";
+    return CmdMgr::ERR_RANGE;
+  }
+
+  const esp_partition_t* run = esp_ota_get_running_partition();
+  const esp_partition_t* boot = esp_ota_get_boot_partition();
+  const OtaImg::Stats& st = s_rx.stats();
+  const TlmProto::Decoder& fr = BtMgr::rxFrames();
+  const uint32_t now = millis();
+  r.add(",\"state\":\"%s\",\"running\":\"%s\",\"img\":\"%s\",\"boot\":\"%s\",\"slot\":\"%s\","
+        "\"confirm_ms\":%ld,\"size\":%lu,\"chunks\":%lu,\"stored\":%lu,\"next\":%lu,"
+        "\"pieces\":%lu,\"dups\":%lu,\"gaps\":%lu,\"bad\":%lu,\"packed\":%lu,\"raw\":%lu,"
+        "\"rx_ms\":%lu,\"frames\":%lu,\"frame_err\":%lu,\"gap_ms\":%lu",
+        stateName(s_state), run ? run->label : "-", imgStateName(run), boot ? boot->label : "-",
+        s_slot ? s_slot->label : "-",
+        s_pending ? (long)(now < CONFIRM_MS ? CONFIRM_MS - now : 0) : -1L,
+        (unsigned long)s_sess.size, (unsigned long)OtaImg::chunkCount(s_sess.size),
+        (unsigned long)s_sess.stored, (unsigned long)s_rx.next(),
+        (unsigned long)st.pieces, (unsigned long)st.dups, (unsigned long)st.gaps,
+        (unsigned long)st.bad, (unsigned long)st.packedBytes, (unsigned long)st.rawBytes,
+        (unsigned long)(s_state == State::Idle ? 0 : now - s_rxStartMs),
+        (unsigned long)fr.frames(), (unsigned long)(fr.crcErrors() + fr.badFrames() + fr.overruns()),
+        (unsigned long)s_gapMs.load());
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+static const TaskSched::TaskDef TASK = { "ota", service, 5000, 5, 0, TaskSched::Overrun::Skip };
+
+void begin(HealthFn healthy, uint32_t gapMs) {
+  s_healthy = healthy;
+  setGapMs(gapMs);
+  CmdMgr::registerCmd("ota", cmdOta);
+  TaskSched::add(TASK);
+  s_cmdTask = TaskSched::find("cmd");
+  BtMgr::onFrame(onFrame);
+
+  s_state = State::Idle;
+  s_collect = false;
+  s_rebootAtMs = 0;
+  s_rx.begin(0, 0);
+
+  const esp_partition_t* run = esp_ota_get_running_partition();
+  esp_ota_img_states_t st;
+  s_pending = run && esp_ota_get_state_partition(run, &st) == ESP_OK && st == ESP_OTA_IMG_PENDING_VERIFY;
+  s_slot = esp_ota_get_next_update_partition(nullptr);
+  s_flash.set(s_slot);
+  loadSession();
+  // written for the slot we now run from: done with
+  if (!s_slot || s_sess.addr != s_slot->address) s_sess = Session{};
+
+  xTaskCreatePinnedToCore(writerTask, "ota_wr", WRITER_STACK, nullptr,
+                          WRITER_PRIO, &s_writer, WRITER_CORE);
+}
+
+void setGapMs(uint32_t gapMs) {
+  s_gapMs.store(min(gapMs, MAX_GAP_MS));
+}
+
+void service() {
+  pump();
+
+  // host gone: park the session once the writer is done, "begin" resumes it
+  if (s_state == State::Rx && !BtMgr::connected() && !s_collect && !s_rx.ready()) setState(State::Idle);
+
+  const uint32_t now = millis();
+  if (s_pending && now >= CONFIRM_MS && (!s_healthy || s_healthy())) {
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) s_pending = false;
+  }
+  if (s_rebootAtMs && (int32_t)(now - s_rebootAtMs) >= 0) {
+    s_rebootAtMs = 0;
+    prepareRestart();
+    esp_restart();
+  }
+}
+
+State state() { return s_state; }
+
+const char* stateName(State s) {
+  switch (s) {
+    case State::Idle:   return "idle";
+    case State::Rx:     return "rx";
+    case State::Verify: return "verify";
+    case State::Ready:  return "ready";
+    case State::Failed: return "failed";
+  }
+  return "?";
+}
+
+} // namespace OtaMgr
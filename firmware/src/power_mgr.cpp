@@ -1,48 +1,118 @@
 #include "power_mgr.h"
 #include "pins.h"
+#include "time_mgr.h"
+#include "task_sched.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
 
 namespace PowerMgr {
 
-// Keep these always ON (as your original design)
-static const int ALWAYS_ON_PINS[] = {
-  PIN_EN_CHARGE,
-  PIN_EN_LOAD_DSG,
-  PIN_EN_BYPASS
-  // NOTE: PIN_EN_DCDC removed from here (we will control it dynamically)
+// GPIO for each Out bit, bit 0 first
+static const int OUT_PINS[] = {
+  PIN_EN_CHARGE, PIN_EN_DCDC, PIN_EN_RELAY, PIN_EN_LOAD_DSG, PIN_EN_BYPASS,
 };
+static constexpr size_t NUM_OUTS = sizeof(OUT_PINS) / sizeof(OUT_PINS[0]);
 
-void begin() {
-  for (int pin : ALWAYS_ON_PINS) {
-    pinMode(pin, OUTPUT);
-    digitalWrite(pin, HIGH);
+static_assert(PIN_EN_CHARGE < 32 && PIN_EN_DCDC < 32 && PIN_EN_RELAY < 32 &&
+              PIN_EN_LOAD_DSG < 32 && PIN_EN_BYPASS < 32,
+              "W1TS/W1TC writes below only cover GPIO 0..31");
+
+static constexpr uint8_t BOOT_LEVELS = OUT_CHARGE | OUT_LOAD_DSG | OUT_BYPASS | OUT_DCDC;
+
+static Timing   s_timing;
+static uint8_t  s_out = 0;          // shadow: what the pins drive
+static uint8_t  s_target = 0;
+static uint64_t s_breakUs = 0;      // last off edge in the bbm group
+static uint32_t s_gpioMask[OUT_ALL + 1];   // Out bits -> GPIO register bits
+
+static void writeOff(uint8_t bits) {
+  REG_WRITE(GPIO_OUT_W1TC_REG, s_gpioMask[bits & OUT_ALL]);
+  s_out &= ~bits;
+}
+
+static void writeOn(uint8_t bits) {
+  REG_WRITE(GPIO_OUT_W1TS_REG, s_gpioMask[bits & OUT_ALL]);
+  s_out |= bits;
+}
+
+// Moves the outputs toward s_target as far as the dead time allows
+static void step() {
+  const uint8_t offs = s_out & ~s_target;
+  if (offs) {
+    writeOff(offs);
+    if (offs & s_timing.bbmMask) s_breakUs = TimeMgr::nowUs();
+  }
+
+  uint8_t ons = s_target & ~s_out;
+  if ((ons & s_timing.bbmMask) && TimeMgr::nowUs() - s_breakUs < s_timing.deadUs) {
+    ons &= ~s_timing.bbmMask;   // the task writes them once the dead time is over
+  }
+  if (ons) writeOn(ons);
+}
+
+static void service() {
+  if (s_out != s_target) step();
+}
+
+static const TaskSched::TaskDef TASK = { "power", service, 0, 1, 0, TaskSched::Overrun::Skip };
+
+void begin(const Timing& t) {
+  s_timing = t;
+
+  for (uint32_t bits = 0; bits <= OUT_ALL; bits++) {
+    uint32_t m = 0;
+    for (size_t i = 0; i < NUM_OUTS; i++) {
+      if (bits & (1u << i)) m |= 1u << OUT_PINS[i];
+    }
+    s_gpioMask[bits] = m;
   }
 
-  pinMode(PIN_EN_DCDC, OUTPUT);
-  digitalWrite(PIN_EN_DCDC, HIGH);   // default ON (until we apply mode)
+  // Known state first: everything low, and that counts as a break
+  writeOff(OUT_ALL);
+  for (int pin : OUT_PINS) pinMode(pin, OUTPUT);
+  s_breakUs = TimeMgr::nowUs();
+
+  s_target = BOOT_LEVELS;
+  step();
+  TaskSched::add(TASK);
+}
+
+void setTiming(const Timing& t) {
+  s_timing = t;
+}
+
+const Timing& timing() { return s_timing; }
 
-  pinMode(PIN_EN_RELAY, OUTPUT);
-  digitalWrite(PIN_EN_RELAY, LOW);   // default OFF
+void set(uint8_t mask, uint8_t levels) {
+  const uint8_t next = (uint8_t)((s_target & ~mask) | (levels & mask)) & OUT_ALL;
+  if (next == s_target) return;
+  s_target = next;
+  step();
 }
 
 void setRelay(bool on) {
-  digitalWrite(PIN_EN_RELAY, on ? HIGH : LOW);
+  set(OUT_RELAY, on ? OUT_RELAY : 0);
 }
 
 void setDcdc(bool on) {
-  digitalWrite(PIN_EN_DCDC, on ? HIGH : LOW);
+  set(OUT_DCDC, on ? OUT_DCDC : 0);
 }
 
 void applyChargingMode(bool charging) {
-  if (charging) {
-    // Charging: relay ON, DC-DC OFF
-    setRelay(true);
-    setDcdc(false);
-  } else {
-    // Not charging: relay OFF, DC-DC ON
-    setDcdc(true);
-    setRelay(false);
-    
+  // Charging: relay ON, DC-DC OFF. Not charging: relay OFF, DC-DC ON.
+  set(OUT_RELAY | OUT_DCDC, charging ? OUT_RELAY : OUT_DCDC);
+}
+
+void settle() {
+  while (s_out != s_target) {
+    const uint64_t since = TimeMgr::nowUs() - s_breakUs;
+    if (since < s_timing.deadUs) delayMicroseconds((uint32_t)(s_timing.deadUs - since));
+    step();
   }
 }
 
+uint8_t outputs() { return s_out; }
+uint8_t target()  { return s_target; }
+bool    busy()    { return s_out != s_target; }
+
 } // namespace PowerMgr
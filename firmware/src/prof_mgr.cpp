@@ -0,0 +1,121 @@
+#include "prof_mgr.h"
+
+#if PROF_ENABLE
+
+#include "cmd_mgr.h"
+
+namespace ProfMgr {
+
+static const char* const NAMES[ZONE_COUNT] = {
+  "adc_service", "soc_update", "load_prot", "ui_draw", "tlm_json", "tlm_bin",
+};
+
+// One extra slot past the public zones for the calibration runs
+static constexpr uint8_t Z_SELF = ZONE_COUNT;
+static constexpr int     CALIB_RUNS = 256;
+
+static ZoneStats s_zones[ZONE_COUNT + 1];
+static uint32_t  s_ovhCyc = 0;
+static uint32_t  s_biasCyc = 0;
+
+static constexpr size_t ENTRY_MAX = 448;   // one zone with a full histogram
+
+static void clearZone(ZoneStats& z) {
+  memset(&z, 0, sizeof(z));
+  z.minCyc = UINT32_MAX;
+}
+
+void record(uint8_t zone, uint32_t cyc) {
+  if (zone > Z_SELF) return;
+  ZoneStats& z = s_zones[zone];
+  z.n++;
+  z.totalCyc += cyc;
+  if (cyc < z.minCyc) z.minCyc = cyc;
+  if (cyc > z.maxCyc) z.maxCyc = cyc;
+  z.hist[31 - __builtin_clz(cyc | 1)]++;
+}
+
+void reset() {
+  for (uint8_t i = 0; i < ZONE_COUNT; i++) clearZone(s_zones[i]);
+}
+
+const char* zoneName(uint8_t zone) { return zone < ZONE_COUNT ? NAMES[zone] : "?"; }
+
+const ZoneStats& stats(uint8_t zone) { return s_zones[zone < ZONE_COUNT ? zone : Z_SELF]; }
+
+uint32_t overheadCycles() { return s_ovhCyc; }
+uint32_t biasCycles()     { return s_biasCyc; }
+
+// Empty zones back to back: total cycles / runs is what a zone costs the
+// code around it, the smallest recorded value is the bias in every sample
+static void calibrate() {
+  clearZone(s_zones[Z_SELF]);
+  const uint32_t t0 = cycles();
+  for (int i = 0; i < CALIB_RUNS; i++) {
+    Zone z(Z_SELF);
+  }
+  s_ovhCyc = (cycles() - t0) / CALIB_RUNS;
+  s_biasCyc = s_zones[Z_SELF].minCyc;
+}
+
+// ------------------------------------------------------------
+// Command
+// ------------------------------------------------------------
+// [name, n, min, avg, max, b0, [hist b0..last non-empty]]
+static size_t formatZone(uint8_t id, char* buf, size_t cap) {
+  const ZoneStats& z = s_zones[id];
+  size_t b0 = HIST_BUCKETS, b1 = 0;
+  for (size_t b = 0; b < HIST_BUCKETS; b++) {
+    if (!z.hist[b]) continue;
+    if (b0 == HIST_BUCKETS) b0 = b;
+    b1 = b + 1;
+  }
+  if (b0 == HIST_BUCKETS) b0 = 0;
+
+  int n = snprintf(buf, cap, "[\"%s\",%lu,%lu,%lu,%lu,%u,[", NAMES[id], (unsigned long)z.n,
+                   (unsigned long)(z.n ? z.minCyc : 0),
+                   (unsigned long)(z.n ? (uint32_t)(z.totalCyc / z.n) : 0),
+                   (unsigned long)z.maxCyc, (unsigned)b0);
+  for (size_t b = b0; b < b1 && n > 0 && (size_t)n < cap; b++) {
+    n += snprintf(buf + n, cap - n, "%s%lu", b > b0 ? "," : "", (unsigned long)z.hist[b]);
+  }
+  if (n > 0 && (size_t)n < cap) n += snprintf(buf + n, cap - n, "]]");
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+static CmdMgr::Err cmdProf(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  long reset = 0;
+  if (a.getLong("reset", reset) && reset) {
+    ProfMgr::reset();
+    return CmdMgr::ERR_OK;
+  }
+
+  long from = 0;
+  (void)a.getLong("from", from);
+  if (from < 0) from = 0;
+
+  r.add(",\"mhz\":%lu,\"ovh_cyc\":%lu,\"bias_cyc\":%lu,\"zones\":[",
+        (unsigned long)ESP.getCpuFreqMHz(), (unsigned long)s_ovhCyc, (unsigned long)s_biasCyc);
+  char entry[ENTRY_MAX];
+  size_t i = (size_t)from;
+  for (; i < ZONE_COUNT; i++) {
+    const size_t n = formatZone((uint8_t)i, entry, sizeof(entry));
+    if (i > (size_t)from && r.len + n + 16 > r.cap) break;
+    r.add("%s%s", i > (size_t)from ? "," : "", entry);
+  }
+  r.add("]");
+  if (i < ZONE_COUNT) r.add(",\"next\":%u", (unsigned)i);
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+void begin() {
+  for (uint8_t i = 0; i < ZONE_COUNT; i++) clearZone(s_zones[i]);
+  calibrate();
+  CmdMgr::registerCmd("prof", cmdProf);
+}
+
+} // namespace ProfMgr
+
+#endif // PROF_ENABLE
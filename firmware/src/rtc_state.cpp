@@ -0,0 +1,187 @@
+#include "rtc_state.h"
+#include <stddef.h>
+#include "esp_system.h"
+#include "cmd_mgr.h"
+#include "soc_mgr.h"
+#include "load_prot.h"
+#include "charge_mgr.h"
+#include "thermal_mgr.h"
+#include "energy_mgr.h"
+#include "log_mgr.h"
+#include "time_mgr.h"
+#include "tlm_proto.h"
+
+namespace RtcState {
+
+static constexpr float    BO_MARGIN_V = 0.05f;   // commit this close to boV whatever the slope
+static constexpr float    BO_REARM_V  = 0.20f;
+static constexpr float    SLOPE_TAU_S = 2.0f;    // vbat slope low-pass
+static constexpr uint64_t GAP_US      = 2000000; // longer frame gaps restart the slope
+static constexpr uint64_t CHG_FRESH_MS = 2000;   // older charger levels: the pins decide
+
+// Bump VER if the layout changes; an older block then falls back to NVS
+static constexpr uint32_t MAGIC = 0x31535452;    // "RTS1"
+static constexpr uint16_t VER = 1;
+
+struct Block {
+  uint32_t magic;
+  uint16_t ver;
+  uint16_t size;
+  uint64_t ms;               // TimeMgr ms of the last update()
+  uint32_t restores;
+  uint32_t boCommits;
+  SocMgr::State     soc;
+  LoadProt::State   lp;
+  ChargeMgr::State  chg;
+  ThermalMgr::State th;
+  EnergyMgr::State  en;
+  bool     enCharge;
+  bool     enLoadDsg;
+  uint16_t crc;
+
+  uint16_t calc() const {
+    return TlmProto::crc16(reinterpret_cast<const uint8_t*>(this), offsetof(Block, crc));
+  }
+  bool valid() const { return magic == MAGIC && ver == VER && size == sizeof(Block) && crc == calc(); }
+  void seal() { crc = calc(); }
+};
+
+RTC_NOINIT_ATTR static Block s_blk;
+
+static Config s_cfg;
+static Info   s_info;
+static bool   s_valid = false;     // block checked at begin()
+static bool   s_live = false;      // update() may write the block
+
+// brownout watch
+static bool     s_havePrev = false;
+static uint64_t s_prevUs = 0;
+static float    s_prevV = 0;
+static float    s_slope = 0;
+static bool     s_armed = true;
+
+static const char* const REASONS[] = {
+  "unknown", "poweron", "ext", "sw", "panic", "int_wdt", "task_wdt", "wdt",
+  "deepsleep", "brownout", "sdio",
+};
+
+const char* reasonName(uint8_t reason) {
+  return reason < sizeof(REASONS) / sizeof(REASONS[0]) ? REASONS[reason] : "?";
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static CmdMgr::Err cmdBoot(CmdMgr::Args&, CmdMgr::Reply& r) {
+  const Info i = info();
+  char stale[24] = "null";
+  if (i.src == SRC_RTC) snprintf(stale, sizeof(stale), "%llu", (unsigned long long)i.staleMs);
+  r.add(",\"reason\":\"%s\",\"src\":\"%s\",\"stale_ms\":%s,\"restore_us\":%lu,\"at_ms\":%lu,"
+        "\"restores\":%lu,\"bo_commits\":%lu,\"vslope\":%.4f,\"bo_armed\":%d",
+        reasonName(i.reason), i.src == SRC_RTC ? "rtc" : "nvs", stale,
+        (unsigned long)i.restoreUs, (unsigned long)i.atMs,
+        (unsigned long)i.restores, (unsigned long)i.boCommits, i.slopeVs, s_armed ? 1 : 0);
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+void begin(const Config& cfg) {
+  s_cfg = cfg;
+  s_info = Info{};
+  s_info.reason = (uint8_t)esp_reset_reason();
+  // TimeMgr carries on over the reset; a block from the future is not ours
+  s_valid = s_blk.valid() && s_blk.ms <= TimeMgr::nowMs();
+  s_live = false;
+  s_havePrev = false;
+  s_slope = 0;
+  s_armed = true;
+  CmdMgr::registerCmd("boot", cmdBoot);
+}
+
+void setConfig(const Config& cfg) { s_cfg = cfg; }
+const Config& config() { return s_cfg; }
+
+bool restore(CmdMgr::AppConfig& cfg) {
+  const uint32_t c0 = ESP.getCycleCount();
+  if (s_valid && s_blk.valid()) {
+    s_info.src = SRC_RTC;
+    s_info.staleMs = TimeMgr::nowMs() - s_blk.ms;
+    SocMgr::restore(s_blk.soc);
+    LoadProt::restore(s_blk.lp);
+    // a reset in the middle of a bounce, not a wake from deep sleep
+    if (s_info.staleMs <= CHG_FRESH_MS) ChargeMgr::restore(s_blk.chg);
+    ThermalMgr::restore(s_blk.th);
+    EnergyMgr::restore(s_blk.en);
+    cfg.en_charge   = s_blk.enCharge;
+    cfg.en_load_dsg = s_blk.enLoadDsg;
+    s_blk.restores++;
+  } else {
+    // power-on (or a torn block): start the counters over
+    s_info.src = SRC_NVS;
+    s_blk.restores = 0;
+    s_blk.boCommits = 0;
+  }
+  s_info.restoreUs = (ESP.getCycleCount() - c0) / ESP.getCpuFreqMHz();
+  s_info.atMs = millis();
+  s_live = true;
+  return s_info.src == SRC_RTC;
+}
+
+// All NVS records now, before the supply is gone
+static void commit() {
+  SocMgr::save();
+  EnergyMgr::save();
+  LogMgr::flush(false);
+  s_blk.boCommits++;
+}
+
+static void watchBrownout(float v, uint64_t tUs) {
+  if (s_havePrev && tUs > s_prevUs && tUs - s_prevUs <= GAP_US) {
+    const float dtS = (tUs - s_prevUs) * 1e-6f;
+    s_slope += ((v - s_prevV) / dtS - s_slope) * (dtS / (SLOPE_TAU_S + dtS));
+  } else {
+    s_slope = 0;
+  }
+  s_havePrev = true;
+  s_prevUs = tUs;
+  s_prevV = v;
+
+  const float head = v - s_cfg.boV;
+  const bool near = head <= BO_MARGIN_V ||
+                    (s_cfg.boLeadS > 0 && s_slope < 0 && head <= -s_slope * s_cfg.boLeadS);
+  if (near && s_armed) {
+    s_armed = false;
+    commit();
+  } else if (!near && head >= BO_REARM_V) {
+    s_armed = true;
+  }
+}
+
+void update(const AdcReadings& adc, uint64_t tUs, const CmdMgr::AppConfig& cfg) {
+  if (!s_live) return;
+  watchBrownout(adc.vbat_meas_sys_v, tUs);
+
+  s_blk.magic = MAGIC;
+  s_blk.ver = VER;
+  s_blk.size = sizeof(Block);
+  s_blk.ms = TimeMgr::nowMs();
+  s_blk.soc = SocMgr::state();
+  s_blk.lp = LoadProt::state();
+  s_blk.chg = ChargeMgr::state();
+  s_blk.th = ThermalMgr::state();
+  s_blk.en = EnergyMgr::state();
+  s_blk.enCharge = cfg.en_charge;
+  s_blk.enLoadDsg = cfg.en_load_dsg;
+  s_blk.seal();
+}
+
+Info info() {
+  Info i = s_info;
+  i.restores = s_blk.restores;
+  i.boCommits = s_blk.boCommits;
+  i.slopeVs = s_slope;
+  return i;
+}
+
+} // namespace RtcState
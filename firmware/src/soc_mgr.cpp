@@ -1,23 +1,20 @@
 #include "soc_mgr.h"
 #include <Preferences.h>
+#include "time_mgr.h"
+#include "prof_mgr.h"
+#include "ir_est.h"
 
 namespace SocMgr {
 
 // ===============================
-// USER SYSTEM CONSTANTS
+// USER SYSTEM CONSTANTS (the tunable ones are in Params)
 // ===============================
-static constexpr float I_ACTIVE_A    = 0.180f;   // LCD + MCU
 static constexpr float I_CHG_SELF_A  = 0.000f;   // MCU during charging CCCCChanged
-static constexpr float I_SLEEP_A     = 0.003f;
 
-static constexpr float ADC_MIN_A     = 0.200f;
-
-static constexpr float VBAT_FULL     = 4.100f;    ///CCCChanged
-static constexpr float VBAT_EMPTY    = 3.20f;
-
-static constexpr uint32_t EMPTY_TIME_MS = 15000;
 static constexpr uint32_t SAVE_MS       = 30000;
 
+static Params P;
+
 // ===============================
 
 static Preferences prefs;
@@ -27,11 +24,17 @@ static float used_mAh = 0.0f;     // REM display: used/consumed since full (star
 static float soc_pct  = 100.0f;
 static float I_net_A  = 0.0f;     // ✅ store net current for debug
 
-static uint32_t last_ms   = 0;
-static uint32_t last_save = 0;
+static uint64_t last_ms   = 0;   // TimeMgr ms
+static uint64_t last_save = 0;
 
 static bool prevCharging     = false;
-static uint32_t emptyTimer   = 0;
+static uint64_t emptyTimer   = 0;
+static bool emptyLatched     = false;
+static Cal  lastCalPt        = CAL_NONE;
+
+static IrEst ir_est;
+static float ir_ref_ohm = NAN;    // first estimate for this cell (NVS "ir_ref")
+static float ocv_v      = 0.0f;   // last empty-test voltage
 
 static float clamp(float v, float lo, float hi) {
   if (v < lo) return lo;
@@ -49,6 +52,22 @@ static void recalc() {
 
 // ===============================
 
+static void applyIrParams() {
+  IrEst::Config c = ir_est.config();
+  c.minStepA = P.ir_min_step_a;
+  c.lambda   = P.ir_lambda;
+  ir_est.setConfig(c);
+}
+
+void setParams(const Params& p) {
+  P = p;
+  applyIrParams();
+}
+
+const Params& params() {
+  return P;
+}
+
 void begin(float capacity_mAh) {
 
   FCC_mAh = capacity_mAh;
@@ -68,8 +87,15 @@ void begin(float capacity_mAh) {
     used_mAh = clamp(FCC_mAh - oldRem, 0, FCC_mAh);
   }
 
-  last_ms   = millis();
+  // R carries over boots; NAN (missing) = learn from scratch
+  applyIrParams();
+  ir_est.reset(prefs.getFloat("ir", NAN));
+  ir_ref_ohm = prefs.getFloat("ir_ref", NAN);
+
+  last_ms   = TimeMgr::nowMs();
   last_save = last_ms;
+  emptyLatched = false;
+  lastCalPt = CAL_NONE;
 
   recalc();
 
@@ -96,32 +122,87 @@ float inet() {
   return I_net_A;
 }
 
+Cal lastCal() {
+  return lastCalPt;
+}
+
+IrInfo ir() {
+  IrInfo i;
+  i.ohm     = ir_est.ohm();
+  i.refOhm  = ir_ref_ohm;
+  i.ocv     = ocv_v;
+  i.steps   = ir_est.accepted();
+  i.rejects = ir_est.rejected();
+  return i;
+}
+
+void resetIr() {
+  ir_est.reset();
+  ir_ref_ohm = NAN;
+  prefs.remove("ir");
+  prefs.remove("ir_ref");
+}
+
+State state() {
+  State s;
+  s.usedMah = used_mAh;
+  s.fccMah  = FCC_mAh;
+  s.irOhm   = ir_est.ohm();
+  return s;
+}
+
+void restore(const State& s) {
+  if (s.fccMah >= 100.0f && s.fccMah <= 10000.0f) FCC_mAh = s.fccMah;
+  used_mAh = s.usedMah;
+  if (!isnan(s.irOhm)) ir_est.reset(s.irOhm);
+  recalc();
+}
+
+void save() {
+  last_save = TimeMgr::nowMs();
+  prefs.putFloat("fcc",  FCC_mAh);
+  prefs.putFloat("used", used_mAh);
+  prefs.putFloat("soc",  soc_pct);
+  prefs.putFloat("ir",   ir_est.ohm());   // NAN while (re)learning
+}
+
+void setCapacity(float capacity_mAh) {
+  if (capacity_mAh < 100.0f || capacity_mAh > 10000.0f) return;
+  FCC_mAh = capacity_mAh;
+  recalc();
+  prefs.putFloat("fcc",  FCC_mAh);
+  prefs.putFloat("used", used_mAh);
+}
+
 // ===============================
 
 void update(const AdcReadings& a, bool isCharging, bool isSleeping, bool isFull)
 {
-  uint32_t now = millis();
+  PROF_ZONE(ProfMgr::Z_SOC_UPDATE);
+  const uint64_t now = TimeMgr::nowMs();
   float dt = (now - last_ms) / 1000.0f;
   last_ms = now;
 
   if (dt < 0) dt = 0;
   if (dt > 5) dt = 5;
+  lastCalPt = CAL_NONE;
 
   // --- FULL latch (debounced) ---
   static bool fullLatched = false;
-  static uint32_t fullMs = 0;
+  static uint64_t fullMs = 0;
   static constexpr uint32_t FULL_HOLD_MS = 3000; // 3s stable
 
   if (!isCharging) {
     fullLatched = false;
     fullMs = 0;
   } else {
-    if (isFull && a.vbat_meas_sys_v >= VBAT_FULL) {
+    if (isFull && a.vbat_meas_sys_v >= P.vbat_full) {
       if (fullMs == 0) fullMs = now;
       if (!fullLatched && (now - fullMs) >= FULL_HOLD_MS) {
         used_mAh = 0.0f;   // full => nothing used
         recalc();
         fullLatched = true;
+        lastCalPt = CAL_FULL;
       }
     } else {
       fullMs = 0;
@@ -133,7 +214,7 @@ void update(const AdcReadings& a, bool isCharging, bool isSleeping, bool isFull)
   // -----------------------------
   float I_chg = 0;
 
-  if (isCharging && a.ibatt_chg_a >= ADC_MIN_A)
+  if (isCharging && a.ibatt_chg_a >= P.adc_min_a)
     I_chg = a.ibatt_chg_a;
 
   // -----------------------------
@@ -142,16 +223,16 @@ void update(const AdcReadings& a, bool isCharging, bool isSleeping, bool isFull)
   float I_dsg = 0;
 
   if (isSleeping) {
-    I_dsg = I_SLEEP_A;
+    I_dsg = P.i_sleep_a;
   }
   else if (isCharging) {
     // If discharge isn't measurable, assume battery is NOT discharging
     I_dsg = 0.0f;  ///// changeddddd
   }
   else {
-    I_dsg = (a.ibatt_dsg_a >= ADC_MIN_A)
+    I_dsg = (a.ibatt_dsg_a >= P.adc_min_a)
               ? a.ibatt_dsg_a
-              : I_ACTIVE_A;
+              : P.i_active_a;
   }
 
   // -----------------------------
@@ -166,15 +247,15 @@ void update(const AdcReadings& a, bool isCharging, bool isSleeping, bool isFull)
 
   // -----------------------------
   // DYNAMIC FCC based on discharge current
-  // y = -280x + 2130
+  // y = fcc_slope * x + fcc_icept (battery profile)
   // -----------------------------
   if (!isCharging && !isSleeping) {
-    float I_for_fcc = (a.ibatt_dsg_a >= ADC_MIN_A) ? a.ibatt_dsg_a : I_ACTIVE_A;
+    float I_for_fcc = (a.ibatt_dsg_a >= P.adc_min_a) ? a.ibatt_dsg_a : P.i_active_a;
 
-    float newFCC = (-280.0f * I_for_fcc) + 2130.0f;
+    float newFCC = (P.fcc_slope * I_for_fcc) + P.fcc_icept;
 
     // Clamp to sane range so FCC doesn't go crazy
-    newFCC = clamp(newFCC, 1200.0f, 2130.0f);
+    newFCC = clamp(newFCC, P.fcc_min, P.fcc_max);
 
     FCC_mAh = newFCC;
 
@@ -184,31 +265,43 @@ void update(const AdcReadings& a, bool isCharging, bool isSleeping, bool isFull)
 
   recalc();
 
+  // -----------------------------
+  // INTERNAL RESISTANCE (net current out of the cell)
+  // -----------------------------
+  if (!isSleeping &&
+      ir_est.push((uint32_t)now, a.vbat_meas_sys_v, a.ibatt_dsg_a - a.ibatt_chg_a) &&
+      isnan(ir_ref_ohm) && ir_est.valid()) {
+    ir_ref_ohm = ir_est.ohm();
+    prefs.putFloat("ir_ref", ir_ref_ohm);
+  }
+
   // -----------------------------
   // EMPTY CALIBRATION
+  // Open-circuit voltage, so a load's IR drop doesn't end the
+  // discharge early; vbat_cutoff still guards the loaded voltage.
   // -----------------------------
-  if (!isCharging && a.vbat_meas_sys_v <= VBAT_EMPTY) {
+  ocv_v = (P.ir_comp && !isCharging) ? ir_est.ocv(a.vbat_meas_sys_v, a.ibatt_dsg_a)
+                                     : a.vbat_meas_sys_v;
+  if (!isCharging && (ocv_v <= P.vbat_empty || a.vbat_meas_sys_v <= P.vbat_cutoff)) {
     if (emptyTimer == 0)
       emptyTimer = now;
 
-    if (now - emptyTimer > EMPTY_TIME_MS) {
+    if (now - emptyTimer > P.empty_time_ms) {
       used_mAh = FCC_mAh; // empty => all used
       recalc();
+      if (!emptyLatched) lastCalPt = CAL_EMPTY;
+      emptyLatched = true;
     }
   }
   else {
     emptyTimer = 0;
+    emptyLatched = false;
   }
 
   // -----------------------------
   // SAVE TO FLASH
   // -----------------------------
-  if (now - last_save > SAVE_MS) {
-    last_save = now;
-    prefs.putFloat("fcc",  FCC_mAh);
-    prefs.putFloat("used", used_mAh);
-    prefs.putFloat("soc",  soc_pct);
-  }
+  if (now - last_save > SAVE_MS) save();
 }
 
 } // namespace
@@ -0,0 +1,208 @@
+#include "stream_mgr.h"
+#include "bt_mgr.h"
+#include "tlm_proto.h"
+#include "time_mgr.h"
+#include "task_sched.h"
+
+namespace StreamMgr {
+
+using namespace TlmProto;
+
+static constexpr uint32_t MIN_TICK_US      = 250;    // 4 kHz aggregate
+static constexpr uint32_t MAX_BATCH_AGE_US = 100000; // latency bound for slow rates
+static constexpr uint8_t  MAX_DECIM        = 64;
+static constexpr uint32_t RELAX_MS         = 2000;   // headroom time before decim /2
+
+static ADCMgr* s_adc = nullptr;
+static bool    s_active = false;
+static uint8_t s_chMask = 0x1F;
+
+static uint32_t s_normalTick = 2000;
+static int      s_normalSpc  = 64;
+
+// Current batch
+static RawHdrV1    s_hdr;
+static RawSampleV1 s_samples[RAW_MAX_SAMPLES];
+static uint8_t     s_count = 0;
+static uint32_t    s_lastSampleUs = 0;
+
+static uint32_t s_readIdx  = 0;   // every read of a streamed channel, kept or not
+static uint8_t  s_decim    = 1;   // from the next batch on
+static uint32_t s_lastIdx   = 0;  // last read kept, and its batch's decim: the
+static uint8_t  s_lastDecim = 1;  //   next batch starts at a read both keep
+static uint16_t s_seq      = 0;
+static uint32_t s_sent     = 0;
+static uint32_t s_dropped  = 0;
+static uint64_t s_headroomSinceMs = 0;
+
+static void flushBatch();
+
+// A batch keeps every decim-th read of the streamed channels. A new
+// decimation starts a new batch, at the first read that both it and the
+// old one keep (decim is a power of two), so the receiver knows where
+// each batch starts (rawNextIdx()); anything else is loss.
+static void onRawSample(uint8_t ch, int mv, uint32_t t_us) {
+  if (!s_active) return;
+  if (!(s_chMask & (1u << ch))) return;
+  const uint32_t idx = s_readIdx++;
+  if (s_count >= RAW_MAX_SAMPLES ||                             // service() is late
+      (s_count > 0 && s_decim != s_hdr.decim && (idx % max(s_decim, s_hdr.decim)) == 0)) {
+    flushBatch();
+  }
+  const uint8_t decim = s_count ? s_hdr.decim : max(s_decim, s_lastDecim);
+  if (decim > 1 && (idx % decim) != 0) return;
+
+  if (s_count == 0) {
+    s_hdr.t0_us = t_us;
+    s_hdr.first_idx = idx;
+    s_hdr.decim = s_decim;
+    s_lastSampleUs = t_us;
+  }
+
+  uint32_t dt = t_us - s_lastSampleUs;
+  s_lastSampleUs = t_us;
+
+  if (mv < 0) mv = 0;
+  if (mv > RAW_MV_MASK) mv = RAW_MV_MASK;
+
+  RawSampleV1& s = s_samples[s_count++];
+  s.ch_mv = (uint16_t)((ch << RAW_CH_SHIFT) | (uint16_t)mv);
+  s.dt_us = (uint16_t)(dt > 0xFFFF ? 0xFFFF : dt);
+  s_lastIdx = idx;
+  s_lastDecim = s_hdr.decim;
+}
+
+static void flushBatch() {
+  if (s_count == 0) return;
+
+  uint8_t payload[MAX_PAYLOAD];
+  s_hdr.tick_us = (uint16_t)min<uint32_t>(s_adc ? s_adc->tickUs() : 0, 0xFFFF);
+  s_hdr.count = s_count;
+
+  const size_t n = sizeof(RawHdrV1) + s_count * sizeof(RawSampleV1);
+  memcpy(payload, &s_hdr, sizeof(RawHdrV1));
+  memcpy(payload + sizeof(RawHdrV1), s_samples, s_count * sizeof(RawSampleV1));
+  s_count = 0;
+
+  // A batch that doesn't make it onto the queue still takes its seq: the
+  // receiver counts lost batches from the gaps
+  uint8_t frame[MAX_FRAME];
+  const size_t len = encodeFrame(SCHEMA_RAW_V1, s_seq++, payload, n, frame, sizeof(frame));
+  if (len == 0) { s_dropped++; return; }
+
+  // Keep room for a second packet plus the 1 Hz telemetry; otherwise
+  // the link can't keep up - drop this batch and thin the stream.
+  if (BtMgr::txFree(BtMgr::TxPrio::Telemetry) < 2 * len) {
+    s_dropped++;
+    if (s_decim < MAX_DECIM) s_decim *= 2;
+    s_headroomSinceMs = 0;
+    return;
+  }
+
+  if (BtMgr::write(frame, len, BtMgr::TxPrio::Telemetry)) {
+    s_sent++;
+  } else {
+    s_dropped++;
+  }
+}
+
+static void adaptDecimation() {
+  if (s_decim <= 1) return;
+
+  const bool roomy = BtMgr::txFree(BtMgr::TxPrio::Telemetry) > 3 * MAX_FRAME;
+  if (!roomy) { s_headroomSinceMs = 0; return; }
+
+  const uint64_t now = TimeMgr::nowMs();
+  if (s_headroomSinceMs == 0) { s_headroomSinceMs = now; return; }
+  if (now - s_headroomSinceMs >= RELAX_MS) {
+    s_decim /= 2;
+    s_headroomSinceMs = now;
+  }
+}
+
+// The ADC is paced here because the read budget depends on streaming.
+// Every pass: a tick missed by more than one period is a lost sample.
+static void adcTask() {
+  s_adc->service(readsPerService());
+  service();
+}
+
+static const TaskSched::TaskDef TASK = { "adc", adcTask, 0, 0, 2000, TaskSched::Overrun::Skip };
+
+void begin(ADCMgr& adc) {
+  s_adc = &adc;
+  s_adc->setRawSink(&onRawSample);
+  TaskSched::add(TASK);
+}
+
+bool start(uint32_t tick_us, uint8_t chMask) {
+  if (!s_adc) return false;
+  if (tick_us < MIN_TICK_US) tick_us = MIN_TICK_US;
+  chMask &= 0x1F;
+  if (chMask == 0) chMask = 0x1F;
+
+  if (!s_active) {
+    s_normalTick = s_adc->baseTickUs();
+    s_normalSpc  = s_adc->baseSamplesPerChannel();
+  }
+
+  // the reads so far go out at the old tick; the new stream carries on
+  // where the last batch ended, so the receiver sees no gap
+  if (s_active) flushBatch();
+  s_readIdx = (s_lastIdx / s_lastDecim + 1) * s_lastDecim;
+  s_chMask = chMask;
+  s_count = 0;
+  s_decim = 1;
+  s_headroomSinceMs = 0;
+
+  // the stream runs at its own fixed tick, not the adaptive rate
+  s_adc->setJitter(false);
+  s_adc->holdRate(true);
+  if (!s_adc->startTimer(tick_us, s_normalSpc)) {
+    s_adc->setJitter(true);
+    s_adc->holdRate(false);
+    s_adc->startTimer(s_normalTick, s_normalSpc);
+    return false;
+  }
+  s_active = true;
+  return true;
+}
+
+void stop() {
+  if (!s_active) return;
+  s_active = false;
+  flushBatch();
+  s_adc->setJitter(true);
+  s_adc->startTimer(s_normalTick, s_normalSpc);
+  s_adc->holdRate(false);
+}
+
+bool active() { return s_active; }
+
+void service() {
+  if (!s_active) return;
+
+  if (!BtMgr::connected()) {
+    stop();   // nobody is listening
+    return;
+  }
+
+  if (s_count >= RAW_MAX_SAMPLES ||
+      (s_count > 0 && ((uint32_t)TimeMgr::nowUs() - s_hdr.t0_us) >= MAX_BATCH_AGE_US)) {
+    flushBatch();
+  }
+  adaptDecimation();
+}
+
+uint8_t readsPerService() {
+  if (!s_active || !s_adc) return 3;
+  // enough to keep up with the faster tick at a ~2 ms loop pass
+  uint32_t n = 2000 / s_adc->tickUs() + 2;
+  return (uint8_t)min<uint32_t>(n, 16);
+}
+
+uint8_t  decimation()     { return s_decim; }
+uint32_t packetsSent()    { return s_sent; }
+uint32_t packetsDropped() { return s_dropped; }
+
+} // namespace StreamMgr
@@ -0,0 +1,207 @@
+#include "task_sched.h"
+#include "cmd_mgr.h"
+#include "time_mgr.h"
+
+namespace TaskSched {
+
+struct Slot {
+  TaskDef  def;
+  bool     enabled;
+  uint64_t due;        // next release, TimeMgr µs
+  Stats    st;
+};
+
+// Slots stay where add() put them (ids are stable); s_order is the run
+// order, sorted by prio, so a pass is one walk over it
+static Slot     s_slots[MAX_TASKS];
+static uint8_t  s_order[MAX_TASKS];
+static size_t   s_count = 0;
+static uint32_t s_passes = 0;
+static uint32_t s_passMaxUs = 0;
+
+static constexpr size_t ENTRY_MAX = 80;   // one task in the "sched" list
+
+static void clearStats(Slot& s) {
+  memset(&s.st, 0, sizeof(s.st));
+}
+
+// ------------------------------------------------------------
+// Command
+// ------------------------------------------------------------
+static const char* overrunName(Overrun o) {
+  return o == Overrun::CatchUp ? "catch_up" : "skip";
+}
+
+static uint32_t avg(uint64_t total, uint32_t n) {
+  return n ? (uint32_t)(total / n) : 0;
+}
+
+static CmdMgr::Err cmdSched(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  long reset = 0;
+  if (a.getLong("reset", reset) && reset) {
+    resetStats();
+    return CmdMgr::ERR_OK;
+  }
+
+  const char* name = a.getStr("task");
+  if (name) {
+    const int id = find(name);
+    if (id < 0) { a.errKey = "task"; return CmdMgr::ERR_BAD_VALUE; }
+    const Slot& s = s_slots[id];
+    r.add(",\"task\":\"%s\",\"period_us\":%lu,\"prio\":%u,\"deadline_us\":%lu,\"overrun\":\"%s\","
+          "\"on\":%d,\"runs\":%lu,\"run_avg_us\":%lu,\"run_max_us\":%lu,"
+          "\"jit_avg_us\":%lu,\"jit_max_us\":%lu,\"miss\":%lu,\"skip\":%lu",
+          s.def.name, (unsigned long)s.def.periodUs, (unsigned)s.def.prio,
+          (unsigned long)s.def.deadlineUs, overrunName(s.def.overrun), s.enabled ? 1 : 0,
+          (unsigned long)s.st.runs, (unsigned long)avg(s.st.runTotalUs, s.st.runs),
+          (unsigned long)s.st.runMaxUs, (unsigned long)avg(s.st.jitTotalUs, s.st.runs),
+          (unsigned long)s.st.jitMaxUs, (unsigned long)s.st.misses, (unsigned long)s.st.skipped);
+    return CmdMgr::ERR_OK;
+  }
+
+  // [name, runs, run_avg_us, run_max_us, jit_max_us, miss, skip], in run
+  // order from "from"; "next" says where to continue if the reply is full
+  long from = 0;
+  (void)a.getLong("from", from);
+  if (from < 0) from = 0;
+
+  r.add(",\"passes\":%lu,\"pass_max_us\":%lu,\"tasks\":[",
+        (unsigned long)s_passes, (unsigned long)s_passMaxUs);
+  size_t i = (size_t)from;
+  for (; i < s_count; i++) {
+    if (r.len + ENTRY_MAX + 16 > r.cap) break;
+    const Slot& s = s_slots[s_order[i]];
+    r.add("%s[\"%s\",%lu,%lu,%lu,%lu,%lu,%lu]", i > (size_t)from ? "," : "", s.def.name,
+          (unsigned long)s.st.runs, (unsigned long)avg(s.st.runTotalUs, s.st.runs),
+          (unsigned long)s.st.runMaxUs, (unsigned long)s.st.jitMaxUs,
+          (unsigned long)s.st.misses, (unsigned long)s.st.skipped);
+  }
+  r.add("]");
+  if (i < s_count) r.add(",\"next\":%u", (unsigned)i);
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+void begin() {
+  CmdMgr::registerCmd("sched", cmdSched);
+}
+
+int find(const char* name) {
+  for (size_t i = 0; i < s_count; i++) {
+    if (!strcmp(s_slots[i].def.name, name)) return (int)i;
+  }
+  return -1;
+}
+
+static void sortOrder() {
+  // insertion sort, stable: equal prio keeps add() order
+  for (size_t i = 0; i < s_count; i++) s_order[i] = (uint8_t)i;
+  for (size_t i = 1; i < s_count; i++) {
+    const uint8_t id = s_order[i];
+    size_t j = i;
+    while (j > 0 && s_slots[s_order[j - 1]].def.prio > s_slots[id].def.prio) {
+      s_order[j] = s_order[j - 1];
+      j--;
+    }
+    s_order[j] = id;
+  }
+}
+
+int add(const TaskDef& def) {
+  if (!def.name || !def.fn) return -1;
+
+  int id = find(def.name);
+  if (id < 0) {
+    if (s_count >= MAX_TASKS) return -1;
+    id = (int)s_count++;
+    Slot& s = s_slots[id];
+    s.enabled = true;
+    clearStats(s);
+  }
+  s_slots[id].def = def;
+  s_slots[id].due = TimeMgr::nowUs();   // also on a re-add after a restart
+  sortOrder();
+  return id;
+}
+
+void setPeriod(int id, uint32_t periodUs) {
+  if (id < 0 || (size_t)id >= s_count) return;
+  Slot& s = s_slots[id];
+  if (s.def.periodUs == periodUs) return;
+  s.def.periodUs = periodUs;
+  s.due = TimeMgr::nowUs();
+}
+
+void setEnabled(int id, bool on) {
+  if (id < 0 || (size_t)id >= s_count) return;
+  Slot& s = s_slots[id];
+  if (on && !s.enabled) s.due = TimeMgr::nowUs();
+  s.enabled = on;
+}
+
+void runPass() {
+  const uint64_t passStart = TimeMgr::nowUs();
+  uint64_t now = passStart;
+
+  for (size_t i = 0; i < s_count; i++) {
+    Slot& s = s_slots[s_order[i]];
+    if (!s.enabled) continue;
+
+    uint64_t release;
+    if (s.def.periodUs == 0) {
+      release = passStart;
+    } else {
+      if (now < s.due) continue;
+      release = s.due;
+      s.due += s.def.periodUs;
+      if (now >= s.due) {
+        // a whole period late: the releases in between are missed
+        const uint64_t behind = (now - s.due) / s.def.periodUs + 1;
+        if (s.def.overrun == Overrun::Skip || behind > MAX_CATCHUP) {
+          s.st.skipped += (uint32_t)behind;
+          s.due = now + s.def.periodUs;
+        }
+      }
+    }
+
+    s.def.fn();
+
+    const uint64_t end = TimeMgr::nowUs();
+    const uint32_t run = (uint32_t)(end - now);
+    const uint32_t jit = (uint32_t)(now - release);
+    s.st.runs++;
+    s.st.runTotalUs += run;
+    s.st.jitTotalUs += jit;
+    if (run > s.st.runMaxUs) s.st.runMaxUs = run;
+    if (jit > s.st.jitMaxUs) s.st.jitMaxUs = jit;
+    if (s.def.deadlineUs && end - release > s.def.deadlineUs) s.st.misses++;
+    now = end;
+  }
+
+  s_passes++;
+  const uint32_t pass = (uint32_t)(now - passStart);
+  if (pass > s_passMaxUs) s_passMaxUs = pass;
+}
+
+void resetStats() {
+  for (size_t i = 0; i < s_count; i++) clearStats(s_slots[i]);
+  s_passes = 0;
+  s_passMaxUs = 0;
+}
+
+size_t count() { return s_count; }
+
+const TaskDef* def(size_t i) { return i < s_count ? &s_slots[s_order[i]].def : nullptr; }
+
+Stats stats(size_t i) {
+  Stats st;
+  memset(&st, 0, sizeof(st));
+  if (i < s_count) st = s_slots[s_order[i]].st;
+  return st;
+}
+
+uint32_t passes()    { return s_passes; }
+uint32_t passMaxUs() { return s_passMaxUs; }
+
+} // namespace TaskSched
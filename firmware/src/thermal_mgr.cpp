@@ -0,0 +1,148 @@
+#include "thermal_mgr.h"
+#include "time_mgr.h"
+#include <math.h>
+
+namespace ThermalMgr {
+
+static constexpr uint8_t  NTC_FAULT_FRAMES = 3;
+static constexpr uint32_t BUCKET_MS   = 5000;   // dT/dt points: 5 s means
+static constexpr size_t   BUCKETS     = 12;     // -> 1 min window
+static constexpr size_t   MIN_BUCKETS = 3;
+
+static constexpr uint8_t CHG_BLOCK = TH_CHG_COLD | TH_CHG_HOT | TH_RATE | TH_NTC;
+static constexpr uint8_t DSG_BLOCK = TH_DSG_COLD | TH_DSG_HOT | TH_RATE | TH_NTC;
+
+static Config   s_cfg;
+static uint8_t  s_flags = 0;
+static uint8_t  s_invalid = 0;          // invalid readings in a row
+static uint64_t s_sinceMs = 0;
+static uint32_t s_trips = 0;
+static uint64_t s_lastTripMs = 0;
+
+// dT/dt window: ring of 5 s means, plus the bucket being filled
+struct Point { uint64_t ms; float c; };
+static Point    s_pts[BUCKETS];
+static size_t   s_head = 0, s_count = 0;
+static uint64_t s_bucketMs = 0;
+static float    s_sumC = 0, s_sumT = 0;   // s_sumT: ms into the bucket
+static uint16_t s_n = 0;
+static float    s_rate = NAN;
+
+static void clearWindow() {
+  s_head = s_count = 0;
+  s_n = 0;
+  s_sumC = s_sumT = 0;
+  s_rate = NAN;
+}
+
+// Least-squares slope of the window, C/min
+static float slope() {
+  // times in s relative to the oldest point, so float is plenty
+  const uint64_t t0 = s_pts[(s_head + BUCKETS - s_count) % BUCKETS].ms;
+  float mt = 0, mc = 0;
+  for (size_t i = 0; i < s_count; i++) { mt += (s_pts[i].ms - t0) / 1000.0f; mc += s_pts[i].c; }
+  mt /= s_count;
+  mc /= s_count;
+  float num = 0, den = 0;
+  for (size_t i = 0; i < s_count; i++) {
+    const float dt = (s_pts[i].ms - t0) / 1000.0f - mt;
+    num += dt * (s_pts[i].c - mc);
+    den += dt * dt;
+  }
+  return den > 0 ? num / den * 60.0f : NAN;
+}
+
+static void addSample(uint64_t nowMs, float c) {
+  if (s_n == 0) s_bucketMs = nowMs;
+  s_sumT += (float)(nowMs - s_bucketMs);
+  s_sumC += c;
+  s_n++;
+  if (nowMs - s_bucketMs < BUCKET_MS) return;
+
+  s_pts[s_head] = { s_bucketMs + (uint64_t)(s_sumT / s_n), s_sumC / s_n };
+  s_head = (s_head + 1) % BUCKETS;
+  if (s_count < BUCKETS) s_count++;
+  s_n = 0;
+  s_sumC = s_sumT = 0;
+  s_rate = s_count >= MIN_BUCKETS ? slope() : NAN;
+}
+
+// One hysteretic window: a bit sets at the limit, clears hystC inside
+static uint8_t window(uint8_t f, float c, float cold, float hot, uint8_t coldBit, uint8_t hotBit) {
+  if (c >= hot) f |= hotBit;
+  else if (c <= hot - s_cfg.hystC) f &= ~hotBit;
+  if (c <= cold) f |= coldBit;
+  else if (c >= cold + s_cfg.hystC) f &= ~coldBit;
+  return f;
+}
+
+void begin(const Config& cfg) {
+  s_cfg = cfg;
+  s_flags = 0;
+  s_invalid = 0;
+  s_sinceMs = TimeMgr::nowMs();
+  s_trips = 0;
+  s_lastTripMs = 0;
+  clearWindow();
+}
+
+void setConfig(const Config& cfg) {
+  s_cfg = cfg;
+}
+
+const Config& config() { return s_cfg; }
+
+void update(const AdcReadings& adc) {
+  const uint64_t now = TimeMgr::nowMs();
+  uint8_t f = s_flags;
+
+  if (isnan(adc.temp_c)) {
+    if (s_invalid < NTC_FAULT_FRAMES) s_invalid++;
+    if (s_invalid >= NTC_FAULT_FRAMES) {
+      f |= TH_NTC;
+      clearWindow();        // the slope must not bridge the gap
+    }
+  } else {
+    s_invalid = 0;
+    f &= ~TH_NTC;
+    const float c = adc.temp_c;
+    f = window(f, c, s_cfg.chgColdC, s_cfg.chgHotC, TH_CHG_COLD, TH_CHG_HOT);
+    f = window(f, c, s_cfg.dsgColdC, s_cfg.dsgHotC, TH_DSG_COLD, TH_DSG_HOT);
+    addSample(now, c);
+  }
+
+  if (s_cfg.rateCMin <= 0 || isnan(s_rate)) f &= ~TH_RATE;
+  else if (s_rate > s_cfg.rateCMin) f |= TH_RATE;
+  else if (s_rate < s_cfg.rateCMin * 0.5f) f &= ~TH_RATE;
+
+  if (f == s_flags) return;
+  if (f & ~s_flags) {
+    s_trips++;
+    s_lastTripMs = now;
+  }
+  s_flags = f;
+  s_sinceMs = now;
+}
+
+bool allowCharge() { return !s_cfg.enabled || !(s_flags & CHG_BLOCK); }
+bool allowLoad()   { return !s_cfg.enabled || !(s_flags & DSG_BLOCK); }
+
+uint8_t  flags()      { return s_flags; }
+float    rateCMin()   { return s_rate; }
+uint32_t sinceS()     { return (uint32_t)((TimeMgr::nowMs() - s_sinceMs) / 1000); }
+uint32_t trips()      { return s_trips; }
+uint64_t lastTripMs() { return s_lastTripMs; }
+
+State state() {
+  State s;
+  s.flags = s_flags;
+  s.sinceMs = s_sinceMs;
+  return s;
+}
+
+void restore(const State& s) {
+  s_flags = s.flags;
+  s_sinceMs = s.sinceMs;
+}
+
+} // namespace ThermalMgr
@@ -0,0 +1,87 @@
+#include "time_mgr.h"
+#include "cmd_mgr.h"
+#include "task_sched.h"
+#include "time_sync.h"
+#include "esp_timer.h"
+#include <sys/time.h>
+
+namespace TimeMgr {
+
+static constexpr uint64_t ANCHOR_PERIOD_US = 1000000;
+
+RTC_NOINIT_ATTR static TimeSync::Anchor s_anchor;
+static TimeSync::Mono s_mono;
+static uint64_t s_lastAnchorUs = 0;
+
+static uint64_t timerUs() { return (uint64_t)esp_timer_get_time(); }
+
+static uint64_t rtcUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (uint64_t)tv.tv_sec * 1000000ull + (uint64_t)tv.tv_usec;
+}
+
+static void saveAnchor() {
+  s_mono.save(s_anchor, rtcUs(), timerUs());
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static CmdMgr::Err cmdTime(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  int64_t epoch = 0, at = 0;
+  if (a.getInt64("epoch_us", epoch)) {
+    if (epoch <= 0) { a.errKey = "epoch_us"; return CmdMgr::ERR_RANGE; }
+    uint64_t mono = nowUs();
+    if (a.getInt64("at_us", at)) {
+      if (at < 0 || (uint64_t)at > mono) { a.errKey = "at_us"; return CmdMgr::ERR_RANGE; }
+      mono = (uint64_t)at;
+    }
+    s_anchor.sync.add(mono, epoch);
+    saveAnchor();
+  }
+
+  const uint64_t now = nowUs();
+  const TimeSync::Sync& s = s_anchor.sync;
+  r.add(",\"mono_us\":%llu,\"synced\":%d,\"epoch_us\":%lld,\"drift_ppb\":%ld,"
+        "\"err_us\":%ld,\"syncs\":%lu,\"boots\":%lu,\"gap_ms\":%llu",
+        (unsigned long long)now, s.valid() ? 1 : 0, (long long)s.toEpoch(now),
+        (long)s.driftPpb, (long)s.lastErrUs, (unsigned long)s.count,
+        (unsigned long)s_anchor.boots, (unsigned long long)(s_mono.gapUs() / 1000));
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+static const TaskSched::TaskDef TASK = { "time", service, 100000, 6, 0, TaskSched::Overrun::Skip };
+
+void begin() {
+  s_mono.boot(s_anchor, rtcUs(), timerUs());
+  s_lastAnchorUs = nowUs();
+  CmdMgr::registerCmd("time", cmdTime);
+  TaskSched::add(TASK);
+}
+
+void service() {
+  // keeps the anchor fresh so a watchdog reset loses at most ~1 s of sync
+  const uint64_t now = nowUs();
+  if (now - s_lastAnchorUs >= ANCHOR_PERIOD_US) {
+    s_lastAnchorUs = now;
+    saveAnchor();
+  }
+}
+
+void prepareSleep() {
+  saveAnchor();
+}
+
+uint64_t nowUs()  { return s_mono.now(timerUs()); }
+uint64_t nowMs()  { return nowUs() / 1000ull; }
+
+bool     synced()            { return s_anchor.sync.valid(); }
+int64_t  epochUs(uint64_t m) { return s_anchor.sync.toEpoch(m); }
+int32_t  driftPpb()          { return s_anchor.sync.driftPpb; }
+uint32_t boots()             { return s_anchor.boots; }
+uint64_t lastGapUs()         { return s_mono.gapUs(); }
+
+} // namespace TimeMgr
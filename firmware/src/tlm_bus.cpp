@@ -0,0 +1,219 @@
+#include "tlm_bus.h"
+#include "bt_mgr.h"
+#include "task_sched.h"
+
+namespace TlmBus {
+
+// ------------------------------------------------------------
+// Frame pool
+// ------------------------------------------------------------
+static constexpr size_t POOL_SIZE = 6;
+static FrameBuf s_pool[POOL_SIZE];
+
+FrameBuf* alloc(Fmt fmt) {
+  for (FrameBuf& f : s_pool) {
+    uint8_t expected = 0;
+    if (f.refs.compare_exchange_strong(expected, 1)) {
+      f.len = 0;
+      f.fmt = fmt;
+      f.urgent = false;
+      return &f;
+    }
+  }
+  return nullptr;
+}
+
+void retain(FrameBuf* f) {
+  if (f) f->refs.fetch_add(1);
+}
+
+void release(FrameBuf* f) {
+  if (f) f->refs.fetch_sub(1);
+}
+
+size_t poolFree() {
+  size_t n = 0;
+  for (FrameBuf& f : s_pool) if (f.refs.load() == 0) n++;
+  return n;
+}
+
+// ------------------------------------------------------------
+// Registry
+// ------------------------------------------------------------
+static Transport* s_tr[MAX_TRANSPORTS];
+static size_t s_count = 0;
+
+bool add(Transport* t) {
+  if (!t) return false;
+  for (size_t i = 0; i < s_count; i++) if (s_tr[i] == t) return true;
+  if (s_count >= MAX_TRANSPORTS) return false;
+  s_tr[s_count++] = t;
+  return true;
+}
+
+size_t count() { return s_count; }
+Transport* get(size_t i) { return i < s_count ? s_tr[i] : nullptr; }
+
+bool wants(Fmt fmt) {
+  for (size_t i = 0; i < s_count; i++) {
+    if (s_tr[i]->fmt == fmt && !s_tr[i]->custom && s_tr[i]->connected()) return true;
+  }
+  return false;
+}
+
+void publish(FrameBuf* f) {
+  if (!f) return;
+  for (size_t i = 0; i < s_count; i++) {
+    Transport* t = s_tr[i];
+    if (t->fmt != f->fmt || t->custom || !t->connected()) continue;
+    if (t->send(f)) t->framesSent++;
+    else            t->framesDropped++;
+  }
+  release(f);
+}
+
+bool sendTo(Transport* t, FrameBuf* f) {
+  if (!f) return false;
+  const bool ok = t->send(f);
+  if (ok) t->framesSent++;
+  else    t->framesDropped++;
+  release(f);
+  return ok;
+}
+
+void service() {
+  for (size_t i = 0; i < s_count; i++) s_tr[i]->service();
+}
+
+static const TaskSched::TaskDef TASK = { "tlm_bus", service, 0, 4, 0, TaskSched::Overrun::Skip };
+
+void begin() {
+  TaskSched::add(TASK);
+}
+
+// ------------------------------------------------------------
+// Bluetooth SPP: BtMgr already owns a bounded TX ring, so the bytes are
+// copied there (a memcpy; the frame itself is never re-encoded).
+// ------------------------------------------------------------
+class BtTransport : public Transport {
+public:
+  const char* name() const override { return "bt"; }
+  bool connected() override { return BtMgr::connected(); }
+  bool send(FrameBuf* f) override {
+    return BtMgr::write(f->data, f->len,
+                        f->urgent ? BtMgr::TxPrio::Reply : BtMgr::TxPrio::Telemetry);
+  }
+
+  // every new client starts on JSON, so an old one never sees binary
+  void service() override {
+    const bool now = BtMgr::connected();
+    if (now && !was_) fmt = Fmt::Json;
+    was_ = now;
+  }
+
+private:
+  bool was_ = false;
+};
+
+// ------------------------------------------------------------
+// USB Serial: keeps references to queued frames and writes only what
+// the UART FIFO can take right now. A native USB port is false while no
+// host has it open; a UART bridge always looks open, so a port that takes
+// nothing for STALL_MS counts as gone too: the queue is dropped, and
+// wants() stops encoding for it until the port takes bytes again.
+// ------------------------------------------------------------
+class UsbTransport : public Transport {
+public:
+  const char* name() const override { return "usb"; }
+  bool connected() override { return enabled_ && !stalled_ && Serial; }
+
+  bool send(FrameBuf* f) override {
+    if (count_ >= QLEN) return false;
+    if (count_ == 0) lastMs_ = millis();   // the stall clock starts with a queue
+    retain(f);
+    q_[(head_ + count_) % QLEN] = f;
+    count_++;
+    return true;
+  }
+
+  void service() override {
+    if (stalled_) {
+      if (Serial.availableForWrite() <= 0) return;
+      stalled_ = false;
+    }
+    while (count_ > 0) {
+      FrameBuf* f = q_[head_];
+      int room = Serial.availableForWrite();
+      if (room <= 0) {
+        if (millis() - lastMs_ >= STALL_MS) {
+          stalled_ = true;
+          stalls++;
+          drop();
+        }
+        return;
+      }
+
+      size_t n = min((size_t)room, (size_t)(f->len - off_));
+      Serial.write(f->data + off_, n);
+      off_ += n;
+      lastMs_ = millis();
+      if (off_ < f->len) return;
+
+      release(f);
+      q_[head_] = nullptr;
+      head_ = (head_ + 1) % QLEN;
+      count_--;
+      off_ = 0;
+    }
+  }
+
+  void enable(bool on) {
+    enabled_ = on;
+    stalled_ = false;
+    if (!on) drop();
+  }
+
+  uint32_t stalls = 0;
+
+private:
+  static constexpr size_t   QLEN = 3;
+  static constexpr uint32_t STALL_MS = 2000;
+
+  void drop() {
+    while (count_ > 0) {
+      release(q_[head_]);
+      q_[head_] = nullptr;
+      head_ = (head_ + 1) % QLEN;
+      count_--;
+    }
+    off_ = 0;
+  }
+
+  FrameBuf* q_[QLEN] = {nullptr};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  size_t off_ = 0;
+  uint32_t lastMs_ = 0;
+  bool enabled_ = false;
+  bool stalled_ = false;
+};
+
+static BtTransport  s_bt;
+static UsbTransport s_usb;
+
+Transport* bt()  { return &s_bt; }
+Transport* usb() { return &s_usb; }
+
+void usbBegin(unsigned long baud) {
+  Serial.begin(baud);
+}
+
+void usbEnable(bool on) {
+  s_usb.enable(on);
+}
+
+uint32_t usbStalls() {
+  return s_usb.stalls;
+}
+
+} // namespace TlmBus
@@ -0,0 +1,265 @@
+#include "tlm_sub.h"
+#include "cmd_mgr.h"
+#include "time_mgr.h"
+#include "task_sched.h"
+#include <math.h>
+
+namespace TlmSub {
+
+using namespace TlmProto;
+
+struct Sub {
+  bool     active;
+  uint16_t mask;
+  uint32_t periodMs;
+  float    th[FIELD_COUNT];
+  float    last[FIELD_COUNT];
+  uint16_t haveLast;        // fields with a valid last[]
+  uint64_t lastSendMs;
+  uint64_t lastKeyMs;
+  uint16_t seq;
+  Stats    st;
+};
+
+static Sub    s_subs[TlmBus::MAX_TRANSPORTS];
+static FillFn s_fill = nullptr;
+
+static int indexOf(TlmBus::Transport* t) {
+  for (size_t i = 0; i < TlmBus::count(); i++) {
+    if (TlmBus::get(i) == t) return (int)i;
+  }
+  return -1;
+}
+
+static bool moved(float v, float last, float th) {
+  if (isnan(v) || isnan(last)) return isnan(v) != isnan(last);
+  return fabsf(v - last) >= th;
+}
+
+// ------------------------------------------------------------
+// Encoders (only the fields in mask)
+// ------------------------------------------------------------
+static bool encodeJson(const Snapshot& s, uint16_t mask, bool key, TlmBus::FrameBuf* f) {
+  char* p = (char*)f->data;
+  const size_t cap = TlmBus::FrameBuf::CAP;
+  size_t n = snprintf(p, cap, "{\"ver\":1,\"ms\":%llu,\"key\":%d", (unsigned long long)s.ms, key ? 1 : 0);
+
+  for (int i = 0; i < FIELD_COUNT && n < cap; i++) {
+    if (!(mask & (1u << i))) continue;
+    const FieldDef& fd = FIELDS[i];
+
+    if (i == F_PINS) {
+      const unsigned pins = (unsigned)s.v[i];
+      n += snprintf(p + n, cap - n, ",\"pins\":{");
+      for (int b = 0; b < 8 && n < cap; b++) {
+        n += snprintf(p + n, cap - n, "%s\"%s\":%u", b ? "," : "", PIN_NAMES[b], (pins >> b) & 1u);
+      }
+      if (n < cap) n += snprintf(p + n, cap - n, "}");
+    } else if (isnan(s.v[i])) {
+      n += snprintf(p + n, cap - n, ",\"%s\":null", fd.name);
+    } else {
+      n += snprintf(p + n, cap - n, ",\"%s\":%.*f", fd.name, (int)fd.decimals, s.v[i]);
+    }
+  }
+  if (n < cap) n += snprintf(p + n, cap - n, "}\n");
+  if (n >= cap) return false;
+  f->len = (uint16_t)n;
+  return true;
+}
+
+static bool encodeBin(const Snapshot& s, uint16_t mask, bool key, uint16_t seq, TlmBus::FrameBuf* f) {
+  uint8_t payload[sizeof(DeltaHdrV1) + 2 * FIELD_COUNT];
+  DeltaHdrV1 h = { (uint32_t)s.ms, mask, (uint8_t)(key ? 1 : 0) };
+  memcpy(payload, &h, sizeof(h));
+  size_t n = sizeof(h);
+
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    if (!(mask & (1u << i))) continue;
+    uint16_t w;
+    if (i == F_TEMP && isnan(s.v[i]))   w = (uint16_t)TEMP_INVALID;
+    else if (FIELDS[i].isSigned)        w = (uint16_t)toI16(s.v[i], FIELDS[i].scale);
+    else                                w = toU16(s.v[i], FIELDS[i].scale);
+    payload[n++] = (uint8_t)(w & 0xFF);
+    payload[n++] = (uint8_t)(w >> 8);
+  }
+
+  size_t len = encodeFrame(SCHEMA_DELTA_V1, seq, payload, n, f->data, TlmBus::FrameBuf::CAP);
+  f->len = (uint16_t)len;
+  return len > 0;
+}
+
+// ------------------------------------------------------------
+// BT command
+// ------------------------------------------------------------
+static CmdMgr::Err cmdSub(CmdMgr::Args& a, CmdMgr::Reply& r) {
+  using namespace JsonTok;
+  TlmBus::Transport* t = TlmBus::bt();
+
+  long off = 0;
+  if (a.getLong("off", off) && off) {
+    unsubscribe(t);
+  } else if (a.find("fields") >= 0 || a.find("mask") >= 0 || a.find("period_ms") >= 0) {
+    uint16_t mask = 0;
+    long m;
+    if (a.getLong("mask", m)) mask = (uint16_t)(m & FIELD_MASK_ALL);
+
+    const int fl = a.find("fields");
+    if (fl >= 0) {
+      if (a.t[fl].type != ARRAY) { a.errKey = "fields"; return CmdMgr::ERR_BAD_VALUE; }
+      for (int i = fl + 1; i < a.n && a.t[i].start < a.t[fl].end; i = skip(a.t, a.n, i)) {
+        int id = fieldByName(a.s + a.t[i].start);
+        if (id < 0) { a.errKey = a.s + a.t[i].start; return CmdMgr::ERR_UNKNOWN_KEY; }
+        mask |= (uint16_t)(1u << id);
+      }
+    }
+    if (mask == 0) mask = FIELD_MASK_ALL;
+
+    long period = 1000;
+    (void)a.getLong("period_ms", period);
+    if (period < (long)MIN_PERIOD_MS || period > 3600000L) { a.errKey = "period_ms"; return CmdMgr::ERR_RANGE; }
+
+    float th[FIELD_COUNT];
+    for (int i = 0; i < FIELD_COUNT; i++) th[i] = 1.0f / FIELDS[i].scale;
+
+    const int tho = a.find("th");
+    if (tho >= 0) {
+      if (a.t[tho].type != OBJECT) { a.errKey = "th"; return CmdMgr::ERR_BAD_VALUE; }
+      for (int i = tho + 1; i + 1 < a.n && a.t[i].start < a.t[tho].end; i = skip(a.t, a.n, i + 1)) {
+        int id = fieldByName(a.s + a.t[i].start);
+        if (id < 0) { a.errKey = a.s + a.t[i].start; return CmdMgr::ERR_UNKNOWN_KEY; }
+        float v;
+        if (!toFloat(a.s, a.t[i + 1], v) || v < 0.0f) { a.errKey = FIELDS[id].name; return CmdMgr::ERR_BAD_VALUE; }
+        th[id] = v;
+      }
+    }
+
+    if (!subscribe(t, mask, (uint32_t)period, th)) return CmdMgr::ERR_FAILED;
+  }
+
+  const int i = indexOf(t);
+  const Sub* s = (i >= 0) ? &s_subs[i] : nullptr;
+  if (s && s->active) {
+    r.add(",\"sub\":1,\"mask\":%u,\"period_ms\":%lu,\"frames\":%lu,\"bytes\":%lu,\"skipped\":%lu",
+          (unsigned)s->mask, (unsigned long)s->periodMs,
+          (unsigned long)s->st.frames, (unsigned long)s->st.bytes,
+          (unsigned long)s->st.fieldsSkipped);
+  } else {
+    r.add(",\"sub\":0");
+  }
+  return CmdMgr::ERR_OK;
+}
+
+// ------------------------------------------------------------
+
+static const TaskSched::TaskDef TASK = { "tlm_sub", service, 10000, 4, 10000, TaskSched::Overrun::Skip };
+
+void begin(FillFn fill) {
+  s_fill = fill;
+  memset(s_subs, 0, sizeof(s_subs));
+  CmdMgr::registerCmd("sub", cmdSub);
+  TaskSched::add(TASK);
+}
+
+bool subscribe(TlmBus::Transport* t, uint16_t mask, uint32_t periodMs, const float* th) {
+  const int i = indexOf(t);
+  if (i < 0 || mask == 0) return false;
+
+  Sub& s = s_subs[i];
+  memset(&s, 0, sizeof(s));
+  s.active = true;
+  s.mask = mask & FIELD_MASK_ALL;
+  s.periodMs = max(periodMs, MIN_PERIOD_MS);
+  for (int k = 0; k < FIELD_COUNT; k++) {
+    s.th[k] = th ? th[k] : 1.0f / FIELDS[k].scale;
+  }
+  s.lastSendMs = TimeMgr::nowMs() - s.periodMs;   // first frame right away
+  t->custom = true;
+  return true;
+}
+
+void unsubscribe(TlmBus::Transport* t) {
+  const int i = indexOf(t);
+  if (i < 0) return;
+  s_subs[i].active = false;
+  t->custom = false;
+}
+
+bool subscribed(TlmBus::Transport* t) {
+  const int i = indexOf(t);
+  return i >= 0 && s_subs[i].active;
+}
+
+Stats stats(TlmBus::Transport* t) {
+  const int i = indexOf(t);
+  return i >= 0 ? s_subs[i].st : Stats{};
+}
+
+void service() {
+  if (!s_fill) return;
+
+  const uint64_t now = TimeMgr::nowMs();
+  uint16_t need = 0;
+  bool due[TlmBus::MAX_TRANSPORTS] = {false};
+
+  for (size_t i = 0; i < TlmBus::count(); i++) {
+    Sub& s = s_subs[i];
+    TlmBus::Transport* t = TlmBus::get(i);
+    if (!s.active) continue;
+    if (!t->connected()) {
+      // a new client must not inherit an old subscription
+      unsubscribe(t);
+      continue;
+    }
+    if (now - s.lastSendMs >= s.periodMs) {
+      due[i] = true;
+      need |= s.mask;
+    }
+  }
+  if (!need) return;
+
+  // Only what the due subscriptions need is computed
+  Snapshot snap;
+  snap.ms = now;
+  s_fill(snap, need);
+
+  for (size_t i = 0; i < TlmBus::count(); i++) {
+    if (!due[i]) continue;
+    Sub& s = s_subs[i];
+    TlmBus::Transport* t = TlmBus::get(i);
+    s.lastSendMs = now;
+
+    const bool key = (s.haveLast != s.mask) || (now - s.lastKeyMs >= KEYFRAME_MS);
+    uint16_t send = 0;
+    for (int k = 0; k < FIELD_COUNT; k++) {
+      const uint16_t bit = (uint16_t)(1u << k);
+      if (!(s.mask & bit)) continue;
+      if (key || moved(snap.v[k], s.last[k], s.th[k])) send |= bit;
+      else s.st.fieldsSkipped++;
+    }
+    if (!send) continue;
+
+    TlmBus::FrameBuf* f = TlmBus::alloc(t->fmt);
+    if (!f) { t->framesDropped++; continue; }
+
+    const bool ok = (t->fmt == TlmBus::Fmt::Bin) ? encodeBin(snap, send, key, s.seq, f)
+                                                 : encodeJson(snap, send, key, f);
+    if (ok && t->send(f)) {
+      t->framesSent++;
+      s.seq++;
+      s.st.frames++;
+      s.st.bytes += f->len;
+      for (int k = 0; k < FIELD_COUNT; k++) {
+        if (!(send & (1u << k))) continue;
+        s.last[k] = snap.v[k];
+        s.st.fieldsSent++;
+      }
+      s.haveLast |= send;
+      if (key) s.lastKeyMs = now;
+    } else {
+      t->framesDropped++;
+    }
+    TlmBus::release(f);
+  }
+}
+
+} // namespace TlmSub
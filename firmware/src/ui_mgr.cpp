@@ -1,7 +1,7 @@
 #include "ui_mgr.h"
 #include <TFT_eSPI.h>
 #include <math.h>
-#include "bt_mgr.h"
+#include "prof_mgr.h"
 
 
 #ifndef TFT_BL
@@ -13,9 +13,9 @@ namespace UIMgr {
 static TFT_eSPI tft;
 
 // NA thresholds for what you show on screen (not for SOC math)
-static constexpr float CHG_NA_LIMIT_A  = 0.218f; // ~200mA
-static constexpr float DSG_NA_LIMIT_A  = 0.218f; // ~200mA
-static constexpr float LOAD_NA_LIMIT_A = 0.120f; // ~120mA
+static constexpr float CHG_NA_LIMIT_A  = Profile::BOARD.naChgA;
+static constexpr float DSG_NA_LIMIT_A  = Profile::BOARD.naDsgA;
+static constexpr float LOAD_NA_LIMIT_A = Profile::BOARD.naLoadA;
 
 // Layout constants
 static constexpr int LABEL_X = 10;
@@ -101,13 +101,6 @@ static void drawCurrentOrNA(int y, float current_a, float na_limit_a) {
     drawValueField(y, buf);
   }
 }
-static void fmtCurrentOrNA(char* out, size_t n, float current_a, float na_limit_a) {
-  if (fabsf(current_a) < na_limit_a) {
-    snprintf(out, n, "NA");
-  } else {
-    snprintf(out, n, "%.3f A", current_a);
-  }
-}
 
 void drawValues(const AdcReadings& d,
                 bool chargingStable,
@@ -118,6 +111,7 @@ void drawValues(const AdcReadings& d,
                 float fccmAh,
                 float remmAh)
 {
+  PROF_ZONE(ProfMgr::Z_UI_DRAW);
   char buf[40];
 
   // VBAT
@@ -159,56 +153,6 @@ void drawValues(const AdcReadings& d,
 
   snprintf(buf, sizeof(buf), "%.0f/%.0f", fccmAh, remmAh);
   drawValueField(Y_DBG2, buf);
-  /*if (BtMgr::connected()) {
-    char line[64];
-    char tmp[24];
-
-    // VBAT
-    snprintf(line, sizeof(line), "VBAT: %.3f V", d.vbat_meas_sys_v);
-    BtMgr::println(line);
-
-    // SOC
-    snprintf(line, sizeof(line), "SOC : %.1f %%", socPct);
-    BtMgr::println(line);
-
-    // Load/Chg/Dsg
-    fmtCurrentOrNA(tmp, sizeof(tmp), d.iload_a, LOAD_NA_LIMIT_A);
-    snprintf(line, sizeof(line), "Load: %s", tmp);
-    BtMgr::println(line);
-
-    fmtCurrentOrNA(tmp, sizeof(tmp), d.ibatt_chg_a, CHG_NA_LIMIT_A);
-    snprintf(line, sizeof(line), "Chg : %s", tmp);
-    BtMgr::println(line);
-
-    fmtCurrentOrNA(tmp, sizeof(tmp), d.ibatt_dsg_a, DSG_NA_LIMIT_A);
-    snprintf(line, sizeof(line), "Dsg : %s", tmp);
-    BtMgr::println(line);
-
-    // Temp
-    if (isnan(d.temp_c)) snprintf(line, sizeof(line), "Temp: ---");
-    else                snprintf(line, sizeof(line), "Temp: %.1f C", d.temp_c);
-    BtMgr::println(line);
-
-    // Stat
-    if (pending) {
-      snprintf(line, sizeof(line), "Stat: %s (%lus)",
-               chargingStable ? "Charging" : "Idle",
-               (unsigned long)secondsLeft);
-    } else {
-      snprintf(line, sizeof(line), "Stat: %s", chargingStable ? "Charging" : "Idle");
-    }
-    BtMgr::println(line);
-
-    // Inet
-    snprintf(line, sizeof(line), "Inet: %+.3f A", inetA);
-    BtMgr::println(line);
-
-    // FCC/REM
-    snprintf(line, sizeof(line), "FCC/REM: %.0f/%.0f", fccmAh, remmAh);
-    BtMgr::println(line);
-
-    BtMgr::println("---");
-  }*/
 
   tft.setTextSize(2);
 }
@@ -0,0 +1,316 @@
+// fanout_bench - what TlmBus' fan-out costs with 1 to 4 transports
+//
+//   fanout_bench [-n frames] [-b] [-u]
+//
+// Runs the firmware's tlm_bus.cpp against the simulator shims. Each
+// frame is the telemetry line (the shape of main.cpp's encodeJsonFull,
+// about 600 bytes) or, with -b, the FullV1 binary frame. Two ways of
+// getting it to N transports are timed:
+//   bus       encode once into a pooled FrameBuf, TlmBus::publish() to
+//             every transport, then each writes it out in service()
+//   per-sink  what the firmware did before TlmBus: each output path
+//             formats its own copy and sends it
+// The transports are memory sinks that copy what they are sent into a
+// buffer (a UART FIFO stand-in), or with -u the simulator's socket sinks
+// (sim_sink.cpp) with a thread reading each far end. loop() pays the
+// encode and publish; the writes are the "tlm_bus" task's.
+//
+// Check (exit status 1 if it fails): every transport got every frame,
+// byte for byte (a checksum against the encoder's output), in both ways.
+
+#include "tlm_bus.h"
+#include "tlm_proto.h"
+#include "sim_sink.h"
+#include "time_mgr.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace TlmBus;
+
+// The scheduler's clock (task_sched.cpp is linked for TlmBus::begin()); real
+// time here, not the simulator's
+namespace TimeMgr {
+uint64_t nowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+uint64_t nowMs() { return nowUs() / 1000; }
+} // namespace TimeMgr
+
+static uint32_t s_fails = 0;
+
+static void check(bool ok, const char* what, size_t arg = 0) {
+  if (ok) return;
+  if (s_fails < 20) std::fprintf(stderr, "FAIL %s (%zu)\n", what, arg);
+  s_fails++;
+}
+
+static uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Byte checksum of everything a transport got, to compare with the encoder's
+static uint64_t sum(const uint8_t* p, size_t n, uint64_t s) {
+  for (size_t i = 0; i < n; i++) s = s * 31 + p[i];
+  return s;
+}
+
+// ------------------------------------------------------------
+// Encoders
+// ------------------------------------------------------------
+static bool s_bin = false;
+
+static bool encodeJson(uint32_t i, FrameBuf* f) {
+  const float vbat = 3.6f + (i % 600) * 0.001f, iload = 0.5f + (i % 7) * 0.013f;
+  const int n = std::snprintf((char*)f->data, FrameBuf::CAP,
+    "{\"ver\":1,\"ms\":%lu,\"vbat\":%.3f,\"soc\":%.1f,\"iload\":%.3f,\"ichg\":%.3f,\"idsg\":%.3f,"
+    "\"temp\":%.2f,\"stat\":\"%s\",\"chg\":%d,\"ui_pending\":%d,\"ui_left_s\":%lu,\"inet\":%.3f,"
+    "\"fcc\":%d,\"rem\":%d,\"pins\":{\"en_charge\":%d,\"en_dcdc\":%d,\"en_relay\":%d,"
+    "\"en_load_dsg\":%d,\"en_bypass\":%d,\"chg_done\":%d,\"charging\":%d,\"btn_sleep\":%d},"
+    "\"therm\":{\"flags\":%u,\"dtdt\":%.2f,\"since_s\":%lu,\"trips\":%lu},"
+    "\"energy\":{\"in_wh\":%.4f,\"out_wh\":%.4f,\"load_wh\":%.4f,\"eff\":%.3f},"
+    "\"ir\":{\"r_mohm\":%.1f,\"ref_mohm\":%.1f,\"ocv\":%.3f},"
+    "\"adc\":{\"rate\":\"%s\",\"tick_us\":%lu,\"idle_s\":%lu,\"norm_s\":%lu,\"burst_s\":%lu,\"bursts\":%lu}}\n",
+    (unsigned long)(1000u * i), vbat, 55.0f + (i % 100) * 0.1f, iload, 0.0f, iload + 0.021f,
+    25.0f + (i % 50) * 0.01f, "Idle", 0, 0, 0ul, -iload, 2000, (int)(1100 - i % 1000),
+    0, 1, 0, 1, 0, 0, 0, 0,
+    0u, 0.01f, (unsigned long)i, 0ul,
+    0.5f, 1.25f + i * 1e-4f, 1.1f, 0.88f,
+    81.5f, 80.0f, 3.702f,
+    "normal", 2000ul, 10ul, (unsigned long)i, 3ul, 7ul);
+  if (n <= 0 || n >= (int)FrameBuf::CAP) return false;
+  f->len = (uint16_t)n;
+  return true;
+}
+
+static bool encodeBin(uint32_t i, FrameBuf* f) {
+  TlmProto::FullV1 r = {};
+  r.ms = 1000u * i;
+  r.vbat_mv = TlmProto::toU16(3.6f + (i % 600) * 0.001f, 1000.0f);
+  r.soc_x10 = TlmProto::toU16(55.0f + (i % 100) * 0.1f, 10.0f);
+  r.iload_ma = TlmProto::toU16(0.5f + (i % 7) * 0.013f, 1000.0f);
+  r.temp_cx100 = TlmProto::toI16(25.0f + (i % 50) * 0.01f, 100.0f);
+  r.fcc_mah = 2000;
+  r.rem_mah = (uint16_t)(1100 - i % 1000);
+  const size_t n = TlmProto::encodeFrame(TlmProto::SCHEMA_FULL_V1, (uint16_t)i, &r, sizeof(r),
+                                         f->data, FrameBuf::CAP);
+  f->len = (uint16_t)n;
+  return n > 0;
+}
+
+static bool encode(uint32_t i, FrameBuf* f) { return s_bin ? encodeBin(i, f) : encodeJson(i, f); }
+
+// ------------------------------------------------------------
+// Memory sink: keeps references like UsbTransport, and its service()
+// copies the bytes into a FIFO-sized buffer
+// ------------------------------------------------------------
+class MemSink : public Transport {
+public:
+  const char* name() const override { return "mem"; }
+  bool connected() override { return on; }
+
+  bool send(FrameBuf* f) override {
+    if (count_ >= QLEN) return false;
+    retain(f);
+    q_[(head_ + count_) % QLEN] = f;
+    count_++;
+    return true;
+  }
+
+  void service() override {
+    while (count_ > 0) {
+      FrameBuf* f = q_[head_];
+      std::memcpy(fifo_, f->data, f->len);
+      check = sum(fifo_, f->len, check);
+      bytes += f->len;
+      release(f);
+      head_ = (head_ + 1) % QLEN;
+      count_--;
+    }
+  }
+
+  bool     on = false;
+  uint64_t check = 0;
+  uint64_t bytes = 0;
+
+private:
+  static constexpr size_t QLEN = 3;
+  FrameBuf* q_[QLEN] = {nullptr};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  uint8_t fifo_[FrameBuf::CAP];
+};
+
+// Socket sink (-u): the sim's FdSink on a socketpair, with a thread that
+// drains the far end and sums what arrives. The sums start again at the
+// first read after reset is set (between runs, with nothing in flight).
+struct SockReader {
+  Transport*            t = nullptr;
+  int                   fd = -1;
+  std::thread           th;
+  std::atomic<bool>     reset{false};
+  std::atomic<uint64_t> check{0}, bytes{0};
+};
+
+static void readSock(SockReader* r) {
+  uint8_t buf[8192];
+  uint64_t s = 0, n = 0;
+  ssize_t k;
+  while ((k = ::read(r->fd, buf, sizeof(buf))) > 0) {
+    if (r->reset.exchange(false)) s = n = 0;
+    s = sum(buf, (size_t)k, s);
+    n += (uint64_t)k;
+    r->check = s;
+    r->bytes = n;
+  }
+  ::close(r->fd);
+}
+
+static constexpr size_t MAX_N = MAX_TRANSPORTS;
+static MemSink    s_mem[MAX_N];
+static SockReader s_sock[MAX_N];
+static bool       s_useSock = false;
+
+static Transport* sink(size_t i) { return s_useSock ? s_sock[i].t : &s_mem[i]; }
+static uint64_t gotCheck(size_t i) { return s_useSock ? s_sock[i].check.load() : s_mem[i].check; }
+static uint64_t gotBytes(size_t i) { return s_useSock ? s_sock[i].bytes.load() : s_mem[i].bytes; }
+
+// Sinks 0..n-1 take part; the rest are marked custom, which publish()
+// passes by (sendTo() is only called for the ones taking part)
+static void use(size_t n) {
+  for (size_t i = 0; i < MAX_N; i++) {
+    Transport* t = sink(i);
+    t->custom = i >= n;
+    t->fmt = s_bin ? Fmt::Bin : Fmt::Json;
+    t->framesSent = t->framesDropped = 0;
+    s_mem[i].on = true;
+    s_mem[i].check = s_mem[i].bytes = 0;
+    s_sock[i].reset = true;
+  }
+}
+
+// Sockets: before the next frame, let the readers take everything sent so
+// far, so no sink drops and the next service() call finds room. Not timed.
+static void catchUp(size_t n, uint64_t wantBytes) {
+  if (!s_useSock) return;
+  for (int k = 0; k < 1000000; k++) {
+    TlmBus::service();
+    bool done = true;
+    for (size_t i = 0; i < n; i++) done = done && s_sock[i].bytes >= wantBytes;
+    if (done) return;
+    std::this_thread::yield();
+  }
+}
+
+// ------------------------------------------------------------
+// Bench
+// ------------------------------------------------------------
+struct Times {
+  uint64_t encode = 0, publish = 0, write = 0;
+  uint32_t frames = 0, noBuf = 0;
+};
+
+// One frame, encoded into a pooled buffer; nullptr if the pool is empty
+static FrameBuf* make(uint32_t i, Times& t) {
+  FrameBuf* f = alloc(s_bin ? Fmt::Bin : Fmt::Json);
+  if (!f) { t.noBuf++; return nullptr; }
+  if (!encode(i, f)) { release(f); return nullptr; }
+  return f;
+}
+
+static Times run(size_t n, bool perSink, uint32_t frames, uint64_t& want, uint64_t& wantBytes) {
+  Times t;
+  for (uint32_t i = 0; i < frames; i++) {
+    for (size_t k = 0; k < (perSink ? n : 1); k++) {
+      uint64_t t0 = nowNs();
+      FrameBuf* f = make(i, t);
+      uint64_t t1 = nowNs();
+      if (!f) continue;
+      if (k == 0) { want = sum(f->data, f->len, want); wantBytes += f->len; }
+      uint64_t t2 = nowNs();
+      if (perSink) sendTo(sink(k), f);
+      else         publish(f);
+      uint64_t t3 = nowNs();
+      t.encode += t1 - t0;
+      t.publish += t3 - t2;
+    }
+    uint64_t t4 = nowNs();
+    TlmBus::service();
+    t.write += nowNs() - t4;
+    t.frames++;
+    catchUp(n, wantBytes);
+  }
+  return t;
+}
+
+int main(int argc, char** argv) {
+  uint32_t frames = 100000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:bu")) != -1) {
+    switch (opt) {
+      case 'n': frames = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 'b': s_bin = true; break;
+      case 'u': s_useSock = true; break;
+      default:
+        std::fprintf(stderr, "usage: %s [-n frames] [-b] [-u]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (frames < 1) frames = 1;
+
+  for (size_t i = 0; i < MAX_N; i++) {
+    if (s_useSock) {
+      s_sock[i].t = Sim::sinkPair(Fmt::Json, &s_sock[i].fd);
+      if (!s_sock[i].t) { std::fprintf(stderr, "socketpair failed\n"); return 1; }
+      s_sock[i].th = std::thread(readSock, &s_sock[i]);
+    }
+    add(sink(i));
+  }
+
+  std::printf("%u frames of %s to %s\n", frames, s_bin ? "FullV1 (binary)" : "JSON",
+              s_useSock ? "socket sinks (socketpair + reader thread)" : "memory sinks");
+  std::printf("%-5s %-9s %10s %10s %10s %10s %8s %8s\n", "sinks", "way", "encode ns", "publish ns",
+              "loop ns", "write ns", "dropped", "no_buf");
+
+  for (size_t n = 1; n <= MAX_N; n++) {
+    for (int perSink = 0; perSink < 2; perSink++) {
+      use(n);
+      uint64_t want = 0, wantBytes = 0;
+      const Times t = run(n, perSink, frames, want, wantBytes);
+      catchUp(n, wantBytes);
+
+      uint32_t dropped = 0;
+      for (size_t i = 0; i < MAX_N; i++) {
+        const Transport* s = sink(i);
+        dropped += s->framesDropped;
+        if (i >= n) { check(s->framesSent == 0, "idle sink sent to", i); continue; }
+        check(s->framesSent == t.frames && s->framesDropped == 0, "sink frame count", i);
+        check(gotCheck(i) == want && gotBytes(i) == wantBytes, "sink bytes", i);
+      }
+      check(t.noBuf == 0, "pool empty", t.noBuf);
+      const double d = t.frames ? (double)t.frames : 1.0;
+      std::printf("%-5zu %-9s %10.0f %10.0f %10.0f %10.0f %8u %8u\n", n, perSink ? "per-sink" : "bus",
+                  t.encode / d, t.publish / d, (t.encode + t.publish) / d, t.write / d, dropped, t.noBuf);
+    }
+  }
+
+  if (s_useSock) {
+    for (size_t i = 0; i < MAX_N; i++) {
+      Sim::sinkClose(s_sock[i].t, 2000);
+      s_sock[i].th.join();
+    }
+  }
+  std::printf("checks: %s (%u failed)\n", s_fails ? "FAIL" : "ok", s_fails);
+  return s_fails ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+// frame_bench - multi-threaded benchmark of the firmware's FrameBus
+//
+//   frame_bench [-t seconds] [-e every] [-l latest] [-r rate_hz] [-w work_ns]
+//
+// One producer thread publishes AdcReadings frames (claim, fill in place,
+// commit) at rate_hz (0 = flat out). Consumer threads read them in place:
+// -e of them in Mode::Every, -l in Mode::Latest, each spending work_ns
+// on a frame while holding its Ref. Reports frames/s and, per consumer,
+// frames, drops, skipped, lag and commit->read latency.
+//
+// Every frame is filled from its seq; consumers check the whole frame
+// against its seq while holding the Ref, so a slot reused under a reader
+// shows up as "torn" (must stay 0).
+
+#include "adc_mgr.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+// The bus clock: ns here, so the Sub::lat*Us counters are in ns
+static uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+typedef FrameBus<AdcReadings, 8> Bus;
+
+static void fill(AdcReadings& r, uint32_t seq) {
+  r.mv_vmid_sys = (int)seq;
+  r.mv_ntc_sys  = (int)(seq ^ 0x5A5A5A5Au);
+  r.mv_load = r.mv_bchg = r.mv_bdsg = (int)(seq * 3u);
+  r.vbat_meas_sys_v = (float)(seq & 0xFFFF);
+  r.temp_c = (float)(seq & 0xFF);
+  r.iload_a = r.ibatt_chg_a = r.ibatt_dsg_a = (float)(seq & 0xFFF);
+}
+
+static bool intact(const AdcReadings& r, uint32_t seq) {
+  return r.mv_vmid_sys == (int)seq && r.mv_ntc_sys == (int)(seq ^ 0x5A5A5A5Au) &&
+         r.mv_load == (int)(seq * 3u) && r.mv_bchg == r.mv_load && r.mv_bdsg == r.mv_load &&
+         r.vbat_meas_sys_v == (float)(seq & 0xFFFF) && r.temp_c == (float)(seq & 0xFF) &&
+         r.iload_a == (float)(seq & 0xFFF) && r.ibatt_chg_a == r.iload_a &&
+         r.ibatt_dsg_a == r.iload_a;
+}
+
+static void spin(uint64_t ns) {
+  if (!ns) return;
+  const uint64_t end = nowNs() + ns;
+  while (nowNs() < end) {}
+}
+
+int main(int argc, char** argv) {
+  double seconds = 2.0;
+  int every = 2, latest = 2;
+  double rate = 0;
+  uint64_t workNs = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:e:l:r:w:")) != -1) {
+    switch (opt) {
+      case 't': seconds = atof(optarg); break;
+      case 'e': every = atoi(optarg); break;
+      case 'l': latest = atoi(optarg); break;
+      case 'r': rate = atof(optarg); break;
+      case 'w': workNs = strtoull(optarg, nullptr, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-t s] [-e every] [-l latest] [-r rate_hz] [-w work_ns]\n", argv[0]);
+        return 2;
+    }
+  }
+  const int consumers = every + latest;
+  if (consumers < 1 || consumers > 8) { fprintf(stderr, "1..8 consumers\n"); return 2; }
+
+  static Bus bus(nowNs);
+  std::vector<Bus::Sub> subs(consumers);
+  std::vector<uint64_t> torn(consumers, 0);
+  static char names[8][24];
+  for (int i = 0; i < consumers; i++) {
+    const bool ev = i < every;
+    snprintf(names[i], sizeof(names[i]), "%s%d", ev ? "every" : "latest", ev ? i : i - every);
+    bus.subscribe(subs[i], names[i], ev ? Bus::Mode::Every : Bus::Mode::Latest);
+  }
+
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < consumers; i++) {
+    threads.emplace_back([&, i]() {
+      Bus::Ref f;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (!bus.read(subs[i], f)) { std::this_thread::yield(); continue; }
+        if (!intact(*f, f.seq())) torn[i]++;
+        spin(workNs);
+        if (!intact(*f, f.seq())) torn[i]++;   // still ours after the work?
+        f.release();
+      }
+    });
+  }
+
+  uint64_t published = 0;
+  const uint64_t periodNs = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+  const uint64_t t0 = nowNs();
+  const uint64_t tEnd = t0 + (uint64_t)(seconds * 1e9);
+  uint64_t due = t0;
+  for (uint64_t now = t0; now < tEnd; now = nowNs()) {
+    if (periodNs) {
+      if (now < due) {
+        // sleep through most of the wait, spin the rest
+        if (due - now > 100000) std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - 50000));
+        continue;
+      }
+      due += periodNs;
+    }
+    if (AdcReadings* r = bus.claim()) {
+      fill(*r, bus.seq() + 1);
+      bus.commit();
+      published++;
+    }
+  }
+  const double elapsed = (nowNs() - t0) / 1e9;
+  stop = true;
+  for (std::thread& t : threads) t.join();
+
+  printf("%d every + %d latest consumers, %u slots, work %llu ns, %.2f s, %u hw threads\n",
+         every, latest, (unsigned)Bus::slots(), (unsigned long long)workNs, elapsed,
+         std::thread::hardware_concurrency());
+  printf("published %llu frames: %.0f frames/s, claim failures (no free slot) %lu\n\n",
+         (unsigned long long)published, published / elapsed, (unsigned long)bus.noSlot());
+  printf("%-9s %11s %11s %11s %8s %10s %10s %6s\n",
+         "consumer", "frames", "drops", "skipped", "lag_max", "lat_avg_ns", "lat_max_ns", "torn");
+  uint64_t tornAll = 0;
+  for (int i = 0; i < consumers; i++) {
+    const Bus::Sub& s = subs[i];
+    printf("%-9s %11lu %11lu %11lu %8lu %10.0f %10lu %6llu\n", s.name, (unsigned long)s.frames,
+           (unsigned long)s.drops, (unsigned long)s.skipped, (unsigned long)s.lagMax,
+           s.frames ? (double)s.latTotalUs / s.frames : 0.0, (unsigned long)s.latMaxUs,
+           (unsigned long long)torn[i]);
+    tornAll += torn[i];
+  }
+  return tornAll ? 1 : 0;
+}
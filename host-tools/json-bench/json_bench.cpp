@@ -0,0 +1,536 @@
+// json_bench - corpus checks, fuzzing and benchmark of the firmware's JsonTok
+//
+//   json_bench [-n fuzz_cases] [-b lines] [-s seed] [-f corpus.txt] [-c]
+//
+// Checks first (exit status 1 if any fails):
+//   corpus    fixed inputs with the expected token count or error:
+//             trailing commas, missing ':' / ',', a second root value,
+//             inputs cut short, nesting and token limits, escapes; the
+//             values are NUL-terminated in place. -f adds cases from a
+//             file, one per line: <expected><TAB><json> (expected is a
+//             token count, inval, part or nomem)
+//   convert   toLong / toInt64 are base 10 and refuse overflow, toFloat
+//             refuses NaN, toBool takes true/false/0/1
+//   fuzz      mutated corpus inputs and random bytes against a recursive
+//             descent parser of the same grammar: the same result, and
+//             for accepted input a consistent token tree
+//
+// Then the bench (-c: checks only): parse() of the command lines the
+// firmware gets, ns per line, and the heap allocations it made (must be 0).
+
+#include "json_tok.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace JsonTok;
+
+static uint32_t s_fails = 0;
+
+static void check(bool ok, const char* what, const std::string& in = std::string()) {
+  if (ok) return;
+  if (s_fails < 20) std::fprintf(stderr, "FAIL %s: %s\n", what, in.c_str());
+  s_fails++;
+}
+
+static uint32_t s_rng = 1;
+static uint32_t rnd() {
+  s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+static uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------------
+// Heap allocations while armed: malloc & co interposed over glibc's,
+// as the sim's heap guard does (not under a sanitizer, which owns them)
+// ------------------------------------------------------------
+static bool     s_heapArmed = false;
+static uint32_t s_heapAllocs = 0;
+
+#if !defined(__SANITIZE_ADDRESS__)
+extern "C" {
+void* __libc_malloc(size_t n);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t n);
+
+void* malloc(size_t n) {
+  if (s_heapArmed) s_heapAllocs++;
+  return __libc_malloc(n);
+}
+
+void* calloc(size_t n, size_t size) {
+  if (s_heapArmed) s_heapAllocs++;
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t n) {
+  if (s_heapArmed && n) s_heapAllocs++;
+  return __libc_realloc(p, n);
+}
+} // extern "C"
+#endif
+
+// ------------------------------------------------------------
+// Reference: recursive descent over the grammar parse() takes. Values
+// are objects, arrays, strings (escapes skipped) and runs of primitive
+// characters; exactly one root value. Errors are reported where a left
+// to right scan first meets them, like parse() does.
+// ------------------------------------------------------------
+struct Ref {
+  const char* s;
+  size_t len, i;
+  size_t maxToks, toks;
+  int depth;
+
+  static bool prim(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '-' || c == '+' || c == '.';
+  }
+  void ws() {
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) i++;
+  }
+  int tok() { return toks < maxToks ? (toks++, 0) : ERR_NOMEM; }
+
+  int string() {
+    for (i++; i < len && s[i] != '"'; i++) {
+      if (s[i] == '\\' && i + 1 < len) i++;
+    }
+    if (i >= len) return ERR_PART;
+    i++;
+    return tok();
+  }
+
+  int container(bool obj) {
+    const char close = obj ? '}' : ']';
+    if (depth >= (int)MAX_DEPTH) return ERR_NOMEM;
+    if (int e = tok()) return e;
+    depth++;
+    i++;
+    ws();
+    if (i >= len) return ERR_PART;
+    if (s[i] == close) { i++; depth--; return 0; }
+    for (;;) {
+      ws();
+      if (i >= len) return ERR_PART;
+      if (obj) {
+        if (s[i] != '"') return ERR_INVAL;
+        if (int e = string()) return e;
+        ws();
+        if (i >= len) return ERR_PART;
+        if (s[i] != ':') return ERR_INVAL;
+        i++;
+      }
+      if (int e = value()) return e;
+      ws();
+      if (i >= len) return ERR_PART;
+      if (s[i] == ',') { i++; continue; }
+      if (s[i] != close) return ERR_INVAL;
+      i++;
+      depth--;
+      return 0;
+    }
+  }
+
+  int value() {
+    ws();
+    if (i >= len) return ERR_PART;
+    const char c = s[i];
+    if (c == '{' || c == '[') return container(c == '{');
+    if (c == '"') return string();
+    if (!prim(c)) return ERR_INVAL;
+    while (i < len && prim(s[i])) i++;
+    return tok();
+  }
+
+  int root() {
+    if (int e = value()) return e;
+    ws();
+    return i < len ? ERR_INVAL : (int)toks;
+  }
+};
+
+static int refParse(const char* s, size_t len, size_t maxToks) {
+  if (len >= 0xFFFF) return ERR_INVAL;
+  Ref r = { s, len, 0, maxToks, 0, 0 };
+  return r.root();
+}
+
+// Token tree of an accepted input: inside the input, children inside
+// their parent in order, sizes matching the children, objects in
+// key/value pairs with string keys, every scalar NUL-terminated
+static bool treeOk(const char* s, size_t len, const Token* t, int n) {
+  if (n <= 0 || t[0].start > len || t[0].end > len) return false;
+  int i = 0;
+  struct Walk {
+    const char* s; size_t len; const Token* t; int n;
+    bool node(int& i, uint16_t lo, uint16_t hi) {
+      if (i >= n) return false;
+      const Token& k = t[i];
+      if (k.start < lo || k.end > hi || k.end < k.start) return false;
+      if (k.type == STRING || k.type == PRIMITIVE) {
+        if (k.size != 0 || s[k.end] != '\0' || (k.end == k.start && k.type == PRIMITIVE)) return false;
+        i++;
+        return true;
+      }
+      if (k.type == OBJECT && (k.size & 1)) return false;
+      i++;
+      uint16_t at = (uint16_t)(k.start + 1);
+      for (uint16_t c = 0; c < k.size; c++) {
+        if (k.type == OBJECT && !(c & 1) && (i >= n || t[i].type != STRING)) return false;
+        const int first = i;
+        if (!node(i, at, (uint16_t)(k.end - 1))) return false;
+        at = t[first].end;
+      }
+      return skip(t, n, (int)(&k - t)) == i;
+    }
+  } w = { s, len, t, n };
+  return w.node(i, 0, (uint16_t)len) && i == n;
+}
+
+// ------------------------------------------------------------
+// Corpus
+// ------------------------------------------------------------
+struct Case {
+  int         expect;    // token count, or an Err
+  const char* json;
+  size_t      maxToks;
+};
+
+static const Case CORPUS[] = {
+  // what the firmware gets
+  {  5, "{\"cmd\":\"get\",\"id\":1}", 48 },
+  {  9, "{\"cmd\":\"get\",\"keys\":[\"trip_a\",\"bo_v\"],\"id\":4}", 48 },
+  { 11, "{\"cmd\":\"set\",\"mem_period_ms\":1000,\"ui_period_ms\":200,\"log_period_ms\":500,\"id\":1}", 48 },
+  { 12, "{\"cmd\":\"sub\",\"fields\":[\"vbat\",\"soc\",\"iload\"],\"period_ms\":100,\"id\":2}", 48 },
+  {  7, "{\"cmd\":\"time\",\"epoch_us\":1760000000000000,\"id\":6}", 48 },
+  {  3, "  {\"a\":1}\r\n", 48 },
+  {  1, "{}", 48 },
+  {  1, "[]", 48 },
+  {  3, "{\"a\":[]}", 48 },
+  {  5, "[[],{},[[]]]", 48 },
+  {  1, "7", 48 },
+  {  1, "\"x\"", 48 },
+  {  3, "{\"a\":\"x\\\"y\"}", 48 },
+  {  3, "{\"a\":\"\\\\\"}", 48 },
+  {  3, "{\"\":\"\"}", 48 },
+  // trailing and missing separators
+  { ERR_INVAL, "{\"a\":1,}", 48 },
+  { ERR_INVAL, "[1,]", 48 },
+  { ERR_INVAL, "[1,2,]", 48 },
+  { ERR_INVAL, "{\"a\":[1,],\"b\":2}", 48 },
+  { ERR_INVAL, "{,}", 48 },
+  { ERR_INVAL, "[,1]", 48 },
+  { ERR_INVAL, "{\"a\":1,,\"b\":2}", 48 },
+  { ERR_INVAL, "{\"a\" \"b\"}", 48 },
+  { ERR_INVAL, "{\"a\":1 \"b\":2}", 48 },
+  { ERR_INVAL, "[1 2]", 48 },
+  { ERR_INVAL, "{\"a\"}", 48 },
+  { ERR_INVAL, "{\"a\":}", 48 },
+  { ERR_INVAL, "{:1}", 48 },
+  { ERR_INVAL, "{\"a\"::1}", 48 },
+  { ERR_INVAL, "{1:2}", 48 },
+  { ERR_INVAL, "{\"a\":1:2}", 48 },
+  { ERR_INVAL, "[\"a\":1]", 48 },
+  { ERR_INVAL, "{\"a\":1]", 48 },
+  { ERR_INVAL, "[1}", 48 },
+  { ERR_INVAL, "]", 48 },
+  { ERR_INVAL, ",", 48 },
+  { ERR_INVAL, "{\"a\":#}", 48 },
+  // exactly one root
+  { ERR_INVAL, "{}{}", 48 },
+  { ERR_INVAL, "{\"cmd\":\"get\"} {\"cmd\":\"set\"}", 48 },
+  { ERR_INVAL, "{\"a\":1} x", 48 },
+  { ERR_INVAL, "{\"a\":1}]", 48 },
+  { ERR_INVAL, "{\"a\":1},", 48 },
+  { ERR_INVAL, "1 2", 48 },
+  { ERR_INVAL, "\"a\" \"b\"", 48 },
+  // cut short
+  { ERR_PART, "", 48 },
+  { ERR_PART, "  \r\n", 48 },
+  { ERR_PART, "{", 48 },
+  { ERR_PART, "{\"a\":1", 48 },
+  { ERR_PART, "{\"a\":1,", 48 },
+  { ERR_PART, "{\"a", 48 },
+  { ERR_PART, "{\"a\"", 48 },
+  { ERR_PART, "{\"a\":", 48 },
+  { ERR_PART, "[1,", 48 },
+  { ERR_PART, "{\"a\":\"x\\\"}", 48 },
+  // limits
+  {  8, "[[[[[[[[]]]]]]]]", 48 },
+  { ERR_NOMEM, "[[[[[[[[[]]]]]]]]]", 48 },
+  {  5, "{\"cmd\":\"get\",\"id\":1}", 5 },
+  { ERR_NOMEM, "{\"cmd\":\"get\",\"id\":1}", 4 },
+};
+
+static const char* errName(int e) {
+  switch (e) {
+    case ERR_INVAL: return "inval";
+    case ERR_PART:  return "part";
+    case ERR_NOMEM: return "nomem";
+  }
+  return "?";
+}
+
+static std::string result(int r) { return r > 0 ? std::to_string(r) : errName(r); }
+
+static bool runCase(int expect, const std::string& json, size_t maxToks) {
+  std::vector<char> buf(json.begin(), json.end());
+  buf.push_back('\0');
+  std::vector<Token> toks(maxToks ? maxToks : 1);
+  const int n = parse(buf.data(), json.size(), toks.data(), maxToks);
+  const bool ok = n == expect && n == refParse(json.data(), json.size(), maxToks) &&
+                  (n <= 0 || treeOk(buf.data(), json.size(), toks.data(), n));
+  if (!ok) check(false, ("corpus: want " + result(expect) + " got " + result(n)).c_str(), json);
+  return ok;
+}
+
+static void checkCorpus(const char* path) {
+  for (const Case& c : CORPUS) runCase(c.expect, c.json, c.maxToks);
+
+  // values usable in place
+  char line[] = "{\"cmd\":\"set\",\"trip_a\":2.5,\"keys\":[\"a\",\"b\"],\"on\":true}";
+  Token t[16];
+  const int n = parse(line, strlen("{\"cmd\":\"set\",\"trip_a\":2.5,\"keys\":[\"a\",\"b\"],\"on\":true}"), t, 16);
+  int i;
+  check(n == 11, "corpus in place: tokens");
+  check((i = find(line, t, n, 0, "cmd")) >= 0 && !strcmp(line + t[i].start, "set"), "corpus in place: cmd");
+  check((i = find(line, t, n, 0, "trip_a")) >= 0 && !strcmp(line + t[i].start, "2.5"), "corpus in place: trip_a");
+  check((i = find(line, t, n, 0, "keys")) >= 0 && t[i].type == ARRAY && t[i].size == 2, "corpus in place: keys");
+  check(find(line, t, n, 0, "nope") < 0, "corpus in place: missing key");
+
+  if (!path) return;
+  FILE* f = std::fopen(path, "r");
+  if (!f) { std::perror(path); s_fails++; return; }
+  char buf[4096];
+  unsigned lineNo = 0, cases = 0;
+  while (std::fgets(buf, sizeof(buf), f)) {
+    lineNo++;
+    std::string l(buf);
+    while (!l.empty() && (l.back() == '\n' || l.back() == '\r')) l.pop_back();
+    if (l.empty() || l[0] == '#') continue;
+    const size_t tab = l.find('\t');
+    if (tab == std::string::npos) { check(false, "corpus file: no tab", std::to_string(lineNo)); continue; }
+    const std::string want = l.substr(0, tab);
+    int expect = want == "inval" ? ERR_INVAL : want == "part" ? ERR_PART : want == "nomem" ? ERR_NOMEM
+                                                                         : std::atoi(want.c_str());
+    if (expect == 0) { check(false, "corpus file: bad expectation", std::to_string(lineNo)); continue; }
+    runCase(expect, l.substr(tab + 1), 48);
+    cases++;
+  }
+  std::fclose(f);
+  std::printf("corpus file: %u cases\n", cases);
+}
+
+static void checkConvert() {
+  struct L { const char* in; bool ok; long v; };
+  static const L LONGS[] = {
+    { "0", true, 0 }, { "-7", true, -7 }, { "010", true, 10 }, { "2147483647", true, 2147483647L },
+    { "0x10", false, 0 }, { "1.5", false, 0 }, { "1e3", false, 0 }, { "12a", false, 0 },
+    { "99999999999999999999", false, 0 }, { "-", false, 0 }, { "true", false, 0 },
+  };
+  for (const L& c : LONGS) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "[%s]", c.in);
+    Token t[2];
+    long v = -1;
+    const bool ok = parse(buf, strlen(buf), t, 2) == 2 && toLong(buf, t[1], v);
+    check(ok == c.ok && (!ok || v == c.v), "toLong", c.in);
+  }
+  struct I { const char* in; bool ok; int64_t v; };
+  static const I INTS[] = {
+    { "1760000000000000", true, 1760000000000000LL }, { "010", true, 10 }, { "-9", true, -9 },
+    { "0x7f", false, 0 }, { "99999999999999999999", false, 0 }, { "1.0", false, 0 },
+  };
+  for (const I& c : INTS) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "[%s]", c.in);
+    Token t[2];
+    int64_t v = -1;
+    const bool ok = parse(buf, strlen(buf), t, 2) == 2 && toInt64(buf, t[1], v);
+    check(ok == c.ok && (!ok || v == c.v), "toInt64", c.in);
+  }
+  struct F { const char* in; bool ok; float v; };
+  static const F FLOATS[] = {
+    { "2.5", true, 2.5f }, { "-0.125", true, -0.125f }, { "1e3", true, 1000.0f }, { "nan", false, 0 },
+    { "1.5x", false, 0 },
+  };
+  for (const F& c : FLOATS) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "[%s]", c.in);
+    Token t[2];
+    float v = -1;
+    const bool ok = parse(buf, strlen(buf), t, 2) == 2 && toFloat(buf, t[1], v);
+    check(ok == c.ok && (!ok || v == c.v), "toFloat", c.in);
+  }
+  struct B { const char* in; bool ok; bool v; };
+  static const B BOOLS[] = {
+    { "true", true, true }, { "1", true, true }, { "false", true, false }, { "0", true, false },
+    { "yes", false, false }, { "\"true\"", false, false },
+  };
+  for (const B& c : BOOLS) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "[%s]", c.in);
+    Token t[2];
+    bool v = !c.v;
+    const bool ok = parse(buf, strlen(buf), t, 2) == 2 && toBool(buf, t[1], v);
+    check(ok == c.ok && (!ok || v == c.v), "toBool", c.in);
+  }
+}
+
+// ------------------------------------------------------------
+// Fuzz: mutate accepted corpus inputs (or start from random bytes) and
+// compare parse() with the reference on an exact-size heap buffer, so a
+// sanitizer build catches any read past the end
+// ------------------------------------------------------------
+static const char ALPHABET[] = "{}[]\":,\\ \t\r\n0123456789-+.aetrufls#\x01\x7f";
+
+static void mutate(std::string& s) {
+  const unsigned ops = 1 + rnd() % 4;
+  for (unsigned k = 0; k < ops; k++) {
+    const size_t at = s.empty() ? 0 : rnd() % (s.size() + 1);
+    const char c = ALPHABET[rnd() % (sizeof(ALPHABET) - 1)];
+    switch (rnd() % 6) {
+      case 0: if (at < s.size()) s[at] = c; break;                       // replace
+      case 1: s.insert(s.begin() + at, c); break;                        // insert
+      case 2: if (at < s.size()) s.erase(at, 1 + rnd() % 3); break;      // delete
+      case 3: s.resize(at); break;                                       // cut short
+      case 4: if (at < s.size()) s.insert(at, s.substr(at, 1 + rnd() % 8)); break;   // repeat a span
+      case 5: s.insert(at, rnd() & 1 ? "," : "{\"k\":"); break;          // stray separator / opener
+    }
+  }
+}
+
+static void fuzz(uint32_t cases) {
+  std::vector<std::string> seeds;
+  for (const Case& c : CORPUS) seeds.push_back(c.json);
+  uint32_t accepted = 0, hist[4] = {};
+  for (uint32_t k = 0; k < cases; k++) {
+    std::string in;
+    if (rnd() % 16 == 0) {
+      const size_t len = rnd() % 64;
+      for (size_t i = 0; i < len; i++) in.push_back(ALPHABET[rnd() % (sizeof(ALPHABET) - 1)]);
+    } else {
+      in = seeds[rnd() % seeds.size()];
+      mutate(in);
+    }
+    const size_t maxToks = 1 + rnd() % 48;
+
+    char* buf = (char*)std::malloc(in.size() + 1);
+    std::memcpy(buf, in.data(), in.size());
+    buf[in.size()] = '\0';
+    std::vector<Token> toks(maxToks);
+    const int n = parse(buf, in.size(), toks.data(), maxToks);
+    const int want = refParse(in.data(), in.size(), maxToks);
+    if (n != want) {
+      check(false, ("fuzz: parse " + result(n) + " reference " + result(want)).c_str(), in);
+    } else if (n > 0) {
+      accepted++;
+      check(treeOk(buf, in.size(), toks.data(), n), "fuzz: token tree", in);
+      for (int i = 0; i < n; i++) {          // the lookups stay inside the tokens
+        const int j = find(buf, toks.data(), n, i, "k");
+        check(j < n, "fuzz: find", in);
+      }
+    } else {
+      hist[-n]++;
+    }
+    std::free(buf);
+    if (rnd() % 8 == 0 && n > 0) seeds.push_back(in);   // grow the corpus with accepted inputs
+    if (seeds.size() > 4096) seeds.erase(seeds.begin() + (sizeof(CORPUS) / sizeof(CORPUS[0])));
+  }
+  std::printf("fuzz: %u cases, %u accepted, inval %u part %u nomem %u\n", cases, accepted,
+              hist[-ERR_INVAL], hist[-ERR_PART], hist[-ERR_NOMEM]);
+}
+
+// ------------------------------------------------------------
+// Bench
+// ------------------------------------------------------------
+static const char* const LINES[] = {
+  "{\"cmd\":\"get\",\"id\":3}",
+  "{\"cmd\":\"get\",\"keys\":[\"trip_a\",\"bo_v\"],\"id\":4}",
+  "{\"cmd\":\"set\",\"mem_period_ms\":1000,\"ui_period_ms\":200,\"log_period_ms\":500,\"id\":1}",
+  "{\"cmd\":\"sub\",\"fields\":[\"vbat\",\"soc\",\"iload\"],\"period_ms\":100,\"id\":2}",
+  "{\"cmd\":\"stream\",\"on\":1,\"tick_us\":1000,\"mask\":31,\"id\":19}",
+  "{\"cmd\":\"time\",\"epoch_us\":1760000000000000,\"id\":6}",
+};
+
+static void bench(uint32_t lines) {
+  static const size_t NL = sizeof(LINES) / sizeof(LINES[0]);
+  static char src[NL][256], buf[256];
+  static Token toks[48];                 // cmd_mgr's MAX_TOKENS
+  size_t lens[NL], bytes = 0;
+  for (size_t i = 0; i < NL; i++) {
+    lens[i] = strlen(LINES[i]);
+    std::memcpy(src[i], LINES[i], lens[i] + 1);
+  }
+
+  // what handleLine() does per line: copy (the line buffer is reused),
+  // tokenize, look up cmd and id, convert id
+  uint64_t copyNs = 0, parseNs = 0;
+  long sum = 0;
+  int tokens = 0;
+  s_heapAllocs = 0;
+  s_heapArmed = true;
+  for (uint32_t k = 0; k < lines; k++) {
+    const size_t i = k % NL;
+    uint64_t t0 = nowNs();
+    std::memcpy(buf, src[i], lens[i] + 1);
+    uint64_t t1 = nowNs();
+    const int n = parse(buf, lens[i], toks, 48);
+    const int c = find(buf, toks, n, 0, "cmd");
+    const int id = find(buf, toks, n, 0, "id");
+    long v = 0;
+    if (c > 0 && id > 0 && toLong(buf, toks[id], v)) sum += v + buf[toks[c].start];
+    uint64_t t2 = nowNs();
+    copyNs += t1 - t0;
+    parseNs += t2 - t1;
+    tokens += n;
+    bytes += lens[i];
+  }
+  s_heapArmed = false;
+  check(s_heapAllocs == 0, "bench: parse allocated", std::to_string(s_heapAllocs));
+
+  const double perLine = (double)parseNs / lines;
+  std::printf("%u lines, %zu command shapes, %.1f bytes and %.1f tokens per line\n",
+              lines, NL, (double)bytes / lines, (double)tokens / lines);
+  std::printf("parse+find+toLong %.0f ns/line  %.1f MB/s  (timer and copy %.0f ns/line)  heap allocs %u  (%ld)\n",
+              perLine, bytes / (parseNs * 1e-9) / 1e6, (double)copyNs / lines, s_heapAllocs, sum & 1);
+}
+
+int main(int argc, char** argv) {
+  uint32_t cases = 200000, lines = 1000000;
+  const char* corpus = nullptr;
+  bool checksOnly = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:b:s:f:c")) != -1) {
+    switch (opt) {
+      case 'n': cases = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 'b': lines = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 's': s_rng = (uint32_t)strtoul(optarg, nullptr, 10) | 1; break;
+      case 'f': corpus = optarg; break;
+      case 'c': checksOnly = true; break;
+      default:
+        std::fprintf(stderr, "usage: %s [-n fuzz_cases] [-b lines] [-s seed] [-f corpus.txt] [-c]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (lines < 1) lines = 1;
+
+  checkCorpus(corpus);
+  checkConvert();
+  fuzz(cases);
+  std::printf("checks: %s (%u failed)\n", s_fails ? "FAIL" : "ok", s_fails);
+
+  if (!checksOnly) bench(lines);
+  return s_fails ? 1 : 0;
+}
@@ -0,0 +1,296 @@
+// log_fetch - download the on-flash telemetry history (TlmProto SCHEMA_LOG_V1)
+//
+//   log_fetch [-s store.tlg] [-t timeout_s] <port>   download new blocks
+//   log_fetch -d store.tlg > history.csv             decode a store file
+//
+// The store file is a plain concatenation of verified sectors (header +
+// data, see tlm_log.h). A run asks the device for everything after the
+// newest block already in the store, so an interrupted download resumes
+// where it stopped; a half-received sector is kept in <store>.part and
+// resumed at its byte offset. A lost chunk or a bad sector CRC triggers a
+// new request from that point.
+
+#include "tlm_proto.h"
+#include "tlm_log.h"
+
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace TlmProto;
+using namespace TlmLog;
+
+static volatile sig_atomic_t g_stop = 0;
+static void onSigint(int) { g_stop = 1; }
+
+static void makeRaw(int fd) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0) return;
+  cfmakeraw(&t);
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &t);
+}
+
+static bool sendLine(int fd, const std::string& s) {
+  std::string l = s + "\n";
+  return write(fd, l.data(), l.size()) == (ssize_t)l.size();
+}
+
+// ------------------------------------------------------------
+// Store file
+// ------------------------------------------------------------
+// Calls fn(sector bytes) for each stored sector; returns false on a torn tail
+template <typename Fn>
+static bool forEachSector(FILE* f, Fn fn) {
+  std::vector<uint8_t> sec(SECTOR_SIZE);
+  for (;;) {
+    SectorHdr h;
+    const size_t got = std::fread(&h, 1, sizeof(h), f);
+    if (got == 0) return true;
+    if (got != sizeof(h) || h.magic != MAGIC || h.bytes > BLOCK_DATA) return false;
+    std::memcpy(sec.data(), &h, sizeof(h));
+    if (std::fread(sec.data() + sizeof(h), 1, h.bytes, f) != h.bytes) return false;
+    fn(sec.data());
+  }
+}
+
+static int decodeStore(const char* path) {
+  FILE* f = std::fopen(path, "rb");
+  if (!f) { std::perror(path); return 1; }
+
+  std::printf("seq,boot,ms");
+  for (int i = 0; i < FIELD_COUNT; i++) std::printf(",%s", FIELDS[i].name);
+  std::printf("\n");
+
+  uint32_t blocks = 0, bad = 0, records = 0;
+  const bool ok = forEachSector(f, [&](const uint8_t* sec) {
+    if (!sectorValid(sec)) { bad++; return; }
+    SectorHdr h;
+    std::memcpy(&h, sec, sizeof(h));
+    BlockDecoder d;
+    d.begin(sec + sizeof(h), h.bytes, h.count);
+    Record r;
+    while (d.next(r)) {
+      std::printf("%u,%u,%u", h.seq, h.boot, r.ms);
+      for (int i = 0; i < FIELD_COUNT; i++) {
+        const float v = restore(r, i);
+        if (std::isnan(v)) std::printf(",");
+        else               std::printf(",%.*f", (int)FIELDS[i].decimals, v);
+      }
+      std::printf("\n");
+      records++;
+    }
+    blocks++;
+  });
+  std::fclose(f);
+
+  std::fprintf(stderr, "blocks=%u bad_crc=%u records=%u%s\n",
+               blocks, bad, records, ok ? "" : " (torn tail ignored)");
+  return 0;
+}
+
+// Newest seq in the store, false if empty
+static bool lastStoredSeq(const char* path, uint32_t& seq) {
+  FILE* f = std::fopen(path, "rb");
+  if (!f) return false;
+  bool any = false;
+  forEachSector(f, [&](const uint8_t* sec) {
+    SectorHdr h;
+    std::memcpy(&h, sec, sizeof(h));
+    if (!any || (int32_t)(h.seq - seq) > 0) seq = h.seq;
+    any = true;
+  });
+  std::fclose(f);
+  return any;
+}
+
+// ------------------------------------------------------------
+// Download
+// ------------------------------------------------------------
+struct Partial {
+  uint32_t seq = 0;
+  std::vector<uint8_t> data;
+};
+
+static bool loadPartial(const std::string& path, Partial& p) {
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (!f) return false;
+  uint8_t buf[4 + SECTOR_SIZE];
+  const size_t n = std::fread(buf, 1, sizeof(buf), f);
+  std::fclose(f);
+  if (n < 4) return false;
+  std::memcpy(&p.seq, buf, 4);
+  p.data.assign(buf + 4, buf + n);
+  return true;
+}
+
+static void savePartial(const std::string& path, const Partial& p) {
+  if (p.data.empty()) { std::remove(path.c_str()); return; }
+  FILE* f = std::fopen(path.c_str(), "wb");
+  if (!f) return;
+  std::fwrite(&p.seq, 1, 4, f);
+  std::fwrite(p.data.data(), 1, p.data.size(), f);
+  std::fclose(f);
+}
+
+int main(int argc, char** argv) {
+  const char* store = "history.tlg";
+  const char* decodePath = nullptr;
+  double timeout = 10.0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:d:")) != -1) {
+    switch (opt) {
+      case 's': store = optarg; break;
+      case 't': timeout = std::atof(optarg); break;
+      case 'd': decodePath = optarg; break;
+      default: break;
+    }
+  }
+  if (decodePath) return decodeStore(decodePath);
+
+  const char* port = (optind < argc) ? argv[optind] : nullptr;
+  if (!port) {
+    std::fprintf(stderr, "usage: %s [-s store.tlg] [-t timeout_s] <port>\n"
+                         "       %s -d store.tlg > history.csv\n", argv[0], argv[0]);
+    return 2;
+  }
+
+  int fd = open(port, O_RDWR | O_NOCTTY);
+  if (fd < 0) { std::perror(port); return 1; }
+  if (isatty(fd)) makeRaw(fd);
+
+  FILE* out = std::fopen(store, "ab");
+  if (!out) { std::perror(store); return 1; }
+
+  const std::string partPath = std::string(store) + ".part";
+  Partial part;
+  uint32_t last = 0;
+  const bool haveLast = lastStoredSeq(store, last);
+  uint32_t from = haveLast ? last + 1 : 0;
+  if (loadPartial(partPath, part) && (!haveLast || (int32_t)(part.seq - last) > 0)) from = part.seq;
+  else part.data.clear();
+
+  std::signal(SIGINT, onSigint);
+
+  static const int MAX_RETRIES = 3;
+  uint32_t sectors = 0, crcBad = 0, rerequests = 0, chunks = 0;
+  int retries = 0;   // re-requests without progress
+  uint64_t bytes = 0;
+  bool done = false;
+
+  while (!g_stop && !done) {
+    // (Re)issue the request; the ack is a JSON line, frames follow it
+    char cmd[96];
+    const unsigned off = (!part.data.empty() && part.seq == from) ? (unsigned)part.data.size() : 0;
+    if (off == 0) part.data.clear();
+    std::snprintf(cmd, sizeof(cmd), "{\"cmd\":\"log\",\"op\":\"get\",\"from\":%u,\"off\":%u}", from, off);
+    if (!sendLine(fd, cmd)) { std::perror("write"); break; }
+
+    Decoder dec;
+    bool acked = false, restart = false;
+    std::string line;
+    auto tLast = std::chrono::steady_clock::now();
+    uint8_t buf[4096];
+
+    while (!g_stop && !done && !restart) {
+      if (std::chrono::duration<double>(std::chrono::steady_clock::now() - tLast).count() > timeout) {
+        std::fprintf(stderr, "timeout\n");
+        g_stop = 1;
+        break;
+      }
+      pollfd p = { fd, POLLIN, 0 };
+      if (poll(&p, 1, 100) <= 0) continue;
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n <= 0) { g_stop = 1; break; }
+      bytes += (uint64_t)n;
+      tLast = std::chrono::steady_clock::now();
+
+      for (ssize_t i = 0; i < n && !done && !restart; i++) {
+        const uint8_t b = buf[i];
+
+        if (!acked) {
+          if (b == '\n') {
+            if (line.find("\"ack\":\"log\"") != std::string::npos) {
+              if (line.find("\"err\":0") == std::string::npos) {
+                std::fprintf(stderr, "device refused: %s\n", line.c_str());
+                g_stop = 1;
+              }
+              acked = true;
+            }
+            line.clear();
+          } else if (line.size() < 2048) {
+            line.push_back((char)b);
+          }
+          continue;
+        }
+
+        if (!dec.push(b) || dec.schema() != SCHEMA_LOG_V1) continue;
+        if (dec.payloadLen() < sizeof(LogChunkV1)) continue;
+
+        LogChunkV1 c;
+        std::memcpy(&c, dec.payload(), sizeof(c));
+        if (dec.payloadLen() != sizeof(c) + c.len) continue;
+        chunks++;
+
+        if (c.len == 0) { done = true; break; }
+
+        if (c.off == 0) {
+          // a new sector while one is half done: we lost its tail, unless
+          // the device skipped it (overwritten) - then give up on it
+          if (!part.data.empty() && part.seq != c.seq && retries < MAX_RETRIES) restart = true;
+          else { part.seq = c.seq; part.data.clear(); }
+        } else if (c.seq != part.seq || c.off != part.data.size()) {
+          restart = true;                                                 // lost a chunk
+        }
+        if (restart) { from = part.data.empty() ? c.seq : part.seq; break; }
+
+        part.data.insert(part.data.end(), dec.payload() + sizeof(c), dec.payload() + sizeof(c) + c.len);
+        if (part.data.size() < c.total) continue;
+
+        if (sectorValid(part.data.data())) {
+          std::fwrite(part.data.data(), 1, part.data.size(), out);
+          std::fflush(out);
+          sectors++;
+          from = part.seq + 1;
+          part.data.clear();
+          retries = 0;
+        } else {
+          crcBad++;
+          from = (retries < MAX_RETRIES) ? part.seq : part.seq + 1;
+          part.data.clear();
+          restart = true;
+        }
+      }
+    }
+
+    if (restart) {
+      rerequests++;
+      retries++;
+      sendLine(fd, "{\"cmd\":\"log\",\"op\":\"stop\"}");
+      usleep(300 * 1000);
+      tcflush(fd, TCIFLUSH);
+    }
+  }
+
+  savePartial(partPath, part);
+  sendLine(fd, "{\"cmd\":\"proto\",\"fmt\":\"json\"}");
+  std::fclose(out);
+  close(fd);
+
+  std::fprintf(stderr, "sectors=%u chunks=%u bad_sector_crc=%u rerequests=%u bytes=%llu%s\n",
+               sectors, chunks, crcBad, rerequests, (unsigned long long)bytes,
+               done ? "" : " (incomplete - run again to resume)");
+  return done ? 0 : 1;
+}
@@ -0,0 +1,844 @@
+// ota_send - firmware update over the BT link (OtaMgr, TlmProto SCHEMA_OTA_V1)
+//
+//   ota_send [-w window] [-r bytes_per_s] [-t timeout_s] [-f] [-R] <firmware.bin> <port>
+//   ota_send -i <port>                        device OTA state
+//   ota_send -B [bench options] [image]       sender against an in-process device
+//
+// The image is cut into 4 KB chunks (one flash sector each), every chunk
+// LZ4-compressed on its own (OtaImg), and sent as frames of up to 480
+// bytes between the command lines. The device reports each chunk it has
+// on flash; the sender keeps at most `window` chunks beyond that in
+// flight and goes back to the device's "next" when it reports a gap or a
+// bad chunk, or when nothing moves for 0.5 s. "begin" resumes a transfer the
+// device already has a part of (same size + CRC), so an interrupted run
+// is continued by running the same command again.
+//
+// -B runs the same sender against a device model over a throttled
+// loopback: OtaImg::Receiver, a file-backed slot with sector erase /
+// program times, the writer pause, a 512-byte RX queue that drops what
+// does not fit and a cache-disabled loop during flash operations. It
+// prints the effective throughput and checks the slot against the image.
+
+#include "tlm_proto.h"
+#include "ota_img.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace TlmProto;
+using Clock = std::chrono::steady_clock;
+
+static volatile sig_atomic_t g_stop = 0;
+static void onSigint(int) { g_stop = 1; }
+
+static double since(Clock::time_point t) {
+  return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+static void makeRaw(int fd) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0) return;
+  cfmakeraw(&t);
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &t);
+}
+
+static bool writeAll(int fd, const void* p, size_t n) {
+  const uint8_t* b = (const uint8_t*)p;
+  while (n) {
+    const ssize_t w = write(fd, b, n);
+    if (w <= 0) return false;
+    b += w;
+    n -= (size_t)w;
+  }
+  return true;
+}
+
+static bool sendLine(int fd, const std::string& s) {
+  const std::string l = s + "\n";
+  return writeAll(fd, l.data(), l.size());
+}
+
+// "key":123 anywhere in the line
+static bool jsonNum(const std::string& l, const char* key, long long& v) {
+  const std::string k = std::string("\"") + key + "\":";
+  const size_t p = l.find(k);
+  if (p == std::string::npos) return false;
+  const char* s = l.c_str() + p + k.size();
+  char* end;
+  v = std::strtoll(s, &end, 10);
+  return end != s;
+}
+
+// "key":"text" anywhere in the line
+static std::string jsonStr(const std::string& l, const char* key) {
+  const std::string k = std::string("\"") + key + "\":\"";
+  const size_t p = l.find(k);
+  if (p == std::string::npos) return "";
+  const size_t e = l.find('"', p + k.size());
+  return e == std::string::npos ? "" : l.substr(p + k.size(), e - p - k.size());
+}
+
+// JSON lines from the device. Binary telemetry frames may sit in between:
+// a 0x00 ends one, so it starts a new line.
+class LineReader {
+public:
+  // Waits up to ms for input, calls fn(line) per complete line.
+  // False once the port is gone.
+  template <typename Fn>
+  bool poll(int fd, int ms, Fn fn) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (::poll(&p, 1, ms) <= 0) return true;
+    uint8_t buf[1024];
+    const ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) return false;
+    for (ssize_t i = 0; i < n; i++) {
+      const char c = (char)buf[i];
+      if (c == '\n') { fn(cur_); cur_.clear(); }
+      else if (c == '\0') cur_.clear();
+      else if (cur_.size() < 2048) cur_.push_back(c);
+    }
+    return true;
+  }
+
+private:
+  std::string cur_;
+};
+
+// ------------------------------------------------------------
+// Image
+// ------------------------------------------------------------
+struct Packed {
+  std::vector<uint8_t> bytes;
+  uint16_t raw;
+  uint8_t  method;
+  uint32_t crc;
+};
+
+struct Image {
+  std::vector<uint8_t> data;
+  uint32_t crc = 0;
+  std::vector<Packed> chunks;
+  size_t packedBytes = 0;
+};
+
+static bool loadImage(const char* path, bool force, Image& img) {
+  FILE* f = std::fopen(path, "rb");
+  if (!f) { std::perror(path); return false; }
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) img.data.insert(img.data.end(), buf, buf + n);
+  std::fclose(f);
+  if (img.data.empty()) { std::fprintf(stderr, "%s: empty\n", path); return false; }
+  if (!force && img.data[0] != 0xE9) {
+    std::fprintf(stderr, "%s: not an ESP32 app image (no 0xE9 magic), -f to send anyway\n", path);
+    return false;
+  }
+
+  img.crc = OtaImg::crc32(img.data.data(), img.data.size());
+  static uint16_t work[OtaImg::LZ4_HASH_SIZE];
+  const uint32_t size = (uint32_t)img.data.size();
+  for (uint32_t i = 0; i < OtaImg::chunkCount(size); i++) {
+    const uint8_t* raw = img.data.data() + (size_t)i * OtaImg::CHUNK;
+    const size_t rawLen = OtaImg::chunkSize(size, i);
+    Packed p;
+    p.raw = (uint16_t)rawLen;
+    p.crc = OtaImg::crc32(raw, rawLen);
+    p.bytes.resize(OtaImg::CHUNK);
+    const size_t z = OtaImg::lz4Compress(raw, rawLen, p.bytes.data(), p.bytes.size(), work);
+    if (z) {
+      p.method = OtaImg::LZ4;
+      p.bytes.resize(z);
+    } else {
+      p.method = OtaImg::STORED;
+      p.bytes.assign(raw, raw + rawLen);
+    }
+    img.packedBytes += p.bytes.size();
+    img.chunks.push_back(std::move(p));
+  }
+  return true;
+}
+
+// ------------------------------------------------------------
+// Sender
+// ------------------------------------------------------------
+struct SendOpts {
+  uint32_t window = 1;        // chunks in flight beyond the stored ones
+  double   rate = 0;          // bytes/s on the wire, 0 = as fast as the port takes them
+  double   timeout = 10;      // s without any reply
+  bool     reboot = false;    // start the new image when done
+};
+
+struct SendStats {
+  uint64_t wireBytes = 0;
+  uint32_t frames = 0;
+  uint32_t chunksSent = 0;
+  uint32_t rewinds = 0;       // device reported gap / busy / bad
+  uint32_t stalls = 0;        // nothing moved for STALL_S
+  uint32_t resumedAt = 0;     // "next" in the begin ack
+  uint32_t stored = 0;
+  double   seconds = 0;
+};
+
+enum class SendResult { Done, Incomplete, Failed };
+
+class Sender {
+public:
+  static constexpr double STALL_S = 0.5;   // a chunk takes ~0.1 s at 80 kB/s
+  static constexpr int    BEGIN_TRIES = 10;
+
+  Sender(const Image& img, const SendOpts& o) : img_(img), o_(o) {}
+
+  SendResult run(int fd) {
+    const Clock::time_point t0 = Clock::now();
+    t0_ = t0;
+    SendResult r = begin(fd);
+    if (r == SendResult::Done) r = transfer(fd);
+    if (r == SendResult::Done && o_.reboot) {
+      sendLine(fd, "{\"cmd\":\"ota\",\"op\":\"reboot\"}");
+      std::string ack;
+      if (!waitAck(fd, ack) || ack.find("\"err\":0") == std::string::npos) {
+        std::fprintf(stderr, "reboot refused: %s\n", ack.c_str());
+        r = SendResult::Failed;
+      }
+    }
+    st_.seconds = since(t0);
+    return r;
+  }
+
+  const SendStats& stats() const { return st_; }
+
+private:
+  bool waitAck(int fd, std::string& ack) {
+    const Clock::time_point t = Clock::now();
+    bool got = false;
+    while (!got && !g_stop && since(t) < o_.timeout) {
+      if (!rd_.poll(fd, 100, [&](const std::string& l) {
+            if (got) onLine(l);
+            else if (l.find("\"ack\":\"ota\"") != std::string::npos) { ack = l; got = true; }
+          }))
+        return false;
+    }
+    return got;
+  }
+
+  SendResult begin(int fd) {
+    char cmd[96];
+    std::snprintf(cmd, sizeof(cmd), "{\"cmd\":\"ota\",\"op\":\"begin\",\"size\":%zu,\"crc\":%u}",
+                  img_.data.size(), img_.crc);
+    for (int i = 0; i < BEGIN_TRIES && !g_stop; i++) {
+      if (!sendLine(fd, cmd)) return SendResult::Incomplete;
+      std::string ack;
+      if (!waitAck(fd, ack)) return SendResult::Incomplete;
+      if (ack.find("\"msg\":\"busy\"") != std::string::npos) {
+        // still writing or verifying from the last run
+        usleep(500 * 1000);
+        continue;
+      }
+      long long next = -1, chunks = -1;
+      if (ack.find("\"err\":0") == std::string::npos || !jsonNum(ack, "next", next) ||
+          !jsonNum(ack, "chunks", chunks) || chunks != (long long)img_.chunks.size()) {
+        std::fprintf(stderr, "device refused: %s\n", ack.c_str());
+        return SendResult::Failed;
+      }
+      st_.resumedAt = st_.stored = (uint32_t)next;
+      next_ = (uint32_t)next;
+      return SendResult::Done;
+    }
+    return SendResult::Incomplete;
+  }
+
+  void onLine(const std::string& l) {
+    if (l.find("\"ota\":{") == std::string::npos) return;
+    const std::string state = jsonStr(l, "state");
+    long long stored = 0, next = 0;
+    if (!jsonNum(l, "stored", stored) || !jsonNum(l, "next", next)) return;
+    progress_ = Clock::now();
+    if (state == "ready") done_ = true;
+    if (state == "failed") { failed_ = true; failWhy_ = l; }
+    if ((uint32_t)stored > st_.stored) st_.stored = (uint32_t)stored;
+    if (!jsonStr(l, "err").empty()) {
+      // go back to where the device stands; what it still holds comes again as dups
+      st_.rewinds++;
+      next_ = std::min(next_, (uint32_t)next);
+    }
+  }
+
+  bool sendChunk(int fd, uint32_t idx) {
+    const Packed& c = img_.chunks[idx];
+    for (size_t off = 0; off < c.bytes.size(); off += OTA_PIECE_MAX) {
+      uint8_t payload[sizeof(OtaChunkV1) + OTA_PIECE_MAX];
+      OtaChunkV1 h;
+      h.idx = (uint16_t)idx;
+      h.off = (uint16_t)off;
+      h.total = (uint16_t)c.bytes.size();
+      h.len = (uint16_t)std::min(c.bytes.size() - off, OTA_PIECE_MAX);
+      h.raw = c.raw;
+      h.method = c.method;
+      h.crc = c.crc;
+      std::memcpy(payload, &h, sizeof(h));
+      std::memcpy(payload + sizeof(h), c.bytes.data() + off, h.len);
+
+      uint8_t frame[1 + MAX_FRAME];
+      frame[0] = 0x00;   // opens the frame between the command lines
+      const size_t n = encodeFrame(SCHEMA_OTA_V1, seq_++, payload, sizeof(h) + h.len, frame + 1, MAX_FRAME);
+      if (!n || !writeAll(fd, frame, n + 1)) return false;
+      st_.wireBytes += n + 1;
+      st_.frames++;
+      if (o_.rate > 0) {
+        const double ahead = (double)st_.wireBytes / o_.rate - since(t0_);
+        if (ahead > 0) usleep((useconds_t)(ahead * 1e6));
+      }
+    }
+    st_.chunksSent++;
+    return true;
+  }
+
+  SendResult transfer(int fd) {
+    const uint32_t chunks = (uint32_t)img_.chunks.size();
+    progress_ = Clock::now();
+    Clock::time_point heard = progress_;
+    uint32_t lastStored = st_.stored;
+    int shown = -1;
+
+    while (!done_ && !failed_ && !g_stop) {
+      const bool canSend = next_ < chunks && next_ < st_.stored + o_.window;
+      if (canSend && !sendChunk(fd, next_++)) return SendResult::Incomplete;
+      const uint32_t before = st_.stored;
+      if (!rd_.poll(fd, canSend ? 0 : 50, [&](const std::string& l) { heard = Clock::now(); onLine(l); }))
+        return SendResult::Incomplete;
+      if (st_.stored != before) lastStored = st_.stored;
+
+      if (since(progress_) > STALL_S) {
+        // lost the tail of a window, or the report of it
+        st_.stalls++;
+        next_ = st_.stored;
+        progress_ = Clock::now();
+      }
+      if (since(heard) > o_.timeout) {
+        std::fprintf(stderr, "\ntimeout\n");
+        return SendResult::Incomplete;
+      }
+      const int pct = (int)(100.0 * lastStored / chunks);
+      if (pct != shown && isatty(2)) {
+        std::fprintf(stderr, "\r%u/%u chunks  %d%%", lastStored, chunks, pct);
+        shown = pct;
+      }
+    }
+    if (shown >= 0 && isatty(2)) std::fprintf(stderr, "\n");
+    if (failed_) {
+      std::fprintf(stderr, "device failed: %s\n", failWhy_.c_str());
+      return SendResult::Failed;
+    }
+    return done_ ? SendResult::Done : SendResult::Incomplete;
+  }
+
+  const Image&      img_;
+  const SendOpts    o_;
+  SendStats         st_;
+  LineReader        rd_;
+  uint32_t          next_ = 0;      // next chunk to send
+  uint16_t          seq_ = 0;
+  bool              done_ = false;
+  bool              failed_ = false;
+  std::string       failWhy_;
+  Clock::time_point t0_;
+  Clock::time_point progress_;
+};
+
+static void printStats(const Image& img, const SendStats& s, bool done) {
+  const double mb = img.data.size() / 1e6;
+  std::fprintf(stderr,
+               "image %zu bytes, %zu chunks, packed %.1f%%, crc %08x\n"
+               "%.2f s  %.1f kB/s image  %.1f kB/s wire  frames %u  chunks sent %u (resumed at %u)"
+               "  rewinds %u  stalls %u%s\n",
+               img.data.size(), img.chunks.size(), 100.0 * img.packedBytes / img.data.size(), img.crc,
+               s.seconds, s.seconds > 0 ? mb * 1e3 / s.seconds : 0.0,
+               s.seconds > 0 ? s.wireBytes / 1e3 / s.seconds : 0.0, s.frames, s.chunksSent,
+               s.resumedAt, s.rewinds, s.stalls, done ? "" : "  (incomplete - run again to resume)");
+}
+
+// ------------------------------------------------------------
+// Bench: device model
+// ------------------------------------------------------------
+struct BenchOpts {
+  double   linkBps = 80000;    // host -> device, bytes/s
+  double   latencyMs = 20;
+  size_t   rxQueue = 512;      // BluetoothSerial RX queue
+  double   pollMs = 1;         // cmd task period while receiving
+  double   eraseMs = 45;       // 4 KB sector erase
+  double   progMs = 0.7;       // 256-byte page program
+  double   gapMs = 20;         // OtaMgr ota_gap_ms
+  bool     stall = true;       // the loop waits while flash runs (cache off)
+  double   dropAt = 0;         // cut the link once at this fraction of the image, 0 = never
+};
+
+static void sleepMs(double ms) {
+  if (ms > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+}
+
+// App slot in a file, with NOR semantics and flash timing
+class FileFlash : public OtaImg::FlashIf {
+public:
+  FileFlash(int fd, size_t size, const BenchOpts& o, std::atomic<bool>& busy)
+    : fd_(fd), size_(size), o_(o), busy_(busy) {}
+  size_t size() const override { return size_; }
+  bool erase(size_t off, size_t len) override {
+    if (off % OtaImg::CHUNK || len % OtaImg::CHUNK || off + len > size_) return false;
+    std::vector<uint8_t> ff(len, 0xFF);
+    busy_ = true;
+    sleepMs(o_.eraseMs * len / OtaImg::CHUNK);
+    busy_ = false;
+    return pwrite(fd_, ff.data(), len, (off_t)off) == (ssize_t)len;
+  }
+  bool write(size_t off, const void* src, size_t len) override {
+    if (off + len > size_) return false;
+    std::vector<uint8_t> cur(len);
+    if (pread(fd_, cur.data(), len, (off_t)off) != (ssize_t)len) return false;
+    const uint8_t* b = (const uint8_t*)src;
+    for (size_t i = 0; i < len; i++) cur[i] &= b[i];   // can only clear bits
+    busy_ = true;
+    sleepMs(o_.progMs * ((len + 255) / 256));
+    busy_ = false;
+    return pwrite(fd_, cur.data(), len, (off_t)off) == (ssize_t)len;
+  }
+  bool read(size_t off, void* dst, size_t len) override {
+    return off + len <= size_ && pread(fd_, dst, len, (off_t)off) == (ssize_t)len;
+  }
+
+private:
+  int fd_;
+  size_t size_;
+  const BenchOpts& o_;
+  std::atomic<bool>& busy_;
+};
+
+// OtaMgr's receive path with the BT link, the flash and the writer task
+// replaced by the pieces above. Lives across link drops, like the device.
+class BenchDevice {
+public:
+  static constexpr size_t   SLOT_SIZE = 0x180000;
+  static constexpr uint32_t SAVE_EVERY = 16;
+
+  struct Stats {
+    uint64_t rxBytes = 0;
+    uint64_t rxDrops = 0;       // did not fit the RX queue
+    uint32_t flashStallMs = 0;
+  };
+
+  BenchDevice(int slotFd, const BenchOpts& o) : o_(o), flash_(slotFd, SLOT_SIZE, o, flashBusy_) {
+    writer_ = std::thread([this] { writerLoop(); });
+  }
+  ~BenchDevice() {
+    quit_ = true;
+    if (writer_.joinable()) writer_.join();
+  }
+
+  // Runs the link and the loop until the host end closes or `cut` bytes
+  // went through (then drops the link). sock is the device end.
+  void connect(int sock, uint64_t cut) {
+    std::deque<std::pair<Clock::time_point, uint8_t>> inFlight;
+    std::mutex mu;
+    std::atomic<bool> linkUp(true);
+
+    // sender -> air: serialises at linkBps, delivered latencyMs later
+    std::thread air([&] {
+      Clock::time_point txEnd = Clock::now();
+      uint64_t moved = 0;
+      uint8_t buf[64];
+      while (linkUp && !quit_) {
+        pollfd p = { sock, POLLIN, 0 };
+        if (::poll(&p, 1, 20) <= 0) continue;
+        const ssize_t n = ::read(sock, buf, sizeof(buf));
+        if (n <= 0) break;
+        txEnd = std::max(txEnd, Clock::now()) +
+                std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(n / o_.linkBps));
+        std::this_thread::sleep_until(txEnd);
+        const Clock::time_point at =
+            txEnd + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(o_.latencyMs));
+        {
+          std::lock_guard<std::mutex> l(mu);
+          for (ssize_t i = 0; i < n; i++) inFlight.push_back({ at, buf[i] });
+        }
+        moved += (uint64_t)n;
+        if (cut && moved >= cut) break;
+      }
+      linkUp = false;
+    });
+
+    // the loop: the cmd task's poll, OtaMgr::service()
+    std::deque<uint8_t> rxq;
+    sock_ = sock;
+    const Clock::duration tickLen =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(o_.pollMs));
+    Clock::time_point tick = Clock::now();
+    double stalledMs = 0;
+    while (linkUp && !quit_) {
+      sleepMs(o_.pollMs);
+      const Clock::time_point now = Clock::now();
+      const bool stalled = o_.stall && flashBusy_;
+      // one pass per poll period; a late wakeup (host scheduling) catches
+      // up period by period, so only the device's own stalls fill the queue
+      for (; tick + tickLen <= now; tick += tickLen) {
+        {
+          // bytes land in the RX queue whether the loop runs or not
+          std::lock_guard<std::mutex> l(mu);
+          while (!inFlight.empty() && inFlight.front().first <= tick + tickLen) {
+            if (rxq.size() < o_.rxQueue) rxq.push_back(inFlight.front().second);
+            else                         stats_.rxDrops++;
+            inFlight.pop_front();
+          }
+        }
+        if (stalled) { stalledMs += o_.pollMs; continue; }
+        while (!rxq.empty()) {
+          rxByte(rxq.front());
+          rxq.pop_front();
+        }
+      }
+      if (!stalled) pump();
+    }
+    stats_.flashStallMs += (uint32_t)stalledMs;
+    linkUp = false;
+    air.join();
+    shutdown(sock, SHUT_RDWR);
+
+    // BtMgr drops a torn frame; OtaMgr parks the session once the writer is done
+    if (inFrame_) dec_.push(0x00);
+    inFrame_ = false;
+    frameLen_ = 0;
+    line_.clear();
+    while (busy_ || collect_) { sleepMs(1); pump(); }
+    rxState_ = false;
+  }
+
+  const Stats& stats() const { return stats_; }
+  const OtaImg::Receiver& rx() const { return rx_; }
+  bool ready() const { return ready_; }
+
+private:
+  void reply(const std::string& s) {
+    const std::string l = s + "\n";
+    writeAll(sock_, l.data(), l.size());
+  }
+
+  void report(const char* err) {
+    char b[128];
+    std::snprintf(b, sizeof(b), "{\"ver\":1,\"ota\":{\"state\":\"%s\",\"stored\":%u,\"next\":%u%s%s%s}}",
+                  ready_ ? "ready" : failed_ ? "failed" : verifying_ ? "verify" : "rx",
+                  stored_, rx_.next(), err ? ",\"err\":\"" : "", err ? err : "", err ? "\"" : "");
+    reply(b);
+  }
+
+  // BtMgr::readLine: 0x00 opens a frame, the frame's own 0x00 closes it
+  void rxByte(uint8_t c) {
+    stats_.rxBytes++;
+    if (inFrame_) {
+      if (c == 0x00 && frameLen_ == 0) return;
+      frameLen_++;
+      if (dec_.push(c)) onFrame();
+      if (c == 0x00) { inFrame_ = false; frameLen_ = 0; }
+      return;
+    }
+    if (c == 0x00) { inFrame_ = true; line_.clear(); return; }
+    if (c == '\n') { onCommand(line_); line_.clear(); return; }
+    if (c != '\r' && line_.size() < 255) line_.push_back((char)c);
+  }
+
+  void onCommand(const std::string& l) {
+    if (l.find("\"cmd\":\"ota\"") == std::string::npos) return;
+    const std::string op = jsonStr(l, "op");
+    char b[256];
+    if (op == "begin") {
+      long long size = 0, crc = 0;
+      if (busy_ || collect_ || verifying_) { reply("{\"ver\":1,\"ack\":\"ota\",\"err\":6,\"msg\":\"busy\"}"); return; }
+      if (!jsonNum(l, "size", size) || !jsonNum(l, "crc", crc) || size <= 0 || size > (long long)SLOT_SIZE) {
+        reply("{\"ver\":1,\"ack\":\"ota\",\"err\":5,\"msg\":\"range\"}");
+        return;
+      }
+      if (sessSize_ != (uint32_t)size || sessCrc_ != (uint32_t)crc) {
+        sessSize_ = (uint32_t)size;
+        sessCrc_ = (uint32_t)crc;
+        stored_ = 0;
+      }
+      rx_.begin(sessSize_, stored_);
+      nakSent_ = false;
+      failed_ = ready_ = false;
+      rxState_ = true;
+      if (stored_ == rx_.chunks()) verifying_ = true;
+      std::snprintf(b, sizeof(b), "{\"ver\":1,\"ack\":\"ota\",\"err\":0,\"msg\":\"ok\",\"slot\":\"bench\","
+                    "\"chunk\":%zu,\"piece\":%zu,\"chunks\":%u,\"next\":%u}",
+                    OtaImg::CHUNK, OTA_PIECE_MAX, rx_.chunks(), stored_);
+      reply(b);
+    } else if (op == "reboot") {
+      reply(ready_ ? "{\"ver\":1,\"ack\":\"ota\",\"err\":0,\"msg\":\"ok\"}"
+                   : "{\"ver\":1,\"ack\":\"ota\",\"err\":6,\"msg\":\"busy\"}");
+    } else {
+      std::snprintf(b, sizeof(b), "{\"ver\":1,\"ack\":\"ota\",\"err\":0,\"msg\":\"ok\",\"stored\":%u,\"next\":%u}",
+                    stored_, rx_.next());
+      reply(b);
+    }
+  }
+
+  void onFrame() {
+    if (dec_.schema() != SCHEMA_OTA_V1 || !rxState_ || verifying_ || ready_ || failed_) return;
+    using OtaImg::Result;
+    const Result r = rx_.push(dec_.payload(), dec_.payloadLen());
+    switch (r) {
+      case Result::Piece:
+      case Result::Chunk:
+      case Result::Held:
+        nakSent_ = false;
+        break;
+      case Result::Dup:
+        break;
+      default:
+        if (!nakSent_) report(OtaImg::resultName(r));
+        nakSent_ = true;
+        break;
+    }
+    pump();
+  }
+
+  // ---- writer handshake, as OtaMgr ----
+  enum class Job { Write, Verify };
+
+  void startJob(Job j) {
+    job_ = j;
+    collect_ = true;
+    done_ = false;
+    busy_ = true;
+  }
+
+  void pump() {
+    if (collect_ && done_) {
+      collect_ = false;
+      if (job_ == Job::Verify) {
+        verifying_ = false;
+        if (jobOk_) ready_ = true;
+        else        failed_ = true;
+        report(jobOk_ ? nullptr : "verify");
+      } else if (!jobOk_) {
+        failed_ = true;
+        report("flash");
+      } else {
+        stored_ = jobIdx_ + 1;
+        const OtaImg::Result r = rx_.release();
+        if (stored_ == rx_.chunks()) verifying_ = true;
+        report(r == OtaImg::Result::Bad ? "bad" : nullptr);
+      }
+    }
+    if (collect_ || busy_) return;
+    if (verifying_) {
+      startJob(Job::Verify);
+    } else if (rxState_ && !failed_ && !ready_ && rx_.ready()) {
+      jobIdx_ = rx_.chunkIdx();
+      jobLen_ = rx_.chunkLen();
+      startJob(Job::Write);
+    }
+  }
+
+  void writerLoop() {
+    static uint8_t buf[1024];
+    while (!quit_) {
+      if (!busy_) { sleepMs(0.2); continue; }
+      if (job_ == Job::Write) {
+        jobOk_ = OtaImg::writeChunk(flash_, jobIdx_, rx_.chunk(), jobLen_);
+        done_ = true;
+        sleepMs(o_.gapMs);
+      } else {
+        uint32_t crc = 0;
+        jobOk_ = OtaImg::readCrc(flash_, sessSize_, buf, sizeof(buf), crc) && crc == sessCrc_;
+        done_ = true;
+      }
+      busy_ = false;
+    }
+  }
+
+  const BenchOpts&  o_;
+  std::atomic<bool> flashBusy_{ false };
+  FileFlash         flash_;
+  OtaImg::Receiver  rx_;
+  Decoder           dec_;
+  Stats             stats_;
+  int               sock_ = -1;
+  bool              inFrame_ = false;
+  size_t            frameLen_ = 0;
+  std::string       line_;
+
+  uint32_t sessSize_ = 0, sessCrc_ = 0, stored_ = 0;
+  bool     rxState_ = false, nakSent_ = false;
+  bool     verifying_ = false, ready_ = false, failed_ = false;
+
+  std::atomic<bool> done_{ false };    // before the writer's pause
+  std::atomic<bool> busy_{ false };
+  std::atomic<bool> quit_{ false };
+  bool              collect_ = false;
+  Job               job_ = Job::Write;
+  uint32_t          jobIdx_ = 0;
+  size_t            jobLen_ = 0;
+  std::atomic<bool> jobOk_{ false };
+  std::thread       writer_;
+};
+
+static int runBench(const char* path, const SendOpts& so, const BenchOpts& bo) {
+  Image img;
+  if (!loadImage(path, true, img)) return 1;
+  if (img.data.size() > BenchDevice::SLOT_SIZE) {
+    std::fprintf(stderr, "%s: larger than the slot (%zu bytes)\n", path, BenchDevice::SLOT_SIZE);
+    return 1;
+  }
+
+  char slotPath[] = "/tmp/ota_slot_XXXXXX";
+  const int slotFd = mkstemp(slotPath);
+  if (slotFd < 0 || ftruncate(slotFd, BenchDevice::SLOT_SIZE) != 0) { std::perror("slot"); return 1; }
+  unlink(slotPath);
+
+  std::printf("bench: %s, link %.0f B/s %.0f ms, rx queue %zu, poll %.1f ms, erase %.0f ms, "
+              "page %.1f ms, gap %.0f ms, stall %s, window %u, rate %.0f\n",
+              path, bo.linkBps, bo.latencyMs, bo.rxQueue, bo.pollMs, bo.eraseMs, bo.progMs, bo.gapMs,
+              bo.stall ? "on" : "off", so.window, so.rate);
+
+  BenchDevice dev(slotFd, bo);
+  SendStats total;
+  SendResult res = SendResult::Incomplete;
+  uint64_t cut = bo.dropAt > 0 ? (uint64_t)(img.packedBytes * bo.dropAt) : 0;
+  for (int run = 0; run < 4 && res == SendResult::Incomplete && !g_stop; run++) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) { std::perror("socketpair"); return 1; }
+    // a small send buffer, so the window and the link pace the sender
+    const int sndbuf = 4096;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    std::thread link([&] { dev.connect(sv[1], cut); });
+
+    Sender s(img, so);
+    res = s.run(sv[0]);
+    shutdown(sv[0], SHUT_RDWR);
+    link.join();
+    close(sv[0]);
+    close(sv[1]);
+
+    const SendStats& st = s.stats();
+    std::printf("run %d: %s at chunk %u, stored %u, %.2f s, wire %llu bytes, rewinds %u, stalls %u\n",
+                run + 1, res == SendResult::Done ? "done" : res == SendResult::Failed ? "failed" : "cut",
+                st.resumedAt, st.stored, st.seconds, (unsigned long long)st.wireBytes, st.rewinds, st.stalls);
+    total.seconds += st.seconds;
+    total.wireBytes += st.wireBytes;
+    total.frames += st.frames;
+    total.chunksSent += st.chunksSent;
+    total.rewinds += st.rewinds;
+    total.stalls += st.stalls;
+    cut = 0;
+  }
+
+  // the slot must now hold the image, byte for byte
+  std::vector<uint8_t> back(img.data.size());
+  const bool same = pread(slotFd, back.data(), back.size(), 0) == (ssize_t)back.size() && back == img.data;
+  close(slotFd);
+
+  const OtaImg::Stats& rs = dev.rx().stats();
+  const BenchDevice::Stats& ds = dev.stats();
+  std::printf("image %zu bytes in %zu chunks, packed %.1f%%\n"
+              "%.2f s  %.1f kB/s image  %.1f kB/s wire (link %.1f kB/s)\n"
+              "frames %u  chunks sent %u (%.2fx)  rewinds %u  stalls %u\n"
+              "device: rx %llu bytes, queue drops %llu, loop stalled %u ms, pieces %u dups %u gaps %u bad %u\n"
+              "slot %s the image\n",
+              img.data.size(), img.chunks.size(), 100.0 * img.packedBytes / img.data.size(),
+              total.seconds, img.data.size() / 1e3 / total.seconds, total.wireBytes / 1e3 / total.seconds,
+              bo.linkBps / 1e3, total.frames, total.chunksSent,
+              (double)total.chunksSent / img.chunks.size(), total.rewinds, total.stalls,
+              (unsigned long long)ds.rxBytes, (unsigned long long)ds.rxDrops, ds.flashStallMs,
+              rs.pieces, rs.dups, rs.gaps, rs.bad, same ? "matches" : "DOES NOT MATCH");
+  return res == SendResult::Done && same ? 0 : 1;
+}
+
+// ------------------------------------------------------------
+
+static void usage(const char* p) {
+  std::fprintf(stderr,
+               "usage: %s [-w window] [-r bytes_per_s] [-t timeout_s] [-f] [-R] <firmware.bin> <port>\n"
+               "       %s -i <port>\n"
+               "       %s -B [-w window] [-r bytes_per_s] [-b link_Bps] [-l latency_ms] [-q rx_queue]\n"
+               "             [-p poll_ms] [-e erase_ms] [-g gap_ms] [-S] [-x drop_at] [image]\n",
+               p, p, p);
+}
+
+int main(int argc, char** argv) {
+  SendOpts so;
+  BenchOpts bo;
+  bool force = false, info = false, bench = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "w:r:t:fRiBb:l:q:p:e:g:Sx:")) != -1) {
+    switch (opt) {
+      case 'w': so.window = (uint32_t)std::max(1, std::atoi(optarg)); break;
+      case 'r': so.rate = std::atof(optarg); break;
+      case 't': so.timeout = std::atof(optarg); break;
+      case 'f': force = true; break;
+      case 'R': so.reboot = true; break;
+      case 'i': info = true; break;
+      case 'B': bench = true; break;
+      case 'b': bo.linkBps = std::max(1000.0, std::atof(optarg)); break;
+      case 'l': bo.latencyMs = std::atof(optarg); break;
+      case 'q': bo.rxQueue = (size_t)std::atol(optarg); break;
+      case 'p': bo.pollMs = std::max(0.1, std::atof(optarg)); break;
+      case 'e': bo.eraseMs = std::atof(optarg); break;
+      case 'g': bo.gapMs = std::atof(optarg); break;
+      case 'S': bo.stall = false; break;
+      case 'x': bo.dropAt = std::atof(optarg); break;
+      default: usage(argv[0]); return 2;
+    }
+  }
+  std::signal(SIGINT, onSigint);
+  std::signal(SIGPIPE, SIG_IGN);   // a dropped link shows up as a failed write
+
+  if (bench) return runBench(optind < argc ? argv[optind] : "/proc/self/exe", so, bo);
+
+  const char* image = nullptr;
+  const char* port = nullptr;
+  if (info && optind < argc) port = argv[optind];
+  else if (!info && optind + 1 < argc) { image = argv[optind]; port = argv[optind + 1]; }
+  if (!port) { usage(argv[0]); return 2; }
+
+  int fd = open(port, O_RDWR | O_NOCTTY);
+  if (fd < 0) { std::perror(port); return 1; }
+  if (isatty(fd)) makeRaw(fd);
+
+  if (info) {
+    sendLine(fd, "{\"cmd\":\"ota\"}");
+    LineReader rd;
+    bool got = false;
+    const Clock::time_point t = Clock::now();
+    while (!got && since(t) < so.timeout && rd.poll(fd, 100, [&](const std::string& l) {
+             if (l.find("\"ack\":\"ota\"") != std::string::npos) { std::printf("%s\n", l.c_str()); got = true; }
+           })) {}
+    close(fd);
+    return got ? 0 : 1;
+  }
+
+  Image img;
+  if (!loadImage(image, force, img)) return 1;
+  Sender s(img, so);
+  const SendResult r = s.run(fd);
+  close(fd);
+  printStats(img, s.stats(), r == SendResult::Done);
+  if (r == SendResult::Done) std::fprintf(stderr, so.reboot ? "rebooting into the new image\n"
+                                                            : "ready: {\"cmd\":\"ota\",\"op\":\"reboot\"} starts it\n");
+  return r == SendResult::Done ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+// prof_view - fetch and render the firmware's profiler zones (ProfMgr)
+//
+//   prof_view [-r] [-c] [-t timeout_s] <port>   ask the device ({"cmd":"prof"})
+//   prof_view [-c] -f acks.txt                  render saved "prof" ack lines
+//
+// Prints one block per zone: count, min / avg / max and the log2
+// histogram as bars, in µs (-c: raw cycles). -r clears the counters on
+// the device after reading them.
+
+#include "json_tok.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace JsonTok;
+
+struct ZoneRow {
+  std::string           name;
+  unsigned long         n = 0, minCyc = 0, avgCyc = 0, maxCyc = 0;
+  unsigned              b0 = 0;
+  std::vector<unsigned long> hist;
+};
+
+struct Dump {
+  unsigned long        mhz = 240, ovhCyc = 0, biasCyc = 0;
+  long                 next = -1;
+  std::vector<ZoneRow> zones;
+};
+
+static bool s_cycles = false;
+
+static void makeRaw(int fd) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0) return;
+  cfmakeraw(&t);
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &t);
+}
+
+static bool sendLine(int fd, const std::string& s) {
+  std::string l = s + "\n";
+  return write(fd, l.data(), l.size()) == (ssize_t)l.size();
+}
+
+static unsigned long num(const char* s, const Token& t) {
+  long v = 0;
+  return toLong(s, t, v) && v > 0 ? (unsigned long)v : 0;
+}
+
+// One {"ack":"prof",...} line into d (zones appended). False if it is not one.
+static bool parseAck(std::string line, Dump& d) {
+  if (line.find("\"ack\":\"prof\"") == std::string::npos) return false;
+  static Token toks[512];
+  char* s = &line[0];
+  const int n = parse(s, line.size(), toks, 512);
+  if (n <= 0 || toks[0].type != OBJECT) return false;
+
+  int i;
+  if ((i = find(s, toks, n, 0, "err")) >= 0 && num(s, toks[i]) != 0) {
+    std::fprintf(stderr, "device refused: %s\n", line.c_str());
+    return false;
+  }
+  if ((i = find(s, toks, n, 0, "mhz")) >= 0)      d.mhz = num(s, toks[i]);
+  if ((i = find(s, toks, n, 0, "ovh_cyc")) >= 0)  d.ovhCyc = num(s, toks[i]);
+  if ((i = find(s, toks, n, 0, "bias_cyc")) >= 0) d.biasCyc = num(s, toks[i]);
+  d.next = -1;
+  if ((i = find(s, toks, n, 0, "next")) >= 0)     d.next = (long)num(s, toks[i]);
+
+  const int zs = find(s, toks, n, 0, "zones");
+  if (zs < 0 || toks[zs].type != ARRAY) return true;
+  int z = zs + 1;
+  for (unsigned k = 0; k < toks[zs].size; k++, z = skip(toks, n, z)) {
+    if (toks[z].type != ARRAY || toks[z].size < 7) continue;
+    ZoneRow r;
+    int e = z + 1;
+    r.name   = s + toks[e].start;  e++;
+    r.n      = num(s, toks[e++]);
+    r.minCyc = num(s, toks[e++]);
+    r.avgCyc = num(s, toks[e++]);
+    r.maxCyc = num(s, toks[e++]);
+    r.b0     = (unsigned)num(s, toks[e++]);
+    if (toks[e].type == ARRAY) {
+      for (unsigned h = 0; h < toks[e].size; h++) r.hist.push_back(num(s, toks[e + 1 + h]));
+    }
+    d.zones.push_back(r);
+  }
+  return true;
+}
+
+static void fmtTime(char* buf, size_t cap, double cyc, unsigned long mhz) {
+  if (s_cycles || !mhz) std::snprintf(buf, cap, "%.0f cyc", cyc);
+  else                  std::snprintf(buf, cap, "%.2f us", cyc / mhz);
+}
+
+static void render(const Dump& d) {
+  char a[32], b[32], c[32];
+  fmtTime(a, sizeof(a), d.ovhCyc, d.mhz);
+  fmtTime(b, sizeof(b), d.biasCyc, d.mhz);
+  std::printf("cpu %lu MHz   zone overhead %s%s   bias %s (included in every sample)\n\n",
+              d.mhz, a, (d.mhz && d.ovhCyc >= d.mhz) ? " (over 1 us!)" : "", b);
+
+  static const int BAR = 40;
+  for (const ZoneRow& z : d.zones) {
+    fmtTime(a, sizeof(a), z.minCyc, d.mhz);
+    fmtTime(b, sizeof(b), z.avgCyc, d.mhz);
+    fmtTime(c, sizeof(c), z.maxCyc, d.mhz);
+    std::printf("%-12s n %-9lu min %-12s avg %-12s max %s\n", z.name.c_str(), z.n, a, b, c);
+    if (!z.n) { std::printf("\n"); continue; }
+
+    unsigned long top = 1;
+    for (unsigned long h : z.hist) top = std::max(top, h);
+    for (size_t k = 0; k < z.hist.size(); k++) {
+      const unsigned bucket = z.b0 + (unsigned)k;
+      fmtTime(a, sizeof(a), std::ldexp(1.0, (int)bucket), d.mhz);
+      fmtTime(b, sizeof(b), std::ldexp(1.0, (int)bucket + 1), d.mhz);
+      const int w = (int)((z.hist[k] * BAR + top - 1) / top);
+      std::printf("  %12s .. %-12s |%-*.*s| %9lu %5.1f%%\n", a, b, BAR, w,
+                  "########################################", z.hist[k],
+                  100.0 * z.hist[k] / z.n);
+    }
+    std::printf("\n");
+  }
+}
+
+// Sends one request and waits for its ack line
+static bool request(int fd, const std::string& cmd, double timeout, Dump& d) {
+  if (!sendLine(fd, cmd)) { std::perror("write"); return false; }
+  std::string line;
+  const auto t0 = std::chrono::steady_clock::now();
+  char buf[1024];
+  while (std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() < timeout) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 100) <= 0) continue;
+    const ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) return false;
+    for (ssize_t i = 0; i < n; i++) {
+      const char ch = buf[i];
+      if (ch == '\n') {
+        if (parseAck(line, d)) return true;
+        line.clear();
+      } else if (ch == 0) {
+        line.clear();                  // binary telemetry frame delimiter
+      } else if (line.size() < 4096) {
+        line.push_back(ch);
+      }
+    }
+  }
+  std::fprintf(stderr, "timeout\n");
+  return false;
+}
+
+int main(int argc, char** argv) {
+  const char* file = nullptr;
+  bool reset = false;
+  double timeout = 5.0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "rct:f:")) != -1) {
+    switch (opt) {
+      case 'r': reset = true; break;
+      case 'c': s_cycles = true; break;
+      case 't': timeout = std::atof(optarg); break;
+      case 'f': file = optarg; break;
+      default: break;
+    }
+  }
+
+  Dump d;
+  if (file) {
+    FILE* f = std::fopen(file, "r");
+    if (!f) { std::perror(file); return 1; }
+    char buf[4096];
+    while (std::fgets(buf, sizeof(buf), f)) {
+      std::string l(buf);
+      while (!l.empty() && (l.back() == '\n' || l.back() == '\r')) l.pop_back();
+      parseAck(l, d);
+    }
+    std::fclose(f);
+    render(d);
+    return 0;
+  }
+
+  const char* port = (optind < argc) ? argv[optind] : nullptr;
+  if (!port) {
+    std::fprintf(stderr, "usage: %s [-r] [-c] [-t timeout_s] <port>\n"
+                         "       %s [-c] -f acks.txt\n", argv[0], argv[0]);
+    return 2;
+  }
+  int fd = open(port, O_RDWR | O_NOCTTY);
+  if (fd < 0) { std::perror(port); return 1; }
+  if (isatty(fd)) makeRaw(fd);
+
+  long from = 0;
+  do {
+    char cmd[64];
+    std::snprintf(cmd, sizeof(cmd), "{\"cmd\":\"prof\",\"from\":%ld}", from);
+    if (!request(fd, cmd, timeout, d)) { close(fd); return 1; }
+    from = d.next;
+  } while (from > 0);
+
+  if (reset) {
+    Dump ignored;
+    request(fd, "{\"cmd\":\"prof\",\"reset\":1}", timeout, ignored);
+  }
+  close(fd);
+  render(d);
+  return 0;
+}
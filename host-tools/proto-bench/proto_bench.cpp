@@ -0,0 +1,370 @@
+// proto_bench - round-trip checks and benchmark of the firmware's TlmProto
+//
+//   proto_bench [-n frames] [-s seed] [-c]
+//
+// Checks first (exit status 1 if any fails):
+//   crc16     the CRC-16/CCITT-FALSE check value
+//   cobs      encode/decode of zero runs, 253..255 and 508 byte blocks
+//             without zeros, random buffers; no 0x00 in the output,
+//             length within cobsMaxLen(), decode in place
+//   frame     every payload length 0..MAX_PAYLOAD through encodeFrame()
+//             and Decoder, byte by byte; oversize payloads refused
+//   crc       a frame with a wrong CRC, and every single data byte of a
+//             frame changed to every other non-zero value: none may pass
+//   resync    garbage, empty frames and an overrun ahead of a good frame
+//   scale     toU16/toI16 rounding, saturation, NaN, INT16_MIN kept free
+//
+// Then the bench (-c: checks only): the FullV1 frame against the JSON
+// line with the same fields (the shape of main.cpp's encodeJsonFull),
+// encode ns, bytes on air and decode ns, decode done by TlmProto::Decoder
+// and by JsonTok + strtof.
+
+#include "tlm_proto.h"
+#include "json_tok.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace TlmProto;
+
+static uint32_t s_fails = 0;
+
+static void check(bool ok, const char* what, size_t arg = 0) {
+  if (ok) return;
+  if (s_fails < 20) std::fprintf(stderr, "FAIL %s (%zu)\n", what, arg);
+  s_fails++;
+}
+
+static uint32_t s_rng = 1;
+static uint32_t rnd() {
+  s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+static uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------------
+// Checks
+// ------------------------------------------------------------
+static void cobsRoundTrip(const uint8_t* in, size_t len, const char* what) {
+  std::vector<uint8_t> enc(cobsMaxLen(len)), dec(len + 1);
+  const size_t n = cobsEncode(in, len, enc.data(), enc.size());
+  check(n > 0 && n <= cobsMaxLen(len), what, len);
+  check(std::memchr(enc.data(), 0, n) == nullptr, what, len);
+  check(cobsEncode(in, len, enc.data(), cobsMaxLen(len) - 1) == 0, "cobs short out", len);
+
+  const size_t m = cobsDecode(enc.data(), n, dec.data(), dec.size());
+  check(m == len && std::memcmp(in, dec.data(), len) == 0, what, len);
+  const size_t k = cobsDecode(enc.data(), n, enc.data(), enc.size());   // in place
+  check(k == len && std::memcmp(in, enc.data(), len) == 0, "cobs in place", len);
+}
+
+static void checkCobs() {
+  uint8_t buf[1200];
+
+  for (size_t len = 0; len <= 600; len++) {           // zero runs
+    std::memset(buf, 0, len);
+    cobsRoundTrip(buf, len, "cobs zeros");
+  }
+  static const size_t BLOCKS[] = { 1, 253, 254, 255, 507, 508, 509, 1016 };
+  for (size_t len : BLOCKS) {                         // no zeros: 254-byte blocks
+    for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)(1 + i % 255);
+    cobsRoundTrip(buf, len, "cobs block");
+    buf[len] = 0;                                     // block, then a zero
+    cobsRoundTrip(buf, len + 1, "cobs block+0");
+    buf[0] = 0;                                       // zero, then a block
+    cobsRoundTrip(buf, len, "cobs 0+block");
+  }
+  for (int r = 0; r < 2000; r++) {                    // random, zero-heavy
+    const size_t len = rnd() % sizeof(buf);
+    for (size_t i = 0; i < len; i++) buf[i] = (rnd() & 3) ? (uint8_t)rnd() : 0;
+    cobsRoundTrip(buf, len, "cobs random");
+  }
+
+  static const uint8_t BAD[][3] = { { 0x03, 0x11, 0x00 }, { 0x05, 0x11, 0x22 } };
+  check(cobsDecode(BAD[0], 3, buf, sizeof(buf)) == 0, "cobs zero inside", 0);
+  check(cobsDecode(BAD[1], 3, buf, sizeof(buf)) == 0, "cobs short block", 1);
+}
+
+static bool feed(Decoder& d, const uint8_t* p, size_t n) {
+  bool got = false;
+  for (size_t i = 0; i < n; i++) {
+    if (d.push(p[i])) { check(i == n - 1, "frame early", i); got = true; }
+  }
+  return got;
+}
+
+static void checkFrames() {
+  uint8_t payload[MAX_PAYLOAD + 1], frame[MAX_FRAME + 16];
+  Decoder d;
+  uint32_t want = 0;
+
+  for (size_t len = 0; len <= MAX_PAYLOAD; len++) {
+    const int pat = (int)(len % 3);     // zeros / no zeros / random
+    for (size_t i = 0; i < len; i++) {
+      payload[i] = pat == 0 ? 0 : pat == 1 ? (uint8_t)(1 + i % 255) : (uint8_t)rnd();
+    }
+    const uint16_t seq = (uint16_t)(len * 257);
+    const size_t n = encodeFrame((uint8_t)(len & 0xFF), seq, payload, len, frame, sizeof(frame));
+    check(n > 0 && n <= MAX_FRAME && frame[n - 1] == 0, "frame encode", len);
+    check(std::memchr(frame, 0, n - 1) == nullptr, "frame zero inside", len);
+
+    const bool got = feed(d, frame, n);
+    want++;
+    check(got && d.version() == PROTO_VER && d.schema() == (uint8_t)(len & 0xFF) &&
+          d.seq() == seq && d.payloadLen() == len &&
+          std::memcmp(d.payload(), payload, len) == 0, "frame round trip", len);
+  }
+  check(d.frames() == want && d.crcErrors() == 0 && d.badFrames() == 0, "frame counters", want);
+
+  check(encodeFrame(1, 0, payload, MAX_PAYLOAD + 1, frame, sizeof(frame)) == 0, "frame oversize", 0);
+  check(encodeFrame(1, 0, payload, 10, frame, 12) == 0, "frame short out", 0);
+}
+
+// Positions of the COBS code bytes of an encoded frame (the rest is data)
+static void codeBytes(const uint8_t* f, size_t n, std::vector<bool>& isCode) {
+  isCode.assign(n, false);
+  for (size_t i = 0; i < n && f[i] != 0; i += f[i]) isCode[i] = true;
+}
+
+static void checkCrc() {
+  // wrong CRC, COBS intact
+  uint8_t raw[HEADER_LEN + 8 + CRC_LEN] = { PROTO_VER, SCHEMA_FULL_V1, 1, 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+  const uint16_t crc = (uint16_t)(crc16(raw, HEADER_LEN + 8) ^ 0x0100);
+  raw[HEADER_LEN + 8] = (uint8_t)crc;
+  raw[HEADER_LEN + 9] = (uint8_t)(crc >> 8);
+  uint8_t frame[MAX_FRAME];
+  size_t n = cobsEncode(raw, sizeof(raw), frame, sizeof(frame));
+  frame[n++] = 0;
+  Decoder d;
+  check(!feed(d, frame, n) && d.crcErrors() == 1, "crc mismatch", d.crcErrors());
+
+  // each data byte of a FullV1 frame, changed to each other non-zero value
+  FullV1 r;
+  for (size_t i = 0; i < sizeof(r); i++) ((uint8_t*)&r)[i] = (i % 4) ? (uint8_t)(i * 37) : 0;
+  n = encodeFrame(SCHEMA_FULL_V1, 0x1234, &r, sizeof(r), frame, sizeof(frame));
+  std::vector<bool> isCode;
+  codeBytes(frame, n - 1, isCode);
+  Decoder e;
+  uint32_t tried = 0, passed = 0;
+  for (size_t i = 0; i + 1 < n; i++) {
+    if (isCode[i]) continue;
+    const uint8_t orig = frame[i];
+    for (int v = 1; v < 256; v++) {
+      if (v == orig) continue;
+      frame[i] = (uint8_t)v;
+      if (feed(e, frame, n)) passed++;
+      tried++;
+    }
+    frame[i] = orig;
+  }
+  check(passed == 0 && e.crcErrors() == tried, "crc single byte", passed);
+  check(feed(e, frame, n), "crc original", 0);
+}
+
+static void checkResync() {
+  uint8_t p[16] = { 1, 2, 3, 0, 0, 4 };
+  uint8_t frame[MAX_FRAME];
+  const size_t n = encodeFrame(SCHEMA_FULL_V1, 7, p, sizeof(p), frame, sizeof(frame));
+  Decoder d;
+
+  static const uint8_t junk[] = { 0x00, 0x00, 0x41, 0x42, 0x00, 0x02, 0x00 };   // empty, bad, short
+  feed(d, junk, sizeof(junk));
+  check(feed(d, frame, n) && d.seq() == 7, "resync after junk", 0);
+
+  for (size_t i = 0; i < MAX_FRAME + 10; i++) d.push(0x55);                     // overrun
+  d.push(0x00);
+  check(d.overruns() == 1, "overrun counted", d.overruns());
+  check(feed(d, frame, n) && d.payloadLen() == sizeof(p), "resync after overrun", 0);
+  check(d.frames() == 2 && d.badFrames() == 2, "resync counters", d.badFrames());
+}
+
+static void checkScale() {
+  check(toU16(1.2345f, 1000.0f) == 1235, "toU16 round", 0);
+  check(toU16(-1.0f, 1000.0f) == 0 && toU16(NAN, 1.0f) == 0, "toU16 low/nan", 0);
+  check(toU16(100.0f, 1000.0f) == 65535, "toU16 saturate", 0);
+  check(toI16(-1.2345f, 1000.0f) == -1235 && toI16(1.2345f, 1000.0f) == 1235, "toI16 round", 0);
+  check(toI16(-100.0f, 1000.0f) == -32767 && toI16(100.0f, 1000.0f) == 32767, "toI16 saturate", 0);
+  check(toI16(NAN, 1.0f) == 0, "toI16 nan", 0);
+}
+
+// ------------------------------------------------------------
+// Bench
+// ------------------------------------------------------------
+struct Sample {
+  uint32_t ms;
+  float vbat, soc, iload, ichg, idsg, temp, inet, fcc, rem;
+  uint8_t flags, uiLeft, pins;
+};
+
+static void makeSample(Sample& s, uint32_t i) {
+  s.ms = 1000u * i;
+  s.vbat = 3.6f + (i % 600) * 0.001f;
+  s.soc = 55.0f + (i % 100) * 0.1f;
+  s.iload = 0.5f + (i % 7) * 0.013f;
+  s.ichg = 0.0f;
+  s.idsg = s.iload + 0.021f;
+  s.temp = 25.0f + (i % 50) * 0.01f;
+  s.inet = -s.idsg;
+  s.fcc = 2000.0f;
+  s.rem = 1100.0f - i * 0.01f;
+  s.flags = 0;
+  s.uiLeft = 0;
+  s.pins = PIN_BIT_EN_DCDC | PIN_BIT_EN_LOAD_DSG;
+}
+
+static size_t encodeBin(const Sample& s, uint16_t seq, uint8_t* out, size_t cap) {
+  FullV1 r;
+  r.ms = s.ms;
+  r.vbat_mv = toU16(s.vbat, 1000.0f);
+  r.soc_x10 = toU16(s.soc, 10.0f);
+  r.iload_ma = toU16(s.iload, 1000.0f);
+  r.ichg_ma = toU16(s.ichg, 1000.0f);
+  r.idsg_ma = toU16(s.idsg, 1000.0f);
+  r.temp_cx100 = toI16(s.temp, 100.0f);
+  r.inet_ma = toI16(s.inet, 1000.0f);
+  r.fcc_mah = toU16(s.fcc, 1.0f);
+  r.rem_mah = toU16(s.rem, 1.0f);
+  r.flags = s.flags;
+  r.ui_left_s = s.uiLeft;
+  r.pins = s.pins;
+  return encodeFrame(SCHEMA_FULL_V1, seq, &r, sizeof(r), out, cap);
+}
+
+// The fields FullV1 carries, in the JSON line's layout (keys and number
+// formats as main.cpp's encodeJsonFull; its therm/energy/ir/adc objects
+// have no FullV1 counterpart and are left out)
+static size_t encodeJson(const Sample& s, char* out, size_t cap) {
+  const int n = std::snprintf(out, cap,
+    "{\"ver\":1,\"ms\":%lu,\"vbat\":%.3f,\"soc\":%.1f,\"iload\":%.3f,\"ichg\":%.3f,"
+    "\"idsg\":%.3f,\"temp\":%.2f,\"stat\":\"%s\",\"chg\":%d,\"ui_pending\":%d,"
+    "\"ui_left_s\":%u,\"inet\":%.3f,\"fcc\":%d,\"rem\":%d,\"pins\":{"
+    "\"en_charge\":%d,\"en_dcdc\":%d,\"en_relay\":%d,\"en_load_dsg\":%d,"
+    "\"en_bypass\":%d,\"chg_done\":%d,\"charging\":%d,\"btn_sleep\":%d}}\n",
+    (unsigned long)s.ms, s.vbat, s.soc, s.iload, s.ichg, s.idsg, s.temp,
+    (s.flags & FLAG_CHARGING) ? "Charging" : "Idle", (s.flags & FLAG_CHARGING) ? 1 : 0,
+    (s.flags & FLAG_UI_PENDING) ? 1 : 0, (unsigned)s.uiLeft, s.inet, (int)s.fcc, (int)s.rem,
+    (s.pins >> 0) & 1, (s.pins >> 1) & 1, (s.pins >> 2) & 1, (s.pins >> 3) & 1,
+    (s.pins >> 4) & 1, (s.pins >> 5) & 1, (s.pins >> 6) & 1, (s.pins >> 7) & 1);
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+// JSON decode: tokenize in place, convert every number, sum them so the
+// work is not optimised away
+static double decodeJson(char* line, size_t len) {
+  static JsonTok::Token toks[64];
+  const int n = JsonTok::parse(line, len, toks, 64);
+  double sum = 0;
+  for (int i = 0; i < n; i++) {
+    float v;
+    if (JsonTok::toFloat(line, toks[i], v)) sum += v;
+  }
+  return n > 0 ? sum : -1.0;
+}
+
+static double decodeBin(Decoder& d, const uint8_t* p, size_t n) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!d.push(p[i])) continue;
+    FullV1 r;
+    std::memcpy(&r, d.payload(), sizeof(r));
+    sum += r.vbat_mv + r.soc_x10 + r.iload_ma + r.idsg_ma + r.temp_cx100 + r.rem_mah;
+  }
+  return sum;
+}
+
+static void bench(uint32_t frames) {
+  std::vector<uint8_t> bin((size_t)frames * 40);
+  std::vector<char> json((size_t)frames * 400);
+  std::vector<uint32_t> jsonOff(frames + 1);
+  Sample s;
+  size_t binLen = 0, jsonLen = 0;
+
+  uint64_t t0 = nowNs();
+  for (uint32_t i = 0; i < frames; i++) {
+    makeSample(s, i);
+    binLen += encodeBin(s, (uint16_t)i, bin.data() + binLen, bin.size() - binLen);
+  }
+  const uint64_t binEnc = nowNs() - t0;
+
+  t0 = nowNs();
+  for (uint32_t i = 0; i < frames; i++) {
+    makeSample(s, i);
+    jsonOff[i] = (uint32_t)jsonLen;
+    jsonLen += encodeJson(s, json.data() + jsonLen, json.size() - jsonLen);
+  }
+  jsonOff[frames] = (uint32_t)jsonLen;
+  const uint64_t jsonEnc = nowNs() - t0;
+
+  Decoder d;
+  t0 = nowNs();
+  volatile double sink = decodeBin(d, bin.data(), binLen);
+  const uint64_t binDec = nowNs() - t0;
+  check(d.frames() == frames && d.crcErrors() == 0, "bench bin decode", d.frames());
+
+  uint32_t jsonOk = 0;
+  t0 = nowNs();
+  for (uint32_t i = 0; i < frames; i++) {
+    const double v = decodeJson(json.data() + jsonOff[i], jsonOff[i + 1] - jsonOff[i] - 1);
+    if (v >= 0) jsonOk++;
+    sink = sink + v;
+  }
+  const uint64_t jsonDec = nowNs() - t0;
+  check(jsonOk == frames, "bench json decode", jsonOk);
+  (void)sink;
+
+  std::printf("%u frames, FullV1 vs the same fields as a JSON line\n", frames);
+  std::printf("%-6s %10s %12s %12s %14s\n", "format", "bytes/frm", "encode ns", "decode ns", "decode MB/s");
+  std::printf("%-6s %10.1f %12.0f %12.0f %14.1f\n", "bin", (double)binLen / frames,
+              (double)binEnc / frames, (double)binDec / frames, binLen * 1e3 / binDec);
+  std::printf("%-6s %10.1f %12.0f %12.0f %14.1f\n", "json", (double)jsonLen / frames,
+              (double)jsonEnc / frames, (double)jsonDec / frames, jsonLen * 1e3 / jsonDec);
+  std::printf("bin/json: bytes %.1f%%  encode %.1f%%  decode %.1f%%\n",
+              100.0 * binLen / jsonLen, 100.0 * binEnc / jsonEnc, 100.0 * binDec / jsonDec);
+
+  std::vector<uint8_t> big(1 << 20);
+  for (uint8_t& b : big) b = (uint8_t)rnd();
+  t0 = nowNs();
+  volatile uint16_t c = crc16(big.data(), big.size());
+  const uint64_t crcNs = nowNs() - t0;
+  (void)c;
+  std::printf("crc16 %.1f MB/s\n", big.size() * 1e3 / crcNs);
+}
+
+int main(int argc, char** argv) {
+  uint32_t frames = 200000;
+  bool checksOnly = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:c")) != -1) {
+    switch (opt) {
+      case 'n': frames = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 's': s_rng = (uint32_t)strtoul(optarg, nullptr, 10) | 1; break;
+      case 'c': checksOnly = true; break;
+      default:
+        std::fprintf(stderr, "usage: %s [-n frames] [-s seed] [-c]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (frames < 1) frames = 1;
+
+  check(crc16((const uint8_t*)"123456789", 9) == 0x29B1, "crc16 check value", 0);
+  checkCobs();
+  checkFrames();
+  checkCrc();
+  checkResync();
+  checkScale();
+  std::printf("checks: %s (%u failed)\n", s_fails ? "FAIL" : "ok", s_fails);
+
+  if (!checksOnly) bench(frames);
+  return s_fails ? 1 : 0;
+}
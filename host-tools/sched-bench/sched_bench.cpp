@@ -0,0 +1,118 @@
+// sched_bench - overhead of the firmware's cooperative scheduler (TaskSched)
+//
+//   sched_bench [-n passes]
+//
+// Runs the real task_sched.cpp on the host with empty task bodies and
+// compares against calling the same bodies straight from a loop, so the
+// difference is the scheduler itself: the due check, two clock reads
+// per dispatch and the stats update.
+
+#include "task_sched.h"
+#include "time_mgr.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+// The scheduler's clock; real time here, not the simulator's
+namespace TimeMgr {
+uint64_t nowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+uint64_t nowMs() { return nowUs() / 1000; }
+} // namespace TimeMgr
+
+static volatile uint32_t g_sink = 0;
+
+template <int N> static void body() { g_sink = g_sink + N; }
+
+typedef void (*Fn)();
+static const Fn BODIES[16] = {
+  body<0>, body<1>, body<2>,  body<3>,  body<4>,  body<5>,  body<6>,  body<7>,
+  body<8>, body<9>, body<10>, body<11>, body<12>, body<13>, body<14>, body<15>,
+};
+static const char* const NAMES[16] = {
+  "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+  "t8", "t9", "t10", "t11", "t12", "t13", "t14", "t15",
+};
+
+static double nsPer(std::chrono::steady_clock::time_point t0, uint64_t n) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+}
+
+// Scheduler holds its table in statics: one configuration per process
+// would be cleaner, but re-adding by name with period changes is enough
+static void setup(int n, uint32_t periodUs) {
+  for (int i = 0; i < n; i++) {
+    TaskSched::TaskDef d = { NAMES[i], BODIES[i], periodUs, (uint8_t)i, 0, TaskSched::Overrun::Skip };
+    TaskSched::add(d);
+  }
+  for (int i = n; i < 16; i++) TaskSched::setEnabled(TaskSched::find(NAMES[i]), false);
+  for (int i = 0; i < n; i++) TaskSched::setEnabled(TaskSched::find(NAMES[i]), true);
+  TaskSched::resetStats();
+}
+
+int main(int argc, char** argv) {
+  uint64_t passes = 2000000;
+  if (argc > 2 && argv[1][0] == '-' && argv[1][1] == 'n') passes = strtoull(argv[2], nullptr, 0);
+
+  // clock cost, for reading the numbers below
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t acc = 0;
+  for (uint64_t i = 0; i < passes; i++) acc += TimeMgr::nowUs();
+  const double clockNs = nsPer(t0, passes);
+  g_sink = (uint32_t)acc;
+  printf("clock read (TimeMgr::nowUs): %.1f ns\n\n", clockNs);
+
+  printf("%-5s %-22s %12s %12s %14s\n", "tasks", "case", "direct ns", "sched ns", "ns/dispatch");
+  static const int COUNTS[] = { 1, 4, 9, 16 };
+  for (int n : COUNTS) {
+    // every task due every pass
+    t0 = std::chrono::steady_clock::now();
+    for (uint64_t p = 0; p < passes; p++) for (int i = 0; i < n; i++) BODIES[i]();
+    const double direct = nsPer(t0, passes);
+
+    setup(n, 0);
+    t0 = std::chrono::steady_clock::now();
+    for (uint64_t p = 0; p < passes; p++) TaskSched::runPass();
+    const double sched = nsPer(t0, passes);
+    printf("%-5d %-22s %12.1f %12.1f %14.1f\n", n, "all due", direct, sched, (sched - direct) / n);
+
+    // nothing due: the cost of an idle pass
+    setup(n, 1000000000u);
+    TaskSched::runPass();   // consume the initial release
+    t0 = std::chrono::steady_clock::now();
+    for (uint64_t p = 0; p < passes; p++) TaskSched::runPass();
+    const double idle = nsPer(t0, passes);
+    printf("%-5d %-22s %12s %12.1f %14s\n", n, "none due", "-", idle, "-");
+  }
+
+  // The firmware's table shape: 3 every-pass tasks, 6 periodic
+  static const struct { uint32_t period; } FW[9] = {
+    { 0 }, { 0 }, { 10000 }, { 5000 }, { 0 }, { 10000 }, { 5000 }, { 100000 }, { 1000000 },
+  };
+  for (int i = 0; i < 9; i++) {
+    TaskSched::TaskDef d = { NAMES[i], BODIES[i], FW[i].period, (uint8_t)i, 0, TaskSched::Overrun::Skip };
+    TaskSched::add(d);
+  }
+  for (int i = 9; i < 16; i++) TaskSched::setEnabled(TaskSched::find(NAMES[i]), false);
+  TaskSched::resetStats();
+  const uint64_t fwPasses = passes * 2;
+  t0 = std::chrono::steady_clock::now();
+  for (uint64_t p = 0; p < fwPasses; p++) TaskSched::runPass();
+  const double fw = nsPer(t0, fwPasses);
+  printf("\nfirmware-shaped table (9 tasks, 3 every pass): %.1f ns/pass, %.2f M passes/s\n",
+         fw, 1e3 / fw);
+  for (size_t i = 0; i < TaskSched::count(); i++) {
+    const TaskSched::TaskDef* d = TaskSched::def(i);
+    const TaskSched::Stats st = TaskSched::stats(i);
+    if (!st.runs) continue;
+    printf("  %-4s period %7lu us  runs %10lu  run max %5lu us  jit max %5lu us  skipped %lu\n",
+           d->name, (unsigned long)d->periodUs, (unsigned long)st.runs, (unsigned long)st.runMaxUs,
+           (unsigned long)st.jitMaxUs, (unsigned long)st.skipped);
+  }
+  return 0;
+}
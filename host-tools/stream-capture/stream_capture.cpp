@@ -0,0 +1,198 @@
+// stream_capture - record the raw ADC stream (TlmProto SCHEMA_RAW_V1)
+//
+//   stream_capture [-t seconds] [-k tick_us] [-m mask] [-o out.csv] <port>
+//
+// Starts the stream with {"cmd":"stream","on":1,...}, writes one CSV row
+// per sample (read index, device time, channel, mV) and stops the stream
+// on exit. Loss is reported from frame sequence gaps and from first_idx,
+// which has to continue where the previous batch ended.
+
+#include "tlm_proto.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace TlmProto;
+
+static volatile sig_atomic_t g_stop = 0;
+static void onSigint(int) { g_stop = 1; }
+
+static const char* CH_NAMES[] = { "volt", "ntc", "load", "bchg", "bdsg", "ch5", "ch6", "ch7" };
+
+static void makeRaw(int fd) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0) return;
+  cfmakeraw(&t);
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &t);
+}
+
+static bool sendLine(int fd, const std::string& s) {
+  std::string l = s + "\n";
+  return write(fd, l.data(), l.size()) == (ssize_t)l.size();
+}
+
+int main(int argc, char** argv) {
+  double seconds = 10.0;
+  unsigned tickUs = 1000;
+  unsigned mask = 0x1F;
+  const char* outPath = nullptr;
+  const char* port = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:k:m:o:")) != -1) {
+    switch (opt) {
+      case 't': seconds = std::atof(optarg); break;
+      case 'k': tickUs = (unsigned)std::strtoul(optarg, nullptr, 0); break;
+      case 'm': mask = (unsigned)std::strtoul(optarg, nullptr, 0); break;
+      case 'o': outPath = optarg; break;
+      default: break;
+    }
+  }
+  if (optind < argc) port = argv[optind];
+  if (!port) {
+    std::fprintf(stderr, "usage: %s [-t seconds] [-k tick_us] [-m mask] [-o out.csv] <port>\n", argv[0]);
+    return 2;
+  }
+
+  int fd = open(port, O_RDWR | O_NOCTTY);
+  if (fd < 0) { std::perror(port); return 1; }
+  if (isatty(fd)) makeRaw(fd);
+
+  FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+  if (!out) { std::perror(outPath); return 1; }
+  std::fprintf(out, "idx,t_us,ch,name,mv\n");
+
+  char cmd[96];
+  std::snprintf(cmd, sizeof(cmd), "{\"cmd\":\"stream\",\"on\":1,\"tick_us\":%u,\"mask\":%u}", tickUs, mask);
+  if (!sendLine(fd, cmd)) { std::perror("write"); return 1; }
+
+  std::signal(SIGINT, onSigint);
+
+  Decoder dec;
+  bool streaming = false;
+  std::string line;
+
+  uint64_t bytes = 0, samples = 0;
+  uint32_t packets = 0, seqGaps = 0, lostPackets = 0, otherFrames = 0;
+  uint32_t maxDecim = 1;
+  bool haveSeq = false;
+  uint16_t lastSeq = 0;
+  RawHdrV1 prev = {};
+  uint32_t idxGaps = 0, idxBack = 0;   // first_idx not where the last batch ended
+  uint64_t lostSamples = 0;
+  uint64_t tBase = 0;          // unwrapped device time
+  uint32_t tPrev = 0;
+  bool haveT = false;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  auto tFirst = t0;
+
+  uint8_t buf[8192];
+  while (!g_stop) {
+    const double el = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (el >= seconds) break;
+
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 100) <= 0) continue;
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) break;
+    bytes += (uint64_t)n;
+
+    for (ssize_t i = 0; i < n; i++) {
+      const uint8_t b = buf[i];
+
+      if (!streaming) {
+        if (b == '\n') {
+          if (line.find("\"stream\":1") != std::string::npos) {
+            streaming = true;
+            tFirst = std::chrono::steady_clock::now();
+          } else if (line.find("\"stream\":0") != std::string::npos) {
+            std::fprintf(stderr, "device refused stream: %s\n", line.c_str());
+            g_stop = 1;
+          }
+          line.clear();
+        } else if (line.size() < 2048) {
+          line.push_back((char)b);
+        }
+        continue;
+      }
+
+      if (!dec.push(b)) continue;
+      if (dec.schema() != SCHEMA_RAW_V1 || dec.payloadLen() < sizeof(RawHdrV1)) {
+        otherFrames++;   // 1 Hz telemetry etc.
+        continue;
+      }
+
+      RawHdrV1 h;
+      std::memcpy(&h, dec.payload(), sizeof(h));
+      if (dec.payloadLen() != sizeof(h) + h.count * sizeof(RawSampleV1)) continue;
+
+      const bool seqGap = haveSeq && (uint16_t)(lastSeq + 1) != dec.seq();
+      if (seqGap) {
+        seqGaps++;
+        lostPackets += (uint16_t)(dec.seq() - lastSeq - 1);
+      }
+      // Lost samples: what a dropped batch held, or anything the device
+      // lost without a seq gap (idx_gaps, which should stay 0)
+      if (haveSeq) {
+        const uint32_t want = rawNextIdx(prev, h.decim);
+        const int32_t d = (int32_t)(h.first_idx - want);
+        if (d > 0) {
+          lostSamples += (uint32_t)d / (h.decim ? h.decim : 1);
+          if (!seqGap) idxGaps++;
+        } else if (d < 0) {
+          idxBack++;
+        }
+      }
+      prev = h;
+      haveSeq = true;
+      lastSeq = dec.seq();
+      packets++;
+      if (h.decim > maxDecim) maxDecim = h.decim;
+
+      // device time is the low 32 bits of its µs clock (~71 min): unwrap
+      if (haveT && h.t0_us < tPrev) tBase += (1ull << 32);
+      haveT = true;
+      tPrev = h.t0_us;
+      uint64_t t = tBase + h.t0_us;
+
+      const uint8_t* ps = dec.payload() + sizeof(h);
+      for (unsigned k = 0; k < h.count; k++) {
+        RawSampleV1 s;
+        std::memcpy(&s, ps + k * sizeof(s), sizeof(s));
+        t += s.dt_us;
+        const unsigned ch = s.ch_mv >> RAW_CH_SHIFT;
+        std::fprintf(out, "%u,%llu,%u,%s,%u\n",
+                     h.first_idx + k * (h.decim ? h.decim : 1u), (unsigned long long)t, ch, CH_NAMES[ch & 7],
+                     (unsigned)(s.ch_mv & RAW_MV_MASK));
+        samples++;
+      }
+    }
+  }
+
+  sendLine(fd, "{\"cmd\":\"stream\",\"on\":0}");
+  if (out != stdout) std::fclose(out);
+
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - tFirst).count();
+  std::fprintf(stderr,
+               "packets=%u lost_packets=%u seq_gaps=%u lost_samples=%llu idx_gaps=%u idx_back=%u "
+               "other_frames=%u crc_err=%u bad=%u "
+               "max_decim=%u samples=%llu bytes=%llu time=%.2fs rate=%.0f samples/s %.1f kB/s\n",
+               packets, lostPackets, seqGaps, (unsigned long long)lostSamples, idxGaps, idxBack,
+               otherFrames, dec.crcErrors(), dec.badFrames(),
+               maxDecim, (unsigned long long)samples, (unsigned long long)bytes, secs,
+               secs > 0 ? samples / secs : 0.0, secs > 0 ? bytes / secs / 1000.0 : 0.0);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,197 @@
+// tlm_decode - host decoder for the binary telemetry frames (TlmProto)
+//
+//   tlm_decode [--switch] [--bin] <port|file|->
+//
+//   --switch  send {"cmd":"proto","fmt":"bin"} first (live port)
+//   --bin     input is raw frames only (no JSON ack line in front)
+//
+// Prints one CSV row per frame on stdout, events and counters on stderr.
+
+#include "tlm_proto.h"
+
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace TlmProto;
+
+static volatile sig_atomic_t g_stop = 0;
+static void onSigint(int) { g_stop = 1; }
+
+static void makeRaw(int fd) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0) return;
+  cfmakeraw(&t);
+  t.c_cc[VMIN] = 1;
+  t.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &t);
+}
+
+static void printHeader() {
+  std::printf("seq,ms,vbat,soc,iload,ichg,idsg,temp,inet,fcc,rem,chg,ui_pending,ui_left_s,"
+              "en_charge,en_dcdc,en_relay,en_load_dsg,en_bypass,chg_done,charging,btn_sleep,"
+              "therm,dtdt,ir\n");
+}
+
+static void printFullV1(uint16_t seq, const uint8_t* p) {
+  FullV1 r;
+  std::memcpy(&r, p, sizeof(r));
+
+  char temp[16];
+  if (r.temp_cx100 == TEMP_INVALID) std::snprintf(temp, sizeof(temp), "nan");
+  else                              std::snprintf(temp, sizeof(temp), "%.2f", r.temp_cx100 / 100.0);
+
+  std::printf("%u,%lu,%.3f,%.1f,%.3f,%.3f,%.3f,%s,%.3f,%u,%u,%d,%d,%u",
+              (unsigned)seq, (unsigned long)r.ms,
+              r.vbat_mv / 1000.0, r.soc_x10 / 10.0,
+              r.iload_ma / 1000.0, r.ichg_ma / 1000.0, r.idsg_ma / 1000.0,
+              temp, r.inet_ma / 1000.0,
+              (unsigned)r.fcc_mah, (unsigned)r.rem_mah,
+              (r.flags & FLAG_CHARGING) ? 1 : 0,
+              (r.flags & FLAG_UI_PENDING) ? 1 : 0,
+              (unsigned)r.ui_left_s);
+  for (int b = 0; b < 8; b++) std::printf(",%d", (r.pins >> b) & 1);
+  std::printf(",,,\n");   // therm / dtdt / ir only come in subscription frames
+}
+
+// Subscription frames: absent fields are left empty. Column order is the
+// Field enum order, which matches the FullV1 columns.
+static void printDeltaV1(uint16_t seq, const uint8_t* p, size_t len) {
+  DeltaHdrV1 h;
+  std::memcpy(&h, p, sizeof(h));
+  size_t off = sizeof(h);
+
+  std::printf("%u,%lu", (unsigned)seq, (unsigned long)h.ms);
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    const bool present = (h.mask & (1u << i)) && off + 2 <= len;
+    uint16_t w = 0;
+    if (present) { w = (uint16_t)(p[off] | (p[off + 1] << 8)); off += 2; }
+
+    if (i == F_PINS) {
+      for (int b = 0; b < 8; b++) {
+        if (present) std::printf(",%d", (w >> b) & 1);
+        else         std::printf(",");
+      }
+      continue;
+    }
+    if (!present) { std::printf(","); continue; }
+
+    const FieldDef& fd = FIELDS[i];
+    if (i == F_TEMP && (int16_t)w == TEMP_INVALID) { std::printf(",nan"); continue; }
+    const double v = (fd.isSigned ? (double)(int16_t)w : (double)w) / fd.scale;
+    std::printf(",%.*f", (int)fd.decimals, v);
+  }
+  std::printf("\n");
+}
+
+// Event frames go to stderr, like the JSON lines, so the CSV stays one
+// row per telemetry frame.
+static void printEventV1(const uint8_t* p) {
+  EventV1 e;
+  std::memcpy(&e, p, sizeof(e));
+  const char* name = e.type < EVT_TYPE_COUNT ? EVENT_NAMES[e.type] : "?";
+  std::fprintf(stderr, "evt: %s seq=%lu boot=%u t_us=%llu", name, (unsigned long)e.seq,
+               (unsigned)e.boot, (unsigned long long)e.t_us);
+  if (e.type == EVT_LOAD_STEP || e.type == EVT_TRIP) std::fprintf(stderr, " a=%.3f", e.value_ma / 1000.0);
+  std::fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+  bool doSwitch = false;
+  bool binOnly = false;
+  const char* path = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (!std::strcmp(argv[i], "--switch"))   doSwitch = true;
+    else if (!std::strcmp(argv[i], "--bin")) binOnly = true;
+    else path = argv[i];
+  }
+  if (!path) {
+    std::fprintf(stderr, "usage: %s [--switch] [--bin] <port|file|->\n", argv[0]);
+    return 2;
+  }
+
+  int fd = !std::strcmp(path, "-") ? STDIN_FILENO : open(path, doSwitch ? O_RDWR : O_RDONLY);
+  if (fd < 0) { std::perror(path); return 1; }
+  if (isatty(fd)) makeRaw(fd);
+
+  if (doSwitch) {
+    static const char cmd[] = "{\"cmd\":\"proto\",\"fmt\":\"bin\"}\n";
+    if (write(fd, cmd, sizeof(cmd) - 1) < 0) { std::perror("write"); return 1; }
+  }
+
+  std::signal(SIGINT, onSigint);
+
+  Decoder dec;
+  bool binary = binOnly;
+  std::string line;
+  uint64_t bytesIn = 0;
+  uint32_t seqGaps = 0, unknownSchema = 0;
+  bool haveSeq = false;
+  uint16_t lastSeq = 0;
+
+  printHeader();
+  auto t0 = std::chrono::steady_clock::now();
+
+  uint8_t buf[4096];
+  while (!g_stop) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) break;
+    bytesIn += (uint64_t)n;
+
+    for (ssize_t i = 0; i < n; i++) {
+      const uint8_t b = buf[i];
+
+      if (!binary) {
+        // JSON lines until the device acks the switch
+        if (b == '\n') {
+          if (line.find("\"proto\":\"bin\"") != std::string::npos) binary = true;
+          else std::fprintf(stderr, "json: %s\n", line.c_str());
+          line.clear();
+        } else if (line.size() < 2048) {
+          line.push_back((char)b);
+        }
+        continue;
+      }
+
+      if (!dec.push(b)) continue;
+
+      if (dec.schema() == SCHEMA_EVENT_V1 && dec.payloadLen() == sizeof(EventV1)) {
+        // own sequence (event seq), not part of the telemetry stream
+        printEventV1(dec.payload());
+        continue;
+      }
+
+      if (dec.schema() != SCHEMA_RAW_V1) {
+        if (haveSeq && (uint16_t)(lastSeq + 1) != dec.seq()) seqGaps++;
+        haveSeq = true;
+        lastSeq = dec.seq();
+      }
+
+      if (dec.schema() == SCHEMA_FULL_V1 && dec.payloadLen() == sizeof(FullV1)) {
+        printFullV1(dec.seq(), dec.payload());
+      } else if (dec.schema() == SCHEMA_DELTA_V1 && dec.payloadLen() >= sizeof(DeltaHdrV1)) {
+        printDeltaV1(dec.seq(), dec.payload(), dec.payloadLen());
+      } else {
+        unknownSchema++;
+      }
+    }
+  }
+
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::fflush(stdout);
+  std::fprintf(stderr,
+               "frames=%u crc_err=%u bad=%u overrun=%u unknown_schema=%u seq_gaps=%u "
+               "bytes=%llu time=%.3fs rate=%.1f frames/s\n",
+               dec.frames(), dec.crcErrors(), dec.badFrames(), dec.overruns(),
+               unknownSchema, seqGaps, (unsigned long long)bytesIn, secs,
+               secs > 0 ? dec.frames() / secs : 0.0);
+  return 0;
+}
@@ -0,0 +1,567 @@
+// trace_replay - run recorded telemetry through the firmware's SocMgr and
+// LoadProt with different parameter sets
+//
+//   trace_replay [-j N] [-p "key=v1,v2 key=lo:hi:step"]... [--csv] <trace>
+//
+// The trace is memory-mapped and parsed once into AdcReadings frames.
+// Every parameter set then runs in its own forked process (the modules
+// keep their state in file statics), N at a time, and sends one Result
+// back over a pipe. Set 0 is always the firmware defaults.
+
+#include "soc_mgr.h"
+#include "load_prot.h"
+#include "time_mgr.h"
+#include "json_tok.h"
+#include "tlm_proto.h"
+#include <Preferences.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ------------------------------------------------------------
+// Replay clock: the modules only ever ask TimeMgr
+// ------------------------------------------------------------
+static uint64_t g_nowMs = 0;
+
+namespace TimeMgr {
+uint64_t nowMs() { return g_nowMs; }
+uint64_t nowUs() { return g_nowMs * 1000; }
+} // namespace TimeMgr
+
+// ------------------------------------------------------------
+// Trace
+// ------------------------------------------------------------
+struct Frame {
+  uint64_t ms;
+  float    vbat, iload, ichg, idsg, temp;
+  float    socRef;        // NAN if the trace has no reference
+  float    rRef;          // true cell resistance (fw_sim r_true), NAN if unknown
+  bool     charging;      // raw charge-detect pin (as loop() passes it)
+  bool     full;          // CHG_DONE active
+};
+
+struct Trace {
+  std::vector<Frame> frames;
+  const char* refName = nullptr;   // column the SOC error is measured against
+  size_t skipped = 0;
+};
+
+// ms columns restart at every boot (log-fetch) or wrap at 32 bit
+// (tlm-decode): keep a running offset so replay time never goes back.
+struct Unwrap {
+  uint64_t off = 0, prev = 0;
+  bool any = false;
+  uint64_t operator()(uint64_t t) {
+    if (any && t + off < prev) {
+      const uint64_t back = prev - off - t;
+      off += back > 0x80000000ull ? 0x100000000ull : back;
+    }
+    any = true;
+    prev = t + off;
+    return prev;
+  }
+};
+
+static bool parseJsonLine(char* s, size_t n, Frame& f, bool& hasRef, Unwrap& uw) {
+  using namespace JsonTok;
+  static Token t[64];
+  const int nt = parse(s, n, t, 64);
+  if (nt <= 0 || t[0].type != OBJECT) return false;
+
+  auto num = [&](const char* key, float def) {
+    const int v = find(s, t, nt, 0, key);
+    float x;
+    return (v >= 0 && toFloat(s, t[v], x)) ? x : def;
+  };
+
+  int64_t ms;
+  const int vm = find(s, t, nt, 0, "ms");
+  const int vb = find(s, t, nt, 0, "vbat");
+  if (vm < 0 || vb < 0 || !toInt64(s, t[vm], ms)) return false;   // acks etc.
+
+  f.ms    = uw((uint64_t)ms);
+  f.vbat  = num("vbat", NAN);
+  f.iload = num("iload", 0);
+  f.ichg  = num("ichg", 0);
+  f.idsg  = num("idsg", 0);
+  f.temp  = num("temp", NAN);
+  f.socRef = num("soc", NAN);
+  f.rRef = NAN;
+  hasRef = hasRef || !std::isnan(f.socRef);
+
+  f.charging = num("chg", 0) != 0;
+  f.full = false;
+  const int pins = find(s, t, nt, 0, "pins");
+  if (pins >= 0 && t[pins].type == OBJECT) {
+    bool b;
+    int v = find(s, t, nt, pins, "charging");
+    if (v >= 0 && toBool(s, t[v], b)) f.charging = b;
+    v = find(s, t, nt, pins, "chg_done");
+    if (v >= 0 && toBool(s, t[v], b)) f.full = b;
+  }
+  return true;
+}
+
+// Column indices for the CSV layouts we know (tlm-decode, log-fetch -d,
+// fw_sim --trace); -1 = not present
+struct Cols {
+  int ms = -1, t_s = -1, vbat = -1, iload = -1, ichg = -1, idsg = -1, temp = -1;
+  int soc = -1, soc_true = -1, chg = -1, charging = -1, chg_done = -1, pins = -1, asleep = -1;
+  int r_true = -1;
+};
+
+static bool parseHeader(const char* s, size_t n, Cols& c) {
+  struct { const char* name; int Cols::*col; } MAP[] = {
+    { "ms", &Cols::ms }, { "t_s", &Cols::t_s }, { "vbat", &Cols::vbat },
+    { "iload", &Cols::iload }, { "ichg", &Cols::ichg }, { "idsg", &Cols::idsg },
+    { "temp", &Cols::temp }, { "temp_c", &Cols::temp }, { "soc", &Cols::soc },
+    { "soc_true", &Cols::soc_true }, { "chg", &Cols::chg }, { "charging", &Cols::charging },
+    { "chg_done", &Cols::chg_done }, { "pins", &Cols::pins }, { "asleep", &Cols::asleep },
+    { "r_true", &Cols::r_true },
+  };
+  int col = 0;
+  size_t i = 0;
+  while (i <= n) {
+    size_t j = i;
+    while (j < n && s[j] != ',') j++;
+    for (auto& m : MAP) {
+      if (strlen(m.name) == j - i && !memcmp(s + i, m.name, j - i)) c.*m.col = col;
+    }
+    col++;
+    i = j + 1;
+  }
+  return (c.ms >= 0 || c.t_s >= 0) && c.vbat >= 0 && c.ichg >= 0 && c.idsg >= 0;
+}
+
+static bool parseCsvRow(const char* s, size_t n, const Cols& c, Frame& f, Unwrap& uw) {
+  double v[32];
+  int nv = 0;
+  const char* p = s;
+  const char* end = s + n;
+  while (p <= end && nv < 32) {
+    char* q;
+    double x = strtod(p, &q);
+    if (q == p) x = NAN;                      // empty cell (subscription rows)
+    v[nv++] = x;
+    while (q < end && *q != ',') q++;
+    p = q + 1;
+  }
+  auto at = [&](int i, double def) { return (i >= 0 && i < nv && !std::isnan(v[i])) ? v[i] : def; };
+
+  const double t = c.ms >= 0 ? at(c.ms, NAN) : at(c.t_s, NAN) * 1000.0;
+  if (std::isnan(t) || std::isnan(at(c.vbat, NAN))) return false;
+  if (at(c.asleep, 0) != 0) return false;     // firmware doesn't run while asleep
+
+  f.ms    = uw((uint64_t)t);
+  f.vbat  = (float)at(c.vbat, NAN);
+  f.iload = (float)at(c.iload, 0);
+  f.ichg  = (float)at(c.ichg, 0);
+  f.idsg  = (float)at(c.idsg, 0);
+  f.temp  = (float)at(c.temp, NAN);
+  f.socRef = (float)(c.soc_true >= 0 ? at(c.soc_true, NAN) : at(c.soc, NAN));
+  f.rRef  = (float)at(c.r_true, NAN);
+
+  const int pins = (int)at(c.pins, 0);
+  f.charging = c.charging >= 0 ? at(c.charging, 0) != 0
+             : c.pins >= 0     ? (pins & TlmProto::PIN_BIT_CHARGING) != 0
+             :                   at(c.chg, 0) != 0;
+  f.full = c.chg_done >= 0 ? at(c.chg_done, 0) != 0
+         : (pins & TlmProto::PIN_BIT_CHG_DONE) != 0;
+  return true;
+}
+
+static bool loadTrace(const char* path, Trace& tr) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) { perror(path); return false; }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) { fprintf(stderr, "%s: empty\n", path); close(fd); return false; }
+  const size_t size = (size_t)st.st_size;
+  const char* m = (const char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) { perror("mmap"); return false; }
+  madvise((void*)m, size, MADV_SEQUENTIAL);
+
+  Cols cols;
+  bool csv = false, header = false, hasRef = false;
+  Unwrap uw;
+  char line[2048];
+  tr.frames.reserve(size / 64);
+
+  for (const char* p = m; p < m + size;) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(m + size - p));
+    const char* e = nl ? nl : m + size;
+    size_t n = (size_t)(e - p);
+    const char* s = p;
+    p = e + 1;
+    if (n && s[n - 1] == '\r') n--;
+    if (n == 0) continue;
+
+    Frame f;
+    if (s[0] == '{') {
+      if (n >= sizeof(line)) { tr.skipped++; continue; }
+      memcpy(line, s, n);             // the tokenizer writes into its input
+      line[n] = '\0';
+      if (parseJsonLine(line, n, f, hasRef, uw)) tr.frames.push_back(f);
+      else tr.skipped++;
+    } else if (!header) {
+      header = csv = parseHeader(s, n, cols);
+      if (!header) { fprintf(stderr, "%s: no usable CSV header (need ms|t_s, vbat, ichg, idsg)\n", path); break; }
+    } else if (csv && parseCsvRow(s, n, cols, f, uw)) {
+      tr.frames.push_back(f);
+    } else {
+      tr.skipped++;
+    }
+  }
+  munmap((void*)m, size);
+
+  if (csv) tr.refName = cols.soc_true >= 0 ? "soc_true" : cols.soc >= 0 ? "soc" : nullptr;
+  else     tr.refName = hasRef ? "soc" : nullptr;
+  return !tr.frames.empty();
+}
+
+// ------------------------------------------------------------
+// Parameter sets (keys as in CmdMgr's config table where they overlap)
+// ------------------------------------------------------------
+struct Set {
+  SocMgr::Params   soc;
+  LoadProt::Config lp;
+  float cap_mah = 2000.0f;   // SocMgr::begin() capacity (s_cfg.soc_cap_mah)
+  float soc0 = NAN;          // start SOC %, NAN = first reference value (else 100)
+  std::string label;
+};
+
+enum FieldType : uint8_t { F_FLOAT, F_U32, F_BOOL };
+
+struct Field {
+  const char* key;
+  FieldType   type;
+  size_t      off;
+};
+
+#define SET_FIELD(key, type, member) { key, type, offsetof(Set, member) }
+
+static const Field FIELDS[] = {
+  SET_FIELD("cap_mah",      F_FLOAT, cap_mah),
+  SET_FIELD("soc0",         F_FLOAT, soc0),
+  SET_FIELD("i_active_a",   F_FLOAT, soc.i_active_a),
+  SET_FIELD("i_sleep_a",    F_FLOAT, soc.i_sleep_a),
+  SET_FIELD("adc_min_a",    F_FLOAT, soc.adc_min_a),
+  SET_FIELD("vbat_full",    F_FLOAT, soc.vbat_full),
+  SET_FIELD("vbat_empty",   F_FLOAT, soc.vbat_empty),
+  SET_FIELD("empty_ms",     F_U32,   soc.empty_time_ms),
+  SET_FIELD("ir_comp",      F_BOOL,  soc.ir_comp),
+  SET_FIELD("ir_min_step_a", F_FLOAT, soc.ir_min_step_a),
+  SET_FIELD("ir_lambda",    F_FLOAT, soc.ir_lambda),
+  SET_FIELD("vbat_cutoff",  F_FLOAT, soc.vbat_cutoff),
+  SET_FIELD("fcc_slope",    F_FLOAT, soc.fcc_slope),
+  SET_FIELD("fcc_icept",    F_FLOAT, soc.fcc_icept),
+  SET_FIELD("fcc_min",      F_FLOAT, soc.fcc_min),
+  SET_FIELD("fcc_max",      F_FLOAT, soc.fcc_max),
+  SET_FIELD("trip_a",       F_FLOAT, lp.trip_A),
+  SET_FIELD("trip_ms",      F_U32,   lp.tripDelayMs),
+  SET_FIELD("reset_safe_a", F_FLOAT, lp.resetSafe_A),
+  SET_FIELD("latch",        F_BOOL,  lp.latch),
+  SET_FIELD("retry_ms",     F_U32,   lp.retryDelayMs),
+};
+
+#undef SET_FIELD
+
+static const Field* findField(const char* key) {
+  for (const Field& f : FIELDS) {
+    if (!strcmp(f.key, key)) return &f;
+  }
+  return nullptr;
+}
+
+static void setField(Set& s, const Field& f, double v) {
+  uint8_t* p = reinterpret_cast<uint8_t*>(&s) + f.off;
+  switch (f.type) {
+    case F_FLOAT: *reinterpret_cast<float*>(p)    = (float)v; break;
+    case F_U32:   *reinterpret_cast<uint32_t*>(p) = (uint32_t)(v + 0.5); break;
+    case F_BOOL:  *reinterpret_cast<bool*>(p)     = v != 0; break;
+  }
+}
+
+// "key=a,b,c" or "key=lo:hi:step" -> list of values
+static bool parseValues(const char* s, std::vector<double>& out) {
+  const char* c1 = strchr(s, ':');
+  if (c1) {
+    char* e;
+    const double lo = strtod(s, &e);
+    const double hi = strtod(c1 + 1, &e);
+    const char* c2 = strchr(c1 + 1, ':');
+    const double step = c2 ? strtod(c2 + 1, &e) : 1.0;
+    if (!(step > 0) || hi < lo || (hi - lo) / step > 10000) return false;
+    for (double v = lo; v <= hi + step * 1e-6; v += step) out.push_back(v);
+    return true;
+  }
+  for (const char* p = s; *p;) {
+    char* e;
+    out.push_back(strtod(p, &e));
+    if (e == p) return false;
+    p = (*e == ',') ? e + 1 : e;
+    if (*e && *e != ',') return false;
+  }
+  return !out.empty();
+}
+
+// One -p argument: the cartesian product of its keys' value lists
+static bool expandSpec(const char* spec, std::vector<Set>& sets) {
+  struct Axis { const Field* f; std::string key; std::vector<double> vals; };
+  std::vector<Axis> axes;
+
+  std::string buf(spec);
+  for (char* tok = strtok(&buf[0], " ;"); tok; tok = strtok(nullptr, " ;")) {
+    char* eq = strchr(tok, '=');
+    if (!eq) { fprintf(stderr, "-p: expected key=values, got '%s'\n", tok); return false; }
+    *eq = '\0';
+    Axis a;
+    a.f = findField(tok);
+    a.key = tok;
+    if (!a.f) { fprintf(stderr, "-p: unknown key '%s'\n", tok); return false; }
+    if (!parseValues(eq + 1, a.vals)) { fprintf(stderr, "-p: bad values for '%s'\n", tok); return false; }
+    axes.push_back(a);
+  }
+
+  std::vector<size_t> idx(axes.size(), 0);
+  for (;;) {
+    Set s;
+    char lab[48];
+    for (size_t i = 0; i < axes.size(); i++) {
+      setField(s, *axes[i].f, axes[i].vals[idx[i]]);
+      snprintf(lab, sizeof(lab), "%s%s=%g", s.label.empty() ? "" : " ", axes[i].key.c_str(), axes[i].vals[idx[i]]);
+      s.label += lab;
+    }
+    sets.push_back(s);
+
+    size_t k = 0;
+    while (k < axes.size() && ++idx[k] == axes[k].vals.size()) idx[k++] = 0;
+    if (k == axes.size()) break;
+  }
+  return true;
+}
+
+// ------------------------------------------------------------
+// Replay one set
+// ------------------------------------------------------------
+struct Result {
+  uint32_t idx;
+  uint32_t frames;
+  double   socRms, socMax, socEndErr;   // vs the reference column, NAN if none
+  float    socEnd, fccEnd;
+  uint32_t trips;
+  double   firstTripS;                  // NAN if never
+  double   offS;                        // time LoadProt kept the load off
+  float    irEnd;                       // SocMgr's R at the end, NAN if not learnt
+  float    irErr;                       // irEnd - r_true, NAN without r_true
+  uint32_t irSteps, irRej;
+  double   emptyS;                      // first time SOC reached 0, NAN if never
+  float    emptyRef;                    // reference SOC at that moment
+};
+
+static Result replay(const Trace& tr, const Set& set, uint32_t idx) {
+  Result r;
+  memset(&r, 0, sizeof(r));
+  r.idx = idx;
+  r.firstTripS = NAN;
+  r.emptyS = NAN;
+  r.emptyRef = NAN;
+
+  const std::vector<Frame>& fr = tr.frames;
+  const uint64_t t0 = fr.front().ms;
+
+  // Start state: SocMgr restores "used" from NVS in begin()
+  float soc0 = set.soc0;
+  if (std::isnan(soc0)) soc0 = std::isnan(fr.front().socRef) ? 100.0f : fr.front().socRef;
+  Preferences prefs;
+  prefs.begin("soc", false);
+  prefs.putFloat("fcc", set.cap_mah);
+  prefs.putFloat("used", set.cap_mah * (1.0f - soc0 / 100.0f));
+
+  g_nowMs = t0;
+  SocMgr::setParams(set.soc);
+  SocMgr::begin(set.cap_mah);
+  LoadProt::begin(set.lp);
+
+  double sq = 0;
+  size_t nRef = 0;
+  bool wasTripped = false;
+  uint64_t prevMs = t0;
+
+  for (const Frame& f : fr) {
+    g_nowMs = f.ms;
+    AdcReadings a;
+    a.vbat_meas_sys_v = f.vbat;
+    a.temp_c = f.temp;
+    a.iload_a = f.iload;
+    a.ibatt_chg_a = f.ichg;
+    a.ibatt_dsg_a = f.idsg;
+
+    if (wasTripped) r.offS += (f.ms - prevMs) * 1e-3;
+    prevMs = f.ms;
+
+    // same order as loop()
+    LoadProt::update(a);
+    SocMgr::update(a, f.charging, false, f.full);
+
+    const bool t = LoadProt::tripped();
+    if (t && !wasTripped) {
+      if (r.trips++ == 0) r.firstTripS = (f.ms - t0) * 1e-3;
+    }
+    wasTripped = t;
+
+    if (!std::isnan(f.socRef)) {
+      const double e = SocMgr::soc() - f.socRef;
+      sq += e * e;
+      nRef++;
+      if (fabs(e) > r.socMax) r.socMax = fabs(e);
+      r.socEndErr = e;
+    }
+    if (std::isnan(r.emptyS) && SocMgr::soc() <= 0.0f) {
+      r.emptyS = (f.ms - t0) * 1e-3;
+      r.emptyRef = f.socRef;
+    }
+  }
+
+  r.frames = (uint32_t)fr.size();
+  r.socRms = nRef ? sqrt(sq / nRef) : NAN;
+  if (!nRef) { r.socMax = NAN; r.socEndErr = NAN; }
+  r.socEnd = SocMgr::soc();
+  r.fccEnd = SocMgr::fcc();
+  const SocMgr::IrInfo ir = SocMgr::ir();
+  r.irEnd = ir.ohm;
+  r.irErr = ir.ohm - fr.back().rRef;
+  r.irSteps = ir.steps;
+  r.irRej = ir.rejects;
+  return r;
+}
+
+// ------------------------------------------------------------
+
+static void usage() {
+  fprintf(stderr,
+    "usage: trace_replay [-j N] [-p spec]... [--csv] <trace.csv|trace.jsonl>\n"
+    "  -p spec   parameter sets: \"key=v1,v2 key2=lo:hi:step\" (cartesian product);\n"
+    "            repeat -p for more groups. Set 0 is always the defaults.\n"
+    "  -j N      parallel processes (default: all cores)\n"
+    "  --csv     machine-readable output\n"
+    "  -k        list parameter keys and defaults\n");
+}
+
+static void listKeys() {
+  Set def;
+  for (const Field& f : FIELDS) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&def) + f.off;
+    switch (f.type) {
+      case F_FLOAT: printf("%-13s %g\n", f.key, (double)*reinterpret_cast<const float*>(p)); break;
+      case F_U32:   printf("%-13s %u\n", f.key, *reinterpret_cast<const uint32_t*>(p)); break;
+      case F_BOOL:  printf("%-13s %d\n", f.key, *reinterpret_cast<const bool*>(p) ? 1 : 0); break;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  std::vector<Set> sets(1);
+  sets[0].label = "defaults";
+  int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+  bool csv = false;
+  const char* path = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc) { if (!expandSpec(argv[++i], sets)) return 2; }
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc) jobs = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--csv")) csv = true;
+    else if (!strcmp(argv[i], "-k")) { listKeys(); return 0; }
+    else if (argv[i][0] == '-') { usage(); return 2; }
+    else path = argv[i];
+  }
+  if (!path) { usage(); return 2; }
+
+  const auto w0 = std::chrono::steady_clock::now();
+  Trace tr;
+  if (!loadTrace(path, tr)) { fprintf(stderr, "%s: no frames\n", path); return 1; }
+  const double parseS = std::chrono::duration<double>(std::chrono::steady_clock::now() - w0).count();
+  const double spanH = (tr.frames.back().ms - tr.frames.front().ms) / 3.6e6;
+  fprintf(stderr, "%s: %zu frames (%zu skipped), %.2f h, parsed in %.3f s, reference: %s\n",
+          path, tr.frames.size(), tr.skipped, spanH, parseS, tr.refName ? tr.refName : "none");
+
+  // Workers inherit the parsed trace; results come back as fixed-size
+  // records (< PIPE_BUF, so writes from different children don't mix)
+  int fds[2];
+  if (pipe(fds) != 0) { perror("pipe"); return 1; }
+  std::vector<Result> results(sets.size());
+  std::vector<bool> got(sets.size(), false);
+
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  auto drain = [&]() {
+    Result r;
+    while (read(fds[0], &r, sizeof(r)) == (ssize_t)sizeof(r)) {
+      if (r.idx < results.size()) { results[r.idx] = r; got[r.idx] = true; }
+    }
+  };
+  // Keep the pipe drained while waiting, or children block on a full pipe
+  auto reapOne = [&]() {
+    for (;;) {
+      drain();
+      if (waitpid(-1, nullptr, WNOHANG) > 0) return;
+      pollfd pfd = { fds[0], POLLIN, 0 };
+      poll(&pfd, 1, 10);
+    }
+  };
+
+  int running = 0;
+  for (size_t i = 0; i < sets.size(); i++) {
+    if (running >= jobs) { reapOne(); running--; }
+    const pid_t pid = fork();
+    if (pid < 0) { perror("fork"); return 1; }
+    if (pid == 0) {
+      close(fds[0]);
+      const Result r = replay(tr, sets[i], (uint32_t)i);
+      if (write(fds[1], &r, sizeof(r)) != (ssize_t)sizeof(r)) _exit(1);
+      _exit(0);
+    }
+    running++;
+  }
+  close(fds[1]);
+  while (running > 0) { reapOne(); running--; }
+  drain();
+
+  const double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - w0).count();
+
+  if (csv) printf("set,params,frames,soc_rms,soc_max,soc_end_err,soc_end,fcc_end,trips,first_trip_s,off_s,"
+                  "ir_mohm,ir_err_mohm,ir_steps,ir_rej,empty_s,empty_ref\n");
+  for (size_t i = 0; i < sets.size(); i++) {
+    if (!got[i]) { fprintf(stderr, "set %zu: worker failed\n", i); continue; }
+    const Result& r = results[i];
+    if (csv) {
+      printf("%zu,\"%s\",%u,%.3f,%.3f,%.3f,%.2f,%.0f,%u,%.1f,%.1f,%.1f,%.1f,%u,%u,%.0f,%.2f\n",
+             i, sets[i].label.c_str(), r.frames,
+             r.socRms, r.socMax, r.socEndErr, r.socEnd, r.fccEnd, r.trips, r.firstTripS, r.offS,
+             r.irEnd * 1000.0f, r.irErr * 1000.0f, r.irSteps, r.irRej, r.emptyS, r.emptyRef);
+    } else {
+      printf("%3zu  soc_err rms %6.2f max %6.2f end %+6.2f  soc_end %5.1f  fcc %4.0f  "
+             "trips %4u first %8.1f s  off %8.1f s  ir %6.1f mOhm err %+5.1f steps %4u rej %4u  "
+             "empty %8.0f s ref %5.2f  %s\n",
+             i, r.socRms, r.socMax, r.socEndErr, r.socEnd, r.fccEnd, r.trips,
+             r.firstTripS, r.offS, r.irEnd * 1000.0f, r.irErr * 1000.0f, r.irSteps, r.irRej,
+             r.emptyS, r.emptyRef, sets[i].label.c_str());
+    }
+  }
+  fprintf(stderr, "%zu sets x %zu frames in %.2f s (%d jobs)\n", sets.size(), tr.frames.size(), wallS, jobs);
+  return 0;
+}